@@ -349,32 +349,35 @@ AVLNode *avl_delete(AVLNode *tree, void *scnd_index, float value)
 /**
  * @brief Search for a node with a specific float value in the AVL tree
  *
- * This function searches for a node with a specific value in the AVL tree. If the value is less than the current node, it searches the left subtree, if the value is greater, it searches the right subtree. If the value is equal to the current node, it returns the node.
+ * This function searches for a node with a specific value in the AVL tree. If the value is less than the current node, it searches the left subtree, if the value is greater, it searches the right subtree. If the value is equal to the current node, it keeps searching the left subtree, since rotations can leave nodes with an equal value on either side, so the first node in order with the value is returned.
  *
  * @param tree The AVL tree to search
  * @param value The value to search for
  *
- * @return AVLNode* The node with the specified value
+ * @return AVLNode* The first node with the specified value, NULL if there is none
  */
 AVLNode *avl_search_float(AVLNode *tree, float value)
 {
-    if (tree == NULL)
-    {
-        return NULL;
-    }
+    AVLNode *found = NULL;
 
-    if (value < tree->value)
-    {
-        return avl_search_float(tree->left, value);
-    }
-    else if (value > tree->value)
-    {
-        return avl_search_float(tree->right, value);
-    }
-    else
+    while (tree != NULL)
     {
-        return tree;
+        if (value < tree->value)
+        {
+            tree = tree->left;
+        }
+        else if (value > tree->value)
+        {
+            tree = tree->right;
+        }
+        else
+        {
+            found = tree;
+            tree = tree->left;
+        }
     }
+
+    return found;
 }
 
 /**
@@ -1,50 +1,289 @@
-// * This file contains the implementation of the ZSet data structure. The ZSet is a collection of key-value pairs, where each key is unique and maps to a float value. The ZSet is implemented using a hash table and an AVL tree. The hash table is used to store the key-value pairs, and the AVL tree is used to store the key-value pairs sorted by the value. The ZSet supports adding, removing, and searching for key-value pairs.
+// * This file contains the implementation of the ZSet data structure. The ZSet is a collection of key-value pairs, where each key is unique and maps to a float value. The ZSet is implemented using a hash table and a skiplist. The skiplist stores the key-value pairs sorted by the value, with the rank of every pair, and the hash table maps every key to its node in the skiplist. The hash node and the skiplist node share the key, so a member is a single copy of its key, and the score of a member is found and changed through its node without searching the skiplist by key. The ZSet supports adding, removing, and searching for key-value pairs.
+// * Both are ordered by score, and by key for equal scores, so a (score, key) pair has a single place and is found with a search that never looks at more than one branch. A small ZSet is packed into a single array of (score, key) pairs in the same order instead, which is searched with a binary search, and by key alone with a linear scan. It is converted to the hash table and skiplist once it has more than zset_max_packed_entries members, and stays converted.
 
 #include "ZSet.h"
 
+int zset_max_packed_entries = ZSET_MAX_PACKED_ENTRIES;
+
 /**
- * @brief Compare two secondary indexes
+ * @brief Initializes a new ZSet
+ *
+ * This function initializes a new ZSet, it starts out packed and empty, without a hash table or a skiplist.
  *
- * This function compares two secondary indexes (expected to be strings) and returns 0 if they are equal, 1 otherwise. Necessary since importing AVL Tree module.
+ * @return ZSet* The initialized ZSet
+ */
+ZSet *zset_init()
+{
+    ZSet *zset = (ZSet *)calloc(1, sizeof(ZSet));
+    if (!zset)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    zset->hash_table = NULL;
+    zset->skiplist = NULL;
+
+    return zset;
+}
+
+/**
+ * @brief Checks if a ZSet is packed into a sorted array
  *
- * @param scnd_index1 The first secondary index
- * @param scnd_index2 The second secondary index
+ * @param zset The ZSet
  *
- * @return int 0 if the secondary indexes are equal, 1 otherwise
+ * @return bool true if the ZSet is packed, false if it has a hash table and a skiplist
  */
-int compare_scnd_index(void *scnd_index1, void *scnd_index2)
+bool zset_is_packed(ZSet *zset)
 {
-    if (strcmp((char *)scnd_index1, (char *)scnd_index2) == 0)
+    return zset->hash_table == NULL;
+}
+
+/**
+ * @brief Finds the index of a key in a packed ZSet with a linear scan
+ *
+ * @param zset The packed ZSet
+ * @param key The key to find
+ *
+ * @return int The index of the key, -1 if it is not in the ZSet
+ */
+static int zset_packed_find_key(ZSet *zset, char *key)
+{
+    for (int i = 0; i < zset->num_entries; i++)
     {
-        // check if the strings are equal
-        return 0;
+        if (strcmp(zset->entries[i].key, key) == 0)
+        {
+            return i;
+        }
     }
-    else
+
+    return -1;
+}
+
+/**
+ * @brief Returns the index of the first entry of a packed ZSet that does not go before a score and a key
+ *
+ * @param zset The packed ZSet
+ * @param value The score
+ * @param key The key
+ *
+ * @return int The index, num_entries if every entry goes before the score and the key
+ */
+static int zset_packed_lower_bound(ZSet *zset, float value, char *key)
+{
+    int low = 0;
+    int high = zset->num_entries;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        ZSetEntry *entry = &zset->entries[mid];
+        if (entry->score < value || (entry->score == value && strcmp(entry->key, key) < 0))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief Search a packed ZSet for the entry with a key and a score
+ *
+ * @param zset The packed ZSet
+ * @param key The key to search for
+ * @param value The score of the key
+ *
+ * @return int The index of the entry, -1 if there is none
+ */
+static int zset_packed_search_pair(ZSet *zset, char *key, float value)
+{
+    int index = zset_packed_lower_bound(zset, value, key);
+    if (index == zset->num_entries || zset->entries[index].score != value || strcmp(zset->entries[index].key, key) != 0)
     {
-        return 1;
+        return -1;
     }
+
+    return index;
 }
 
 /**
- * @brief Initializes a new ZSet
+ * @brief Removes the entry at an index of a packed ZSet, the key of the entry is not freed
  *
- * This function initializes a new ZSet with an empty hash table and an empty AVL tree.
+ * @param zset The packed ZSet
+ * @param index The index of the entry
+ */
+static void zset_packed_delete(ZSet *zset, int index)
+{
+    memmove(zset->entries + index, zset->entries + index + 1, (zset->num_entries - index - 1) * sizeof(ZSetEntry));
+    zset->num_entries--;
+}
+
+/**
+ * @brief Inserts an entry into a packed ZSet at the position of its score and key
  *
- * @return ZSet* The initialized ZSet
+ * @param zset The packed ZSet
+ * @param key The key of the entry, owned by the ZSet afterwards, it must not be in the ZSet
+ * @param value The score of the entry
  */
-ZSet *zset_init()
+static void zset_packed_insert(ZSet *zset, char *key, float value)
 {
-    ZSet *zset = (ZSet *)calloc(1, sizeof(ZSet));
-    if (!zset)
+    if (zset->num_entries == zset->capacity)
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        int capacity = zset->capacity ? zset->capacity * 2 : 4;
+        ZSetEntry *entries = realloc(zset->entries, capacity * sizeof(ZSetEntry));
+        if (entries == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        zset->entries = entries;
+        zset->capacity = capacity;
     }
 
-    zset->hash_table = hcreate(INIT_TABLE_SIZE);
-    zset->avl_tree = NULL;
+    int index = zset_packed_lower_bound(zset, value, key);
+    memmove(zset->entries + index + 1, zset->entries + index, (zset->num_entries - index) * sizeof(ZSetEntry));
+    zset->entries[index].score = value;
+    zset->entries[index].key = key;
+    zset->num_entries++;
+}
 
-    return zset;
+/**
+ * @brief Converts a packed ZSet to a hash table and a skiplist
+ *
+ * @param zset The packed ZSet
+ */
+static void zset_convert(ZSet *zset)
+{
+    zset->hash_table = hcreate(HASH_MIN_SIZE);
+    zset->skiplist = skiplist_init();
+
+    for (int i = 0; i < zset->num_entries; i++)
+    {
+        SkipListNode *node = skiplist_insert(zset->skiplist, zset->entries[i].key, zset->entries[i].score);
+        hinsert(zset->hash_table, hinit(node->key, ZSET_MEMBER, node));
+        free(zset->entries[i].key);
+    }
+
+    free(zset->entries);
+    zset->entries = NULL;
+    zset->num_entries = 0;
+    zset->capacity = 0;
+}
+
+/**
+ * @brief Returns the number of members of the ZSet
+ *
+ * @param zset The ZSet
+ *
+ * @return int The number of members
+ */
+int zset_length(ZSet *zset)
+{
+    return zset_is_packed(zset) ? zset->num_entries : zset->skiplist->length;
+}
+
+/**
+ * @brief Counts the members with a score lower than a value, or at most the value
+ *
+ * @param zset The ZSet
+ * @param value The value
+ * @param inclusive true to count the members with a score at most the value, false for the members with a lower score
+ *
+ * @return int The number of members
+ */
+int zset_count_lower(ZSet *zset, float value, bool inclusive)
+{
+    if (!zset_is_packed(zset))
+    {
+        return skiplist_count_lower(zset->skiplist, value, inclusive);
+    }
+
+    int low = 0;
+    int high = zset->num_entries;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        float score = zset->entries[mid].score;
+        if (score < value || (inclusive && score == value))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief Returns the rank of the first member with a score at least a value, members are ranked from 0 by score and key
+ *
+ * @param zset The ZSet
+ * @param value The value
+ *
+ * @return int The rank, -1 if every member has a lower score
+ */
+int zset_rank_of_score(ZSet *zset, float value)
+{
+    int rank = zset_count_lower(zset, value, false);
+    return rank < zset_length(zset) ? rank : -1;
+}
+
+/**
+ * @brief Returns the rank of a member with a score
+ *
+ * @param zset The ZSet
+ * @param key The member
+ * @param value The score of the member
+ *
+ * @return int The rank, -1 if the member does not have the score
+ */
+int zset_rank_of_pair(ZSet *zset, char *key, float value)
+{
+    if (zset_is_packed(zset))
+    {
+        return zset_packed_search_pair(zset, key, value);
+    }
+
+    int rank;
+    return skiplist_search_pair(zset->skiplist, key, value, &rank) ? rank : -1;
+}
+
+/**
+ * @brief Returns the rank of a member, members are ranked from 0 by score and key
+ *
+ * The member is found by key in the hash table, and its rank is summed from the spans of the links on the way down to its node in the skiplist.
+ *
+ * @param zset The ZSet
+ * @param key The member
+ *
+ * @return int The rank, -1 if the member is not in the ZSet
+ */
+int zset_rank(ZSet *zset, char *key)
+{
+    if (zset_is_packed(zset))
+    {
+        return zset_packed_find_key(zset, key);
+    }
+
+    HashNode *hash_node = hget(zset->hash_table, key);
+    if (!hash_node)
+    {
+        return -1;
+    }
+
+    SkipListNode *node = hash_node->value;
+    int rank;
+    skiplist_search_pair(zset->skiplist, node->key, node->score, &rank);
+
+    return rank;
 }
 
 // adds/updates a key in the ZSet
@@ -61,53 +300,207 @@ ZSet *zset_init()
  */
 int zset_add(ZSet *zset, char *key, float value)
 {
+    if (zset_is_packed(zset))
+    {
+        int index = zset_packed_find_key(zset, key);
+        if (index >= 0)
+        {
+            // move the entry to the position of its new score, the key is kept
+            char *key_alloc = zset->entries[index].key;
+            zset_packed_delete(zset, index);
+            zset_packed_insert(zset, key_alloc, value);
+            return 0;
+        }
 
-    HashNode *hash_node = hget(zset->hash_table, key);
+        if (zset->num_entries < zset_max_packed_entries)
+        {
+            char *key_alloc = strdup(key);
+            if (key_alloc == NULL)
+            {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
 
+            zset_packed_insert(zset, key_alloc, value);
+            return 0;
+        }
+
+        zset_convert(zset);
+    }
+
+    HashNode *hash_node = hget(zset->hash_table, key);
     if (hash_node)
     {
-        // if the key already exists, update
+        // if the key already exists, move its node to the new score, the hash node keeps pointing at it
+        skiplist_update_score(zset->skiplist, hash_node->value, value);
+        return 0;
+    }
 
-        // /deserialize the value from the hash node
-        int type = hash_node->valueType;
-        if (type != FLOAT)
-        {
-            fprintf(stderr, "value in zset is somehow not a float\n");
-            return -1;
-        }
+    // the hash node shares the key copied into the skiplist node
+    SkipListNode *node = skiplist_insert(zset->skiplist, key, value);
+    hinsert(zset->hash_table, hinit(node->key, ZSET_MEMBER, node));
+
+    return 0;
+}
 
-        float score = *(float *)hash_node->value;
+// a member of a bulk add, seq orders the members with the same key so the last one wins
+typedef struct
+{
+    float score;
+    char *key;
+    int seq;
+} ZSetPair;
 
-        // delete the hash node from the hash table and the AVL tree
-        hremove(zset->hash_table, key);
-        hfree(hash_node);
+// orders pairs by key, then by seq
+static int zset_pair_compare_key(const void *a, const void *b)
+{
+    const ZSetPair *pair1 = a;
+    const ZSetPair *pair2 = b;
+    int cmp = strcmp(pair1->key, pair2->key);
+    return cmp != 0 ? cmp : pair1->seq - pair2->seq;
+}
 
-        zset->avl_tree = avl_delete(zset->avl_tree, key, score);
+// orders pairs by score, then by key
+static int zset_pair_compare_score(const void *a, const void *b)
+{
+    const ZSetPair *pair1 = a;
+    const ZSetPair *pair2 = b;
+    if (pair1->score != pair2->score)
+    {
+        return pair1->score < pair2->score ? -1 : 1;
     }
 
-    char *key_alloc = strdup(key);
-    if (key_alloc == NULL)
+    return strcmp(pair1->key, pair2->key);
+}
+
+/**
+ * @brief Add several keys to the ZSet, like calling zset_add() for each one in order
+ *
+ * When the ZSet is empty or packed, the members are sorted and the skiplist is built bottom-up in O(n) instead of searched once per member. Keys that appear more than once keep their last score. A ZSet that already has a skiplist with members adds them one at a time.
+ *
+ * @param zset The ZSet to add the keys to
+ * @param keys The keys to add
+ * @param values The values of the keys
+ * @param count The number of keys
+ *
+ * @return int 0 if successful, -1 if failed
+ */
+int zset_add_many(ZSet *zset, char **keys, float *values, int count)
+{
+    bool packed = zset_is_packed(zset);
+    if ((!packed && zset->skiplist->length > 0) || (packed && zset->num_entries + count <= zset_max_packed_entries))
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (zset_add(zset, keys[i], values[i]) < 0)
+            {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    // the members of a packed ZSet go first, so a new score of the same key replaces them
+    int num_existing = packed ? zset->num_entries : 0;
+    int num_pairs = num_existing + count;
+    ZSetPair *pairs = malloc(num_pairs * sizeof(ZSetPair));
+    if (pairs == NULL)
     {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
-    float *value_alloc = (float *)calloc(1, sizeof(float));
-    if (value_alloc == NULL)
+    for (int i = 0; i < num_pairs; i++)
+    {
+        pairs[i].key = i < num_existing ? zset->entries[i].key : keys[i - num_existing];
+        pairs[i].score = i < num_existing ? zset->entries[i].score : values[i - num_existing];
+        pairs[i].seq = i;
+    }
+
+    // keep the last pair of every key, then sort the pairs in the order of the skiplist
+    qsort(pairs, num_pairs, sizeof(ZSetPair), zset_pair_compare_key);
+    int num_unique = 0;
+    for (int i = 0; i < num_pairs; i++)
+    {
+        if (i + 1 < num_pairs && strcmp(pairs[i].key, pairs[i + 1].key) == 0)
+        {
+            continue;
+        }
+
+        pairs[num_unique++] = pairs[i];
+    }
+
+    qsort(pairs, num_unique, sizeof(ZSetPair), zset_pair_compare_score);
+
+    char **sorted_keys = malloc(num_unique * sizeof(char *));
+    float *sorted_scores = malloc(num_unique * sizeof(float));
+    if (sorted_keys == NULL || sorted_scores == NULL)
     {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
-    *value_alloc = value;
+    for (int i = 0; i < num_unique; i++)
+    {
+        sorted_keys[i] = pairs[i].key;
+        sorted_scores[i] = pairs[i].score;
+    }
+
+    free(pairs);
+
+    if (packed && num_unique <= zset_max_packed_entries)
+    {
+        // the keys repeated in the batch still fit in the packed ZSet, the entries are rebuilt in order with copies of the keys
+        ZSetEntry *entries = malloc((num_unique > 0 ? num_unique : 1) * sizeof(ZSetEntry));
+        if (entries == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < num_unique; i++)
+        {
+            entries[i].score = sorted_scores[i];
+            entries[i].key = strdup(sorted_keys[i]);
+        }
+
+        zset_free_contents(zset);
+        zset->entries = entries;
+        zset->num_entries = num_unique;
+        zset->capacity = num_unique > 0 ? num_unique : 1;
+    }
+    else
+    {
+        if (packed)
+        {
+            zset->hash_table = hcreate(HASH_MIN_SIZE);
+            zset->skiplist = skiplist_init();
+        }
+
+        // the skiplist copies the keys, the hash table shares the copies
+        skiplist_build(zset->skiplist, sorted_keys, sorted_scores, num_unique);
+        for (SkipListNode *node = zset->skiplist->header->level[0].forward; node != NULL; node = node->level[0].forward)
+        {
+            hinsert(zset->hash_table, hinit(node->key, ZSET_MEMBER, node));
+        }
 
-    hash_node = hinit(key_alloc, FLOAT, value_alloc);
+        if (packed)
+        {
+            for (int i = 0; i < zset->num_entries; i++)
+            {
+                free(zset->entries[i].key);
+            }
 
-    // insert the hash node into the hash table
-    hinsert(zset->hash_table, hash_node);
+            free(zset->entries);
+            zset->entries = NULL;
+            zset->num_entries = 0;
+            zset->capacity = 0;
+        }
+    }
 
-    // insert the hash node into the AVL tree
-    zset->avl_tree = avl_insert(zset->avl_tree, key, value);
+    free(sorted_keys);
+    free(sorted_scores);
 
     return 0;
 }
@@ -124,6 +517,20 @@ int zset_add(ZSet *zset, char *key, float value)
  */
 int zset_remove(ZSet *zset, char *key)
 {
+    if (zset_is_packed(zset))
+    {
+        int index = zset_packed_find_key(zset, key);
+        if (index < 0)
+        {
+            fprintf(stderr, "Key does not exist in the ZSet\n");
+            return -1;
+        }
+
+        free(zset->entries[index].key);
+        zset_packed_delete(zset, index);
+        return 0;
+    }
+
     HashNode *hash_node = hremove(zset->hash_table, key);
     if (!hash_node)
     {
@@ -131,42 +538,201 @@ int zset_remove(ZSet *zset, char *key)
         return -1;
     }
 
-    // deserialize the value from the hash node
-    int type = hash_node->valueType;
-    if (type != FLOAT)
+    // the hash node does not free the key and the skiplist node, the skiplist does
+    SkipListNode *node = hash_node->value;
+    hfree(hash_node);
+    skiplist_delete_node(zset->skiplist, node);
+
+    return 0;
+}
+
+/**
+ * @brief Remove the members of a range of ranks from the ZSet
+ *
+ * The skiplist nodes of the range are unlinked in O(log n + k) for k members, and only their hash nodes are freed. The skiplist nodes are handed back to the caller, which frees them with skiplist_free_nodes() whenever it suits it.
+ *
+ * @param zset The ZSet to remove the members from
+ * @param start The rank of the first member
+ * @param end The rank of the last member, included
+ * @param removed Set to the first skiplist node removed, NULL if there is none, the members of a packed ZSet are freed right away
+ *
+ * @return int The number of members removed
+ */
+int zset_remove_range_by_rank(ZSet *zset, int start, int end, SkipListNode **removed)
+{
+    *removed = NULL;
+
+    int length = zset_length(zset);
+    if (start < 0)
     {
-        fprintf(stderr, "value in zset is not a float\n");
-        return -1;
+        start = 0;
     }
 
-    float score = *(float *)hash_node->value;
+    if (end >= length)
+    {
+        end = length - 1;
+    }
 
-    // delete the hash node from the hash table and the AVL tree, delete the hash node from the avl_tree first since hash node frees the key
-    zset->avl_tree = avl_delete(zset->avl_tree, key, score);
-    hfree(hash_node);
+    if (start > end)
+    {
+        return 0;
+    }
 
-    return 0;
+    if (zset_is_packed(zset))
+    {
+        for (int i = start; i <= end; i++)
+        {
+            free(zset->entries[i].key);
+        }
+
+        memmove(zset->entries + start, zset->entries + end + 1, (zset->num_entries - end - 1) * sizeof(ZSetEntry));
+        zset->num_entries -= end - start + 1;
+        return end - start + 1;
+    }
+
+    int count = skiplist_delete_range_by_rank(zset->skiplist, start, end, removed);
+    for (SkipListNode *node = *removed; node != NULL; node = node->level[0].forward)
+    {
+        hfree(hremove(zset->hash_table, node->key));
+    }
+
+    return count;
+}
+
+/**
+ * @brief Remove the members with a score between two bounds from the ZSet, like zset_remove_range_by_rank()
+ *
+ * @param zset The ZSet to remove the members from
+ * @param min The lower bound
+ * @param min_exclusive true if the members with the score min are kept
+ * @param max The upper bound
+ * @param max_exclusive true if the members with the score max are kept
+ * @param removed Set to the first skiplist node removed, NULL if there is none
+ *
+ * @return int The number of members removed
+ */
+int zset_remove_range_by_score(ZSet *zset, float min, bool min_exclusive, float max, bool max_exclusive, SkipListNode **removed)
+{
+    int start = zset_count_lower(zset, min, min_exclusive);
+    int end = zset_count_lower(zset, max, !max_exclusive) - 1;
+
+    return zset_remove_range_by_rank(zset, start, end, removed);
+}
+
+/**
+ * @brief Starts iterating over the members of the ZSet, the members are returned by zset_iter_next(). The ZSet must not be modified during the iteration.
+ *
+ * @param zset The ZSet
+ * @param iter The iterator
+ * @param rank The rank of the first member returned
+ * @param reverse true to go from each member to the one ranked before it
+ */
+void zset_iter_init(ZSet *zset, ZSetIter *iter, int rank, bool reverse)
+{
+    iter->zset = zset;
+    iter->reverse = reverse;
+    iter->index = rank;
+    iter->node = zset_is_packed(zset) ? NULL : skiplist_get_by_rank(zset->skiplist, rank);
+}
+
+/**
+ * @brief Returns the next member of an iteration
+ *
+ * @param iter The iterator
+ * @param key Set to the key of the member, valid until the ZSet is changed
+ * @param score Set to the score of the member
+ *
+ * @return bool false if the iteration is over
+ */
+bool zset_iter_next(ZSetIter *iter, char **key, float *score)
+{
+    ZSet *zset = iter->zset;
+    if (zset_is_packed(zset))
+    {
+        if (iter->index < 0 || iter->index >= zset->num_entries)
+        {
+            return false;
+        }
+
+        *key = zset->entries[iter->index].key;
+        *score = zset->entries[iter->index].score;
+        iter->index += iter->reverse ? -1 : 1;
+        return true;
+    }
+
+    SkipListNode *node = iter->node;
+    if (node == NULL)
+    {
+        return false;
+    }
+
+    *key = node->key;
+    *score = node->score;
+    iter->node = iter->reverse ? node->backward : node->level[0].forward;
+
+    return true;
 }
 
 /**
- * @brief Search for a key in the ZSet
+ * @brief Search for the score of a key in the ZSet
  *
- * This function searches for a key in the ZSet and returns the hash node if found, NULL otherwise.
+ * This function searches for a key in the ZSet and returns its score if found, NULL otherwise.
  *
  * @param zset The ZSet to search in
  * @param key The key to search for
  *
- * @return HashNode* The hash node if found, NULL otherwise
+ * @return float* The score of the key, valid until the ZSet is changed, NULL if the key is not in the ZSet
  */
-HashNode *zset_search_by_key(ZSet *zset, char *key)
+float *zset_score(ZSet *zset, char *key)
 {
+    if (zset_is_packed(zset))
+    {
+        int index = zset_packed_find_key(zset, key);
+        return index < 0 ? NULL : &zset->entries[index].score;
+    }
+
     HashNode *hash_node = hget(zset->hash_table, key);
     if (!hash_node)
     {
         return NULL;
     }
 
-    return hash_node;
+    return &((SkipListNode *)hash_node->value)->score;
+}
+
+/**
+ * @brief Search for the scores of several keys in the ZSet
+ *
+ * The keys of a ZSet with a hash table are looked up a batch at a time so their cache misses overlap.
+ *
+ * @param zset The ZSet to search in
+ * @param keys The keys to search for
+ * @param num_keys The number of keys
+ * @param scores Set to the score of every key as zset_score() returns it
+ */
+void zset_score_many(ZSet *zset, char **keys, int num_keys, float **scores)
+{
+    if (zset_is_packed(zset))
+    {
+        for (int i = 0; i < num_keys; i++)
+        {
+            scores[i] = zset_score(zset, keys[i]);
+        }
+
+        return;
+    }
+
+    HashNode *nodes[HGET_BATCH];
+    for (int start = 0; start < num_keys; start += HGET_BATCH)
+    {
+        int count = num_keys - start < HGET_BATCH ? num_keys - start : HGET_BATCH;
+        hget_many(zset->hash_table, keys + start, count, nodes);
+
+        for (int i = 0; i < count; i++)
+        {
+            scores[start + i] = nodes[i] ? &((SkipListNode *)nodes[i]->value)->score : NULL;
+        }
+    }
 }
 
 /**
@@ -180,13 +746,34 @@ HashNode *zset_search_by_key(ZSet *zset, char *key)
  */
 void zset_free_contents(ZSet *zset)
 {
+    if (zset_is_packed(zset))
+    {
+        for (int i = 0; i < zset->num_entries; i++)
+        {
+            free(zset->entries[i].key);
+        }
+
+        free(zset->entries);
+        return;
+    }
+
+    // the hash nodes are freed first, their keys belong to the skiplist nodes
     hfree_table(zset->hash_table);
-    avl_free(zset->avl_tree);
+    skiplist_free(zset->skiplist);
 }
 
 // print the ZSet
 void zset_print(ZSet *zset)
 {
-    hprint(zset->hash_table);
-    avl_print(zset->avl_tree);
+    if (zset_is_packed(zset))
+    {
+        for (int i = 0; i < zset->num_entries; i++)
+        {
+            printf("%s: %f\n", zset->entries[i].key, zset->entries[i].score);
+        }
+
+        return;
+    }
+
+    skiplist_print(zset->skiplist);
 }
@@ -1,5 +1,5 @@
 #include "../hashTable/hashTable.h"
-#include "../AVLTree/AVLTree.h"
+#include "../skipList/skipList.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -7,15 +7,54 @@
 // should be multiple of two
 #define INIT_TABLE_SIZE 1024
 
+// a ZSet is packed into a sorted array until it has more members than this, the default of zset_max_packed_entries
+#define ZSET_MAX_PACKED_ENTRIES 64
+
+// a member of a packed ZSet
+typedef struct
+{
+    float score;
+    char *key;
+} ZSetEntry;
+
 typedef struct
 {
     HashTable *hash_table;
-    AVLNode *avl_tree;
+    SkipList *skiplist;
+
+    // a small ZSet keeps its members in entries instead, sorted by score and by key for equal scores, hash_table and skiplist are NULL until it is converted
+    ZSetEntry *entries;
+    int num_entries;
+    int capacity;
 } ZSet;
 
+// iterates over the members of a ZSet in order of rank, forward or backward, each step is O(1)
+typedef struct
+{
+    ZSet *zset;
+    bool reverse;
+    // the index of the next entry of a packed ZSet, the next node of a skiplist otherwise
+    int index;
+    SkipListNode *node;
+} ZSetIter;
+
+extern int zset_max_packed_entries;
+
 ZSet *zset_init();
-HashNode *zset_search_by_key(ZSet *zset, char *key);
+bool zset_is_packed(ZSet *zset);
+float *zset_score(ZSet *zset, char *key);
+void zset_score_many(ZSet *zset, char **keys, int num_keys, float **scores);
+int zset_length(ZSet *zset);
+int zset_count_lower(ZSet *zset, float value, bool inclusive);
+int zset_rank_of_score(ZSet *zset, float value);
+int zset_rank(ZSet *zset, char *key);
+int zset_rank_of_pair(ZSet *zset, char *key, float value);
 int zset_add(ZSet *zset, char *key, float value);
+int zset_add_many(ZSet *zset, char **keys, float *values, int count);
 int zset_remove(ZSet *zset, char *key);
+int zset_remove_range_by_rank(ZSet *zset, int start, int end, SkipListNode **removed);
+int zset_remove_range_by_score(ZSet *zset, float min, bool min_exclusive, float max, bool max_exclusive, SkipListNode **removed);
+void zset_iter_init(ZSet *zset, ZSetIter *iter, int rank, bool reverse);
+bool zset_iter_next(ZSetIter *iter, char **key, float *score);
 void zset_free_contents(ZSet *zset);
 void zset_print(ZSet *zset);
@@ -22,21 +22,214 @@ int main()
     zset_add(zset, key7, 0.0);
 
     // search for a key
-    HashNode *hash_node = zset_search_by_key(zset, "key1");
-    if (!hash_node)
+    float *score = zset_score(zset, "key1");
+    if (!score || *score != 1.0)
     {
         fprintf(stderr, "key not found\n");
         exit(EXIT_FAILURE);
     }
 
+    // a small zset is packed, sorted by score
+    if (!zset_is_packed(zset) || zset->num_entries != 7 || strcmp(zset->entries[0].key, "key6") != 0 || strcmp(zset->entries[6].key, "key5") != 0)
+    {
+        fprintf(stderr, "small zset not packed in order\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // test update, the entry moves to its new position
+    zset_add(zset, key6, 10.0);
+    if (*zset_score(zset, "key6") != 10.0 || strcmp(zset->entries[6].key, "key6") != 0 || zset_rank_of_score(zset, 10.0) != 6)
+    {
+        fprintf(stderr, "key not updated\n");
+        exit(EXIT_FAILURE);
+    }
+
     // test delete
     zset_remove(zset, "key1");
-    if (zset_search_by_key(zset, "key1"))
+    if (zset_score(zset, "key1"))
     {
         fprintf(stderr, "key not deleted\n");
         exit(EXIT_FAILURE);
     }
 
+    // the zset is converted to a hash table and a skiplist past the threshold, and every member keeps its score
+    char key[32];
+    for (int i = 0; i < ZSET_MAX_PACKED_ENTRIES; i++)
+    {
+        sprintf(key, "member%d", i);
+        zset_add(zset, key, i % 5);
+    }
+
+    if (zset_is_packed(zset) || zset->hash_table->size != ZSET_MAX_PACKED_ENTRIES + 6 || zset->skiplist->length != ZSET_MAX_PACKED_ENTRIES + 6)
+    {
+        fprintf(stderr, "zset not converted\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // members with equal scores are ordered by key, and a search by score finds the first member with a score at least the value
+    if (zset_rank_of_pair(zset, "key3", 2) != zset_rank_of_score(zset, 1.5) || zset_rank_of_pair(zset, "member12", 2) != zset_rank_of_pair(zset, "key3", 2) + 1 || zset_rank_of_pair(zset, "member2", 2) <= zset_rank_of_pair(zset, "member17", 2) || zset_rank_of_score(zset, 11) != -1)
+    {
+        fprintf(stderr, "zset not ordered by score and key\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // an update moves the skiplist node of the member, the hash node keeps pointing at it and shares its key
+    HashNode *member = hget(zset->hash_table, "member7");
+    SkipListNode *member_node = member->value;
+    zset_add(zset, "member7", 100);
+    zset_add(zset, "member7", 2);
+    if (hget(zset->hash_table, "member7")->value != member_node || member->key != member_node->key || member_node->score != 2 || zset_rank_of_pair(zset, "member7", 2) < 0)
+    {
+        fprintf(stderr, "zset update did not keep the member node\n");
+        exit(EXIT_FAILURE);
+    }
+
+    float *scores[3];
+    char *keys[] = {"member7", "key6", "key1"};
+    zset_score_many(zset, keys, 3, scores);
+    if (!scores[0] || *scores[0] != 2 || !scores[1] || *scores[1] != 10.0 || scores[2])
+    {
+        fprintf(stderr, "scores lost in the conversion\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // iterating backward from the last rank returns the members of a forward iteration in reverse
+    ZSetIter forward, backward;
+    zset_iter_init(zset, &forward, 0, false);
+    zset_iter_init(zset, &backward, zset_length(zset) - 1, true);
+    char *forward_keys[ZSET_MAX_PACKED_ENTRIES + 6];
+    char *iter_key;
+    float iter_score;
+    int num_keys = 0;
+    while (zset_iter_next(&forward, &iter_key, &iter_score))
+    {
+        forward_keys[num_keys++] = iter_key;
+    }
+
+    while (zset_iter_next(&backward, &iter_key, &iter_score))
+    {
+        if (num_keys == 0 || forward_keys[--num_keys] != iter_key)
+        {
+            fprintf(stderr, "zset iterators disagree\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // remove the members with a score of 1 or 2, with a packed zset and a converted one
+    for (int packed = 0; packed < 2; packed++)
+    {
+        ZSet *range = zset_init();
+        zset_max_packed_entries = packed ? ZSET_MAX_PACKED_ENTRIES : 0;
+        for (int i = 0; i < 30; i++)
+        {
+            sprintf(key, "member%d", i);
+            zset_add(range, key, i % 5);
+        }
+
+        SkipListNode *removed;
+        if (zset_remove_range_by_score(range, 1, false, 3, true, &removed) != 12 || zset_length(range) != 18 || zset_score(range, "member6") || !zset_score(range, "member8") || zset_count_lower(range, 3, false) != 6)
+        {
+            fprintf(stderr, "zset range not removed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        skiplist_free_nodes(&removed, -1);
+
+        // the first and the last member by rank
+        SkipListNode *removed_last;
+        if (zset_remove_range_by_rank(range, -5, 0, &removed) != 1 || zset_rank(range, "member0") != -1 || zset_remove_range_by_rank(range, 16, 100, &removed_last) != 1 || zset_length(range) != 16)
+        {
+            fprintf(stderr, "zset range not removed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        skiplist_free_nodes(&removed, -1);
+        skiplist_free_nodes(&removed_last, -1);
+        zset_free_contents(range);
+        free(range);
+    }
+
+    zset_max_packed_entries = ZSET_MAX_PACKED_ENTRIES;
+
+    // adding many members at once gives the same zset as adding them one at a time, whether it starts empty or packed, the last score of a repeated key wins
+    for (int existing = 0; existing < 2; existing++)
+    {
+        ZSet *one_by_one = zset_init();
+        ZSet *bulk = zset_init();
+        char *bulk_keys[200];
+        float bulk_scores[200];
+        for (int i = 0; i < existing * 10; i++)
+        {
+            sprintf(key, "member%d", i * 7);
+            zset_add(one_by_one, key, i);
+            zset_add(bulk, key, i);
+        }
+
+        for (int i = 0; i < 200; i++)
+        {
+            sprintf(key, "member%d", (i * 13) % 150);
+            bulk_keys[i] = strdup(key);
+            bulk_scores[i] = i % 9;
+            zset_add(one_by_one, key, bulk_scores[i]);
+        }
+
+        zset_add_many(bulk, bulk_keys, bulk_scores, 200);
+
+        ZSetIter iter1, iter2;
+        zset_iter_init(one_by_one, &iter1, 0, false);
+        zset_iter_init(bulk, &iter2, 0, false);
+        char *key1, *key2;
+        float score1, score2;
+        int num_members = 0;
+        while (zset_iter_next(&iter1, &key1, &score1))
+        {
+            if (!zset_iter_next(&iter2, &key2, &score2) || strcmp(key1, key2) != 0 || score1 != score2 || *zset_score(bulk, key1) != score1)
+            {
+                fprintf(stderr, "zset bulk add differs\n");
+                exit(EXIT_FAILURE);
+            }
+
+            num_members++;
+        }
+
+        if (zset_iter_next(&iter2, &key2, &score2) || zset_is_packed(bulk) || bulk->hash_table->size != num_members || zset_rank(bulk, key1) != num_members - 1)
+        {
+            fprintf(stderr, "zset bulk add differs\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < 200; i++)
+        {
+            free(bulk_keys[i]);
+        }
+
+        zset_free_contents(one_by_one);
+        free(one_by_one);
+        zset_free_contents(bulk);
+        free(bulk);
+    }
+
+    // repeated keys that still fit keep the zset packed
+    ZSet *small = zset_init();
+    char *small_keys[70];
+    float small_scores[70];
+    zset_add(small, "a", 1);
+    for (int i = 0; i < 70; i++)
+    {
+        small_keys[i] = i % 2 ? "a" : "b";
+        small_scores[i] = i;
+    }
+
+    zset_add_many(small, small_keys, small_scores, 70);
+    if (!zset_is_packed(small) || zset_length(small) != 2 || *zset_score(small, "a") != 69 || *zset_score(small, "b") != 68 || zset_rank(small, "b") != 0)
+    {
+        fprintf(stderr, "zset bulk add of a packed zset wrong\n");
+        exit(EXIT_FAILURE);
+    }
+
+    zset_free_contents(small);
+    free(small);
+
     // free
     zset_free_contents(zset);
     free(zset);
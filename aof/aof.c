@@ -52,6 +52,23 @@ void aof_change_mode(AOF *aof, char *aof_filename, char *mode)
     pthread_mutex_unlock(&aof->mutex);
 }
 
+// truncate the file at the current read position, so an incomplete record left by a crash is not followed by new records
+void aof_truncate(AOF *aof, char *aof_filename)
+{
+    // lock the mutex
+    pthread_mutex_lock(&aof->mutex);
+
+    long position = ftell(aof->file);
+    if (position < 0 || truncate(aof_filename, position) < 0)
+    {
+        perror("Failed to truncate file");
+        exit(EXIT_FAILURE);
+    }
+
+    // unlock the mutex
+    pthread_mutex_unlock(&aof->mutex);
+}
+
 // create a function for flushing file buffer to disk, a worker thread will call this function
 void *aof_flush(void *aof)
 {
@@ -104,21 +121,89 @@ void aof_write(AOF *aof, char *message)
     pthread_mutex_unlock(&aof->mutex);
 }
 
-char *aof_read_line(AOF *aof)
+// write raw bytes to the file, unlike aof_write() the data may contain null bytes
+void aof_write_bytes(AOF *aof, char *data, int size)
 {
+    pthread_mutex_lock(&aof->mutex);
 
-    char *buffer = calloc(1, MAX_MESSAGE_SIZE);
-    if (buffer == NULL)
+    if (fwrite(data, 1, size, aof->file) != (size_t)size)
+    {
+        fprintf(stderr, "Error writing to file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // unlock the mutex
+    pthread_mutex_unlock(&aof->mutex);
+}
+
+// read a record written as its size (4 bytes, little endian) followed by its bytes, the returned record is heap allocated with one spare byte after it. Returns NULL at the end of the file, a record cut short by a crash is skipped and the file is left positioned at its start
+char *aof_read_record(AOF *aof, int *size)
+{
+    char *record = NULL;
+
+    // lock the mutex
+    pthread_mutex_lock(&aof->mutex);
+
+    long start = ftell(aof->file);
+
+    size_t header_read = fread(size, 1, 4, aof->file);
+    if (header_read != 4)
+    {
+        if (ferror(aof->file))
+        {
+            perror("Error reading from file");
+            exit(EXIT_FAILURE);
+        }
+
+        if (header_read)
+        {
+            fprintf(stderr, "Incomplete record at the end of the AOF file\n");
+            fseek(aof->file, start, SEEK_SET);
+        }
+
+        pthread_mutex_unlock(&aof->mutex);
+        return NULL;
+    }
+
+    if (*size < 0)
+    {
+        fprintf(stderr, "Invalid record size in AOF file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    record = malloc(*size + 1);
+    if (!record)
     {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
+    if (fread(record, 1, *size, aof->file) != (size_t)*size)
+    {
+        fprintf(stderr, "Incomplete record at the end of the AOF file\n");
+        fseek(aof->file, start, SEEK_SET);
+        free(record);
+        record = NULL;
+    }
+
+    // unlock the mutex
+    pthread_mutex_unlock(&aof->mutex);
+
+    return record;
+}
+
+// read a line from the file, the returned line is heap allocated and sized to fit so large values are not truncated
+char *aof_read_line(AOF *aof)
+{
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+
     // lock the mutex
     pthread_mutex_lock(&aof->mutex);
 
     // read a line from the file
-    if (fgets(buffer, MAX_MESSAGE_SIZE, aof->file) == NULL)
+    ssize_t len = getline(&buffer, &buffer_size, aof->file);
+    if (len < 0)
     {
         // check if the end of file has been reached or error occured
         if (feof(aof->file))
@@ -135,7 +220,6 @@ char *aof_read_line(AOF *aof)
     }
 
     // Replace the newline character with null terminator
-    int len = strlen(buffer);
     if (len > 0 && buffer[len - 1] == '\n')
     {
         buffer[len - 1] = '\0';
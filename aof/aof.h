@@ -4,6 +4,9 @@
 #include <string.h>
 #include <pthread.h>
 
+// line that separates commands logged one per line by older versions from the framed records that follow it
+#define AOF_HEADER "LITEDB-AOF1"
+
 typedef struct AOF
 {
     FILE *file;
@@ -16,7 +19,10 @@ typedef struct AOF
 // aof functions
 AOF *aof_init(char *aof_file_name, int flush_interval_sec, char *mode);
 void aof_change_mode(AOF *aof, char *aof_filename, char *mode);
+void aof_truncate(AOF *aof, char *aof_filename);
 void *aof_flush(void *aof);
 void aof_close(AOF *aof);
 void aof_write(AOF *aof, char *message);
-char *aof_read_line(AOF *aof);
\ No newline at end of file
+void aof_write_bytes(AOF *aof, char *data, int size);
+char *aof_read_line(AOF *aof);
+char *aof_read_record(AOF *aof, int *size);
\ No newline at end of file
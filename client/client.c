@@ -65,6 +65,33 @@ int write_tcp_socket(int fd, char *buffer, int size)
     return 0;
 }
 
+/**
+ * @brief Reads a message of a known size from a tcp socket into a heap buffer sized to fit it
+ *
+ * @param fd file descriptor of the socket
+ * @param size size of the message, in bytes
+ *
+ * @return char* the message, to be freed by the caller, or NULL on failure
+ */
+char *read_message(int fd, int size)
+{
+    // allocate at least one byte so an empty message is still a valid buffer
+    char *message = malloc(size > 0 ? size : 1);
+    if (!message)
+    {
+        fprintf(stderr, "Failed to allocate memory for message\n");
+        return NULL;
+    }
+
+    if (read_tcp_socket(fd, message, size))
+    {
+        free(message);
+        return NULL;
+    }
+
+    return message;
+}
+
 /**
  * @brief Processes the server response according to the liteDB protocol
  *
@@ -74,7 +101,9 @@ int write_tcp_socket(int fd, char *buffer, int size)
  */
 int process_server_response(int confd)
 {
-    char buffer[5 + MAX_MESSAGE_SIZE];
+    // header of the response, the message itself is read into a buffer sized to fit it
+    char buffer[5];
+    char *message = NULL;
 
     int err = 0;
     int type = 0;
@@ -134,7 +163,8 @@ int process_server_response(int confd)
         break;
     case SER_ERR:
         // read the response message
-        err = read_tcp_socket(confd, buffer + 5, message_size);
+        message = read_message(confd, message_size);
+        err = message ? 0 : -1;
         if (err)
         {
             if (err < 0)
@@ -148,12 +178,14 @@ int process_server_response(int confd)
             return err;
         }
 
-        printf("(err) %.*s\n", message_size, buffer + 5);
+        printf("(err) %.*s\n", message_size, message);
+        free(message);
         return 0;
         break;
     case SER_STR:
         // read the response message
-        err = read_tcp_socket(confd, buffer + 5, message_size);
+        message = read_message(confd, message_size);
+        err = message ? 0 : -1;
         if (err)
         {
             if (err < 0)
@@ -167,12 +199,14 @@ int process_server_response(int confd)
             return err;
         }
 
-        printf("(str) %.*s\n", message_size, buffer + 5);
+        printf("(str) %.*s\n", message_size, message);
+        free(message);
         return 0;
         break;
     case SER_INT:
         // read the response message
-        err = read_tcp_socket(confd, buffer + 5, message_size);
+        message = read_message(confd, message_size);
+        err = message ? 0 : -1;
         if (err)
         {
             if (err < 0)
@@ -186,13 +220,15 @@ int process_server_response(int confd)
             return err;
         }
 
-        int value = *(int *)(buffer + 5);
+        int value = *(int *)message;
         printf("(int) %d\n", value);
+        free(message);
         return 0;
         break;
     case SER_FLOAT:
         // read the response message
-        err = read_tcp_socket(confd, buffer + 5, message_size);
+        message = read_message(confd, message_size);
+        err = message ? 0 : -1;
         if (err)
         {
             if (err < 0)
@@ -206,8 +242,9 @@ int process_server_response(int confd)
             return err;
         }
 
-        float fvalue = *(float *)(buffer + 5);
+        float fvalue = *(float *)message;
         printf("(float) %f\n", fvalue);
+        free(message);
         return 0;
         break;
 
@@ -244,8 +281,6 @@ int process_server_response(int confd)
  */
 int handle_request(int confd, char *message)
 {
-    char buffer[4 + MAX_MESSAGE_SIZE + 1];
-
     // write the message size
     int message_size = strlen(message);
     if (message_size > MAX_MESSAGE_SIZE)
@@ -254,13 +289,13 @@ int handle_request(int confd, char *message)
         return -1;
     }
 
-    memcpy(buffer, &message_size, 4);
-
-    // write the message to the buffer
-    memcpy(buffer + 4, message, message_size);
+    // send the message size followed by the message
+    int err = write_tcp_socket(confd, (char *)&message_size, 4);
+    if (!err)
+    {
+        err = write_tcp_socket(confd, message, message_size);
+    }
 
-    // send the message
-    int err = write_tcp_socket(confd, buffer, 4 + message_size);
     if (err)
     {
         if (err < 0)
@@ -316,16 +351,25 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     };
 
+    // line buffer for the commands, grows to fit long values
+    char *message = NULL;
+    size_t message_capacity = 0;
+
     while (1)
     {
-        char message[200];
-
         printf("liteDB> ");
 
-        fgets(message, 200, stdin);
+        ssize_t len = getline(&message, &message_capacity, stdin);
+        if (len < 0)
+        {
+            break;
+        }
 
         // remove the newline character
-        message[strlen(message) - 1] = '\0';
+        if (len > 0 && message[len - 1] == '\n')
+        {
+            message[len - 1] = '\0';
+        }
 
         int err = handle_request(client_socket, message);
 
@@ -341,6 +385,7 @@ int main(int argc, char *argv[])
         }
     }
 
+    free(message);
     close(client_socket);
     return 0;
 }
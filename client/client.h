@@ -12,5 +12,6 @@
 
 int read_tcp_socket(int fd, char *buffer, int size);
 int write_tcp_socket(int fd, char *buffer, int size);
+char *read_message(int fd, int size);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+// benchmark the chained engine against the swiss engine, for inserts, the slowest insert, which is where a resize done in one go would stall, lookups of keys that are in the table and of keys that are not, and the memory of the table itself
+#include "hashTable.h"
+#include <malloc.h>
+#include <time.h>
+
+#define BENCH_LOOKUPS (1 << 22)
+
+// nanoseconds since an arbitrary point
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// build the keys "key:0" up to "key:<count - 1>", with the given prefix instead of "key"
+static char **make_keys(const char *prefix, int count)
+{
+    char **keys = malloc(sizeof(char *) * count);
+    if (keys == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        char key[32];
+        sprintf(key, "%s:%d", prefix, i);
+        keys[i] = strdup(key);
+    }
+
+    return keys;
+}
+
+// time every operation on a table of num_keys keys with one engine, and print a line of results
+static void bench_engine(HashEngine engine, int num_keys, char **keys, char **missing)
+{
+    hset_engine(engine);
+    HashTable *table = hcreate(HASH_MIN_SIZE);
+
+    double start = now_ns();
+    double worst_ns = 0;
+    for (int i = 0; i < num_keys; i++)
+    {
+        double insert_start = now_ns();
+        hinsert(table, hinit(strdup(keys[i]), STRING, NULL));
+        double insert_end = now_ns();
+        worst_ns = insert_end - insert_start > worst_ns ? insert_end - insert_start : worst_ns;
+    }
+    double insert_ns = (now_ns() - start) / num_keys;
+
+    // let a resize in progress finish, it is not part of the lookups
+    while (hrehash(table, table->mask + 1))
+    {
+    }
+
+    // random keys, so the lookups are not helped by the order the nodes were allocated in
+    srand(1);
+    int found = 0;
+    start = now_ns();
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        found += hget(table, keys[rand() % num_keys]) != NULL;
+    }
+    double hit_ns = (now_ns() - start) / BENCH_LOOKUPS;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        found += hget(table, missing[rand() % num_keys]) != NULL;
+    }
+    double miss_ns = (now_ns() - start) / BENCH_LOOKUPS;
+
+    if (found != BENCH_LOOKUPS)
+    {
+        fprintf(stderr, "lookups found %d keys instead of %d\n", found, BENCH_LOOKUPS);
+        exit(EXIT_FAILURE);
+    }
+
+    // both engines allocate a node and a key per key, they differ in the array that indexes the nodes
+    int slot_bytes = engine == HASH_ENGINE_SWISS ? sizeof(SwissGroup) / SWISS_GROUP : sizeof(HashNode *);
+    double index_bytes = (double)(table->mask + 1) * slot_bytes / num_keys;
+
+    printf("%10d %10s %12.1f %14.1f %12.1f %12.1f %14.1f\n", num_keys, engine == HASH_ENGINE_SWISS ? "swiss" : "chained", insert_ns, worst_ns / 1000, hit_ns, miss_ns, index_bytes);
+
+    hfree_table(table);
+
+    // the allocator merges the chunks of the freed nodes on a later allocation, which would be timed as the insert that makes it
+    malloc_trim(0);
+}
+
+int main()
+{
+    printf("%10s %10s %12s %14s %12s %12s %14s\n", "keys", "engine", "insert ns", "worst ins us", "hit ns", "miss ns", "index B/key");
+
+    for (int num_keys = 1 << 12; num_keys <= 1 << 22; num_keys <<= 5)
+    {
+        char **keys = make_keys("key", num_keys);
+        char **missing = make_keys("missing", num_keys);
+
+        bench_engine(HASH_ENGINE_CHAINED, num_keys, keys, missing);
+        bench_engine(HASH_ENGINE_SWISS, num_keys, keys, missing);
+
+        for (int i = 0; i < num_keys; i++)
+        {
+            free(keys[i]);
+            free(missing[i]);
+        }
+        free(keys);
+        free(missing);
+    }
+
+    return 0;
+}
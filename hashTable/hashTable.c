@@ -2,112 +2,862 @@
 
 #include "hashTable.h"
 
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// control byte and node of a slot of an array of groups of the swiss engine
+#define SWISS_CTRL(groups, slot) ((groups)[(slot) / SWISS_GROUP].ctrl[(slot) % SWISS_GROUP])
+#define SWISS_NODE(groups, slot) ((groups)[(slot) / SWISS_GROUP].slots[(slot) % SWISS_GROUP])
+
+// engine of the tables created by hcreate()
+static HashEngine default_engine = HASH_ENGINE_CHAINED;
+
+// secret constants of the hash, odd with half their bits set
+static const uint64_t hash_secret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+// seed of the hash, random per process so the buckets of a key can not be predicted by a client, 0 until it is initialized
+static uint64_t hash_seed = 0;
+
+/**
+ * @brief Sets the seed of the hash, tables that already hold keys must be empty since their keys would no longer be found
+ *
+ * A seed of 0 picks a random seed.
+ *
+ * @param seed The seed
+ */
+void hash_set_seed(uint64_t seed)
+{
+    if (seed == 0)
+    {
+        // fall back to the time and the process id when there is no random device
+        FILE *urandom = fopen("/dev/urandom", "rb");
+        if (!urandom || fread(&seed, sizeof(seed), 1, urandom) != 1)
+        {
+            seed = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid() ^ (uint64_t)clock();
+        }
+
+        if (urandom)
+        {
+            fclose(urandom);
+        }
+    }
+
+    hash_seed = seed | 1;
+}
+
+// multiplies two 64 bit values into 128 bits and folds the halves together
+static inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+// unaligned little endian reads
+static inline uint64_t hash_read8(const unsigned char *p)
+{
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+static inline uint64_t hash_read4(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
 /**
  * @brief Hash function
  *
- * This function is the djb2 hash function, which is a simple hash function that is used to hash strings.
+ * This function is the wyhash function, every 8 bytes of the key are mixed into the hash with a 64x64 to 128 bit multiplication. Keys up to 16 bytes are read with at most 4 overlapping loads, longer keys 16 bytes at a time, and keys over 48 bytes in three independent lanes of 16 bytes so the multiplications of a round run in parallel. The hash is seeded with a random seed per process, so keys that collide can not be chosen in advance.
+ *
+ * @param key The key to hash
+ *
+ * @return uint64_t The hash value
+ */
+uint64_t hash(char *key)
+{
+    return hash_len(key, strlen(key));
+}
+
+/**
+ * @brief Hashes the first len bytes of a key that is not null terminated, the hash is the same as hash() of the key on its own
+ *
+ * @param key The key to hash
+ * @param len The length of the key
+ *
+ * @return uint64_t The hash value
+ */
+uint64_t hash_len(char *key, int len)
+{
+    if (hash_seed == 0)
+    {
+        hash_set_seed(0);
+    }
+
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t seed = hash_seed ^ hash_mix(hash_seed ^ hash_secret[0], hash_secret[1]);
+    uint64_t a;
+    uint64_t b;
+
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            // two pairs of 4 byte reads that overlap for keys shorter than 16 bytes
+            int shift = (len >> 3) << 2;
+            a = (hash_read4(p) << 32) | hash_read4(p + shift);
+            b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - shift);
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = 0;
+            b = 0;
+        }
+    }
+    else
+    {
+        int i = len;
+        if (i > 48)
+        {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do
+            {
+                seed = hash_mix(hash_read8(p) ^ hash_secret[1], hash_read8(p + 8) ^ seed);
+                seed1 = hash_mix(hash_read8(p + 16) ^ hash_secret[2], hash_read8(p + 24) ^ seed1);
+                seed2 = hash_mix(hash_read8(p + 32) ^ hash_secret[3], hash_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16)
+        {
+            seed = hash_mix(hash_read8(p) ^ hash_secret[1], hash_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        // the last 16 bytes, which may overlap the bytes mixed already
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+
+    a ^= hash_secret[1];
+    b ^= seed;
+
+    __uint128_t product = (__uint128_t)a * b;
+    a = (uint64_t)product;
+    b = (uint64_t)(product >> 64);
+
+    return hash_mix(a ^ hash_secret[0] ^ (uint64_t)len, b ^ hash_secret[1]);
+}
+
+/**
+ * @brief Initializes a new hash node
+ *
+ * This function initializes a new hash node with the specified key, value, and type. Does NOT duplicate the key, the caller is responsible for passing a heap allocated key.
+ *
+ * @param key The key of the node
+ * @param type The type of the value
+ * @param value The value of the node
+ *
+ * @return HashNode* The initialized node
+ */
+HashNode *hinit(char *key, ValueType type, void *value)
+{
+    HashNode *node = calloc(sizeof(HashNode), 1);
+
+    if (node == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // does not dupliate the key, caller is responsible for freeing the key
+    node->key = key;
+    node->valueType = type;
+    node->value = value;
+
+    return node;
+}
+
+/**
+ * @brief Free a single hash node
+ *
+ * This function frees a single hash node, including the key and value, unless they belong to a ZSET_MEMBER.
+ *
+ * @param node The node to free
+ *
+ * @return void
+ */
+void hfree(HashNode *node)
+{
+    if (node->valueType != ZSET_MEMBER)
+    {
+        free(node->key);
+        free(node->value);
+    }
+
+    free(node);
+}
+
+// the 7 bit tag kept in the control byte of the slot of a key, the top bits of the hash, which do not take part in picking the group
+static signed char swiss_tag(uint64_t hashCode)
+{
+    return hashCode >> 57;
+}
+
+// the group the probe sequence of a key starts at, in an array of groups of mask + 1 slots
+static int swiss_first_group(int mask, uint64_t hashCode)
+{
+    return hashCode & (mask / SWISS_GROUP);
+}
+
+/**
+ * @brief Compares the control bytes of a group of SWISS_GROUP slots to a value, with a single SSE2 comparison when it is available
+ *
+ * @param ctrl The control bytes of the group
+ * @param value The value to compare to
+ *
+ * @return unsigned int A bit mask of the slots of the group whose control byte equals value
+ */
+static unsigned int swiss_match(signed char *ctrl, signed char value)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((__m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    unsigned int match = 0;
+    for (int i = 0; i < SWISS_GROUP; i++)
+    {
+        if (ctrl[i] == value)
+        {
+            match |= 1u << i;
+        }
+    }
+    return match;
+#endif
+}
+
+/**
+ * @brief Finds the slots of a group that are not full, either empty or deleted
+ *
+ * @param ctrl The control bytes of the group
+ *
+ * @return unsigned int A bit mask of the slots of the group that can take a node
+ */
+static unsigned int swiss_match_free(signed char *ctrl)
+{
+#ifdef __SSE2__
+    // the control byte of a free slot is negative, so its sign bit is set
+    return _mm_movemask_epi8(_mm_loadu_si128((__m128i *)ctrl));
+#else
+    unsigned int match = 0;
+    for (int i = 0; i < SWISS_GROUP; i++)
+    {
+        if (ctrl[i] < 0)
+        {
+            match |= 1u << i;
+        }
+    }
+    return match;
+#endif
+}
+
+/**
+ * @brief Allocates empty slots for a swiss table, the old slots are not freed and the number of nodes is left to the caller
+ *
+ * @param table The hashtable
+ * @param capacity The number of slots, a power of 2 and a multiple of SWISS_GROUP
+ */
+static void swiss_alloc(HashTable *table, int capacity)
+{
+    int num_groups = capacity / SWISS_GROUP;
+    table->groups = malloc(sizeof(SwissGroup) * num_groups);
+    if (table->groups == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < num_groups; i++)
+    {
+        memset(table->groups[i].ctrl, CTRL_EMPTY, SWISS_GROUP);
+    }
+    table->mask = capacity - 1;
+    table->loadFactor = (float)table->size / capacity;
+
+    // at most 7/8 of the slots are filled, so every probe sequence ends at an empty slot
+    table->growth_left = capacity - capacity / 8;
+}
+
+/**
+ * @brief Finds the slot of a key in an array of groups of a swiss table
+ *
+ * The groups of the probe sequence of the key are visited in turn, the tag of the key is compared to every control byte of a group at once and only the slots whose tag matches are compared to the key. A group with an empty slot ends the probe sequence.
+ *
+ * @param groups The groups to search
+ * @param mask The number of slots of the groups minus 1
+ * @param key The key to search for
+ * @param hashCode The hash code of the key
+ *
+ * @return int The slot of the key, -1 if it is not found
+ */
+static int swiss_find(SwissGroup *groups, int mask, char *key, uint64_t hashCode)
+{
+    signed char tag = swiss_tag(hashCode);
+    int group = swiss_first_group(mask, hashCode);
+
+    for (int step = 1;; step++)
+    {
+        SwissGroup *cur = &groups[group];
+
+        for (unsigned int match = swiss_match(cur->ctrl, tag); match; match &= match - 1)
+        {
+            HashNode *node = cur->slots[__builtin_ctz(match)];
+            if (node->hashCode == hashCode && strcmp(node->key, key) == 0)
+            {
+                return group * SWISS_GROUP + __builtin_ctz(match);
+            }
+        }
+
+        if (swiss_match(cur->ctrl, CTRL_EMPTY))
+        {
+            return -1;
+        }
+
+        // triangular probing visits every group when the number of groups is a power of 2
+        group = (group + step) & (mask / SWISS_GROUP);
+    }
+}
+
+/**
+ * @brief Retrieves the node of a key from a swiss table, see hget_hashed()
+ *
+ * While the table is being resized a key that is not in the new groups yet is still in the old ones.
+ */
+static HashNode *swiss_lookup(HashTable *table, char *key, uint64_t hashCode)
+{
+    int slot = swiss_find(table->groups, table->mask, key, hashCode);
+    if (slot >= 0)
+    {
+        return SWISS_NODE(table->groups, slot);
+    }
+
+    if (table->old_groups && (slot = swiss_find(table->old_groups, table->old_mask, key, hashCode)) >= 0)
+    {
+        return SWISS_NODE(table->old_groups, slot);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Puts a node in the first free slot of its probe sequence in the groups of a swiss table, the key must not be in the table yet
+ *
+ * @param table The hashtable
+ * @param node The node, its hashCode must be set
+ */
+static void swiss_place(HashTable *table, HashNode *node)
+{
+    uint64_t hashCode = node->hashCode;
+    int group = swiss_first_group(table->mask, hashCode);
+
+    unsigned int free_slots;
+    for (int step = 1; (free_slots = swiss_match_free(table->groups[group].ctrl)) == 0; step++)
+    {
+        group = (group + step) & (table->mask / SWISS_GROUP);
+    }
+
+    int slot = group * SWISS_GROUP + __builtin_ctz(free_slots);
+    if (SWISS_CTRL(table->groups, slot) == CTRL_EMPTY)
+    {
+        table->growth_left--;
+    }
+
+    SWISS_CTRL(table->groups, slot) = swiss_tag(hashCode);
+    SWISS_NODE(table->groups, slot) = node;
+}
+
+/**
+ * @brief Starts resizing a swiss table to a new number of slots, which also drops the deleted markers
+ *
+ * The nodes are not moved here, swiss_rehash_move() moves them a group at a time, so a resize never stalls the caller for the whole table.
+ *
+ * @param table The hashtable, it must not be resizing already
+ * @param capacity The new number of slots, a power of 2 and a multiple of SWISS_GROUP
+ */
+static void swiss_rehash_start(HashTable *table, int capacity)
+{
+    table->old_groups = table->groups;
+    table->old_mask = table->mask;
+    table->old_size = table->size;
+    table->rehash_index = 0;
+
+    swiss_alloc(table, capacity);
+}
+
+/**
+ * @brief Moves some groups of a resize in progress to the new groups
+ *
+ * A moved slot is marked deleted, not empty, so the probe sequences of the keys still in the old groups go on past it. Empty groups are skipped but at most 10 of them per group to move, like the buckets of hrehash_move(). Once every node has been moved the old groups are freed.
+ *
+ * @param table The hashtable being resized
+ * @param groups The number of non empty groups to move
+ *
+ * @return bool true if the resize is still in progress
+ */
+static bool swiss_rehash_move(HashTable *table, int groups)
+{
+    if (!table->old_groups)
+    {
+        return false;
+    }
+
+    long emptyVisits = (long)groups * 10;
+
+    // the nodes left are all in the groups at or above rehash_index
+    while (groups > 0 && table->old_size > 0)
+    {
+        SwissGroup *group = &table->old_groups[table->rehash_index];
+        unsigned int full = ~swiss_match_free(group->ctrl) & ((1u << SWISS_GROUP) - 1);
+        table->rehash_index++;
+
+        if (full == 0)
+        {
+            if (--emptyVisits == 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        for (; full; full &= full - 1)
+        {
+            swiss_place(table, group->slots[__builtin_ctz(full)]);
+            group->ctrl[__builtin_ctz(full)] = CTRL_DELETED;
+            table->old_size--;
+        }
+
+        groups--;
+    }
+
+    if (table->old_size == 0)
+    {
+        free(table->old_groups);
+        table->old_groups = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Moves every node of a resize in progress of a swiss table
+ *
+ * @param table The hashtable
+ */
+static void swiss_rehash_finish(HashTable *table)
+{
+    while (swiss_rehash_move(table, table->old_size))
+    {
+    }
+}
+
+/**
+ * @brief Inserts a node into a swiss table, see hinsert()
+ */
+static HashNode *swiss_insert(HashTable *table, HashNode *node)
+{
+    swiss_rehash_move(table, HREHASH_STEP);
+
+    node->hashCode = hash(node->key);
+
+    // make sure the key is unique
+    if (swiss_lookup(table, node->key, node->hashCode) != NULL)
+    {
+        fprintf(stderr, "Key already exists in the table\n");
+        return NULL;
+    }
+
+    // the new groups must keep room for the nodes still to be moved, which only runs out when a resize that started close to the threshold meets a burst of inserts
+    if (table->old_groups && table->growth_left <= table->old_size)
+    {
+        swiss_rehash_finish(table);
+    }
+
+    // out of empty slots, grow if the table is mostly full, otherwise only the deleted markers have to go
+    if (table->growth_left == 0)
+    {
+        int capacity = table->mask + 1;
+        swiss_rehash_start(table, table->size * 16 > capacity * 7 ? capacity * 2 : capacity);
+    }
+
+    swiss_place(table, node);
+    table->size++;
+    table->loadFactor = (float)table->size / (table->mask + 1);
+
+    return node;
+}
+
+/**
+ * @brief Removes a node from a swiss table, see hremove()
+ */
+static HashNode *swiss_remove(HashTable *table, char *key)
+{
+    swiss_rehash_move(table, HREHASH_STEP);
+
+    uint64_t hashCode = hash(key);
+    HashNode *node;
+
+    int slot = swiss_find(table->groups, table->mask, key, hashCode);
+    if (slot >= 0)
+    {
+        node = SWISS_NODE(table->groups, slot);
+        SWISS_NODE(table->groups, slot) = NULL;
+
+        // a group that still has an empty slot never ended up full, so no probe sequence went past it and the slot can be empty again. Otherwise it is marked deleted, which keeps the probe sequences going
+        if (swiss_match(table->groups[slot / SWISS_GROUP].ctrl, CTRL_EMPTY))
+        {
+            SWISS_CTRL(table->groups, slot) = CTRL_EMPTY;
+            table->growth_left++;
+        }
+        else
+        {
+            SWISS_CTRL(table->groups, slot) = CTRL_DELETED;
+        }
+    }
+    else if (table->old_groups && (slot = swiss_find(table->old_groups, table->old_mask, key, hashCode)) >= 0)
+    {
+        // the old groups are only read until they are freed, the slot is marked like a moved one
+        node = SWISS_NODE(table->old_groups, slot);
+        SWISS_CTRL(table->old_groups, slot) = CTRL_DELETED;
+        table->old_size--;
+        swiss_rehash_move(table, 0);
+    }
+    else
+    {
+        return NULL;
+    }
+
+    table->size--;
+
+    // shrink once the table is mostly empty, so memory comes back after mass deletes
+    int capacity = table->mask + 1;
+    if (!table->old_groups && capacity > HASH_MIN_SIZE && (long)table->size * HASH_SHRINK_RATIO < capacity)
+    {
+        int newCapacity = HASH_MIN_SIZE < SWISS_GROUP ? SWISS_GROUP : HASH_MIN_SIZE;
+        while (newCapacity < table->size * 2)
+        {
+            newCapacity *= 2;
+        }
+
+        swiss_rehash_start(table, newCapacity);
+    }
+
+    table->loadFactor = (float)table->size / (table->mask + 1);
+
+    return node;
+}
+
+/**
+ * @brief Frees every node of an array of groups of a swiss table, and the groups
+ *
+ * @param groups The groups
+ * @param mask The number of slots of the groups minus 1
+ */
+static void swiss_free_groups(SwissGroup *groups, int mask)
+{
+    for (int i = 0; i <= mask; i++)
+    {
+        if (SWISS_CTRL(groups, i) >= 0)
+        {
+            hfree(SWISS_NODE(groups, i));
+        }
+    }
+
+    free(groups);
+}
+
+/**
+ * @brief Frees every node of a swiss table and its slots
+ */
+static void swiss_free_contents(HashTable *table)
+{
+    swiss_free_groups(table->groups, table->mask);
+
+    if (table->old_groups)
+    {
+        swiss_free_groups(table->old_groups, table->old_mask);
+        table->old_groups = NULL;
+    }
+}
+
+/**
+ * @brief Returns the node a lookup in a swiss table compares to the key first, used to prefetch it
+ *
+ * @return HashNode* The node of the first slot of the first group whose tag matches, NULL if there is none
+ */
+static HashNode *swiss_first_candidate(HashTable *table, uint64_t hashCode)
+{
+    int group = swiss_first_group(table->mask, hashCode);
+
+    unsigned int match = swiss_match(table->groups[group].ctrl, swiss_tag(hashCode));
+    return match ? table->groups[group].slots[__builtin_ctz(match)] : NULL;
+}
+
+/**
+ * @brief Creates a new hashtable
+ *
+ * This function creates a new hashtable with the specified size. The size must be a power of 2.
+ *
+ * @param size The size of the hashtable
+ *
+ * @return HashTable* The created hashtable
+ */
+HashTable *hcreate(int size)
+{
+    // check if the size is a power of 2, since we are using a mask to calculate the index (faster than modulo)
+    if (size <= 0 || (size & (size - 1)) != 0)
+    {
+        return 0;
+    }
+
+    HashTable *table = calloc(sizeof(HashTable), 1);
+    if (table == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the seed is picked when the first table is created, before the hash of any key is taken
+    if (hash_seed == 0)
+    {
+        hash_set_seed(0);
+    }
+
+    table->engine = default_engine;
+    if (table->engine == HASH_ENGINE_SWISS)
+    {
+        swiss_alloc(table, size < SWISS_GROUP ? SWISS_GROUP : size);
+        return table;
+    }
+
+    table->nodes = calloc(sizeof(HashNode *), size);
+    if (table->nodes == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    table->size = 0;
+    table->mask = size - 1;
+    table->old_nodes = NULL;
+
+    return table;
+}
+
+/**
+ * @brief Sets the engine of the tables created by hcreate() from now on, tables that already exist keep theirs
+ *
+ * @param engine The engine to use
+ */
+void hset_engine(HashEngine engine)
+{
+    default_engine = engine;
+}
+
+/**
+ * @brief Returns the bucket a key with the given hash code lives in
+ *
+ * While a resize is in progress a key lives in its bucket of old_nodes until that bucket has been moved, and in its bucket of nodes afterwards. New nodes are inserted the same way, so a lookup only ever has to look at one bucket.
  *
- * @param key The key to hash
+ * @param table The hashtable
+ * @param hashCode The hash code of the key
  *
- * @return int The hash value
+ * @return HashNode** The bucket of the key
  */
-int hash(char *key)
+static HashNode **hbucket(HashTable *table, uint64_t hashCode)
 {
-    int hash = 0;
-    for (int i = 0; key[i] != '\0'; i++)
+    if (table->old_nodes && (hashCode & table->old_mask) >= table->rehash_index)
     {
-        hash = 31 * hash + key[i];
+        return &table->old_nodes[hashCode & table->old_mask];
     }
 
-    return hash;
+    return &table->nodes[hashCode & table->mask];
 }
 
 /**
- * @brief Initializes a new hash node
- *
- * This function initializes a new hash node with the specified key, value, and type. Does NOT duplicate the key, the caller is responsible for passing a heap allocated key.
+ * @brief Starts resizing the hashtable to a new number of buckets
  *
- * @param key The key of the node
- * @param type The type of the value
- * @param value The value of the node
+ * The nodes are not moved here, hrehash() moves them a few buckets at a time, so a resize never stalls the caller for the whole table.
  *
- * @return HashNode* The initialized node
+ * @param table The hashtable to resize
+ * @param newSize The new number of buckets, must be a power of 2
  */
-HashNode *hinit(char *key, ValueType type, void *value)
+static void hrehash_start(HashTable *table, int newSize)
 {
-    HashNode *node = calloc(sizeof(HashNode), 1);
-
-    if (node == NULL)
+    HashNode **newNodes = calloc(sizeof(HashNode *), newSize);
+    if (newNodes == NULL)
     {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
-    // does not dupliate the key, caller is responsible for freeing the key
-    node->key = key;
-    node->valueType = type;
-    node->value = value;
+    table->old_nodes = table->nodes;
+    table->old_mask = table->mask;
+    table->rehash_index = 0;
 
-    return node;
+    table->nodes = newNodes;
+    table->mask = newSize - 1;
+    table->loadFactor = (float)table->size / (table->mask + 1);
 }
 
 /**
- * @brief Free a single hash node
- *
- * This function frees a single hash node, including the key and value.
+ * @brief Starts a resize if the load of the hashtable is out of bounds, unless a resize is already in progress
  *
- * @param node The node to free
+ * The table grows to double the size once it has more nodes than buckets, and shrinks once it has more than HASH_SHRINK_RATIO buckets per node, so memory comes back after mass deletes.
  *
- * @return void
+ * @param table The hashtable to check
  */
-void hfree(HashNode *node)
+static void hresize_if_needed(HashTable *table)
 {
-    free(node->key);
-    free(node->value);
-    free(node);
+    if (table->old_nodes)
+    {
+        return;
+    }
+
+    if (table->size > table->mask + 1)
+    {
+        hrehash_start(table, (table->mask + 1) * 2);
+    }
+    else if (table->mask + 1 > HASH_MIN_SIZE && (long)table->size * HASH_SHRINK_RATIO < table->mask + 1)
+    {
+        int newSize = HASH_MIN_SIZE;
+        while (newSize < table->size * 2)
+        {
+            newSize *= 2;
+        }
+
+        hrehash_start(table, newSize);
+    }
 }
 
 /**
- * @brief Creates a new hashtable
+ * @brief Moves some buckets of a resize in progress to the new bucket array
  *
- * This function creates a new hashtable with the specified size. The size must be a power of 2.
+ * Moves up to buckets non empty buckets, empty buckets are skipped but at most 10 of them per bucket to move, so a sparse table does not make a single call slow. Once every bucket has been moved the old bucket array is freed.
  *
- * @param size The size of the hashtable
+ * @param table The hashtable being resized
+ * @param buckets The number of buckets to move
  *
- * @return HashTable* The created hashtable
+ * @return bool true if the resize is still in progress
  */
-HashTable *hcreate(int size)
+static bool hrehash_move(HashTable *table, int buckets)
 {
-    // check if the size is a power of 2, since we are using a mask to calculate the index (faster than modulo)
-    if (size <= 0 || (size & (size - 1)) != 0)
+    if (!table->old_nodes)
     {
-        return 0;
+        return false;
     }
 
-    HashTable *table = calloc(sizeof(HashTable), 1);
-    if (table == NULL)
+    long emptyVisits = (long)buckets * 10;
+
+    while (buckets > 0 && table->rehash_index <= table->old_mask)
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        HashNode *traverseList = table->old_nodes[table->rehash_index];
+        if (traverseList == NULL)
+        {
+            table->rehash_index++;
+            if (--emptyVisits == 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        // move every node of the bucket to its bucket in the new array
+        while (traverseList != NULL)
+        {
+            HashNode *next = traverseList->next;
+            int index = traverseList->hashCode & table->mask;
+
+            traverseList->next = table->nodes[index];
+            table->nodes[index] = traverseList;
+
+            traverseList = next;
+        }
+
+        table->old_nodes[table->rehash_index] = NULL;
+        table->rehash_index++;
+        buckets--;
     }
 
-    table->nodes = calloc(sizeof(HashNode *), size);
-    if (table->nodes == NULL)
+    if (table->rehash_index > table->old_mask)
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        free(table->old_nodes);
+        table->old_nodes = NULL;
+        return false;
     }
 
-    table->size = 0;
-    table->mask = size - 1;
+    return true;
+}
 
-    return table;
+/**
+ * @brief Moves some buckets of a resize in progress, called by every operation on the table and by the server when it is idle
+ *
+ * @param table The hashtable being resized
+ * @param buckets The number of non empty buckets to move
+ *
+ * @return bool true if the resize is still in progress
+ */
+bool hrehash(HashTable *table, int buckets)
+{
+    // the swiss engine checks its load when a node is inserted or removed
+    if (table->engine == HASH_ENGINE_SWISS)
+    {
+        return swiss_rehash_move(table, buckets);
+    }
+
+    if (hrehash_move(table, buckets))
+    {
+        return true;
+    }
+
+    // the load may have gone out of bounds while the resize was in progress
+    hresize_if_needed(table);
+    return table->old_nodes != NULL;
+}
+
+/**
+ * @brief Checks if a resize of the hashtable is in progress, its nodes are then moved by hrehash()
+ *
+ * @param table The hashtable
+ *
+ * @return bool true if the table is being resized
+ */
+bool hrehashing(HashTable *table)
+{
+    return table->old_nodes != NULL || table->old_groups != NULL;
 }
 
 /**
  * @brief Inserts a node into the hashtable
  *
- * This function inserts a node into the hashtable. If the key already exists in the hashtable, it returns NULL. If the hashtable is full or the load factor is too high, it resizes the hashtable.
+ * This function inserts a node into the hashtable. If the key already exists in the hashtable, it returns NULL. Once the table has more nodes than buckets, it starts growing to double the size, the nodes are moved by the following operations on the table.
  *
  * @param table The hashtable to insert the node into
  * @param node The node to insert
@@ -116,42 +866,36 @@ HashTable *hcreate(int size)
  */
 HashNode *hinsert(HashTable *table, HashNode *node)
 {
-    // check if the table is full or if load factor is too high
-    if ((table->size == table->mask + 1) || (table->size / (table->mask + 1) > table->loadFactor))
+    if (table->engine == HASH_ENGINE_SWISS)
     {
-
-        table->size == table->mask + 1 ? printf("Table is full, resizing\n") : printf("Load factor is too high\n");
-
-        // replace old table with new table
-        table = hresize(table);
-        if (table == NULL)
-        {
-            fprintf(stderr, "Table resize has failed\n");
-            return NULL;
-        }
+        return swiss_insert(table, node);
     }
 
-    // calculate the index
-    int hashCode = hash(node->key);
+    hrehash(table, HREHASH_STEP);
+
+    // calculate the hash code
+    uint64_t hashCode = hash(node->key);
     node->hashCode = hashCode;
-    int index = hashCode & table->mask;
 
     // make sure the key is unique
-    if (hget(table, node->key) != NULL)
+    if (hget_hashed(table, node->key, hashCode) != NULL)
     {
         fprintf(stderr, "Key already exists in the table\n");
         return NULL;
     }
 
     // insert the node at the head of the linked list
-    node->next = table->nodes[index];
-    table->nodes[index] = node;
+    HashNode **bucket = hbucket(table, hashCode);
+    node->next = *bucket;
+    *bucket = node;
 
     table->size++;
 
     // update the load factor
     table->loadFactor = (float)table->size / (table->mask + 1);
 
+    hresize_if_needed(table);
+
     return node;
 }
 
@@ -167,14 +911,29 @@ HashNode *hinsert(HashTable *table, HashNode *node)
  */
 HashNode *hget(HashTable *table, char *key)
 {
-    // calculate the hash value for the key
-    int hashCode = hash(key);
+    hrehash(table, HREHASH_STEP);
+
+    return hget_hashed(table, key, hash(key));
+}
 
-    // calculate the index
-    int index = hashCode & table->mask;
+/**
+ * @brief Retrieves a node from the hashtable given a key and its hash code, as computed by hash()
+ *
+ * @param table The hashtable to search
+ * @param key The key of the node to retrieve
+ * @param hashCode The hash code of the key
+ *
+ * @return HashNode* The retrieved node, NULL if the key is not found
+ */
+HashNode *hget_hashed(HashTable *table, char *key, uint64_t hashCode)
+{
+    if (table->engine == HASH_ENGINE_SWISS)
+    {
+        return swiss_lookup(table, key, hashCode);
+    }
 
-    // search for the node in the linked list
-    HashNode *traverseList = table->nodes[index];
+    // search for the node in the linked list of its bucket
+    HashNode *traverseList = *hbucket(table, hashCode);
 
     while (traverseList != NULL)
     {
@@ -190,6 +949,107 @@ HashNode *hget(HashTable *table, char *key)
     return NULL;
 }
 
+/**
+ * @brief Prefetches the memory a group of lookups is going to read
+ *
+ * A lookup is a chain of dependent cache misses, the bucket, then the first node of its chain, then the key of that node. Each stage is prefetched for the whole group before the next stage reads it, so the misses of the group overlap instead of being taken one lookup at a time. Nothing is read that a lookup would not read anyway.
+ *
+ * @param table The hashtable the lookups are done in
+ * @param hashCodes The hash codes of the keys, as computed by hash()
+ * @param count The number of hash codes, should be at most HGET_BATCH
+ */
+void hprefetch(HashTable *table, uint64_t *hashCodes, int count)
+{
+    // the swiss engine reads the control bytes of a group, then the node of the first matching tag, then its key
+    if (table->engine == HASH_ENGINE_SWISS)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int group = swiss_first_group(table->mask, hashCodes[i]);
+            // a group spans a few cache lines
+            for (int offset = 0; offset < (int)sizeof(SwissGroup); offset += 64)
+            {
+                __builtin_prefetch((char *)&table->groups[group] + offset);
+            }
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            HashNode *candidate = swiss_first_candidate(table, hashCodes[i]);
+            if (candidate)
+            {
+                __builtin_prefetch(candidate);
+            }
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            HashNode *candidate = swiss_first_candidate(table, hashCodes[i]);
+            if (candidate)
+            {
+                __builtin_prefetch(candidate->key);
+            }
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        __builtin_prefetch(hbucket(table, hashCodes[i]));
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        HashNode *head = *hbucket(table, hashCodes[i]);
+        if (head)
+        {
+            __builtin_prefetch(head);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        HashNode *head = *hbucket(table, hashCodes[i]);
+        if (head)
+        {
+            __builtin_prefetch(head->key);
+        }
+    }
+}
+
+/**
+ * @brief Retrieves the nodes of several keys, the lookups are done HGET_BATCH at a time with their memory prefetched by hprefetch()
+ *
+ * @param table The hashtable to search
+ * @param keys The keys of the nodes to retrieve
+ * @param num_keys The number of keys
+ * @param nodes Filled with the node of every key, NULL for a key that is not found
+ */
+void hget_many(HashTable *table, char **keys, int num_keys, HashNode **nodes)
+{
+    uint64_t hashCodes[HGET_BATCH];
+
+    hrehash(table, HREHASH_STEP);
+
+    for (int start = 0; start < num_keys; start += HGET_BATCH)
+    {
+        int count = num_keys - start < HGET_BATCH ? num_keys - start : HGET_BATCH;
+
+        for (int i = 0; i < count; i++)
+        {
+            hashCodes[i] = hash(keys[start + i]);
+        }
+
+        hprefetch(table, hashCodes, count);
+
+        for (int i = 0; i < count; i++)
+        {
+            nodes[start + i] = hget_hashed(table, keys[start + i], hashCodes[i]);
+        }
+    }
+}
+
 /**
  * @brief Removes a node from the hashtable given a key
  *
@@ -202,14 +1062,19 @@ HashNode *hget(HashTable *table, char *key)
  */
 HashNode *hremove(HashTable *table, char *key)
 {
-    // calculate the hash value for the key
-    int hashCode = hash(key);
+    if (table->engine == HASH_ENGINE_SWISS)
+    {
+        return swiss_remove(table, key);
+    }
 
-    // calculate the index
-    int index = hashCode & table->mask;
+    hrehash(table, HREHASH_STEP);
 
-    // search for the node in the linked list
-    HashNode *traverseList = table->nodes[index];
+    // calculate the hash value for the key
+    uint64_t hashCode = hash(key);
+
+    // search for the node in the linked list of its bucket
+    HashNode **bucket = hbucket(table, hashCode);
+    HashNode *traverseList = *bucket;
     HashNode *prev = NULL;
 
     while (traverseList != NULL)
@@ -219,7 +1084,7 @@ HashNode *hremove(HashTable *table, char *key)
             // first node in the linked list
             if (prev == NULL)
             {
-                table->nodes[index] = traverseList->next;
+                *bucket = traverseList->next;
             }
             else
             {
@@ -227,6 +1092,9 @@ HashNode *hremove(HashTable *table, char *key)
             }
 
             table->size--;
+            table->loadFactor = (float)table->size / (table->mask + 1);
+
+            hresize_if_needed(table);
 
             return traverseList;
         }
@@ -241,79 +1109,69 @@ HashNode *hremove(HashTable *table, char *key)
 /**
  * @brief resizes the hashtable to double the size
  *
- * This function is called when the load factor exceeds a certain threshold, and the hashtable is resized to double the size.
+ * Unlike the resizes started by hinsert() and hremove(), every node is moved before this function returns.
  *
- * @param table The hashtable to free
+ * @param table The hashtable to resize
  *
  * @return HashTable* The resized hashtable
  */
 HashTable *hresize(HashTable *table)
 {
-
-    int newSize = (table->mask + 1) * 2;
-    if (newSize % 2 != 0)
+    if (table->engine == HASH_ENGINE_SWISS)
     {
-        fprintf(stderr, "new size is not a multiple of 2, not resized\n");
+        swiss_rehash_finish(table);
+        swiss_rehash_start(table, (table->mask + 1) * 2);
+        swiss_rehash_finish(table);
         return table;
     }
 
-    HashTable *newTable = hcreate(newSize);
-
-    // iterate through the old table and reinsert the nodes into the new table
-    for (int i = 0; i <= table->mask; i++)
+    // finish a resize in progress first
+    while (hrehash_move(table, table->old_mask + 1))
     {
-        HashNode *traverseList = table->nodes[i];
-
-        while (traverseList != NULL)
-        {
-            HashNode *temp = traverseList->next;
-
-            // insert the node into the new table
-            hinsert(newTable, traverseList);
-
-            traverseList = temp;
-        }
     }
 
-    // free the old nodes
-    free(table->nodes);
-
-    // copy the new table into the old table
-    table->nodes = newTable->nodes;
-    table->loadFactor = newTable->loadFactor;
-    table->size = newTable->size;
-    table->mask = newTable->mask;
+    hrehash_start(table, (table->mask + 1) * 2);
 
-    // free old table
-    free(newTable);
+    while (hrehash_move(table, table->old_mask + 1))
+    {
+    }
 
     return table;
 }
 
 /**
- * @brief Free the hashtable and all its contents
- *
- * @param table The hashtable to free
+ * @brief Frees every node of a bucket array, including their keys and values
  *
- * @return void
+ * @param nodes The bucket array
+ * @param mask The mask of the bucket array
  */
-void hfree_table(HashTable *table)
+static void hfree_buckets(HashNode **nodes, int mask)
 {
-    for (int i = 0; i <= table->mask; i++)
+    for (int i = 0; i <= mask; i++)
     {
-        HashNode *traverseList = table->nodes[i];
+        HashNode *traverseList = nodes[i];
 
         while (traverseList != NULL)
         {
             HashNode *temp = traverseList->next;
-            free(traverseList->key);
-            free(traverseList->value);
-            free(traverseList);
+            hfree(traverseList);
             traverseList = temp;
         }
     }
 
-    free(table->nodes);
+    free(nodes);
+}
+
+/**
+ * @brief Free the hashtable and all its contents
+ *
+ * @param table The hashtable to free
+ *
+ * @return void
+ */
+void hfree_table(HashTable *table)
+{
+    hfree_table_contents(table);
     free(table);
 }
 
@@ -326,21 +1184,124 @@ void hfree_table(HashTable *table)
  */
 void hfree_table_contents(HashTable *table)
 {
-    for (int i = 0; i <= table->mask; i++)
+    if (table->engine == HASH_ENGINE_SWISS)
     {
-        HashNode *traverseList = table->nodes[i];
+        swiss_free_contents(table);
+        return;
+    }
 
-        while (traverseList != NULL)
+    hfree_buckets(table->nodes, table->mask);
+
+    if (table->old_nodes)
+    {
+        hfree_buckets(table->old_nodes, table->old_mask);
+        table->old_nodes = NULL;
+    }
+}
+
+/**
+ * @brief Frees every node of the hashtable, including their keys and values, the hashtable is left empty with HASH_MIN_SIZE buckets
+ *
+ * @param table The hashtable to clear
+ */
+void hclear(HashTable *table)
+{
+    hfree_table_contents(table);
+
+    if (table->engine == HASH_ENGINE_SWISS)
+    {
+        table->size = 0;
+        swiss_alloc(table, HASH_MIN_SIZE < SWISS_GROUP ? SWISS_GROUP : HASH_MIN_SIZE);
+        return;
+    }
+
+    table->nodes = calloc(sizeof(HashNode *), HASH_MIN_SIZE);
+    if (table->nodes == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    table->size = 0;
+    table->mask = HASH_MIN_SIZE - 1;
+    table->loadFactor = 0;
+}
+
+/**
+ * @brief Starts iterating over every node of the hashtable, the nodes are returned by hiter_next()
+ *
+ * @param table The hashtable to iterate over
+ * @param iter The iterator to initialize
+ */
+void hiter_init(HashTable *table, HashIter *iter)
+{
+    iter->table = table;
+
+    // the buckets or groups of a resize in progress come first
+    iter->buckets = table->old_nodes ? table->old_nodes : table->nodes;
+    iter->groups = table->old_groups ? table->old_groups : table->groups;
+    iter->mask = table->old_nodes || table->old_groups ? table->old_mask : table->mask;
+    iter->index = -1;
+    iter->node = NULL;
+}
+
+/**
+ * @brief Returns the next node of an iteration started by hiter_init()
+ *
+ * @param iter The iterator
+ *
+ * @return HashNode* The next node, NULL once every node has been returned
+ */
+HashNode *hiter_next(HashIter *iter)
+{
+    // the swiss engine returns the node of every full slot
+    if (iter->table->engine == HASH_ENGINE_SWISS)
+    {
+        while (true)
         {
-            HashNode *temp = traverseList->next;
-            free(traverseList->key);
-            free(traverseList->value);
-            free(traverseList);
-            traverseList = temp;
+            while (++iter->index <= iter->mask)
+            {
+                if (SWISS_CTRL(iter->groups, iter->index) >= 0)
+                {
+                    return SWISS_NODE(iter->groups, iter->index);
+                }
+            }
+
+            if (iter->groups == iter->table->groups)
+            {
+                return NULL;
+            }
+
+            // done with the old groups, continue with the new ones
+            iter->groups = iter->table->groups;
+            iter->mask = iter->table->mask;
+            iter->index = -1;
+        }
+    }
+
+    while (iter->node == NULL)
+    {
+        iter->index++;
+        if (iter->index > iter->mask)
+        {
+            if (iter->buckets == iter->table->nodes)
+            {
+                return NULL;
+            }
+
+            // done with the old buckets, continue with the new ones
+            iter->buckets = iter->table->nodes;
+            iter->mask = iter->table->mask;
+            iter->index = 0;
         }
+
+        iter->node = iter->buckets[iter->index];
     }
 
-    free(table->nodes);
+    HashNode *node = iter->node;
+    iter->node = node->next;
+
+    return node;
 }
 
 // Print the hashtable
@@ -348,7 +1309,15 @@ void hprint(HashTable *table)
 {
     for (int i = 0; i <= table->mask; i++)
     {
-        HashNode *traverseList = table->nodes[i];
+        HashNode *traverseList;
+        if (table->engine == HASH_ENGINE_SWISS)
+        {
+            traverseList = SWISS_CTRL(table->groups, i) >= 0 ? SWISS_NODE(table->groups, i) : NULL;
+        }
+        else
+        {
+            traverseList = table->nodes[i];
+        }
 
         printf("--------------------\n");
         printf("Index: %d\n", i);
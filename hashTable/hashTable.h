@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 // Define the value type enum
 typedef enum
@@ -10,9 +12,27 @@ typedef enum
     FLOAT,
     ZSET,
     LIST,
-    HASHTABLE
+    HASHTABLE,
+    // a small hash packed into a listpack of field and value pairs, converted to a HASHTABLE when it grows past the thresholds of the server
+    HASHPACK,
+    // a member of a ZSet, the value is the node of the member in the skiplist of the ZSet and the key is the key of that node, both are freed with the skiplist and not with the hash node
+    ZSET_MEMBER,
+    // the queue of the connections of the server blocked on a key, a single allocation freed with the node
+    WAIT_QUEUE
 } ValueType;
 
+// implementation of a table, chosen for every table created by hcreate() with hset_engine()
+typedef enum
+{
+    // an array of buckets, each one a linked list of nodes, resized incrementally
+    HASH_ENGINE_CHAINED,
+    // open addressing, a control byte per slot holds a 7 bit tag of the key of the slot, probed a group of SWISS_GROUP slots at a time, resized incrementally a group at a time
+    HASH_ENGINE_SWISS
+} HashEngine;
+
+// number of slots whose control bytes the swiss engine compares at once
+#define SWISS_GROUP 16
+
 // Define the HashNode structure
 typedef struct HashNode
 {
@@ -23,33 +43,93 @@ typedef struct HashNode
     void *value;
 
     struct HashNode *next;
-    int hashCode;
+    uint64_t hashCode;
 } HashNode;
 
+// a group of slots of the swiss engine, each with a control byte, the control bytes share a cache line with the first slots
+typedef struct SwissGroup
+{
+    signed char ctrl[SWISS_GROUP];
+    HashNode *slots[SWISS_GROUP];
+} SwissGroup;
+
 typedef struct
 {
-    // Array of HashNode pointers
+    HashEngine engine;
+
+    // Array of HashNode pointers, the buckets of the chained engine
     HashNode **nodes;
 
     float loadFactor;
     int size;
     int mask;
+
+    // while the table is being resized its nodes move from old_nodes to nodes a few buckets at a time, the buckets of old_nodes below rehash_index have been moved already. old_nodes is NULL when no resize is in progress
+    HashNode **old_nodes;
+    int old_mask;
+    int rehash_index;
+
+    // swiss engine, the groups of slots and the number of empty slots that can still be filled before the table is resized
+    struct SwissGroup *groups;
+    int growth_left;
+
+    // while a swiss table is being resized its nodes move from old_groups to groups a group at a time, the groups of old_groups below rehash_index have been moved already and old_size nodes are left in it. old_groups is NULL when no resize is in progress
+    struct SwissGroup *old_groups;
+    int old_size;
 } HashTable;
 
+// iterates over every node of a table, including the buckets of a resize in progress. The table must not be modified during the iteration, but the node just returned may be freed
+typedef struct
+{
+    HashTable *table;
+    HashNode **buckets;
+    struct SwissGroup *groups;
+    int mask;
+    int index;
+    HashNode *node;
+} HashIter;
+
+// smallest number of buckets a table shrinks to
+#define HASH_MIN_SIZE 16
+
+// a table shrinks once it has more than this many buckets per node
+#define HASH_SHRINK_RATIO 8
+
+// number of buckets, or groups of slots of the swiss engine, moved by every operation on a table that is being resized
+#define HREHASH_STEP 1
+
+// control bytes of the swiss engine, a full slot holds the tag of its key instead, which is never negative
+#define CTRL_EMPTY ((signed char)-128)
+#define CTRL_DELETED ((signed char)-2)
+
+// number of lookups hget_many() keeps in flight at once
+#define HGET_BATCH 16
+
 // Function prototypes
-int hash(char *key);
+uint64_t hash(char *key);
+uint64_t hash_len(char *key, int len);
+void hash_set_seed(uint64_t seed);
 
 // size is the initial size of the hash table, must be a power of 2
 HashTable *hcreate(int size);
+void hset_engine(HashEngine engine);
 
 // To insert a node, need to dynamically allocate memory for the node, key, and value. Then, calculate the hash code for the key and store it in the node
 HashNode *hinit(char *key, ValueType type, void *value);
 HashTable *hcreate(int size);
 HashTable *hresize(HashTable *table);
+bool hrehash(HashTable *table, int buckets);
+bool hrehashing(HashTable *table);
 HashNode *hinsert(HashTable *table, HashNode *node);
 HashNode *hget(HashTable *table, char *key);
+HashNode *hget_hashed(HashTable *table, char *key, uint64_t hashCode);
+void hprefetch(HashTable *table, uint64_t *hashCodes, int count);
+void hget_many(HashTable *table, char **keys, int num_keys, HashNode **nodes);
 HashNode *hremove(HashTable *table, char *key);
 void hfree(HashNode *node);
 void hfree_table(HashTable *table);
 void hfree_table_contents(HashTable *table);
+void hclear(HashTable *table);
+void hiter_init(HashTable *table, HashIter *iter);
+HashNode *hiter_next(HashIter *iter);
 void hprint(HashTable *table);
@@ -1,6 +1,201 @@
 #include "hashTable.h"
 
 // time to test the hashtable
+// the chains of a chained table stay short for key sets that look alike, which the old 31*h hash spread badly
+int test_chain_lengths(const char *format, int numKeys)
+{
+    hset_engine(HASH_ENGINE_CHAINED);
+    HashTable *table = hcreate(HASH_MIN_SIZE);
+    char key[128];
+    for (int i = 0; i < numKeys; i++)
+    {
+        snprintf(key, sizeof(key), format, i, i % 7);
+        hinsert(table, hinit(strdup(key), STRING, strdup("value")));
+    }
+
+    while (hrehash(table, 1024))
+    {
+    }
+
+    // for keys spread at random the chain lengths follow a poisson distribution, where the mean of the squared lengths per key is 1 + load
+    int buckets = table->mask + 1;
+    int longest = 0;
+    double squares = 0;
+    for (int i = 0; i < buckets; i++)
+    {
+        int length = 0;
+        for (HashNode *node = table->nodes[i]; node; node = node->next)
+        {
+            if ((int)(node->hashCode & table->mask) != i)
+            {
+                fprintf(stderr, "Test 9 (Chain lengths) failed, key %s in the wrong bucket\n", node->key);
+                return 1;
+            }
+
+            length++;
+        }
+
+        longest = length > longest ? length : longest;
+        squares += (double)length * length;
+    }
+
+    double load = (double)table->size / buckets;
+    if (table->size != numKeys || longest > 12 || squares / table->size > 1.1 + load)
+    {
+        fprintf(stderr, "Test 9 (Chain lengths) failed for %s, longest chain %d, mean squared length %f at load %f\n", format, longest, squares / table->size, load);
+        return 1;
+    }
+
+    hfree_table(table);
+
+    return 0;
+}
+
+// insert, look up, iterate, remove and clear enough keys to resize a table a few times
+int test_large_table(HashEngine engine)
+{
+    // test resizing, every key stays reachable while the nodes move between the bucket arrays
+    hset_engine(engine);
+    HashTable *table = hcreate(HASH_MIN_SIZE);
+    char key[32];
+    int rehashingOps = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key%d", i);
+        hinsert(table, hinit(strdup(key), STRING, strdup("value")));
+        rehashingOps += hrehashing(table);
+
+        sprintf(key, "key%d", i / 2);
+        if (hget(table, key) == NULL)
+        {
+            fprintf(stderr, "Test 6 (Resizing) failed, engine %d\n", engine);
+            return 1;
+        }
+    }
+
+    // the nodes are moved over many operations instead of all at once by the insert that starts a resize
+    if (rehashingOps == 0)
+    {
+        fprintf(stderr, "Test 6 (Incremental resizing) failed, engine %d\n", engine);
+        return 1;
+    }
+
+    // batched lookups find the same nodes
+    char *keys[HGET_BATCH + 4];
+    HashNode *nodes[HGET_BATCH + 4];
+    char keyBuffers[HGET_BATCH + 4][32];
+    for (int i = 0; i < HGET_BATCH + 4; i++)
+    {
+        sprintf(keyBuffers[i], "key%d", i * 97);
+        keys[i] = keyBuffers[i];
+    }
+
+    hget_many(table, keys, HGET_BATCH + 4, nodes);
+    for (int i = 0; i < HGET_BATCH + 4; i++)
+    {
+        if (nodes[i] != hget(table, keys[i]) || (nodes[i] == NULL) != (i * 97 >= 1000))
+        {
+            fprintf(stderr, "Test 6 (Batched lookups) failed, engine %d\n", engine);
+            return 1;
+        }
+    }
+
+    // inserting and removing keys over and over reuses the slots of removed keys
+    for (int i = 0; i < 5000; i++)
+    {
+        sprintf(key, "churn%d", i);
+        hinsert(table, hinit(strdup(key), STRING, strdup("value")));
+        hfree(hremove(table, key));
+    }
+
+    // the iteration covers the buckets of a resize in progress
+    int iterated = 0;
+    HashIter iter;
+    hiter_init(table, &iter);
+    while (hiter_next(&iter))
+    {
+        iterated++;
+    }
+
+    if (table->size != 1000 || iterated != 1000 || table->mask + 1 < 1000)
+    {
+        fprintf(stderr, "Test 6 (Resizing) failed, engine %d\n", engine);
+        return 1;
+    }
+
+    // removing most of the keys shrinks the table
+    for (int i = 0; i < 990; i++)
+    {
+        sprintf(key, "key%d", i);
+        hfree(hremove(table, key));
+    }
+
+    while (hrehash(table, 1))
+    {
+    }
+
+    if (table->size != 10 || table->mask + 1 > table->size * HASH_SHRINK_RATIO || hget(table, "key995") == NULL)
+    {
+        fprintf(stderr, "Test 7 (Shrinking) failed, engine %d\n", engine);
+        return 1;
+    }
+
+    hclear(table);
+    if (table->size != 0 || hget(table, "key995") != NULL)
+    {
+        fprintf(stderr, "Test 8 (Clear) failed, engine %d\n", engine);
+        return 1;
+    }
+
+    // random inserts and removes that grow and shrink the table while it is being resized, every key is found exactly when it was inserted last
+    bool present[3000] = {false};
+    int count = 0;
+    srand(7);
+    for (int i = 0; i < 200000; i++)
+    {
+        // phases of mostly inserts and mostly removes
+        int k = rand() % 3000;
+        bool insert = rand() % 100 < ((i / 20000) % 2 ? 5 : 95);
+        sprintf(key, "mix%d", k);
+        if (insert && !present[k])
+        {
+            hinsert(table, hinit(strdup(key), STRING, strdup("value")));
+            present[k] = true;
+            count++;
+        }
+        else if (!insert && present[k])
+        {
+            hfree(hremove(table, key));
+            present[k] = false;
+            count--;
+        }
+
+        sprintf(key, "mix%d", (k * 7 + 1) % 3000);
+        if ((hget(table, key) != NULL) != present[(k * 7 + 1) % 3000] || table->size != count)
+        {
+            fprintf(stderr, "Test 6 (Resizing under churn) failed, engine %d\n", engine);
+            return 1;
+        }
+    }
+
+    int iteratedMix = 0;
+    hiter_init(table, &iter);
+    while (hiter_next(&iter))
+    {
+        iteratedMix++;
+    }
+
+    if (iteratedMix != count)
+    {
+        fprintf(stderr, "Test 6 (Resizing under churn) failed, engine %d\n", engine);
+        return 1;
+    }
+
+    hfree_table(table);
+
+    return 0;
+}
+
 int main()
 {
     HashTable *table = hcreate(16);
@@ -160,9 +355,57 @@ int main()
         return 1;
     }
 
+    // test batched lookups, more keys than fit in one batch and a key that is missing
+    char *keys[HGET_BATCH + 2];
+    HashNode *nodes[HGET_BATCH + 2];
+    for (int i = 0; i < HGET_BATCH + 2; i++)
+    {
+        keys[i] = i % 2 == 0 ? "key1" : "key20";
+    }
+    keys[HGET_BATCH + 1] = "missing";
+
+    hget_many(table, keys, HGET_BATCH + 2, nodes);
+    for (int i = 0; i < HGET_BATCH + 1; i++)
+    {
+        if (nodes[i] != hget(table, keys[i]) || nodes[i] == NULL)
+        {
+            fprintf(stderr, "Test 5 (Batched lookups) failed\n");
+            return 1;
+        }
+    }
+
+    if (nodes[HGET_BATCH + 1] != NULL || hash_len("key20 value", 5) != hash("key20"))
+    {
+        fprintf(stderr, "Test 5 (Batched lookups) failed\n");
+        return 1;
+    }
+
     // free
     hfree_table(table);
 
+    // the hash is seeded, the same key hashes differently under another seed, and long keys hash the same whole or cut out of a longer buffer
+    char longKey[] = "https://example.com/users/12345/sessions/67890/tokens?expires=3600&scope=read";
+    char prefix[21] = {0};
+    memcpy(prefix, longKey, 20);
+    uint64_t seeded = hash(longKey);
+    hash_set_seed(0x1234);
+    if (hash(longKey) == seeded || hash_len(longKey, 60) == hash(longKey) || hash_len(longKey, 20) != hash(prefix))
+    {
+        fprintf(stderr, "Test 10 (Seeded hash) failed\n");
+        return 1;
+    }
+
+    if (test_chain_lengths("user:%d:session", 100000) || test_chain_lengths("%d", 100000) || test_chain_lengths("https://example.com/users/%d/sessions/%d/tokens?expires=3600&scope=read", 100000))
+    {
+        return 1;
+    }
+
+    // the tests of a large table run for every engine
+    if (test_large_table(HASH_ENGINE_CHAINED) || test_large_table(HASH_ENGINE_SWISS))
+    {
+        return 1;
+    }
+
     printf("All tests passed\n");
 
     return 0;
@@ -0,0 +1,118 @@
+// benchmark the value scans of LEXISTS and LREM over lists of a million elements, against reading every element with the iterator and comparing it
+#include "list.h"
+#include <time.h>
+
+#define BENCH_ELEMENTS (1 << 20)
+#define BENCH_SCANS 32
+
+// nanoseconds since an arbitrary point
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// the scan of list_contains() written with the iterator, an element is compared by length and then by bytes
+static bool iter_contains(List *list, char *value)
+{
+    int len = strlen(value);
+
+    ListIter iter;
+    ListNode node;
+    list_iter_init(list, &iter, 0);
+    while (list_iter_next(&iter, &node))
+    {
+        if (node.len == len && memcmp(node.data, value, len) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// a list of num_elements elements, element i is made by format from i
+static List *bench_list(char *format, int modulo)
+{
+    List *list = list_init();
+    for (int i = 0; i < BENCH_ELEMENTS; i++)
+    {
+        char value[32];
+        sprintf(value, format, i % modulo);
+        list_rinsert(list, value, LIST_TYPE_STRING);
+    }
+
+    return list;
+}
+
+// time looking up a value that is not in the list, so every element is read, and a value that is its last element
+static void bench_contains(char *name, List *list, char *missing, char *last)
+{
+    double start = now_ns();
+    bool found = false;
+    for (int i = 0; i < BENCH_SCANS; i++)
+    {
+        found |= list_contains(list, missing, LIST_TYPE_STRING);
+    }
+    double scan_miss = (now_ns() - start) / BENCH_SCANS / list->size;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_SCANS; i++)
+    {
+        found |= iter_contains(list, missing);
+    }
+    double iter_miss = (now_ns() - start) / BENCH_SCANS / list->size;
+
+    start = now_ns();
+    for (int i = 0; i < BENCH_SCANS; i++)
+    {
+        found &= list_contains(list, last, LIST_TYPE_STRING);
+    }
+    double scan_last = (now_ns() - start) / BENCH_SCANS / list->size;
+
+    printf("%-24s %14.2f %14.2f %14.2f\n", name, scan_miss, iter_miss, scan_last);
+
+    // keeps the compiler from dropping the scans
+    if (found)
+    {
+        printf("\n");
+    }
+}
+
+int main()
+{
+    printf("%-24s %14s %14s %14s\n", "list", "miss ns/elem", "iter ns/elem", "last ns/elem");
+
+    // distinct values of the same length, every element is compared byte by byte
+    List *list = bench_list("item:%07d", BENCH_ELEMENTS);
+    bench_contains("distinct, same length", list, "item:9999999", "item:1048575");
+    list_free_contents(list);
+    free(list);
+
+    // a de-dupe queue of short ids of a few lengths
+    list = bench_list("%d", 100000);
+    bench_contains("short ids", list, "100000", "48575");
+
+    // LREM of a value that is in the list once every 100000 elements, from the head and from the tail, then of a value that is not in it
+    double start = now_ns();
+    int removed = list_removeFromHead(list, "12345", LIST_TYPE_STRING, 0);
+    double remove_head = (now_ns() - start) / BENCH_ELEMENTS;
+
+    start = now_ns();
+    removed += list_removeFromTail(list, "54321", LIST_TYPE_STRING, 0);
+    double remove_tail = (now_ns() - start) / BENCH_ELEMENTS;
+
+    start = now_ns();
+    removed += list_removeFromTail(list, "100000", LIST_TYPE_STRING, 0);
+    double remove_miss = (now_ns() - start) / BENCH_ELEMENTS;
+
+    printf("%-24s %14s %14s %14s\n", "lrem", "head ns/elem", "tail ns/elem", "miss ns/elem");
+    printf("%-24s %14.2f %14.2f %14.2f\n", "short ids", remove_head, remove_tail, remove_miss);
+    printf("%d elements removed\n", removed);
+
+    list_free_contents(list);
+    free(list);
+
+    return 0;
+}
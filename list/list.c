@@ -1,11 +1,22 @@
-// * This file contains the implementation of the doubly linked list. The list is a collection of nodes, each node contains a data field and two pointers to the next and previous nodes. The list can be used to store data of different types, the type of the data is specified by the NodeType enum. Will use a doubly linked list to allow for bidirectional traversal: O(1) insertion and deletion at both ends of the list and at the cost of memory. The list supports insertion, removal, modification, retrieval, and trimming of nodes.
+// * This file contains the implementation of the list, an unrolled doubly linked list. Instead of a node and a data allocation per element, the elements are packed one after the other into listpacks of up to LIST_BLOCK_BYTES bytes, and the listpacks are the blocks of a doubly linked list. An element costs a few bytes on top of its data, pushes and pops at both ends change only the first or the last block, and a range is read by walking the entries of a block and then moving to the next block. The blocks are also kept in a position index, so the element at an index is found in O(log n). The list can be used to store data of different types, the type of an element is stored in the first byte of its entry. The list supports insertion, removal, modification, retrieval, and trimming of elements.
 
-//! When a node is removed using list_lremove or list_rremove, still need to free the node using l_free_node.
+//! When an element is removed using list_lremove or list_rremove, still need to free the node using list_free_node.
 
 #include "list.h"
 
 #define EPSILON 1e-9f
 
+// elements of up to this many bytes, type included, are encoded on the stack before being written to a block
+#define LIST_ENCODE_STACK_BYTES 128
+
+// an element encoded as it is stored in an entry, its type followed by its bytes
+typedef struct ListEncoded
+{
+    char *bytes;
+    int len;
+    char stack[LIST_ENCODE_STACK_BYTES];
+} ListEncoded;
+
 /**
  * @brief Initializes a new doubly list
  *
@@ -14,11 +25,19 @@
 List *list_init()
 {
     List *new_list = (List *)calloc(1, sizeof(List));
+    if (new_list == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
 
     new_list->head = NULL;
     new_list->tail = NULL;
     new_list->size = 0;
 
+    // the index is built the first time it is used
+    new_list->index.stale = true;
+
     return new_list;
 }
 
@@ -34,233 +53,533 @@ bool compare_float(float a, float b)
 }
 
 /**
- * @brief Compare two list nodes
+ * @brief Encodes an element as it is stored in an entry
  *
- * @param node1 The first node
- * @param node2 The second node
+ * @param encoded Set to the encoded element, free it with list_encoded_free()
+ * @param data The data of the element
+ * @param listType The type of the data
  *
- * @return bool true if the nodes are equal, false otherwise
+ * @return bool true if successful, false if the type is invalid
  */
-bool compare_list_node(ListNode *node1, ListNode *node2)
+static bool list_encode(ListEncoded *encoded, void *data, ListType listType)
 {
-    if (node1->listType != node2->listType)
+    int len;
+    if (listType == LIST_TYPE_STRING)
     {
-        return false;
+        len = strlen((char *)data);
     }
-
-    if (node1->listType == LIST_TYPE_INT)
+    else if (listType == LIST_TYPE_FLOAT)
     {
-        return *(int *)node1->data == *(int *)node2->data;
+        len = sizeof(float);
     }
-    else if (node1->listType == LIST_TYPE_FLOAT)
+    else if (listType == LIST_TYPE_INT)
     {
-        return compare_float(*(float *)node1->data, *(float *)node2->data);
+        len = sizeof(int);
     }
-    else if (node1->listType == LIST_TYPE_STRING)
+    else
     {
-        return strcmp((char *)node1->data, (char *)node2->data) == 0;
+        fprintf(stderr, "Invalid type\n");
+        return false;
     }
-    else
+
+    encoded->len = len + 1;
+    encoded->bytes = encoded->len <= LIST_ENCODE_STACK_BYTES ? encoded->stack : malloc(encoded->len);
+    if (encoded->bytes == NULL)
     {
-        // should never reach here, list only supports int, float, and string
-        fprintf(stderr, "Invalid type, list should only contain int,float,string\n");
+        fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
+
+    encoded->bytes[0] = listType;
+    memcpy(encoded->bytes + 1, data, len);
+
+    return true;
 }
 
 /**
- *  @brief Checks if a list contains a value
+ * @brief Frees an element encoded by list_encode()
  *
- *  @param list The list to check
- *  @param data The data to check for
- *  @param listType The type of the data
+ * @param encoded The encoded element
  */
-bool list_contains(List *list, void *data, ListType listType)
+static void list_encoded_free(ListEncoded *encoded)
 {
-    ListNode input_node = {data, listType, NULL, NULL};
-    ListNode *current = list->head;
-
-    while (current)
+    if (encoded->bytes != encoded->stack)
     {
-        if (compare_list_node(current, &input_node))
-        {
-            return true;
-        }
-
-        current = current->next;
+        free(encoded->bytes);
     }
+}
+
+/**
+ * @brief Reads the element of an entry
+ *
+ * @param block The block of the entry
+ * @param offset The offset of the entry in the listpack of the block
+ * @param node Set to the element, its data points into the block
+ */
+static void list_decode(ListBlock *block, int offset, ListNode *node)
+{
+    int len;
+    char *bytes = lp_get(block->lp, offset, &len);
 
-    return false;
+    node->listType = (ListType)bytes[0];
+    node->data = bytes + 1;
+    node->len = len - 1;
 }
 
 /**
- * @brief Insert a new node at the head of the list
+ * @brief Compares the entry at an offset with an element, the lengths are compared before the bytes, and floats are compared using epsilon method
  *
- * @param list The list to insert into
- * @param data The data to insert
- * @param listType The type of the data
+ * @param block The block of the entry
+ * @param offset The offset of the entry
+ * @param encoded The element
  *
- * @return int 0 if successful, -1 if failed
+ * @return bool true if they are equal, false otherwise
  */
-int list_linsert(List *list, void *data, ListType listType)
+static bool list_entry_equals(ListBlock *block, int offset, ListEncoded *encoded)
 {
-    ListNode *new_node = (ListNode *)calloc(1, sizeof(ListNode));
-    if (new_node == NULL)
+    int len;
+    char *bytes = lp_get(block->lp, offset, &len);
+    if (len != encoded->len || bytes[0] != encoded->bytes[0])
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        return false;
     }
 
-    // edit Node
-    if (listType == LIST_TYPE_STRING)
+    if (bytes[0] == LIST_TYPE_FLOAT)
     {
-        new_node->data = strdup((char *)data);
-        new_node->listType = LIST_TYPE_STRING;
+        float a, b;
+        memcpy(&a, bytes + 1, sizeof(float));
+        memcpy(&b, encoded->bytes + 1, sizeof(float));
+        return compare_float(a, b);
     }
-    else if (listType == LIST_TYPE_FLOAT)
+
+    return memcmp(bytes + 1, encoded->bytes + 1, len - 1) == 0;
+}
+
+/**
+ * @brief Finds the first entry of a block equal to an element, starting at an offset
+ *
+ * @param block The block to search
+ * @param offset The offset of the entry to start at, may be the number of bytes of the listpack
+ * @param encoded The element to find
+ *
+ * @return int The offset of the entry, -1 if there is none
+ */
+static int list_find(ListBlock *block, int offset, ListEncoded *encoded)
+{
+    // only floats are not compared byte by byte
+    if (encoded->bytes[0] != LIST_TYPE_FLOAT)
+    {
+        return lp_find(block->lp, offset, encoded->bytes, encoded->len, 0);
+    }
+
+    for (; offset >= 0 && offset < (int)block->lp->bytes; offset = lp_next(block->lp, offset))
     {
-        new_node->data = calloc(1, sizeof(float));
-        if (new_node->data == NULL)
+        if (list_entry_equals(block, offset, encoded))
         {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
+            return offset;
         }
+    }
+
+    return -1;
+}
 
-        *(float *)new_node->data = *(float *)data;
-        new_node->listType = LIST_TYPE_FLOAT;
+/**
+ * @brief Adds to the number of elements of a slot in the Fenwick tree of the index
+ *
+ * @param list The list
+ * @param slot The slot
+ * @param delta The number of elements added, negative when removed
+ */
+static void list_index_add(List *list, int slot, int delta)
+{
+    int *tree = list->index.tree;
+    for (int i = slot + 1; i <= list->index.capacity; i += i & -i)
+    {
+        tree[i] += delta;
     }
-    else if (listType == LIST_TYPE_INT)
+}
+
+/**
+ * @brief Rebuilds the position index from the blocks, the blocks get consecutive slots in the middle of the array, with as many free slots as blocks left around them
+ *
+ * @param list The list
+ */
+static void list_index_rebuild(List *list)
+{
+    ListIndex *index = &list->index;
+
+    int num_blocks = 0;
+    for (ListBlock *block = list->head; block; block = block->next)
     {
-        new_node->data = calloc(1, sizeof(int));
-        if (new_node->data == NULL)
+        num_blocks++;
+    }
+
+    int capacity = 2 * num_blocks + 8;
+    if (capacity > index->capacity || capacity * 4 < index->capacity)
+    {
+        index->slots = (ListBlock **)realloc(index->slots, sizeof(ListBlock *) * capacity);
+        index->tree = (int *)realloc(index->tree, sizeof(int) * (capacity + 1));
+        if (index->slots == NULL || index->tree == NULL)
         {
             fprintf(stderr, "Memory allocation failed\n");
             exit(EXIT_FAILURE);
         }
 
-        *(int *)new_node->data = *(int *)data;
-        new_node->listType = LIST_TYPE_INT;
-    }
-    else
-    {
-        fprintf(stderr, "Invalid type\n");
-        return -1;
+        index->capacity = capacity;
     }
 
-    new_node->next = list->head;
-    new_node->prev = NULL;
+    // the tree starts with the number of elements of each slot, then every node adds itself to its parent
+    int *tree = index->tree;
+    memset(tree, 0, sizeof(int) * (index->capacity + 1));
 
-    // edit List
-    if (list->head)
+    index->first = (index->capacity - num_blocks) / 2;
+    index->last = index->first;
+    for (ListBlock *block = list->head; block; block = block->next)
     {
-        list->head->prev = new_node;
+        block->slot = index->last++;
+        index->slots[block->slot] = block;
+
+        if (block != list->head && block != list->tail)
+        {
+            tree[block->slot + 1] = block->lp->count;
+        }
     }
-    list->head = new_node;
 
-    if (!list->tail)
+    for (int i = 1; i <= index->capacity; i++)
     {
-        list->tail = new_node;
+        int parent = i + (i & -i);
+        if (parent <= index->capacity)
+        {
+            tree[parent] += tree[i];
+        }
     }
 
-    list->size++;
+    index->stale = false;
+}
 
-    return 0;
+/**
+ * @brief Updates the index after the number of elements of a block changed
+ *
+ * @param list The list of the block
+ * @param block The block
+ * @param delta The number of elements added to the block, negative when removed
+ */
+static void list_block_resized(List *list, ListBlock *block, int delta)
+{
+    if (!list->index.stale && block != list->head && block != list->tail)
+    {
+        list_index_add(list, block->slot, delta);
+    }
 }
 
 /**
- * @brief Insert a new node at the tail of the list
+ * @brief Creates an empty block and links it between two blocks
  *
- * @param list The list to insert into
- * @param data The data to insert
- * @param listType The type of the data
+ * @param list The list of the block
+ * @param prev The block before the new one, NULL to make it the head
+ * @param next The block after the new one, NULL to make it the tail
  *
- * @return int 0 if successful, -1 if failed
+ * @return ListBlock* The new block
  */
-int list_rinsert(List *list, void *data, ListType listType)
+static ListBlock *list_block_new(List *list, ListBlock *prev, ListBlock *next)
 {
-    ListNode *new_node = (ListNode *)calloc(1, sizeof(ListNode));
-    if (new_node == NULL)
+    ListBlock *block = (ListBlock *)calloc(1, sizeof(ListBlock));
+    if (block == NULL)
     {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
-    // edit Node
-    if (listType == LIST_TYPE_STRING)
+    block->lp = lp_new();
+    block->prev = prev;
+    block->next = next;
+
+    // a new head or tail takes the free slot next to the old one, which joins the tree unless it is also the other end
+    ListIndex *index = &list->index;
+    if (!index->stale && !prev && next && index->first > 0)
     {
-        new_node->data = strdup((char *)data);
-        new_node->listType = LIST_TYPE_STRING;
+        if (next != list->tail)
+        {
+            list_index_add(list, next->slot, next->lp->count);
+        }
+
+        block->slot = --index->first;
+        index->slots[block->slot] = block;
     }
-    else if (listType == LIST_TYPE_FLOAT)
+    else if (!index->stale && prev && !next && index->last < index->capacity)
     {
-        new_node->data = calloc(1, sizeof(float));
-        if (new_node->data == NULL)
+        if (prev != list->head)
         {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
+            list_index_add(list, prev->slot, prev->lp->count);
         }
 
-        *(float *)new_node->data = *(float *)data;
-        new_node->listType = LIST_TYPE_FLOAT;
+        block->slot = index->last++;
+        index->slots[block->slot] = block;
     }
-    else if (listType == LIST_TYPE_INT)
+    else
+    {
+        index->stale = true;
+    }
+
+    if (prev)
+    {
+        prev->next = block;
+    }
+    else
     {
-        new_node->data = calloc(1, sizeof(int));
-        if (new_node->data == NULL)
+        list->head = block;
+    }
+
+    if (next)
+    {
+        next->prev = block;
+    }
+    else
+    {
+        list->tail = block;
+    }
+
+    return block;
+}
+
+/**
+ * @brief Unlinks a block from the list and frees it with its entries, the size of the list is not changed
+ *
+ * @param list The list of the block
+ * @param block The block to free
+ */
+static void list_block_free(List *list, ListBlock *block)
+{
+    // the block next to a freed head or tail becomes the new one and leaves the tree, a block freed in the middle leaves an empty slot
+    ListIndex *index = &list->index;
+    if (!index->stale && block == list->head && block != list->tail)
+    {
+        if (block->next != list->tail)
         {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
+            list_index_add(list, block->next->slot, -block->next->lp->count);
+        }
+
+        index->first++;
+    }
+    else if (!index->stale && block == list->tail && block != list->head)
+    {
+        if (block->prev != list->head)
+        {
+            list_index_add(list, block->prev->slot, -block->prev->lp->count);
         }
 
-        *(int *)new_node->data = *(int *)data;
-        new_node->listType = LIST_TYPE_INT;
+        index->last--;
+    }
+    else if (!index->stale && block != list->head)
+    {
+        list_index_add(list, block->slot, -block->lp->count);
+        index->slots[block->slot] = NULL;
     }
     else
     {
-        fprintf(stderr, "Invalid type\n");
-        return -1;
+        index->stale = true;
     }
 
-    new_node->next = NULL;
-    new_node->prev = list->tail;
+    if (block->prev)
+    {
+        block->prev->next = block->next;
+    }
+    else
+    {
+        list->head = block->next;
+    }
 
-    // edit List
-    if (list->tail)
+    if (block->next)
     {
-        list->tail->next = new_node;
+        block->next->prev = block->prev;
     }
-    list->tail = new_node;
+    else
+    {
+        list->tail = block->prev;
+    }
+
+    lp_free(block->lp);
+    free(block);
+}
 
-    if (!list->head)
+/**
+ * @brief Merges the block after a block into it when both fit in one block, so removals in the middle of the list do not leave it with many small blocks
+ *
+ * @param list The list of the block
+ * @param block The block
+ */
+static void list_block_merge(List *list, ListBlock *block)
+{
+    ListBlock *next = block->next;
+    if (next && block->lp->bytes + next->lp->bytes <= LIST_BLOCK_BYTES)
     {
-        list->head = new_node;
+        list_block_resized(list, block, next->lp->count);
+        block->lp = lp_merge(block->lp, next->lp);
+        list_block_free(list, next);
     }
+}
+
+/**
+ * @brief Finds the block and the entry of the element at an index. The head and the tail are checked first, the other blocks are found with a descent of the Fenwick tree of the index, and the entry is found walking its block from the closer end.
+ *
+ * @param list The list
+ * @param index The index, must be in range
+ * @param block Set to the block of the element
+ *
+ * @return int The offset of the entry in the listpack of the block
+ */
+static int list_seek(List *list, int index, ListBlock **block)
+{
+    int head_count = list->head->lp->count;
+    int tail_start = list->size - list->tail->lp->count;
 
+    if (index < head_count)
+    {
+        *block = list->head;
+        return lp_seek(list->head->lp, index);
+    }
+
+    if (index >= tail_start)
+    {
+        *block = list->tail;
+        return lp_seek(list->tail->lp, index - tail_start);
+    }
+
+    if (list->index.stale)
+    {
+        list_index_rebuild(list);
+    }
+
+    // find the most slots whose elements all come before the index, the slot after them holds the block of the index. The empty slots and the head count for nothing, and the index is before the tail, so the slot found is never an empty one.
+    int *tree = list->index.tree;
+    int capacity = list->index.capacity;
+
+    int step = 1;
+    while (step * 2 <= capacity)
+    {
+        step *= 2;
+    }
+
+    int slot = 0;
+    index -= head_count;
+    for (; step > 0; step /= 2)
+    {
+        if (slot + step <= capacity && tree[slot + step] <= index)
+        {
+            slot += step;
+            index -= tree[slot];
+        }
+    }
+
+    *block = list->index.slots[slot];
+    return lp_seek((*block)->lp, index);
+}
+
+/**
+ * @brief Insert an entry at one end of the list, a new block is started when the block at that end would get more than LIST_BLOCK_BYTES bytes
+ *
+ * @param list The list to insert into
+ * @param bytes The entry, the type of the element followed by its bytes, it may point into the list
+ * @param len The number of bytes of the entry
+ * @param head true to insert at the head, false at the tail
+ */
+static void list_push_entry(List *list, const char *bytes, int len, bool head)
+{
+    ListBlock *block = head ? list->head : list->tail;
+    if (!block || block->lp->bytes + len > LIST_BLOCK_BYTES)
+    {
+        block = head ? list_block_new(list, NULL, list->head) : list_block_new(list, list->tail, NULL);
+    }
+
+    block->lp = lp_insert(block->lp, head ? 0 : block->lp->bytes, bytes, len);
     list->size++;
+}
+
+/**
+ * @brief Insert a new element at one end of the list
+ *
+ * @param list The list to insert into
+ * @param data The data to insert
+ * @param listType The type of the data
+ * @param head true to insert at the head, false at the tail
+ *
+ * @return int 0 if successful, -1 if failed
+ */
+static int list_push(List *list, void *data, ListType listType, bool head)
+{
+    ListEncoded encoded;
+    if (!list_encode(&encoded, data, listType))
+    {
+        return -1;
+    }
+
+    list_push_entry(list, encoded.bytes, encoded.len, head);
+
+    list_encoded_free(&encoded);
 
     return 0;
 }
 
 /**
- * @brief Free a list node
- *
- * @param node List node to free
+ * @brief Inserts an encoded element before the entry at an offset of a block. When the block is full, the element goes to the end of the previous block or the start of the next one if it is inserted at the edge of the block and they have room, otherwise the block is split at the offset.
  *
+ * @param list The list of the block
+ * @param block The block
+ * @param offset The offset of the entry to insert before, the number of bytes of the listpack to append
+ * @param encoded The element
  */
-void list_free_node(ListNode *node)
+static void list_block_insert(List *list, ListBlock *block, int offset, ListEncoded *encoded)
 {
-    free(node->data);
-    free(node);
+    if (block->lp->bytes + encoded->len > LIST_BLOCK_BYTES)
+    {
+        if (offset == 0)
+        {
+            ListBlock *prev = block->prev;
+            if (!prev || prev->lp->bytes + encoded->len > LIST_BLOCK_BYTES)
+            {
+                prev = list_block_new(list, block->prev, block);
+            }
+
+            block = prev;
+            offset = block->lp->bytes;
+        }
+        else if (offset == (int)block->lp->bytes)
+        {
+            ListBlock *next = block->next;
+            if (!next || next->lp->bytes + encoded->len > LIST_BLOCK_BYTES)
+            {
+                next = list_block_new(list, block, block->next);
+            }
+
+            block = next;
+            offset = 0;
+        }
+        else
+        {
+            // the entries from the offset on move to a new block after this one, and the element is appended to this one
+            ListBlock *rest = list_block_new(list, block, block->next);
+            lp_free(rest->lp);
+            block->lp = lp_split(block->lp, offset, &rest->lp);
+
+            // the index still counts the moved entries in this block
+            list->index.stale = true;
+        }
+    }
+
+    block->lp = lp_insert(block->lp, offset, encoded->bytes, encoded->len);
+    list_block_resized(list, block, 1);
+    list->size++;
 }
 
 /**
- * @brief Remove from head
+ * @brief Remove the element at one end of the list
  *
  * @param list The list to remove from
+ * @param head true to remove from the head, false from the tail
  *
- * @return ListNode* The removed node
+ * @return ListNode* The removed element, NULL if the list is empty
  */
-ListNode *list_lremove(List *list)
+static ListNode *list_pop(List *list, bool head)
 {
     if (list->size == 0)
     {
@@ -268,20 +587,30 @@ ListNode *list_lremove(List *list)
         return NULL;
     }
 
-    ListNode *removed_node = list->head;
+    ListBlock *block = head ? list->head : list->tail;
+    int offset = head ? lp_first(block->lp) : lp_last(block->lp);
+
+    ListNode element;
+    list_decode(block, offset, &element);
 
-    // Check if the head node exists and update the prev pointer of the new head
-    if (list->head && list->head->next)
+    // the node and a null terminated copy of the data are a single allocation
+    ListNode *removed_node = (ListNode *)malloc(sizeof(ListNode) + element.len + 1);
+    if (removed_node == NULL)
     {
-        list->head->next->prev = NULL;
-        list->head = list->head->next;
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
     }
-    else
-    {
-        // If the list becomes empty after removal, set head and tail to NULL
 
-        list->head = NULL;
-        list->tail = NULL;
+    removed_node->data = removed_node + 1;
+    removed_node->len = element.len;
+    removed_node->listType = element.listType;
+    memcpy(removed_node->data, element.data, element.len);
+    ((char *)removed_node->data)[element.len] = '\0';
+
+    block->lp = lp_delete(block->lp, offset, 1);
+    if (block->lp->count == 0)
+    {
+        list_block_free(list, block);
     }
 
     list->size--;
@@ -290,49 +619,217 @@ ListNode *list_lremove(List *list)
 }
 
 /**
- * @brief Remove from tail
+ * @brief Remove elements from one end of the list, whole blocks are freed without reading their entries
  *
  * @param list The list to remove from
+ * @param count The number of elements to remove, at most the size of the list
+ * @param head true to remove from the head, false from the tail
+ */
+static void list_delete_end(List *list, int count, bool head)
+{
+    while (count > 0)
+    {
+        ListBlock *block = head ? list->head : list->tail;
+        int removed = block->lp->count;
+
+        if (removed <= count)
+        {
+            list_block_free(list, block);
+        }
+        else
+        {
+            block->lp = lp_delete(block->lp, head ? 0 : lp_seek(block->lp, -count), count);
+            removed = count;
+        }
+
+        count -= removed;
+        list->size -= removed;
+    }
+}
+
+/**
+ *  @brief Checks if a list contains a value
+ *
+ *  @param list The list to check
+ *  @param data The data to check for
+ *  @param listType The type of the data
+ */
+bool list_contains(List *list, void *data, ListType listType)
+{
+    ListEncoded encoded;
+    if (!list_encode(&encoded, data, listType))
+    {
+        return false;
+    }
+
+    bool found = false;
+    for (ListBlock *block = list->head; block && !found; block = block->next)
+    {
+        found = list_find(block, 0, &encoded) >= 0;
+    }
+
+    list_encoded_free(&encoded);
+
+    return found;
+}
+
+/**
+ * @brief Insert a new element at the head of the list
+ *
+ * @param list The list to insert into
+ * @param data The data to insert
+ * @param listType The type of the data
  *
  * @return int 0 if successful, -1 if failed
  */
-ListNode *list_rremove(List *list)
+int list_linsert(List *list, void *data, ListType listType)
 {
-    if (list->size == 0)
+    return list_push(list, data, listType, true);
+}
+
+/**
+ * @brief Insert a new element at the tail of the list
+ *
+ * @param list The list to insert into
+ * @param data The data to insert
+ * @param listType The type of the data
+ *
+ * @return int 0 if successful, -1 if failed
+ */
+int list_rinsert(List *list, void *data, ListType listType)
+{
+    return list_push(list, data, listType, false);
+}
+
+/**
+ * @brief Insert a new element before or after the first element equal to a pivot, searching from the head of the list
+ *
+ * @param list The list to insert into
+ * @param pivot The data of the pivot
+ * @param data The data to insert
+ * @param listType The type of the pivot and of the data
+ * @param after true to insert after the pivot, false before it
+ *
+ * @return int 0 if successful, -1 if the pivot is not in the list or the type is invalid
+ */
+int list_pinsert(List *list, void *pivot, void *data, ListType listType, bool after)
+{
+    ListEncoded encoded_pivot;
+    if (!list_encode(&encoded_pivot, pivot, listType))
     {
-        fprintf(stderr, "List is empty\n");
-        return NULL;
+        return -1;
     }
 
-    ListNode *removed_node = list->tail;
+    ListEncoded encoded;
+    if (!list_encode(&encoded, data, listType))
+    {
+        list_encoded_free(&encoded_pivot);
+        return -1;
+    }
 
-    // Check if the tail node exists and update the prev pointer of the new tail
-    if (list->tail && list->tail->prev)
+    int ret = -1;
+    for (ListBlock *block = list->head; block && ret != 0; block = block->next)
     {
-        list->tail->prev->next = NULL;
-        list->tail = list->tail->prev;
+        int offset = list_find(block, 0, &encoded_pivot);
+        if (offset < 0)
+        {
+            continue;
+        }
+
+        if (after)
+        {
+            offset = lp_next(block->lp, offset);
+            offset = offset < 0 ? (int)block->lp->bytes : offset;
+        }
+
+        list_block_insert(list, block, offset, &encoded);
+        ret = 0;
     }
-    else
+
+    list_encoded_free(&encoded_pivot);
+    list_encoded_free(&encoded);
+
+    return ret;
+}
+
+/**
+ * @brief Move the element at one end of a list to one end of another list, or of the same list. The entry is copied from the block of the source straight into the block of the destination, without being popped into a ListNode first.
+ *
+ * @param source The list to remove from
+ * @param destination The list to insert into
+ * @param from_head true to remove from the head of the source, false from its tail
+ * @param to_head true to insert at the head of the destination, false at its tail
+ *
+ * @return int 0 if successful, -1 if the source is empty
+ */
+int list_move(List *source, List *destination, bool from_head, bool to_head)
+{
+    if (source->size == 0)
+    {
+        return -1;
+    }
+
+    // moving an element to the end it is at leaves the list as it is
+    if (source == destination && from_head == to_head)
     {
-        // If the list becomes empty after removal, set head and tail to NULL
-        list->head = NULL;
-        list->tail = NULL;
+        return 0;
     }
 
-    list->size--;
+    ListBlock *block = from_head ? source->head : source->tail;
+    int len;
+    char *bytes = lp_get(block->lp, from_head ? lp_first(block->lp) : lp_last(block->lp), &len);
 
-    return removed_node;
+    // the insert goes to the other end when the lists are the same, so the element is still at the end it is removed from afterwards
+    list_push_entry(destination, bytes, len, to_head);
+    list_delete_end(source, 1, from_head);
+
+    return 0;
+}
+
+/**
+ * @brief Free a node removed from the list
+ *
+ * @param node List node to free
+ *
+ */
+void list_free_node(ListNode *node)
+{
+    free(node);
+}
+
+/**
+ * @brief Remove from head
+ *
+ * @param list The list to remove from
+ *
+ * @return ListNode* The removed element, NULL if the list is empty
+ */
+ListNode *list_lremove(List *list)
+{
+    return list_pop(list, true);
 }
 
 /**
- * @brief Remove up to a given "count" of nodes with the given data starting from the head of the list. If count = 0, all nodes with the given data will be removed.
+ * @brief Remove from tail
+ *
+ * @param list The list to remove from
+ *
+ * @return ListNode* The removed element, NULL if the list is empty
+ */
+ListNode *list_rremove(List *list)
+{
+    return list_pop(list, false);
+}
+
+/**
+ * @brief Remove up to a given "count" of elements with the given data starting from the head of the list. If count = 0, all elements with the given data will be removed.
 
 * @param list The list to remove from
 * @param data The data to remove
 * @param listType The type of the data
-* @param count The number of nodes to remove
+* @param count The number of elements to remove
 *
-* @return int The number of nodes removed
+* @return int The number of elements removed
 */
 int list_removeFromHead(List *list, void *data, ListType listType, int count)
 {
@@ -345,56 +842,58 @@ int list_removeFromHead(List *list, void *data, ListType listType, int count)
         exit(EXIT_FAILURE);
     }
 
-    ListNode input_node = {data, listType, NULL, NULL};
-    ListNode *traverse = list->head;
+    ListEncoded encoded;
+    if (!list_encode(&encoded, data, listType))
+    {
+        return 0;
+    }
 
-    while (traverse && removed_count < amountToRemove)
+    ListBlock *block = list->head;
+    while (block && removed_count < amountToRemove)
     {
-        ListNode *temp = traverse->next;
+        ListBlock *next = block->next;
 
-        if (compare_list_node(traverse, &input_node))
+        // the entries after a removed one move back to its offset
+        int block_count = block->lp->count;
+        int offset = list_find(block, 0, &encoded);
+        while (offset >= 0 && removed_count < amountToRemove)
         {
-            // update the links
-            if (traverse->prev)
-            {
-                traverse->prev->next = traverse->next;
-            }
-            else
-            {
-                list->head = traverse->next;
-            }
-
-            if (traverse->next)
-            {
-                traverse->next->prev = traverse->prev;
-            }
-            else
-            {
-                list->tail = traverse->prev;
-            }
-
-            // free the node
-            list_free_node(traverse);
+            block->lp = lp_delete(block->lp, offset, 1);
             removed_count++;
             list->size--;
+
+            offset = list_find(block, offset, &encoded);
         }
+        list_block_resized(list, block, block->lp->count - block_count);
 
-        // move to the next node
-        traverse = temp;
+        // the blocks before this one are already searched, so it can be merged into the previous one
+        if (block->lp->count == 0)
+        {
+            list_block_free(list, block);
+        }
+        else if (block->prev)
+        {
+            list_block_merge(list, block->prev);
+        }
+
+        // move to the next block
+        block = next;
     }
 
+    list_encoded_free(&encoded);
+
     return removed_count;
 }
 
 /**
- * @brief Remove up to a given "count" of nodes with the given data starting from the tail of the list. If count = 0, all nodes with the given data will be removed.
+ * @brief Remove up to a given "count" of elements with the given data starting from the tail of the list. If count = 0, all elements with the given data will be removed.
  *
  * @param list The list to remove from
  * @param data The data to remove
  * @param listType The type of the data
- * @param count The number of nodes to remove
+ * @param count The number of elements to remove
  *
- * @return int The number of nodes removed
+ * @return int The number of elements removed
  */
 int list_removeFromTail(List *list, void *data, ListType listType, int count)
 {
@@ -407,54 +906,69 @@ int list_removeFromTail(List *list, void *data, ListType listType, int count)
         exit(EXIT_FAILURE);
     }
 
-    ListNode input_node = {data, listType, NULL, NULL};
-    ListNode *traverse = list->tail;
+    ListEncoded encoded;
+    if (!list_encode(&encoded, data, listType))
+    {
+        return 0;
+    }
 
-    while (traverse && removed_count < amountToRemove)
+    ListBlock *block = list->tail;
+    while (block && removed_count < amountToRemove)
     {
-        ListNode *temp = traverse->prev;
+        ListBlock *prev = block->prev;
 
-        if (compare_list_node(traverse, &input_node))
+        // count the equal entries of the block with the forward search, which rejects a block without any in one pass
+        int block_count = block->lp->count;
+        int matches = 0;
+        for (int offset = list_find(block, 0, &encoded); offset >= 0; offset = list_find(block, lp_next(block->lp, offset), &encoded))
         {
-            // update the links
-            if (traverse->prev)
-            {
-                traverse->prev->next = traverse->next;
-            }
-            else
-            {
-                list->head = traverse->next;
-            }
+            matches++;
+        }
 
-            if (traverse->next)
-            {
-                traverse->next->prev = traverse->prev;
-            }
-            else
-            {
-                list->tail = traverse->prev;
-            }
+        // the last ones are removed, skip the ones before them
+        int offset = list_find(block, 0, &encoded);
+        for (int i = matches - (amountToRemove - removed_count); i > 0; i--)
+        {
+            offset = list_find(block, lp_next(block->lp, offset), &encoded);
+        }
 
-            // free the node
-            list_free_node(traverse);
+        // the entries after a removed one move back to its offset
+        while (offset >= 0)
+        {
+            block->lp = lp_delete(block->lp, offset, 1);
             removed_count++;
             list->size--;
+
+            offset = list_find(block, offset, &encoded);
         }
+        list_block_resized(list, block, block->lp->count - block_count);
 
-        // move to the next node
-        traverse = temp;
+        // the blocks after this one are already searched, so the next one can be merged into it
+        if (block->lp->count == 0)
+        {
+            list_block_free(list, block);
+        }
+        else
+        {
+            list_block_merge(list, block);
+        }
+
+        // move to the previous block
+        block = prev;
     }
 
+    list_encoded_free(&encoded);
+
     return removed_count;
 }
 
 /**
- * @brief Modify the data of a node at a given index
+ * @brief Modify the data of the element at a given index
  *
  * @param list The list to modify
- * @param index The index of the node to modify
+ * @param index The index of the element to modify
+ * @param data The new data
  * @param listType The type of the data
- * @param type The type of the data
  *
  * @return int 0 if successful, -1 if failed
  */
@@ -466,61 +980,89 @@ int list_imodify(List *list, int index, void *data, ListType listType)
         return -1;
     }
 
-    ListNode *traverse = list->head;
-    for (int i = 0; i < index; i++)
+    ListEncoded encoded;
+    if (!list_encode(&encoded, data, listType))
     {
-        traverse = traverse->next;
+        return -1;
     }
 
-    if (listType == LIST_TYPE_STRING)
-    {
-        free(traverse->data);
-        traverse->data = strdup((char *)data);
-    }
-    else if (listType == LIST_TYPE_STRING)
-    {
-        free(traverse->data);
-        traverse->data = calloc(1, sizeof(float));
-        if (traverse->data == NULL)
-        {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
-        }
+    ListBlock *block;
+    int offset = list_seek(list, index, &block);
+    block->lp = lp_replace(block->lp, offset, encoded.bytes, encoded.len);
 
-        *(float *)traverse->data = *(float *)data;
-    }
-    else
-    {
-        fprintf(stderr, "Invalid type\n");
-        return -1;
-    }
+    list_encoded_free(&encoded);
 
     return 0;
 }
 
 /**
- * @brief Retrieve the node at a given index
+ * @brief Retrieve the element at a given index
  *
  * @param list The list to retrieve from
- * @param index The index of the node to retrieve
+ * @param index The index of the element to retrieve
+ * @param node Set to the element, its data points into the list and is valid until the list is changed
  *
- * @return ListNode* The node at the given index
+ * @return int 0 if successful, -1 if the index is out of bounds
  */
-ListNode *list_iget(List *list, int index)
+int list_iget(List *list, int index, ListNode *node)
 {
     if (index < 0 || index >= list->size)
     {
         fprintf(stderr, "Index out of bounds\n");
-        return NULL;
+        return -1;
     }
 
-    ListNode *traverse = list->head;
-    for (int i = 0; i < index; i++)
+    ListBlock *block;
+    int offset = list_seek(list, index, &block);
+    list_decode(block, offset, node);
+
+    return 0;
+}
+
+/**
+ * @brief Initializes an iterator at the element at a given index
+ *
+ * @param list The list to iterate
+ * @param iter The iterator, it is done right away if the index is out of bounds
+ * @param index The index of the first element returned
+ */
+void list_iter_init(List *list, ListIter *iter, int index)
+{
+    iter->block = NULL;
+    iter->offset = -1;
+
+    if (index >= 0 && index < list->size)
     {
-        traverse = traverse->next;
+        iter->offset = list_seek(list, index, &iter->block);
     }
+}
 
-    return traverse;
+/**
+ * @brief Reads the element of an iterator and moves it to the next element, the entries of a block are read one after the other
+ *
+ * @param iter The iterator
+ * @param node Set to the element, its data points into the list and is valid until the list is changed
+ *
+ * @return bool true if an element was read, false if the iterator is past the last element
+ */
+bool list_iter_next(ListIter *iter, ListNode *node)
+{
+    if (!iter->block)
+    {
+        return false;
+    }
+
+    list_decode(iter->block, iter->offset, node);
+
+    // blocks are never empty, so the next block starts with an entry
+    iter->offset = lp_next(iter->block->lp, iter->offset);
+    if (iter->offset < 0)
+    {
+        iter->block = iter->block->next;
+        iter->offset = 0;
+    }
+
+    return true;
 }
 
 /**
@@ -540,33 +1082,9 @@ int list_trim(List *list, int start, int end)
         return -1;
     }
 
-    int initial_size = list->size;
-
-    // free the nodes that are trimmed from the start
-    for (int i = 0; i < start; i++)
-    {
-        ListNode *removedNode = list_lremove(list);
-        if (!removedNode)
-        {
-            fprintf(stderr, "Failed to remove some node from trim\n");
-            return -1;
-        }
-
-        list_free_node(removedNode);
-    }
-
-    // free the nodes that are trimmed from the end
-    for (int i = initial_size - 1; i > end; i--)
-    {
-        ListNode *removedNode = list_rremove(list);
-        if (!removedNode)
-        {
-            fprintf(stderr, "Failed to remove some node from trim\n");
-            return -1;
-        }
-
-        list_free_node(removedNode);
-    }
+    // free the elements that are trimmed from the end, then from the start
+    list_delete_end(list, list->size - 1 - end, false);
+    list_delete_end(list, start, true);
 
     return 0;
 }
@@ -578,30 +1096,43 @@ int list_trim(List *list, int start, int end)
  */
 void list_free_contents(List *list)
 {
-    ListNode *traverse = list->head;
+    ListBlock *traverse = list->head;
     while (traverse)
     {
-        ListNode *temp = traverse->next;
-        free(traverse->data);
+        ListBlock *temp = traverse->next;
+        lp_free(traverse->lp);
         free(traverse);
         traverse = temp;
     }
+
+    free(list->index.slots);
+    free(list->index.tree);
 }
 
 // print the list
 void list_print(List *list)
 {
-    ListNode *traverse = list->head;
-    while (traverse)
+    ListIter iter;
+    ListNode node;
+
+    list_iter_init(list, &iter, 0);
+    while (list_iter_next(&iter, &node))
     {
-        if (traverse->listType == LIST_TYPE_STRING)
+        if (node.listType == LIST_TYPE_STRING)
+        {
+            printf("%.*s\n", node.len, (char *)node.data);
+        }
+        else if (node.listType == LIST_TYPE_FLOAT)
         {
-            printf("%s\n", (char *)traverse->data);
+            float value;
+            memcpy(&value, node.data, sizeof(float));
+            printf("%f\n", value);
         }
-        else if (traverse->listType == LIST_TYPE_FLOAT)
+        else if (node.listType == LIST_TYPE_INT)
         {
-            printf("%f\n", *(float *)traverse->data);
+            int value;
+            memcpy(&value, node.data, sizeof(int));
+            printf("%d\n", value);
         }
-        traverse = traverse->next;
     }
 }
@@ -3,6 +3,10 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include "../listpack/listpack.h"
+
+// a push starts a new block rather than grow the block at that end past this many bytes, so inserting or removing at the start of a block moves about this many bytes at most
+#define LIST_BLOCK_BYTES 4096
 
 typedef enum ListType
 {
@@ -11,36 +15,75 @@ typedef enum ListType
     LIST_TYPE_STRING
 } ListType;
 
+// an element of the list. The nodes filled by list_iget() and list_iter_next() point into the list and are valid until it is changed, their strings are not null terminated. The nodes returned by list_lremove() and list_rremove() own a null terminated copy and are freed with list_free_node().
 typedef struct ListNode
 {
     void *data;
+    // number of bytes of data, without the null terminator
+    int len;
     ListType listType;
-
-    struct ListNode *prev;
-    struct ListNode *next;
 } ListNode;
 
+// the elements are packed into listpacks, each element is an entry holding its type in the first byte followed by its bytes, and the listpacks are the blocks of a doubly linked list
+typedef struct ListBlock
+{
+    Listpack *lp;
+
+    struct ListBlock *prev;
+    struct ListBlock *next;
+
+    // the slot of the block in the position index of the list
+    int slot;
+} ListBlock;
+
+// a position index over the blocks of a list. The blocks are kept in order in an array of slots with free slots at both ends, and a Fenwick tree over the slots sums the number of elements of the blocks before a slot, so the block of an index is found in O(log n). The head and the tail are counted by the list and not by the tree, so pushes and pops only change the index when they add or free a block. A freed block leaves an empty slot behind, a block added in the middle makes the index stale, and a stale index is rebuilt from the blocks the next time it is used.
+typedef struct ListIndex
+{
+    ListBlock **slots;
+    int *tree;
+    int capacity;
+
+    // the slots from first up to last, excluded, are in use
+    int first;
+    int last;
+    bool stale;
+} ListIndex;
+
 typedef struct List
 {
-    ListNode *head;
-    ListNode *tail;
+    ListBlock *head;
+    ListBlock *tail;
     int size;
+
+    ListIndex index;
 } List;
 
+// a position in a list, read forward with list_iter_next()
+typedef struct ListIter
+{
+    ListBlock *block;
+    int offset;
+} ListIter;
+
 List *list_init();
 
 bool list_contains(List *list, void *data, ListType listType);
 int list_linsert(List *list, void *data, ListType listType);
 int list_rinsert(List *list, void *data, ListType listType);
+int list_pinsert(List *list, void *pivot, void *data, ListType listType, bool after);
 
 ListNode *list_lremove(List *list);
 ListNode *list_rremove(List *list);
 int list_removeFromHead(List *list, void *data, ListType listType, int count);
 int list_removeFromTail(List *list, void *data, ListType listType, int count);
+int list_move(List *source, List *destination, bool from_head, bool to_head);
 
 int list_imodify(List *list, int index, void *data, ListType listType);
 int list_trim(List *list, int start, int end);
-ListNode *list_iget(List *list, int index);
+int list_iget(List *list, int index, ListNode *node);
+
+void list_iter_init(List *list, ListIter *iter, int index);
+bool list_iter_next(ListIter *iter, ListNode *node);
 
 void list_free_node(ListNode *node);
 void list_free_contents(List *list);
@@ -1,5 +1,17 @@
 #include "list.h"
 
+// checks that the element at an index is a string, the strings of the list are not null terminated
+bool check_string(List *list, int index, char *expected)
+{
+    ListNode node;
+    if (list_iget(list, index, &node) != 0)
+    {
+        return false;
+    }
+
+    return node.listType == LIST_TYPE_STRING && node.len == (int)strlen(expected) && memcmp(node.data, expected, node.len) == 0;
+}
+
 int main()
 {
     List *list = list_init();
@@ -10,10 +22,7 @@ int main()
     list_linsert(list, test_strings[1], LIST_TYPE_STRING);
     list_linsert(list, test_strings[0], LIST_TYPE_STRING);
 
-    ListNode *test1 = list_iget(list, 0);
-    ListNode *test2 = list_iget(list, 1);
-
-    if ((strcmp((char *)test1->data, test_strings[0]) != 0) || (strcmp((char *)test2->data, test_strings[1]) != 0))
+    if (!check_string(list, 0, test_strings[0]) || !check_string(list, 1, test_strings[1]))
     {
         printf("Test 1 failed\n");
     }
@@ -22,10 +31,7 @@ int main()
     list_rinsert(list, test_strings[2], LIST_TYPE_STRING);
     list_rinsert(list, test_strings[3], LIST_TYPE_STRING);
 
-    ListNode *test3 = list_iget(list, 2);
-    ListNode *test4 = list_iget(list, 3);
-
-    if ((strcmp((char *)test3->data, test_strings[2]) != 0) || (strcmp((char *)test4->data, test_strings[3]) != 0))
+    if (!check_string(list, 2, test_strings[2]) || !check_string(list, 3, test_strings[3]))
     {
         printf("Test 2 failed\n");
     }
@@ -42,8 +48,7 @@ int main()
         list_free_node(removedNode1);
     }
 
-    ListNode *test5 = list_iget(list, 0);
-    if (strcmp((char *)test5->data, test_strings[1]) != 0)
+    if (!check_string(list, 0, test_strings[1]))
     {
         printf("Test 3 failed\n");
     }
@@ -59,16 +64,14 @@ int main()
         list_free_node(removedNode2);
     }
 
-    ListNode *test6 = list_iget(list, list->size - 1);
-    if (strcmp((char *)test6->data, test_strings[2]) != 0)
+    if (!check_string(list, list->size - 1, test_strings[2]))
     {
         printf("Test 4 failed\n");
     }
 
     // test list_imodify
     list_imodify(list, 0, test_strings[3], LIST_TYPE_STRING);
-    ListNode *test7 = list_iget(list, 0);
-    if (strcmp((char *)test7->data, test_strings[3]) != 0)
+    if (!check_string(list, 0, test_strings[3]))
     {
         printf("Test 5 failed\n");
     }
@@ -82,10 +85,7 @@ int main()
     // trim from 1 to 2
     list_trim(list, 1, 2);
 
-    ListNode *test8 = list_iget(list, 0);
-    ListNode *test9 = list_iget(list, 1);
-
-    if ((strcmp((char *)test8->data, test_strings[1]) != 0) || (strcmp((char *)test9->data, test_strings[2]) != 0) || list->size != 2)
+    if (!check_string(list, 0, test_strings[1]) || !check_string(list, 1, test_strings[2]) || list->size != 2)
     {
         printf("Test 6 failed\n");
     }
@@ -141,15 +141,304 @@ int main()
         exit(EXIT_FAILURE);
     }
 
+    // create a list of many blocks, pushed at both ends
+    List *list4 = list_init();
+    int num_elements = 10000;
+    for (int i = 0; i < num_elements; i++)
+    {
+        char element[32];
+        sprintf(element, "element:%d", i);
+        if (i % 2 == 0)
+        {
+            list_rinsert(list4, element, LIST_TYPE_STRING);
+        }
+        else
+        {
+            list_linsert(list4, element, LIST_TYPE_STRING);
+        }
+    }
+
+    // the odd elements are at the head in reverse order, followed by the even ones in order
+    ListIter iter;
+    ListNode node;
+    int num_read = 0;
+    list_iter_init(list4, &iter, 0);
+    while (list_iter_next(&iter, &node))
+    {
+        int i = num_read < num_elements / 2 ? num_elements - 1 - 2 * num_read : 2 * (num_read - num_elements / 2);
+        char element[32];
+        sprintf(element, "element:%d", i);
+        if (node.len != (int)strlen(element) || memcmp(node.data, element, node.len) != 0)
+        {
+            printf("Test 11 failed\n");
+            exit(EXIT_FAILURE);
+        }
+        num_read++;
+    }
+
+    if (num_read != num_elements || list4->head == list4->tail || !check_string(list4, 5001, "element:2"))
+    {
+        printf("Test 11 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // an iterator past the end is done right away
+    list_iter_init(list4, &iter, num_elements);
+    if (list_iter_next(&iter, &node))
+    {
+        printf("Test 12 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // pop from both ends across blocks
+    for (int i = 0; i < 3000; i++)
+    {
+        list_free_node(list_lremove(list4));
+        list_free_node(list_rremove(list4));
+    }
+
+    ListNode *popped = list_lremove(list4);
+    if (list4->size != num_elements - 6001 || strcmp(popped->data, "element:3999") != 0 || popped->len != 12 || !check_string(list4, list4->size - 1, "element:3998"))
+    {
+        printf("Test 13 failed\n");
+        exit(EXIT_FAILURE);
+    }
+    list_free_node(popped);
+
+    // trim across blocks
+    list_trim(list4, 1000, 2998);
+    if (list4->size != 1999 || !check_string(list4, 0, "element:1997") || !check_string(list4, 998, "element:1") || !check_string(list4, 1998, "element:1998"))
+    {
+        printf("Test 14 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // remove every element of the middle blocks, the blocks left empty are freed and the others merged
+    list_rinsert(list4, test_strings[0], LIST_TYPE_STRING);
+    for (int i = 0; i < 999; i++)
+    {
+        list_imodify(list4, 500 + i, test_strings[0], LIST_TYPE_STRING);
+    }
+
+    if (list_removeFromHead(list4, test_strings[0], LIST_TYPE_STRING, 999) != 999 || list4->size != 1001 || !check_string(list4, 499, "element:999") ||
+        !check_string(list4, 500, "element:1000") || !check_string(list4, 1000, test_strings[0]))
+    {
+        printf("Test 15 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (list_removeFromTail(list4, test_strings[0], LIST_TYPE_STRING, 0) != 1 || list4->size != 1000 || !check_string(list4, 999, "element:1998"))
+    {
+        printf("Test 16 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // an element larger than a block gets a block of its own
+    char *large = malloc(LIST_BLOCK_BYTES * 2);
+    memset(large, 'x', LIST_BLOCK_BYTES * 2 - 1);
+    large[LIST_BLOCK_BYTES * 2 - 1] = '\0';
+    list_linsert(list4, large, LIST_TYPE_STRING);
+    list_rinsert(list4, large, LIST_TYPE_STRING);
+    if (!check_string(list4, 0, large) || !check_string(list4, 1001, large) || !check_string(list4, 1, "element:1997") || list_removeFromHead(list4, large, LIST_TYPE_STRING, 0) != 2)
+    {
+        printf("Test 17 failed\n");
+        exit(EXIT_FAILURE);
+    }
+    free(large);
+
+    // floats are compared using epsilon method
+    float nearFloat = floatData + 1e-10f;
+    if (!list_contains(list2, &nearFloat, LIST_TYPE_FLOAT) || list_removeFromHead(list2, &intData, LIST_TYPE_INT, 0) != 1 || list_contains(list2, &intData, LIST_TYPE_INT))
+    {
+        printf("Test 18 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // test positional access against an array of the same elements, the list is changed at both ends and in the middle
+    List *list5 = list_init();
+    int *model = malloc(sizeof(int) * 100000);
+    int model_size = 0;
+    srand(5);
+    for (int op = 0; op < 50000; op++)
+    {
+        char element[32];
+        int value = rand() % 5000;
+        sprintf(element, "%d", value);
+
+        int kind = rand() % 100;
+        if (kind < 30)
+        {
+            list_rinsert(list5, element, LIST_TYPE_STRING);
+            model[model_size++] = value;
+        }
+        else if (kind < 50)
+        {
+            list_linsert(list5, element, LIST_TYPE_STRING);
+            memmove(model + 1, model, sizeof(int) * model_size++);
+            model[0] = value;
+        }
+        else if (kind < 60 && model_size > 0)
+        {
+            // insert before or after the first element equal to another one of the list
+            int pivot_value = model[rand() % model_size];
+            char pivot[32];
+            sprintf(pivot, "%d", pivot_value);
+
+            int index = 0;
+            while (model[index] != pivot_value)
+            {
+                index++;
+            }
+
+            bool after = rand() % 2;
+            index += after;
+            memmove(model + index + 1, model + index, sizeof(int) * (model_size++ - index));
+            model[index] = value;
+
+            if (list_pinsert(list5, pivot, element, LIST_TYPE_STRING, after) != 0)
+            {
+                printf("Test 19 failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (kind < 75 && model_size > 0)
+        {
+            int index = rand() % model_size;
+            list_imodify(list5, index, element, LIST_TYPE_STRING);
+            model[index] = value;
+        }
+        else if (kind < 80 && model_size > 0)
+        {
+            // remove the first or the last few elements equal to one of the list
+            int removed_value = model[rand() % model_size];
+            sprintf(element, "%d", removed_value);
+            int count = 1 + rand() % 3;
+            bool head = rand() % 2;
+
+            int removed = 0;
+            for (int i = 0; i < model_size && removed < count; i++)
+            {
+                int index = head ? i : model_size - 1 - i;
+                if (model[index] == removed_value)
+                {
+                    memmove(model + index, model + index + 1, sizeof(int) * (model_size - index - 1));
+                    model_size--;
+                    removed++;
+                    i--;
+                }
+            }
+
+            if ((head ? list_removeFromHead(list5, element, LIST_TYPE_STRING, count) : list_removeFromTail(list5, element, LIST_TYPE_STRING, count)) != removed)
+            {
+                printf("Test 20 failed at %d\n", op);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (kind < 90 && model_size > 0)
+        {
+            list_free_node(list_lremove(list5));
+            memmove(model, model + 1, sizeof(int) * --model_size);
+        }
+        else if (model_size > 0)
+        {
+            list_free_node(list_rremove(list5));
+            model_size--;
+        }
+
+        // the pivot of the next insert and the element read are anywhere in the list
+        if (model_size > 0)
+        {
+            int index = rand() % model_size;
+            sprintf(element, "%d", model[index]);
+            if (list5->size != model_size || !check_string(list5, index, element))
+            {
+                printf("Test 20 failed at %d\n", op);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    num_read = 0;
+    list_iter_init(list5, &iter, 0);
+    while (list_iter_next(&iter, &node))
+    {
+        char element[32];
+        sprintf(element, "%d", model[num_read++]);
+        if (node.len != (int)strlen(element) || memcmp(node.data, element, node.len) != 0)
+        {
+            printf("Test 21 failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    char *missing = "missing";
+    if (num_read != model_size || list_pinsert(list5, missing, missing, LIST_TYPE_STRING, false) != -1 || list5->size != model_size)
+    {
+        printf("Test 21 failed\n");
+        exit(EXIT_FAILURE);
+    }
+    free(model);
+
+    // test list_move between two lists and within a list, the type of the element moves with it
+    List *list6 = list_init();
+    List *list7 = list_init();
+    for (int i = 0; i < 1000; i++)
+    {
+        char element[32];
+        sprintf(element, "move:%d", i);
+        list_rinsert(list6, element, LIST_TYPE_STRING);
+    }
+    list_rinsert(list6, &intData, LIST_TYPE_INT);
+
+    if (list_move(list6, list7, false, true) != 0 || list6->size != 1000 || list7->size != 1 || list_iget(list7, 0, &node) != 0 || node.listType != LIST_TYPE_INT ||
+        memcmp(node.data, &intData, sizeof(int)) != 0)
+    {
+        printf("Test 22 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // rotate the list forward 10 times and back once
+    for (int i = 0; i < 10; i++)
+    {
+        list_move(list6, list6, true, false);
+    }
+    list_move(list6, list6, false, true);
+    list_move(list6, list6, true, true);
+
+    if (list6->size != 1000 || !check_string(list6, 0, "move:9") || !check_string(list6, 1, "move:10") || !check_string(list6, 999, "move:8"))
+    {
+        printf("Test 23 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // move every element to the head of the other list, which reverses them
+    while (list_move(list6, list7, true, true) == 0)
+    {
+    }
+
+    if (list6->size != 0 || list6->head || list7->size != 1001 || !check_string(list7, 0, "move:8") || !check_string(list7, 999, "move:9") || list_move(list6, list7, true, true) != -1)
+    {
+        printf("Test 24 failed\n");
+        exit(EXIT_FAILURE);
+    }
+
     // free the list contents
     list_free_contents(list);
     list_free_contents(list2);
     list_free_contents(list3);
+    list_free_contents(list4);
+    list_free_contents(list5);
+    list_free_contents(list6);
+    list_free_contents(list7);
 
     // free the list
     free(list);
     free(list2);
     free(list3);
+    free(list4);
+    free(list5);
+    free(list6);
+    free(list7);
 
     printf("All tests passed\n");
 }
\ No newline at end of file
@@ -0,0 +1,575 @@
+// * This file contains the implementation of the listpack, a compact encoding for small collections of strings. Instead of a node and a string allocated per element, the strings are packed one after the other in a single buffer, each one prefixed by its length, so a small collection costs one allocation and a couple of bytes per element, and is scanned with sequential reads. Changing the listpack moves the bytes after the change, so it is meant for collections of up to a few hundred elements.
+
+//! The functions that change a listpack may realloc it, always use the returned listpack instead of the old one.
+
+#include "listpack.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Returns the number of bytes of the varint encoding of a value
+ *
+ * @param value The value
+ *
+ * @return int The number of bytes, from 1 to 5
+ */
+static int varint_size(uint32_t value)
+{
+    int size = 1;
+    while (value >= 128)
+    {
+        value >>= 7;
+        size++;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Writes a value as a varint, 7 bits per byte starting with the lowest, the high bit of a byte is set when more bytes follow
+ *
+ * @param buf The buffer to write to
+ * @param value The value
+ */
+static void varint_write(unsigned char *buf, uint32_t value)
+{
+    while (value >= 128)
+    {
+        *buf++ = (value & 127) | 128;
+        value >>= 7;
+    }
+
+    *buf = value;
+}
+
+/**
+ * @brief Reads a varint written by varint_write()
+ *
+ * @param buf The buffer to read from
+ * @param size Set to the number of bytes read
+ *
+ * @return uint32_t The value
+ */
+static uint32_t varint_read(const unsigned char *buf, int *size)
+{
+    uint32_t value = 0;
+    int i = 0;
+    do
+    {
+        value |= (uint32_t)(buf[i] & 127) << (7 * i);
+    } while (buf[i++] & 128);
+
+    *size = i;
+    return value;
+}
+
+/**
+ * @brief Writes the back length of an entry, the varint bytes in reverse order so that it is read from its last byte
+ *
+ * @param buf The buffer to write to, the back length takes varint_size(value) bytes
+ * @param value The size of the length and string of the entry
+ */
+static void backlen_write(unsigned char *buf, uint32_t value)
+{
+    int size = varint_size(value);
+    for (int i = size - 1; i >= 0; i--)
+    {
+        buf[i] = (value & 127) | (i > 0 ? 128 : 0);
+        value >>= 7;
+    }
+}
+
+/**
+ * @brief Reads a back length written by backlen_write()
+ *
+ * @param last The last byte of the back length
+ * @param size Set to the number of bytes read
+ *
+ * @return uint32_t The value
+ */
+static uint32_t backlen_read(const unsigned char *last, int *size)
+{
+    uint32_t value = 0;
+    int i = 0;
+    do
+    {
+        value |= (uint32_t)(last[-i] & 127) << (7 * i);
+    } while (last[-i++] & 128);
+
+    *size = i;
+    return value;
+}
+
+/**
+ * @brief Returns the number of bytes an entry for a string of len bytes takes
+ *
+ * @param len The length of the string
+ *
+ * @return int The size of the entry
+ */
+static int entry_size(int len)
+{
+    int body = varint_size(len) + len;
+    return body + varint_size(body);
+}
+
+/**
+ * @brief Writes an entry
+ *
+ * @param buf The buffer to write to, must have entry_size(len) bytes
+ * @param value The string
+ * @param len The length of the string
+ */
+static void entry_write(unsigned char *buf, const char *value, int len)
+{
+    int header = varint_size(len);
+    varint_write(buf, len);
+    memcpy(buf + header, value, len);
+    backlen_write(buf + header + len, header + len);
+}
+
+/**
+ * @brief Returns the size of the entry at an offset
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry
+ *
+ * @return int The size of the entry
+ */
+static int entry_size_at(Listpack *lp, int offset)
+{
+    int header;
+    uint32_t len = varint_read(lp->data + offset, &header);
+    return entry_size(len);
+}
+
+/**
+ * @brief Resizes the allocation of a listpack
+ *
+ * @param lp The listpack
+ * @param bytes The number of bytes of data it needs to hold
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+static Listpack *lp_resize(Listpack *lp, uint32_t bytes)
+{
+    Listpack *resized = realloc(lp, sizeof(Listpack) + bytes);
+    if (resized == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return resized;
+}
+
+/**
+ * @brief Creates an empty listpack
+ *
+ * @return Listpack* The listpack
+ */
+Listpack *lp_new()
+{
+    Listpack *lp = calloc(1, sizeof(Listpack));
+    if (lp == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return lp;
+}
+
+/**
+ * @brief Frees a listpack, it is a single allocation, so free() works as well
+ *
+ * @param lp The listpack
+ */
+void lp_free(Listpack *lp)
+{
+    free(lp);
+}
+
+/**
+ * @brief Returns the number of bytes allocated for a listpack
+ *
+ * @param lp The listpack
+ *
+ * @return size_t The number of bytes
+ */
+size_t lp_alloc_size(Listpack *lp)
+{
+    return sizeof(Listpack) + lp->bytes;
+}
+
+/**
+ * @brief Returns the offset of the first entry
+ *
+ * @param lp The listpack
+ *
+ * @return int The offset, -1 if the listpack is empty
+ */
+int lp_first(Listpack *lp)
+{
+    return lp->count > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Returns the offset of the last entry
+ *
+ * @param lp The listpack
+ *
+ * @return int The offset, -1 if the listpack is empty
+ */
+int lp_last(Listpack *lp)
+{
+    return lp->count > 0 ? lp_prev(lp, lp->bytes) : -1;
+}
+
+/**
+ * @brief Returns the offset of the entry after an entry
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry
+ *
+ * @return int The offset of the next entry, -1 if the entry is the last one
+ */
+int lp_next(Listpack *lp, int offset)
+{
+    offset += entry_size_at(lp, offset);
+    return offset < (int)lp->bytes ? offset : -1;
+}
+
+/**
+ * @brief Returns the offset of the entry before an entry
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry, or the number of bytes of the listpack for the last entry
+ *
+ * @return int The offset of the previous entry, -1 if the entry is the first one
+ */
+int lp_prev(Listpack *lp, int offset)
+{
+    if (offset <= 0)
+    {
+        return -1;
+    }
+
+    int size;
+    uint32_t body = backlen_read(lp->data + offset - 1, &size);
+    return offset - size - body;
+}
+
+/**
+ * @brief Returns the string of an entry, it is not null terminated
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry
+ * @param len Set to the length of the string
+ *
+ * @return char* The string, valid until the listpack is changed
+ */
+char *lp_get(Listpack *lp, int offset, int *len)
+{
+    int header;
+    *len = varint_read(lp->data + offset, &header);
+    return (char *)lp->data + offset + header;
+}
+
+/**
+ * @brief Returns the offset of the entry at an index, negative indexes count from the end, -1 being the last entry. The walk starts from the closer end.
+ *
+ * @param lp The listpack
+ * @param index The index
+ *
+ * @return int The offset, -1 if the index is out of range
+ */
+int lp_seek(Listpack *lp, int index)
+{
+    int count = lp->count;
+    if (index < 0)
+    {
+        index += count;
+    }
+
+    if (index < 0 || index >= count)
+    {
+        return -1;
+    }
+
+    if (index < count / 2)
+    {
+        int offset = 0;
+        for (int i = 0; i < index; i++)
+        {
+            offset = lp_next(lp, offset);
+        }
+
+        return offset;
+    }
+
+    int offset = lp_last(lp);
+    for (int i = count - 1; i > index; i--)
+    {
+        offset = lp_prev(lp, offset);
+    }
+
+    return offset;
+}
+
+/**
+ * @brief Finds the first occurrence of a string in the bytes of a listpack, wherever it starts. With SSE2, 16 positions are checked at once by comparing the first and the last byte of the string, and the whole string is only compared where both are equal
+ *
+ * @param data The bytes of the listpack
+ * @param start The position to search from
+ * @param end The number of bytes of the listpack
+ * @param value The string to find, at least one byte long
+ * @param len The length of the string
+ *
+ * @return int The position of the occurrence, -1 if there is none
+ */
+static int lp_search(const unsigned char *data, int start, int end, const char *value, int len)
+{
+    // the last position an occurrence can start at
+    int last = end - len;
+    int i = start;
+
+#ifdef __SSE2__
+    __m128i first_byte = _mm_set1_epi8(value[0]);
+    __m128i last_byte = _mm_set1_epi8(value[len - 1]);
+
+    // the second load ends at i + len + 14, which must be in the listpack
+    for (; i + 15 <= last; i += 16)
+    {
+        __m128i firsts = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i lasts = _mm_loadu_si128((const __m128i *)(data + i + len - 1));
+        unsigned int match = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firsts, first_byte), _mm_cmpeq_epi8(lasts, last_byte)));
+
+        while (match)
+        {
+            int position = i + __builtin_ctz(match);
+            if (memcmp(data + position, value, len) == 0)
+            {
+                return position;
+            }
+
+            match &= match - 1;
+        }
+    }
+#endif
+
+    for (; i <= last; i++)
+    {
+        if (data[i] == (unsigned char)value[0] && memcmp(data + i, value, len) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Finds an entry equal to a string
+ *
+ * The bytes of the listpack are searched for the string with lp_search(), and the entries are only walked up to each occurrence to check that it is the whole string of an entry. A listpack that does not hold the string anywhere is rejected by the search alone.
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry to start at
+ * @param value The string to find
+ * @param len The length of the string
+ * @param skip The number of entries skipped after each entry compared, 1 compares only the fields of a listpack of field and value pairs
+ *
+ * @return int The offset of the entry, -1 if there is none
+ */
+int lp_find(Listpack *lp, int offset, const char *value, int len, int skip)
+{
+    const unsigned char *data = lp->data;
+    int end = lp->bytes;
+
+    // the string is not anywhere before this position
+    int search = offset;
+
+    while (offset >= 0 && offset < end)
+    {
+        int header;
+        int entry_len = varint_read(data + offset, &header);
+        int string = offset + header;
+
+        // the entries whose string starts before the next occurrence are stepped over without being compared
+        if (string >= search)
+        {
+            // an empty string has no bytes to search for
+            int found = len > 0 ? lp_search(data, string, end, value, len) : string;
+            if (found < 0)
+            {
+                return -1;
+            }
+
+            if (found == string && entry_len == len)
+            {
+                return offset;
+            }
+
+            search = found;
+        }
+
+        offset += entry_size(entry_len);
+        for (int i = 0; i < skip && offset < end; i++)
+        {
+            offset += entry_size_at(lp, offset);
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Inserts a string before the entry at an offset
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry to insert before, the number of bytes of the listpack to append
+ * @param value The string
+ * @param len The length of the string
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+Listpack *lp_insert(Listpack *lp, int offset, const char *value, int len)
+{
+    int size = entry_size(len);
+    uint32_t old_bytes = lp->bytes;
+
+    // the string may point into the listpack itself, copy it out before the listpack moves
+    if ((const unsigned char *)value >= lp->data && (const unsigned char *)value < lp->data + old_bytes)
+    {
+        char *copy = malloc(len > 0 ? len : 1);
+        memcpy(copy, value, len);
+        lp = lp_insert(lp, offset, copy, len);
+        free(copy);
+        return lp;
+    }
+
+    lp = lp_resize(lp, old_bytes + size);
+    memmove(lp->data + offset + size, lp->data + offset, old_bytes - offset);
+    entry_write(lp->data + offset, value, len);
+    lp->bytes = old_bytes + size;
+    lp->count++;
+
+    return lp;
+}
+
+/**
+ * @brief Appends a string after the last entry
+ *
+ * @param lp The listpack
+ * @param value The string
+ * @param len The length of the string
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+Listpack *lp_append(Listpack *lp, const char *value, int len)
+{
+    return lp_insert(lp, lp->bytes, value, len);
+}
+
+/**
+ * @brief Replaces the string of an entry
+ *
+ * @param lp The listpack
+ * @param offset The offset of the entry
+ * @param value The new string
+ * @param len The length of the new string
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+Listpack *lp_replace(Listpack *lp, int offset, const char *value, int len)
+{
+    int old_size = entry_size_at(lp, offset);
+    int size = entry_size(len);
+
+    // a string of the same size is written in place
+    if (old_size == size)
+    {
+        memmove(lp->data + offset + varint_size(len), value, len);
+        return lp;
+    }
+
+    lp = lp_insert(lp, offset, value, len);
+    return lp_delete(lp, offset + size, 1);
+}
+
+/**
+ * @brief Deletes entries
+ *
+ * @param lp The listpack
+ * @param offset The offset of the first entry to delete
+ * @param count The number of entries to delete, the deletion stops at the end of the listpack
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+Listpack *lp_delete(Listpack *lp, int offset, int count)
+{
+    int end = offset;
+    int deleted = 0;
+    while (deleted < count && end < (int)lp->bytes)
+    {
+        end += entry_size_at(lp, end);
+        deleted++;
+    }
+
+    memmove(lp->data + offset, lp->data + end, lp->bytes - end);
+    lp->bytes -= end - offset;
+    lp->count -= deleted;
+
+    return lp_resize(lp, lp->bytes);
+}
+
+/**
+ * @brief Appends the entries of another listpack after the last entry, the entries do not depend on their offset so their bytes are copied as they are
+ *
+ * @param lp The listpack
+ * @param other The listpack whose entries are appended, it is not changed
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+Listpack *lp_merge(Listpack *lp, Listpack *other)
+{
+    uint32_t old_bytes = lp->bytes;
+    lp = lp_resize(lp, old_bytes + other->bytes);
+    memcpy(lp->data + old_bytes, other->data, other->bytes);
+    lp->bytes = old_bytes + other->bytes;
+    lp->count += other->count;
+
+    return lp;
+}
+
+/**
+ * @brief Splits a listpack in two, the entries from an offset on are moved to a new listpack
+ *
+ * @param lp The listpack, it keeps the entries before the offset
+ * @param offset The offset of the first entry moved
+ * @param rest Set to the new listpack holding the entries from the offset on
+ *
+ * @return Listpack* The listpack, possibly moved
+ */
+Listpack *lp_split(Listpack *lp, int offset, Listpack **rest)
+{
+    int moved = 0;
+    for (int current = offset; current < (int)lp->bytes; current += entry_size_at(lp, current))
+    {
+        moved++;
+    }
+
+    uint32_t bytes = lp->bytes - offset;
+    *rest = lp_resize(lp_new(), bytes);
+    memcpy((*rest)->data, lp->data + offset, bytes);
+    (*rest)->bytes = bytes;
+    (*rest)->count = moved;
+
+    lp->bytes = offset;
+    lp->count -= moved;
+
+    return lp_resize(lp, lp->bytes);
+}
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A listpack is a single allocation holding a sequence of strings. Every entry is the length of the string as a varint, the bytes of the string, and the size of the first two parts encoded backwards, so the entries can be walked in both directions. An entry is addressed by its offset from the start of data.
+typedef struct Listpack
+{
+    // number of bytes of data in use
+    uint32_t bytes;
+    // number of entries
+    uint32_t count;
+    unsigned char data[];
+} Listpack;
+
+// Function prototypes
+Listpack *lp_new();
+void lp_free(Listpack *lp);
+size_t lp_alloc_size(Listpack *lp);
+
+int lp_first(Listpack *lp);
+int lp_last(Listpack *lp);
+int lp_next(Listpack *lp, int offset);
+int lp_prev(Listpack *lp, int offset);
+char *lp_get(Listpack *lp, int offset, int *len);
+int lp_seek(Listpack *lp, int index);
+int lp_find(Listpack *lp, int offset, const char *value, int len, int skip);
+
+// the functions that change a listpack may move it, and return its new address
+Listpack *lp_insert(Listpack *lp, int offset, const char *value, int len);
+Listpack *lp_append(Listpack *lp, const char *value, int len);
+Listpack *lp_replace(Listpack *lp, int offset, const char *value, int len);
+Listpack *lp_delete(Listpack *lp, int offset, int count);
+Listpack *lp_merge(Listpack *lp, Listpack *other);
+Listpack *lp_split(Listpack *lp, int offset, Listpack **rest);
@@ -0,0 +1,197 @@
+#include "listpack.h"
+
+// finds an entry equal to a string by comparing every entry, like lp_find()
+int find_entry(Listpack *lp, int offset, const char *value, int len, int skip)
+{
+    while (offset >= 0)
+    {
+        int entry_len;
+        char *entry = lp_get(lp, offset, &entry_len);
+        if (entry_len == len && memcmp(entry, value, len) == 0)
+        {
+            return offset;
+        }
+
+        for (int i = 0; i <= skip && offset >= 0; i++)
+        {
+            offset = lp_next(lp, offset);
+        }
+    }
+
+    return -1;
+}
+
+// checks that the entries of a listpack are the strings expected, walking it forward and backward
+int check_entries(Listpack *lp, char **expected, int count)
+{
+    if ((int)lp->count != count)
+    {
+        return 1;
+    }
+
+    int offset = lp_first(lp);
+    for (int i = 0; i < count; i++, offset = lp_next(lp, offset))
+    {
+        int len;
+        char *value = lp_get(lp, offset, &len);
+        if (offset < 0 || len != (int)strlen(expected[i]) || memcmp(value, expected[i], len) != 0)
+        {
+            return 1;
+        }
+    }
+
+    if (offset != -1)
+    {
+        return 1;
+    }
+
+    offset = lp_last(lp);
+    for (int i = count - 1; i >= 0; i--, offset = lp_prev(lp, offset))
+    {
+        int len;
+        char *value = lp_get(lp, offset, &len);
+        if (offset < 0 || len != (int)strlen(expected[i]) || memcmp(value, expected[i], len) != 0)
+        {
+            return 1;
+        }
+    }
+
+    return offset != -1;
+}
+
+int main()
+{
+    Listpack *lp = lp_new();
+
+    // test lp_append and lp_insert
+    lp = lp_append(lp, "world", 5);
+    lp = lp_insert(lp, lp_first(lp), "hello", 5);
+    lp = lp_append(lp, "", 0);
+
+    char *test1[] = {"hello", "world", ""};
+    if (check_entries(lp, test1, 3))
+    {
+        printf("Test 1 (Insert) failed\n");
+        return 1;
+    }
+
+    // test lp_replace with a string of the same size, a shorter one and a longer one that needs a 2 byte length
+    char longValue[300];
+    memset(longValue, 'x', sizeof(longValue) - 1);
+    longValue[sizeof(longValue) - 1] = '\0';
+
+    lp = lp_replace(lp, lp_seek(lp, 1), "WORLD", 5);
+    lp = lp_replace(lp, lp_seek(lp, 0), "hi", 2);
+    lp = lp_replace(lp, lp_seek(lp, -1), longValue, strlen(longValue));
+
+    char *test2[] = {"hi", "WORLD", longValue};
+    if (check_entries(lp, test2, 3))
+    {
+        printf("Test 2 (Replace) failed\n");
+        return 1;
+    }
+
+    // test lp_find, skipping the values of field and value pairs
+    lp = lp_append(lp, "field", 5);
+    lp = lp_append(lp, "WORLD", 5);
+    if (lp_find(lp, lp_first(lp), "WORLD", 5, 0) != lp_seek(lp, 1) || lp_find(lp, lp_first(lp), "WORLD", 5, 1) != lp_seek(lp, 4) ||
+        lp_find(lp, lp_first(lp), "field", 5, 1) != -1 || lp_find(lp, lp_first(lp), "missing", 7, 0) != -1)
+    {
+        printf("Test 3 (Find) failed\n");
+        return 1;
+    }
+
+    // test lp_delete, in the middle and past the end
+    lp = lp_delete(lp, lp_seek(lp, 1), 2);
+    char *test4[] = {"hi", "field", "WORLD"};
+    if (check_entries(lp, test4, 3))
+    {
+        printf("Test 4 (Delete) failed\n");
+        return 1;
+    }
+
+    lp = lp_delete(lp, lp_seek(lp, 1), 10);
+    char *test5[] = {"hi"};
+    if (check_entries(lp, test5, 1) || lp_seek(lp, 1) != -1 || lp_seek(lp, -2) != -1)
+    {
+        printf("Test 5 (Delete) failed\n");
+        return 1;
+    }
+
+    // test inserting a string that is read from the listpack itself
+    int len;
+    char *value = lp_get(lp, lp_first(lp), &len);
+    lp = lp_insert(lp, lp_first(lp), value, len);
+    char *test6[] = {"hi", "hi"};
+    if (check_entries(lp, test6, 2))
+    {
+        printf("Test 6 (Insert from itself) failed\n");
+        return 1;
+    }
+
+    // test lp_merge, the entries of the second listpack are walked from both ends of the first
+    Listpack *other = lp_new();
+    other = lp_append(other, "there", 5);
+    other = lp_append(other, longValue, strlen(longValue));
+    lp = lp_merge(lp, other);
+    lp_free(other);
+    char *test7[] = {"hi", "hi", "there", longValue};
+    if (check_entries(lp, test7, 4))
+    {
+        printf("Test 7 (Merge) failed\n");
+        return 1;
+    }
+
+    // test lp_split, the entries from the third one on are moved
+    lp = lp_split(lp, lp_seek(lp, 2), &other);
+    char *test8[] = {"hi", "hi"};
+    if (check_entries(lp, test8, 2) || check_entries(other, test7 + 2, 2))
+    {
+        printf("Test 8 (Split) failed\n");
+        return 1;
+    }
+
+    lp = lp_merge(lp, other);
+    lp_free(other);
+    lp = lp_delete(lp, lp_first(lp), 4);
+    if (lp->count != 0 || lp->bytes != 0 || lp_first(lp) != -1 || lp_last(lp) != -1)
+    {
+        printf("Test 9 (Empty) failed\n");
+        return 1;
+    }
+
+    // test lp_find against comparing every entry, the strings of two letters are often found inside other entries or across them
+    srand(0);
+    for (int i = 0; i < 300; i++)
+    {
+        char value[24];
+        int len = rand() % 24;
+        for (int j = 0; j < len; j++)
+        {
+            value[j] = "ab"[rand() % 2];
+        }
+        lp = lp_append(lp, value, len);
+    }
+
+    for (int i = 0; i < 2000; i++)
+    {
+        char value[24];
+        int len = rand() % 24;
+        for (int j = 0; j < len; j++)
+        {
+            value[j] = "ab"[rand() % 2];
+        }
+
+        int offset = lp_seek(lp, rand() % lp->count);
+        int skip = rand() % 2;
+        if (lp_find(lp, offset, value, len, skip) != find_entry(lp, offset, value, len, skip))
+        {
+            printf("Test 10 (Find) failed\n");
+            return 1;
+        }
+    }
+
+    lp_free(lp);
+
+    return 0;
+}
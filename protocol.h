@@ -1,9 +1,12 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
-#define MAX_MESSAGE_SIZE 4096
-#define MAX_CLIENTS 2047
-#define MAX_ARGS 10
+// default upper bound for the size of a single request or response message, the server limit can be changed at startup
+#define MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+// connections are indexed by their fd, so this bounds the largest client fd the server accepts
+#define MAX_CLIENTS 65536
+// first byte of a request message with length-prefixed arguments, any other message is a space separated command string
+#define FRAME_MARKER '*'
 #define SERVERPORT 9255
 
 typedef enum
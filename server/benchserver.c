@@ -0,0 +1,92 @@
+// benchmark the cost of framing pipelined requests out of the read buffer, and of looking their keys up in a keyspace larger than the cache
+#include "server.h"
+#include <time.h>
+
+#define BENCH_REQUESTS (1 << 20)
+#define BENCH_KEYS (1 << 21)
+
+// nanoseconds since an arbitrary point
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// fill the read buffer of the connection with depth pipelined requests, as if they arrived in a single read. Without keyed the requests are PING, with it they are GET of random keys
+static void fill_pipeline(Conn *conn, int depth, bool keyed)
+{
+    char message[64];
+
+    conn->read_offset = 0;
+    conn->current_read_size = 0;
+    // the parser needs one writable byte after the last request
+    buffer_reserve(&conn->read_buffer, &conn->read_buffer_capacity, depth * (4 + sizeof(message)) + 1);
+
+    for (int i = 0; i < depth; i++)
+    {
+        int message_size = keyed ? sprintf(message, "GET key:%d", rand() % BENCH_KEYS) : sprintf(message, "PING");
+
+        memcpy(conn->read_buffer + conn->current_read_size, &message_size, 4);
+        memcpy(conn->read_buffer + conn->current_read_size + 4, message, message_size);
+        conn->current_read_size += 4 + message_size;
+    }
+}
+
+// process the same number of requests at a given pipeline depth, returns the average cost of a request in nanoseconds
+static double bench_depth(Conn *conn, int depth, bool keyed)
+{
+    double total = 0;
+    int processed = 0;
+
+    while (processed < BENCH_REQUESTS)
+    {
+        fill_pipeline(conn, depth, keyed);
+
+        double start = now_ns();
+        processed += process_buffered_requests(conn);
+        total += now_ns() - start;
+
+        // the replies are not the subject of the benchmark
+        reply_queue_free(conn);
+    }
+
+    return total / processed;
+}
+
+int main()
+{
+    global_table = hcreate(INIT_TABLE_SIZE);
+    shared_replies_init();
+    command_table_init();
+
+    Conn *conn = calloc(1, sizeof(Conn));
+    if (!conn)
+    {
+        fprintf(stderr, "Failed to allocate memory for connection\n");
+        exit(EXIT_FAILURE);
+    }
+    conn->fd = -1;
+    conn->state = STATE_REQ;
+
+    // GET requests look their keys up in a keyspace far larger than the cache
+    for (int i = 0; i < BENCH_KEYS; i++)
+    {
+        char key[32];
+        sprintf(key, "key:%d", i);
+        hinsert(global_table, hinit(strdup(key), STRING, strdup("value")));
+    }
+
+    printf("%10s %15s %15s\n", "depth", "PING ns/req", "GET ns/req");
+
+    for (int depth = 1; depth <= 16384; depth *= 4)
+    {
+        printf("%10d %15.1f %15.1f\n", depth, bench_depth(conn, depth, false), bench_depth(conn, depth, true));
+    }
+
+    free(conn->read_buffer);
+    free(conn);
+    hfree_table(global_table);
+
+    return 0;
+}
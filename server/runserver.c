@@ -3,23 +3,23 @@
 /**
  * @ Handles the clean up of the server when a SIGINT signal is received.
  *
- * The function handles the clean up of the server when a SIGINT signal is received. The function closes the server socket, all client connections, frees the global table, closes the AOF file, and exits the program.
+ * The function handles the clean up of the server when a SIGINT signal is received. The function closes the server socket, the epoll instance, all client connections, frees the global table, closes the AOF file, and exits the program.
  *
  * @param signum Signal number
  */
 
 void handle_sigint()
 {
-    // close the server socket
+    // close the server socket and the epoll instance
     close(server_socket);
+    close(epoll_fd);
 
     // close all client connections
     for (int i = 0; i < MAX_CLIENTS; i++)
     {
         if (fd2conn[i])
         {
-            close(fd2conn[i]->fd);
-            free(fd2conn[i]);
+            close_connection(fd2conn, fd2conn[i]);
         }
     }
 
@@ -39,15 +39,72 @@ void handle_sigint()
 int main(int argc, char *argv[])
 {
     signal(SIGINT, handle_sigint);
-    int debugMode = 0;
+    // a client that disconnects while its replies are being written must not kill the server
+    signal(SIGPIPE, SIG_IGN);
 
-    // Parse command line arguments for debug mode
+    // Parse command line arguments for debug mode, the maximum message size, the hash table engine and the hash and sorted set encoding thresholds
     for (int i = 1; i < argc; i++)
     {
         if (!strcmp(argv[i], "-d") || !strcmp(argv[i], "--debug"))
         {
-            debugMode = 1;
-            break;
+            debug_mode = true;
+        }
+        else if ((!strcmp(argv[i], "-m") || !strcmp(argv[i], "--max-message-size")) && i + 1 < argc)
+        {
+            max_message_size = atoi(argv[++i]);
+            if (max_message_size <= 0)
+            {
+                fprintf(stderr, "Invalid maximum message size\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if ((!strcmp(argv[i], "-e") || !strcmp(argv[i], "--hash-engine")) && i + 1 < argc)
+        {
+            // the engine of the global table and of every hash and sorted set created afterwards
+            i++;
+            if (!strcmp(argv[i], "chained"))
+            {
+                hset_engine(HASH_ENGINE_CHAINED);
+            }
+            else if (!strcmp(argv[i], "swiss"))
+            {
+                hset_engine(HASH_ENGINE_SWISS);
+            }
+            else
+            {
+                fprintf(stderr, "Unknown hash engine %s, expected chained or swiss\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(argv[i], "--hash-max-listpack-entries") && i + 1 < argc)
+        {
+            // hashes with more fields than this are kept in a hash table instead of a listpack
+            hash_max_listpack_entries = atoi(argv[++i]);
+            if (hash_max_listpack_entries < 0)
+            {
+                fprintf(stderr, "Invalid maximum number of listpack entries\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(argv[i], "--hash-max-listpack-value") && i + 1 < argc)
+        {
+            // hashes with a field or value longer than this are kept in a hash table instead of a listpack
+            hash_max_listpack_value = atoi(argv[++i]);
+            if (hash_max_listpack_value < 0)
+            {
+                fprintf(stderr, "Invalid maximum listpack value size\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (!strcmp(argv[i], "--zset-max-packed-entries") && i + 1 < argc)
+        {
+            // sorted sets with more members than this get a hash table and a skiplist instead of a sorted array
+            zset_max_packed_entries = atoi(argv[++i]);
+            if (zset_max_packed_entries < 0)
+            {
+                fprintf(stderr, "Invalid maximum number of packed sorted set entries\n");
+                exit(EXIT_FAILURE);
+            }
         }
     }
 
@@ -57,14 +114,23 @@ int main(int argc, char *argv[])
 
     // Initialize global structures
     global_table = hcreate(INIT_TABLE_SIZE);
+    shared_replies_init();
+    command_table_init();
     global_aof = aof_init(AOF_FILE, FLUSH_INTERVAL_SEC, "r");
 
     // restore state of database from AOF file
-    aof_restore_db();
+    bool aof_framed = aof_restore_db();
 
-    // change the aof back to append mode, so that new commands are appended to the file
+    // drop anything after the last complete record, then change the aof back to append mode, so that new commands are appended to the file
+    aof_truncate(global_aof, AOF_FILE);
     aof_change_mode(global_aof, AOF_FILE, "a");
 
+    // new commands are logged as framed records, mark where they start in a new or older file
+    if (!aof_framed)
+    {
+        aof_write(global_aof, AOF_HEADER "\n");
+    }
+
     // set up for starting the aof thread in a detached state (so that it cleans up after itself without needing to be joined) since it is in an infinite loop
     pthread_attr_t aof_thread_attr;
     pthread_attr_init(&aof_thread_attr);
@@ -87,7 +153,7 @@ int main(int argc, char *argv[])
     }
 
     // set the socket options to allow address reuse, only for debugging
-    if (debugMode)
+    if (debug_mode)
     {
         int optval = 1;
         if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0)
@@ -123,78 +189,105 @@ int main(int argc, char *argv[])
     // set the server socket to non-blocking
     set_fd_nonblocking(server_socket);
 
-    // set up the poll arguments
-    struct pollfd poll_args[MAX_CLIENTS + 1];
-    memset(poll_args, 0, sizeof(poll_args));
+    // create the epoll instance and register the server socket, edge triggered so pending connections are accepted until accept() would block
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0)
+    {
+        perror("epoll_create1 failed");
+        exit(EXIT_FAILURE);
+    }
 
-    printf("Server running in debug mode? : %s\n", debugMode ? "true" : "false");
-    printf("Server listening on port %d\n", SERVERPORT);
+    struct epoll_event server_event = {0};
+    server_event.events = EPOLLIN | EPOLLET;
+    server_event.data.fd = server_socket;
 
-    // the event loop, note: there is only on server socket responsible for interating with other client fd's
-    while (1)
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &server_event) < 0)
     {
-        // prepare the arguments of the poll(), the first argument is the server socket, the events specifies that we are interested in reading from the server socket,
-        poll_args[0].fd = server_socket;
-        poll_args[0].events = POLLIN;
-        poll_args[0].revents = 0;
+        perror("epoll_ctl failed");
+        exit(EXIT_FAILURE);
+    }
 
-        // handle the client connections
-        for (int i = 0; i < MAX_CLIENTS; i++)
-        {
-            if (!fd2conn[i])
-            {
-                continue;
-            }
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+
+    printf("Server running in debug mode? : %s\n", debug_mode ? "true" : "false");
+    printf("Maximum message size: %d bytes\n", max_message_size);
+    printf("Server listening on port %d\n", SERVERPORT);
 
-            // set the poll arguments for the client fd
-            poll_args[i + 1].fd = fd2conn[i]->fd;
+    // the event loop, each wakeup only visits the fds that are ready. Connections are registered when accepted and only change their registered events when switching between STATE_REQ, STATE_RESP and STATE_BLOCKED
+    while (1)
+    {
+        // free a batch of the nodes removed by range deletions, they are not freed while the deletion replies
+        bool lazy_freeing = lazy_free_step(LAZY_FREE_STEP);
 
-            // set the events to read from the client fd
-            poll_args[i + 1].events = fd2conn[i]->state == STATE_REQ ? POLLIN : POLLOUT;
+        // reply nil to the blocked connections that timed out, then resume the ones that were served or timed out since the last tick
+        expire_blocked_conns();
+        process_unblocked_conns();
 
-            poll_args[i + 1].revents = 0;
+        // while the global table is being resized or nodes are waiting to be freed, poll instead of blocking so idle ticks can do that work. Otherwise wake up in time for the first blocked connection to time out
+        bool rehashing = hrehashing(global_table);
+        int num_events = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, rehashing || lazy_freeing ? 0 : blocked_conns_timeout(1000));
 
-            // make sure thhe OS listens to errors on the client fd
-            poll_args[i].events |= POLLERR;
+        if (num_events == 0 && rehashing)
+        {
+            hrehash(global_table, IDLE_REHASH_BUCKETS);
+            continue;
         }
 
-        // call poll() to wait for events
-        int ret = poll(poll_args, MAX_CLIENTS + 1, 1000);
-
-        if (ret < 0)
+        if (num_events < 0)
         {
-            perror("poll failed");
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("epoll_wait failed");
             exit(1);
         }
 
-        // process ready client connections
-        for (int i = 1; i < MAX_CLIENTS + 1; i++)
+        for (int i = 0; i < num_events; i++)
         {
-            if (poll_args[i].revents == 0)
+            int fd = events[i].data.fd;
+
+            if (fd == server_socket)
+            {
+                // accept all pending connections
+                while (accept_new_connection(fd2conn, server_socket) == 0)
+                {
+                };
+                continue;
+            }
+
+            Conn *conn = fd2conn[fd];
+            if (!conn)
             {
-                // no events on this fd, not interested
                 continue;
             }
 
-            Conn *conn = fd2conn[i - 1];
+            if ((events[i].events & EPOLLERR) && !(events[i].events & (EPOLLIN | EPOLLOUT)))
+            {
+                // error on the client fd with nothing left to read or write
+                conn->state = STATE_DONE;
+            }
+            else if (conn->state == STATE_BLOCKED && (events[i].events & (EPOLLRDHUP | EPOLLHUP)))
+            {
+                // a blocked connection is only registered for the peer closing it, there is nobody left to serve
+                conn->state = STATE_DONE;
+            }
+            else
+            {
+                connection_io(conn);
+            }
 
-            connection_io(conn);
+            if (conn->state != STATE_DONE)
+            {
+                update_conn_events(conn);
+            }
 
             if (conn->state == STATE_DONE)
             {
-                // close the connection
-                close(conn->fd);
-                free(conn);
-                fd2conn[i - 1] = 0;
-                memset(&poll_args[i], 0, sizeof(poll_args[i]));
+                close_connection(fd2conn, conn);
             }
         }
-
-        // try to accept new connections if server socket is ready
-        if (poll_args[0].revents)
-        {
-            accept_new_connection(fd2conn, server_socket);
-        }
     }
 
     return 0;
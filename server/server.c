@@ -5,10 +5,25 @@
 
 // global variables
 HashTable *global_table;
+HashTable *blocking_keys;
 AOF *global_aof;
 pthread_t aof_thread;
 int server_socket;
+int epoll_fd;
+int max_message_size = MAX_MESSAGE_SIZE;
+bool debug_mode = false;
+int hash_max_listpack_entries = HASH_MAX_LISTPACK_ENTRIES;
+int hash_max_listpack_value = HASH_MAX_LISTPACK_VALUE;
 Conn *fd2conn[MAX_CLIENTS] = {0};
+SharedReplies shared;
+
+#define COMMAND_DEF(name, handler, min_args, max_args, flags, usage) {name, handler, min_args, max_args, flags, usage, {0, 0}},
+CommandDef command_table[] = {COMMAND_TABLE(COMMAND_DEF)};
+#undef COMMAND_DEF
+const int num_commands = sizeof(command_table) / sizeof(command_table[0]);
+
+// index over command_table, built by command_table_init()
+static CommandDef *command_index[COMMAND_INDEX_SIZE];
 
 /**
  * @brief Set a file descriptor to nonblocking mode
@@ -44,12 +59,14 @@ void set_fd_nonblocking(int fd)
 }
 
 /**
- * @brief Accept a new pending client connection and add it to the list of client connections
+ * @brief Accept a new pending client connection, add it to the list of client connections and register it with epoll
  *
- * @param fd2conn array of client connections
+ * The server socket is registered as edge triggered, so the caller should keep calling this function until it returns -1 to drain the accept queue.
+ *
+ * @param fd2conn array of client connections, indexed by fd
  * @param server_socket file descriptor of the server socket
  *
- * @return int 0 on success, -1 on failure
+ * @return int 0 on success, -1 on failure or if there are no more pending connections
  */
 int accept_new_connection(Conn *fd2conn[], int server_socket)
 {
@@ -60,30 +77,24 @@ int accept_new_connection(Conn *fd2conn[], int server_socket)
     int confd = accept(server_socket, (struct sockaddr *)&client_address, &client_address_len);
     if (confd < 0)
     {
-        perror("accept failed");
-        return -1;
-    }
-
-    // set the new connection to non-blocking
-    set_fd_nonblocking(confd);
-
-    // find an empty slot in the fd2conn array
-    int i;
-    for (i = 0; i < MAX_CLIENTS; i++)
-    {
-        if (!fd2conn[i])
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
         {
-            break;
+            perror("accept failed");
         }
+        return -1;
     }
 
-    if (i == MAX_CLIENTS)
+    // the fd is used as the index into fd2conn
+    if (confd >= MAX_CLIENTS)
     {
         fprintf(stderr, "Too many clients\n");
         close(confd);
-        return -1;
+        return 0;
     }
 
+    // set the new connection to non-blocking
+    set_fd_nonblocking(confd);
+
     // create a new connection object
     Conn *conn = (Conn *)calloc(1, sizeof(Conn));
     if (!conn)
@@ -94,1421 +105,1991 @@ int accept_new_connection(Conn *fd2conn[], int server_socket)
     conn->fd = confd;
     conn->state = STATE_REQ;
 
+    // the read buffer starts small and grows on demand, reply blocks are only allocated while replies are queued, so idle connections stay cheap
+    buffer_reserve(&conn->read_buffer, &conn->read_buffer_capacity, CONN_BUFFER_INIT_SIZE);
+
+    // register the connection with epoll, a new connection starts by waiting for a request
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLET;
+    event.data.fd = confd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, confd, &event) < 0)
+    {
+        perror("epoll_ctl failed");
+        close(confd);
+        free(conn->read_buffer);
+        free(conn);
+        return 0;
+    }
+    conn->events = event.events;
+
     // add the connection to the fd2conn array
-    fd2conn[i] = conn;
+    fd2conn[confd] = conn;
 
     return 0;
 }
 
 /**
- * @brief Handles the IO for a connection
+ * @brief Update the events a connection is registered for with epoll
+ *
+ * A connection waits for readability in STATE_REQ, and also for writability while it has queued replies the socket could not take yet. In STATE_RESP its output queue is full and it only waits for writability. In STATE_BLOCKED it is not read, so a parked connection is never reported for the requests it sends. epoll is only called when the events have changed since the last update.
  *
  * @param conn connection object
  */
-void connection_io(Conn *conn)
+void update_conn_events(Conn *conn)
 {
+    uint32_t events = EPOLLET;
+
     if (conn->state == STATE_REQ)
     {
-        state_req(conn);
+        events |= EPOLLIN | (conn->reply_queued ? EPOLLOUT : 0);
     }
-    else if (conn->state == STATE_RESP)
+    else if (conn->state == STATE_BLOCKED)
     {
-        state_resp(conn);
+        // a blocked connection is not read, it only waits for the peer to close it, or to write the replies queued before it blocked
+        events |= EPOLLRDHUP | (conn->reply_queued ? EPOLLOUT : 0);
     }
     else
     {
-        // Should not be in the done state here
-        fprintf(stderr, "Invalid state\n");
-        exit(EXIT_FAILURE);
+        events |= EPOLLOUT;
     }
-}
-
-/**
- * @brief Creates an array response with 0 elements (empty array)
- *
- * @return char* response
- */
-char *empty_array_response()
-{
 
-    SerialType type = SER_ARR;
-    int num_elements = 0;
+    if (events == conn->events)
+    {
+        return;
+    }
 
-    // null terminate the response
-    char *response = calloc(1 + 4, sizeof(char));
+    struct epoll_event event = {0};
+    event.events = events;
+    event.data.fd = conn->fd;
 
-    if (!response)
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event) < 0)
     {
-        fprintf(stderr, "Failed to allocate memory for empty array response\n");
-        exit(EXIT_FAILURE);
+        perror("epoll_ctl failed");
+        conn->state = STATE_DONE;
+        return;
     }
 
-    // write the type of the response, 1 byte
-    memcpy(response, &type, 1);
+    conn->events = events;
+}
 
-    // write the number of elements in the array, 4 bytes
-    memcpy(response + 1, &num_elements, 4);
+/**
+ * @brief Close a client connection and free it
+ *
+ * Closing the fd also removes it from the epoll set.
+ *
+ * @param fd2conn array of client connections, indexed by fd
+ * @param conn connection object
+ */
+void close_connection(Conn *fd2conn[], Conn *conn)
+{
+    release_blocked_conn(conn);
 
-    return response;
+    fd2conn[conn->fd] = NULL;
+    close(conn->fd);
+    free(conn->read_buffer);
+    reply_queue_free(conn);
+    free(conn);
 }
 
 /**
- * @brief Generates a value response according to the liteDB protocol
- *
- *  See README for more information on protocol
+ * @brief Handles the IO for a connection
  *
- * @param type type of the value
- * @param value value to send to the client, will NOT be freed after memcpy to the response
+ * Connections are registered as edge triggered, so the socket is always drained until it would block. Once a pending response has been flushed, the connection goes straight back to processing requests since no new readiness event will arrive for data that is already buffered.
  *
- * @return char* response
+ * @param conn connection object
  */
-char *get_response(ValueType type, void *value)
+void connection_io(Conn *conn)
 {
-    SerialType ser_type;
-    int value_len = 0;
-
-    switch (type)
+    if (conn->state == STATE_DONE)
     {
-    case STRING:
-        ser_type = SER_STR;
-        value_len = strlen(value);
-        break;
-    case INTEGER:
-        ser_type = SER_INT;
-        value_len = sizeof(int);
-        break;
-    case FLOAT:
-        ser_type = SER_FLOAT;
-        value_len = sizeof(float);
-        break;
-    default:
-        fprintf(stderr, "Invalid value type\n");
+        // Should not be in the done state here
+        fprintf(stderr, "Invalid state\n");
         exit(EXIT_FAILURE);
     }
 
-    // null terminate the response
-    char *response = calloc(1 + 4 + value_len, sizeof(char));
-
-    if (!response)
+    if (conn->state == STATE_BLOCKED)
     {
-        fprintf(stderr, "Failed to allocate memory for get response\n");
-        exit(EXIT_FAILURE);
+        while (try_flush_write_buffer(conn))
+        {
+        };
+        return;
     }
 
-    // write the type of the response, 1 byte
-    memcpy(response, &ser_type, 1);
-
-    // write the length of the value, 4 bytes
-    memcpy(response + 1, &value_len, 4);
-
-    // write the value
-    memcpy(response + 1 + 4, value, value_len);
-
-    return response;
-}
+    if (conn->state == STATE_RESP)
+    {
+        state_resp(conn);
+    }
 
-/**
- * @Brief Generates a value response according to the liteDB protocol
- *
- * @param type type of the value
- * @param value value to send to the client, will be freed after memcpy to the response so ensure it is a copy
- *
- * This function is like the get_response function, however, if frees the value after writing it to the response.
- */
-char *del_response(ValueType type, void *value)
-{
-    char *response = get_response(type, value);
-    free(value);
-    return response;
+    if (conn->state == STATE_REQ)
+    {
+        state_req(conn);
+    }
 }
 
 /**
- * @brief Generates a null response according to the liteDB protocol
- *
- *  See README for more information on protocol
+ * @brief Ensure a heap buffer can hold at least needed bytes, growing it by doubling
  *
- * @return char* response
+ * @param buffer pointer to the buffer, may be reallocated
+ * @param capacity pointer to the current capacity of the buffer, updated if the buffer grows
+ * @param needed number of bytes the buffer must be able to hold
  */
-char *null_response()
+void buffer_reserve(char **buffer, int *capacity, int needed)
 {
-    SerialType type = SER_NIL;
-    int value_len = 0;
+    if (needed <= *capacity)
+    {
+        return;
+    }
 
-    // null terminate the response
-    char *response = calloc(1 + 4, sizeof(char));
+    int new_capacity = *capacity > 0 ? *capacity : CONN_BUFFER_INIT_SIZE;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
 
-    if (!response)
+    char *new_buffer = realloc(*buffer, new_capacity);
+    if (!new_buffer)
     {
-        fprintf(stderr, "Failed to allocate memory for set response\n");
+        fprintf(stderr, "Failed to reallocate buffer\n");
         exit(EXIT_FAILURE);
     }
 
-    // write the type of the response, 1 byte
-    memcpy(response, &type, 1);
-
-    // write the length of the value, 4 bytes
-    memcpy(response + 1, &value_len, 4);
-
-    return response;
+    *buffer = new_buffer;
+    *capacity = new_capacity;
 }
 
 /**
- * @brief Generates an error response according to the liteDB protocol
- *
- *  See README for more information on protocol
- *
- * @param err_msg error message
+ * @brief Encodes a reply following the liteDB protocol into a heap buffer that is shared by all connections
  *
- * @return char* response
+ * @param reply shared reply to fill in
+ * @param type serial type of the reply
+ * @param value body of the reply
+ * @param value_len length of the body in bytes, the number of elements for arrays
  */
-char *error_response(char *err_msg)
+static void shared_reply_create(SharedReply *reply, SerialType type, const void *value, int value_len)
 {
-    SerialType type = SER_ERR;
-    int err_msg_len = strlen(err_msg);
+    // arrays only carry their number of elements, the elements follow as separate replies
+    int body_len = type == SER_ARR ? 0 : value_len;
 
-    // null terminate the response
-    char *response = calloc(1 + 4 + err_msg_len, sizeof(char));
-
-    if (!response)
+    reply->data = malloc(1 + 4 + body_len);
+    if (!reply->data)
     {
-        fprintf(stderr, "Failed to allocate memory for error response\n");
+        fprintf(stderr, "Failed to allocate memory for shared reply\n");
         exit(EXIT_FAILURE);
     }
 
-    // write the type of the response, 1 byte
-    memcpy(response, &type, 1);
-
-    // write the length of the error message, 4 bytes
-    memcpy(response + 1, &err_msg_len, 4);
+    reply->data[0] = type;
+    memcpy(reply->data + 1, &value_len, 4);
+    // nil and empty array replies have no value to copy
+    if (body_len > 0)
+    {
+        memcpy(reply->data + 1 + 4, value, body_len);
+    }
+    reply->size = 1 + 4 + body_len;
+}
 
-    // write the error message
-    memcpy(response + 1 + 4, err_msg, err_msg_len);
+/**
+ * @brief Builds the shared replies, must be called once before any command is executed
+ */
+void shared_replies_init()
+{
+    shared_reply_create(&shared.nil, SER_NIL, NULL, 0);
+    shared_reply_create(&shared.empty_array, SER_ARR, NULL, 0);
+    shared_reply_create(&shared.pong, SER_STR, "PONG", 4);
+    shared_reply_create(&shared.no_key, SER_ERR, "key not in database", strlen("key not in database"));
+    shared_reply_create(&shared.not_hashtable, SER_ERR, "key is not for a hashtable", strlen("key is not for a hashtable"));
+    shared_reply_create(&shared.not_list, SER_ERR, "key is not for a list", strlen("key is not for a list"));
+    shared_reply_create(&shared.not_zset, SER_ERR, "key is not for a zset", strlen("key is not for a zset"));
+    shared_reply_create(&shared.unknown_command, SER_ERR, "Unknown command", strlen("Unknown command"));
 
-    return response;
+    for (int i = 0; i < SHARED_INTEGERS; i++)
+    {
+        shared_reply_create(&shared.integers[i], SER_INT, &i, sizeof(int));
+    }
 }
 
-// Parse a request from the client(not null terminated) , need to free the returned command and it's args
 /**
- * @brief Parse an input string from the client into a Command struct
+ * @brief Reserves space at the end of the output queue of a connection for a reply to be serialized into
  *
- * Spaces are used as a delimiter to toknize the characters in the input string,
- * The first token is expected to be the command name, and the rest are expected to be the arguments.
+ * The space is taken from the tail block of the queue if it fits, otherwise a new block large enough to hold it is added. Replies never span blocks, so the returned space is contiguous.
  *
- * @param cmd_string input string from the client
- * @param size size of the input string
+ * @param conn Connection to reserve the space for
+ * @param size number of bytes to reserve
  *
- * @return Command* - parsed command
+ * @return char* start of the reserved space
  */
-Command *parse_cmd_string(char *cmd_string, int size)
+char *reply_reserve(Conn *conn, int size)
 {
-    Command *cmd = calloc(1, sizeof(Command));
-    if (!cmd)
-    {
-        fprintf(stderr, "Failed to allocate memory for Command\n");
-        exit(EXIT_FAILURE);
-    }
+    ReplyBlock *tail = conn->reply_tail;
 
-    // Create a new null-terminated string to hold the command string
-    char *n_cmd_string = calloc(size + 1, sizeof(char));
-    if (!n_cmd_string)
+    if (!tail || tail->capacity - tail->size < size)
     {
-        fprintf(stderr, "Failed to allocate memory for n_cmd_string\n");
-        exit(EXIT_FAILURE);
-    }
-    strncpy(n_cmd_string, cmd_string, size);
+        int capacity = size > REPLY_BLOCK_SIZE ? size : REPLY_BLOCK_SIZE;
+
+        ReplyBlock *block = malloc(sizeof(ReplyBlock) + capacity);
+        if (!block)
+        {
+            fprintf(stderr, "Failed to allocate memory for reply block\n");
+            exit(EXIT_FAILURE);
+        }
 
-    // Tokenize the command string by splitting at spaces
-    char *token = strtok(n_cmd_string, " ");
-    int args = 0;
+        block->next = NULL;
+        block->size = 0;
+        block->capacity = capacity;
 
-    while (token != NULL)
-    {
-        if (args == 0)
+        if (tail)
         {
-            cmd->name = strdup(token); // Use strdup for convenience
+            tail->next = block;
         }
         else
         {
-            cmd->args[args - 1] = strdup(token); // Assuming args array is preallocated
+            conn->reply_head = block;
         }
-        token = strtok(NULL, " ");
-        args++;
-    }
 
-    cmd->num_args = args - 1;
+        conn->reply_tail = block;
+        tail = block;
+    }
 
-    free(n_cmd_string);
+    char *start = tail->data + tail->size;
+    tail->size += size;
+    conn->reply_queued += size;
 
-    return cmd;
+    return start;
 }
 
 /**
- * @brief Write a command to the AOF file
+ * @brief Appends a value reply of the given serial type, the header and the value are written straight into the output queue
  *
- * @param cmd Command to write to the AOF file
+ * All the add_reply functions do nothing when conn is NULL, which is the case when commands are restored from the AOF.
  *
- * @return void
+ * @param conn Connection to reply to
+ * @param type serial type of the value
+ * @param value value to write
+ * @param value_len length of the value in bytes
  */
-void handle_aof_write(Command *cmd)
+void add_reply_bulk(Conn *conn, SerialType type, const void *value, int value_len)
 {
-
-    // check if the AOF was initialized
-    if (!global_aof)
+    if (!conn)
     {
-        fprintf(stderr, "AOF not initialized\n");
-        exit(EXIT_FAILURE);
+        return;
     }
 
-    // create a string from the command
-    char message[MAX_MESSAGE_SIZE + 1] = {'\0'};
+    char *reply = reply_reserve(conn, 1 + 4 + value_len);
 
-    // write the command name
-    snprintf(message, MAX_MESSAGE_SIZE, "%s", cmd->name);
+    reply[0] = type;
+    memcpy(reply + 1, &value_len, 4);
+    memcpy(reply + 1 + 4, value, value_len);
+}
 
-    // write the command arguments
-    for (int i = 0; i < cmd->num_args; i++)
+/**
+ * @brief Appends a pre-encoded shared reply
+ *
+ * @param conn Connection to reply to
+ * @param reply shared reply to copy
+ */
+void add_reply_shared(Conn *conn, SharedReply *reply)
+{
+    if (!conn)
     {
-        snprintf(message + strlen(message), MAX_MESSAGE_SIZE - strlen(message) - 1, " %s", cmd->args[i]);
+        return;
     }
 
-    // write the final newline character`
-    snprintf(message + strlen(message), MAX_MESSAGE_SIZE - strlen(message) - 1, "\n");
-
-    // write the command to the AOF
-    aof_write(global_aof, message);
+    memcpy(reply_reserve(conn, reply->size), reply->data, reply->size);
 }
 
 /**
- * @brief Deletes a key-value pair from the global table and handles cleanup of the value if necessary.
- *
- * @param global_table Global hash table
- * @param key Key to delete from the global table.
- * @param value Value to delete from the global table.
- * @param type Type of the value to delete.
+ * @brief Appends a string reply
  *
- * @return void
+ * @param conn Connection to reply to
+ * @param str null terminated string
  */
-void global_table_del(char *key, char *value, ValueType type)
+void add_reply_str(Conn *conn, const char *str)
 {
-    if (type == ZSET)
-    {
-        // free the zset contents, don't free the zset itself
-        ZSet *zset = (ZSet *)value;
-        zset_free_contents(zset);
-    }
-    else if (type == HASHTABLE)
+    if (!conn)
     {
-        // free the hashtable, don't free the hashtable itself
-        HashTable *table = (HashTable *)value;
-        hfree_table_contents(table);
+        return;
     }
-    else if (type == LIST)
+
+    add_reply_bulk(conn, SER_STR, str, strlen(str));
+}
+
+/**
+ * @brief Appends an integer reply, small integers use the shared replies
+ *
+ * @param conn Connection to reply to
+ * @param value integer to write
+ */
+void add_reply_int(Conn *conn, int value)
+{
+    if (value >= 0 && value < SHARED_INTEGERS)
     {
-        // free the list
-        List *list = (List *)value;
-        list_free_contents(list);
+        add_reply_shared(conn, &shared.integers[value]);
+        return;
     }
 
-    // if the key is not for a ZSET, HASHTABLE, or LIST, no need for extra cleanup, just remove the node from the global table
-    HashNode *removed_node = hremove(global_table, key);
-    hfree(removed_node);
+    add_reply_bulk(conn, SER_INT, &value, sizeof(int));
 }
 
 /**
- * @brief Ping command to check if the server is alive, returns PONG
+ * @brief Appends a float reply
+ *
+ * @param conn Connection to reply to
+ * @param value float to write
  */
-char *ping_command()
+void add_reply_float(Conn *conn, float value)
 {
-    ValueType type = STRING;
-    return get_response(type, "PONG");
+    add_reply_bulk(conn, SER_FLOAT, &value, sizeof(float));
 }
 
 /**
- *  EXISTS (key) -  Checks if the specified key exists in the database. Returns an integer response, 1 if the key exists, 0 otherwise.
+ * @brief Appends a nil reply
  *
- * @param cmd Command structure containing the (key)
- * @return char* response
+ * @param conn Connection to reply to
  */
-char *exists_command(Command *cmd)
+void add_reply_nil(Conn *conn)
 {
+    add_reply_shared(conn, &shared.nil);
+}
 
-    ValueType response_type = INTEGER;
-    int elem_exists = 0;
-
-    if (cmd->num_args != 1)
+/**
+ * @brief Appends an error reply
+ *
+ * @param conn Connection to reply to
+ * @param err_msg null terminated error message
+ */
+void add_reply_error(Conn *conn, const char *err_msg)
+{
+    if (!conn)
     {
-        return error_response("exists command requires 1 argument (key)");
+        return;
     }
 
-    HashNode *fetched_node = hget(global_table, cmd->args[0]);
-    if (!fetched_node)
-    {
-        elem_exists = 0;
-    }
-    else
+    add_reply_bulk(conn, SER_ERR, err_msg, strlen(err_msg));
+}
+
+/**
+ * @brief Appends a reply for a value stored in a hash table
+ *
+ * @param conn Connection to reply to
+ * @param type type of the value
+ * @param value value to write
+ */
+void add_reply_value(Conn *conn, ValueType type, void *value)
+{
+    switch (type)
     {
-        elem_exists = 1;
+    case STRING:
+        add_reply_str(conn, value);
+        break;
+    case INTEGER:
+        add_reply_int(conn, *(int *)value);
+        break;
+    case FLOAT:
+        add_reply_float(conn, *(float *)value);
+        break;
+    default:
+        fprintf(stderr, "Invalid value type\n");
+        exit(EXIT_FAILURE);
     }
-
-    return get_response(response_type, &elem_exists);
 }
 
 /**
- * @brief Deletes a key-value pair from the global table ,where value is a string and handles AOF logging if necessary.
- *
- * @param cmd Command structure containing the (key)
- * @param aof_restore Flag indicating whether to log the deletion to the AOF file.
+ * @brief Appends the header of an array reply, the elements are appended after it with the other add_reply functions
  *
- * @return char* A string response indicating the number of elements removed, or NULL if AOF restore is enabled.
+ * @param conn Connection to reply to
+ * @param num_elements number of elements in the array
  */
-char *del_command(Command *cmd, bool aof_restore)
+void add_reply_array_len(Conn *conn, int num_elements)
 {
-
-    ValueType response_type = INTEGER;
-    int elem_removed = 0;
-
-    if (cmd->num_args != 1)
+    if (!num_elements)
     {
-        return error_response("del command requires 1 argument (key)");
+        add_reply_shared(conn, &shared.empty_array);
+        return;
     }
 
-    HashNode *fetched_node = hget(global_table, cmd->args[0]);
-    if (!fetched_node)
+    if (!conn)
     {
-        return error_response("key not in database");
+        return;
     }
 
-    // execute delete
-    global_table_del(fetched_node->key, fetched_node->value, fetched_node->valueType);
-    elem_removed++;
+    char *reply = reply_reserve(conn, 1 + 4);
 
-    if (!aof_restore)
-    {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_removed);
-    }
-    else
-    {
-        return NULL;
-    }
+    reply[0] = SER_ARR;
+    memcpy(reply + 1, &num_elements, 4);
 }
 
 /**
- * @brief Returns a protocol string containing all keys in the global hash table.
+ * @brief Appends the header of an array reply whose number of elements is not known yet
  *
- * @return char* Protocol string with keys.
+ * The header stays in place until the command returns, since blocks are only flushed after that, so the length can be written by set_deferred_array_len() once the elements are appended.
+ *
+ * @param conn Connection to reply to
+ *
+ * @return char* header to pass to set_deferred_array_len(), NULL if conn is NULL
  */
-char *keys_command()
+char *add_reply_deferred_array_len(Conn *conn)
 {
-    // get all the keys in the hash table
-    int num_keys = 0;
-    int inc_buffer = 5;
-
-    // buffer for the data
-    char *buffer = calloc(1 + 4 + MAX_MESSAGE_SIZE, sizeof(char));
-
-    // iterate through the hash table and write the keys to the buffer
-    for (int i = 0; i <= global_table->mask; i++)
+    if (!conn)
     {
-        HashNode *traverseList = global_table->nodes[i];
-
-        while (traverseList != NULL)
-        {
-            // write the key to the buffer
-            int type = SER_STR;
-            int key_len = strlen(traverseList->key);
-
-            // check if the buffer has enough space to write the key
-            if (inc_buffer + 5 + key_len > MAX_MESSAGE_SIZE)
-            {
-                fprintf(stderr, "Failed to reallocate memory for keys response\n");
-                exit(EXIT_FAILURE);
-            }
+        return NULL;
+    }
 
-            // write the type and length of the response, 1 byte
-            memcpy(buffer + inc_buffer, &type, 1);
-            memcpy(buffer + inc_buffer + 1, &key_len, 4);
+    char *reply = reply_reserve(conn, 1 + 4);
+    reply[0] = SER_ARR;
 
-            // write the key
-            memcpy(buffer + inc_buffer + 5, traverseList->key, key_len);
+    return reply;
+}
 
-            inc_buffer += 5 + key_len;
-            num_keys++;
-            traverseList = traverseList->next;
-        }
+/**
+ * @brief Writes the number of elements of an array reply started with add_reply_deferred_array_len()
+ *
+ * @param header header returned by add_reply_deferred_array_len()
+ * @param num_elements number of elements in the array
+ */
+void set_deferred_array_len(char *header, int num_elements)
+{
+    if (!header)
+    {
+        return;
     }
 
-    // write the type and length of array to buffer
-    int type = SER_ARR;
-    memcpy(buffer, &type, 1);
-    memcpy(buffer + 1, &num_keys, 4);
-
-    return buffer;
+    memcpy(header + 1, &num_elements, 4);
 }
 
 /**
- * @brief Flushes the entire database and optionally logs the action to the AOF file.
+ * @brief Appends an argument slice to a command, the first slice becomes the command name
  *
- * @param cmd Command structure triggering the flush operation.
- * @param aof_restore Flag indicating whether to log the flush operation to the AOF file.
+ * Arguments are kept in the inline storage of the command until it is full, then they spill to a heap array that doubles as needed.
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @param cmd command to append to
+ * @param arg start of the argument
+ * @param len length of the argument in bytes
  */
-char *flushall_cmd(Command *cmd, bool aof_restore)
+static void command_push_arg(Command *cmd, char *arg, int len)
 {
-    // iterate through the hash table and free all the nodes
-    for (int i = 0; i <= global_table->mask; i++)
+    if (!cmd->name)
     {
-        HashNode *traverseList = global_table->nodes[i];
-
-        while (traverseList != NULL)
-        {
-            HashNode *next = traverseList->next;
-
-            // execute delete
-            global_table_del(traverseList->key, traverseList->value, traverseList->valueType);
-
-            traverseList = next;
-        }
+        cmd->name = arg;
+        return;
     }
 
-    if (!aof_restore)
+    if (cmd->num_args == cmd->args_capacity)
     {
-        handle_aof_write(cmd);
-        return null_response();
-    }
-    else
-    {
-        return NULL;
+        int new_capacity = cmd->args_capacity * 2;
+        bool spilled = cmd->args != cmd->inline_args;
+
+        char **new_args = realloc(spilled ? cmd->args : NULL, new_capacity * sizeof(char *));
+        int *new_lens = realloc(spilled ? cmd->arg_lens : NULL, new_capacity * sizeof(int));
+        if (!new_args || !new_lens)
+        {
+            fprintf(stderr, "Failed to allocate memory for command arguments\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (!spilled)
+        {
+            memcpy(new_args, cmd->inline_args, cmd->num_args * sizeof(char *));
+            memcpy(new_lens, cmd->inline_arg_lens, cmd->num_args * sizeof(int));
+        }
+
+        cmd->args = new_args;
+        cmd->arg_lens = new_lens;
+        cmd->args_capacity = new_capacity;
     }
+
+    cmd->args[cmd->num_args] = arg;
+    cmd->arg_lens[cmd->num_args] = len;
+    cmd->num_args++;
 }
 
 /**
- * @brief Get the value of a key, it the key does not exist return nil. Returns the value
+ * @brief Parse a request message into a Command struct without copying it
  *
- * @param cmd Command structure specifying the (key)
+ * A message starting with FRAME_MARKER carries the number of arguments (4 bytes) followed by every argument as its length (4 bytes) and its bytes, the first argument is the command name, so arguments may contain spaces. Any other message is a command string whose tokens are separated by spaces, as sent by the CLI.
  *
- * @return char* response
+ * The arguments are null terminated in place: a space, or the length prefix of the next argument, is overwritten once it has been read. The byte right after the message is overwritten as well, so it must be writable and the caller restores it if it belongs to the next request.
+ *
+ * @param cmd_string request message, not null terminated
+ * @param size size of the request message
+ * @param cmd command to fill in, release it with command_free()
+ *
+ * The commands keep their arguments as null terminated strings, so a message with a null byte in an argument is refused instead of being cut short at it.
+ *
+ * @return int 0 on success, -1 if a framed message is malformed, -2 if an argument contains a null byte
  */
-char *get_command(Command *cmd)
+int parse_cmd_string(char *cmd_string, int size, Command *cmd)
 {
+    cmd->name = NULL;
+    cmd->args = cmd->inline_args;
+    cmd->arg_lens = cmd->inline_arg_lens;
+    cmd->num_args = 0;
+    cmd->args_capacity = CMD_INLINE_ARGS;
 
-    // check if the command has the correct number of arguments
-    if (cmd->num_args != 1)
+    if (size > 0 && cmd_string[0] == FRAME_MARKER)
     {
-        return error_response("get command requires 1 argument (key)");
-    }
+        if (size < 1 + 4)
+        {
+            return -1;
+        }
 
-    // get the value from the hash table
-    HashNode *fetched_node = hget(global_table, cmd->args[0]);
-    if (!fetched_node)
-    {
-        return null_response();
-    }
+        int num_args = 0;
+        memcpy(&num_args, cmd_string + 1, 4);
 
-    // get the value from the hash node
-    ValueType type = fetched_node->valueType;
+        // every argument needs at least its length prefix, this bounds the count by the frame size
+        if (num_args < 0 || num_args > (size - 1 - 4) / 4)
+        {
+            return -1;
+        }
 
-    if (type != STRING)
-    {
-        return error_response("Value for this key is not a string");
-    }
+        int offset = 1 + 4;
+        for (int i = 0; i < num_args; i++)
+        {
+            if (size - offset < 4)
+            {
+                return -1;
+            }
 
-    char *value = fetched_node->value;
+            int len = 0;
+            memcpy(&len, cmd_string + offset, 4);
 
-    return get_response(type, value);
-}
+            if (len < 0 || len > size - offset - 4)
+            {
+                return -1;
+            }
 
-// returns null response for the set command
+            if (memchr(cmd_string + offset + 4, '\0', len) != NULL)
+            {
+                return -2;
+            }
 
-/**
- * @brief Executes a SET command and optionally logs the action to the AOF file. All values are stored as strings in the global hashtable.
- *
- * @param cmd Command structure specifying the (key, value)
- * @param aof_restore Flag indicating whether to log the SET operation to the AOF file.
- *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
- *
- */
-char *set_command(Command *cmd, bool aof_restore)
-{
+            // the length prefix has been read, it now terminates the previous argument
+            cmd_string[offset] = '\0';
 
-    // obtain type of the value
-    if (cmd->num_args != 2)
-    {
-        return error_response("set command requires 2 arguments (key, value)");
-    }
+            command_push_arg(cmd, cmd_string + offset + 4, len);
+            offset += 4 + len;
+        }
 
-    // * All data is stored as strings except for the ZSET values
-    HashNode *new_node = hinit(strdup(cmd->args[0]), STRING, strdup(cmd->args[1]));
-    if (new_node == NULL)
-    {
-        fprintf(stderr, "Error creating new node for hashtable\n");
-        exit(EXIT_FAILURE);
+        if (offset != size)
+        {
+            return -1;
+        }
+
+        cmd_string[size] = '\0';
+        return 0;
     }
 
-    HashNode *ret = hinsert(global_table, new_node);
-    if (ret == NULL)
+    if (memchr(cmd_string, '\0', size) != NULL)
     {
-        return error_response("Failed to insert new node into global table");
+        return -2;
     }
 
-    if (!aof_restore)
+    // tokenize the command string by splitting at spaces, consecutive spaces are skipped
+    int i = 0;
+    while (i < size)
     {
-        handle_aof_write(cmd);
-        return null_response();
+        if (cmd_string[i] == ' ')
+        {
+            i++;
+            continue;
+        }
+
+        int start = i;
+        while (i < size && cmd_string[i] != ' ')
+        {
+            i++;
+        }
+
+        command_push_arg(cmd, cmd_string + start, i - start);
+
+        // terminate the token, at the end of the message this is the byte after it
+        cmd_string[i] = '\0';
+        i++;
     }
-    else
+
+    return 0;
+}
+
+/**
+ * @brief Releases the arguments of a command that spilled to the heap, the arguments themselves belong to the request
+ *
+ * @param cmd command to release
+ */
+void command_free(Command *cmd)
+{
+    if (cmd->args != cmd->inline_args)
     {
-        return NULL;
+        free(cmd->args);
+        free(cmd->arg_lens);
     }
+
+    cmd->args = cmd->inline_args;
+    cmd->arg_lens = cmd->inline_arg_lens;
+    cmd->num_args = 0;
 }
 
 /**
- * The HEXISTS (key, field) command checks if a field exists in a hash . Returns an integer response indicating the number of fields found.
+ * @brief Write a command to the AOF file
  *
- * @param cmd Command structure specifying the (key, field)
- * @return char* response
+ * The command is logged as a framed request message with length-prefixed arguments, so arguments containing spaces or newlines are restored exactly.
+ *
+ * @param cmd Command to write to the AOF file
+ *
+ * @return void
  */
-char *hexists_command(Command *cmd)
+void handle_aof_write(Command *cmd)
 {
-    int response_type = INTEGER;
-    int elem_exists = 0;
 
-    if (cmd->num_args < 2)
+    // check if the AOF was initialized
+    if (!global_aof)
     {
-        return error_response("hexists command requires at least 2 arguments (key, field)");
+        fprintf(stderr, "AOF not initialized\n");
+        exit(EXIT_FAILURE);
     }
 
-    char *global_table_key = cmd->args[0];
-    char *field_key = cmd->args[1];
-
-    // fetch the hashtable from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
-
-    if (!fetched_node)
+    // compute the size of the message, the marker, the number of arguments, then every argument with its length, the name counts as an argument
+    int name_len = strlen(cmd->name);
+    int message_size = 1 + 4 + 4 + name_len;
+    for (int i = 0; i < cmd->num_args; i++)
     {
-        fprintf(stderr, "key not in database\n");
-        return get_response(response_type, 0);
+        message_size += 4 + cmd->arg_lens[i];
     }
 
-    // check if the value is a hashtable
-    if (fetched_node->valueType != HASHTABLE)
+    // values can be larger than a single message so size it to fit, the record starts with the size of the message like a request
+    char *record = malloc(4 + message_size);
+    if (!record)
     {
-        fprintf(stderr, "key is not for a hashtable\n");
-        return get_response(response_type, 0);
+        fprintf(stderr, "Failed to allocate memory for AOF record\n");
+        exit(EXIT_FAILURE);
     }
 
-    HashTable *cur_table = (HashTable *)fetched_node->value;
+    int num_args = 1 + cmd->num_args;
+    int offset = 0;
 
-    // check if the field exists in the hashtable
-    HashNode *ret_node = hget(cur_table, field_key);
+    memcpy(record, &message_size, 4);
+    record[4] = FRAME_MARKER;
+    memcpy(record + 4 + 1, &num_args, 4);
+    offset = 4 + 1 + 4;
 
-    if (ret_node)
-    {
-        elem_exists = 1;
-    }
-    else
+    // write the command name
+    memcpy(record + offset, &name_len, 4);
+    memcpy(record + offset + 4, cmd->name, name_len);
+    offset += 4 + name_len;
+
+    // write the command arguments
+    for (int i = 0; i < cmd->num_args; i++)
     {
-        elem_exists = 0;
+        memcpy(record + offset, &cmd->arg_lens[i], 4);
+        memcpy(record + offset + 4, cmd->args[i], cmd->arg_lens[i]);
+        offset += 4 + cmd->arg_lens[i];
     }
 
-    return get_response(response_type, &elem_exists);
+    // write the command to the AOF
+    aof_write_bytes(global_aof, record, offset);
+
+    free(record);
 }
 
 /**
- * @brief Executes an HSET command and optionally logs the action to the AOF file.
- *
- * The HSET (key, field, value) command sets the value of a key in a hash table. If the key does not exist, a new hash table is created. Returns a response which containts the number of elements added/updated.
+ * @brief Deletes a key-value pair from the global table and handles cleanup of the value if necessary.
  *
- * @param cmd Command structure specifying the (key, field, value)
- * @param aof_restore Flag indicating whether to log the HSET operation to the AOF file.
+ * @param global_table Global hash table
+ * @param key Key to delete from the global table.
+ * @param value Value to delete from the global table.
+ * @param type Type of the value to delete.
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return void
  */
-char *hset_command(Command *cmd, bool aof_restore)
+void global_table_del(char *key, char *value, ValueType type)
 {
+    value_free_contents(value, type);
 
-    ValueType response_type = INTEGER;
-    int elem_added = 0;
-
-    if (cmd->num_args < 3)
-    {
-        return error_response("hset command requires at least 3 arguments (key, field, value)");
-    }
-
-    char *global_table_key = cmd->args[0];
-    char *field_key = cmd->args[1];
-    char *value = cmd->args[2];
-
-    // fetch the hashtable from the global table
-    HashTable *cur_table;
+    // if the key is not for a ZSET, HASHTABLE, or LIST, no need for extra cleanup, just remove the node from the global table
+    HashNode *removed_node = hremove(global_table, key);
+    hfree(removed_node);
+}
 
-    HashNode *fetched_node = hget(global_table, global_table_key);
-    if (!fetched_node)
+/**
+ * @brief Frees what a value of the global table owns, but not the value itself, which is freed with its node
+ *
+ * @param value value to free the contents of
+ * @param type type of the value
+ */
+void value_free_contents(void *value, ValueType type)
+{
+    if (type == ZSET)
     {
-        // create a new hashtable
-        HashTable *new_hash_table = hcreate(INIT_TABLE_SIZE);
-
-        // insert the new hashtable into the global table
-        HashNode *new_node = hinit(strdup(global_table_key), HASHTABLE, new_hash_table);
-
-        HashNode *ret = hinsert(global_table, new_node);
-        if (!ret)
-        {
-            return error_response("Failed to insert new hash table into global table");
-        }
-
-        cur_table = new_hash_table;
+        // free the zset contents, don't free the zset itself
+        ZSet *zset = (ZSet *)value;
+        zset_free_contents(zset);
     }
-    else
+    else if (type == HASHTABLE)
     {
-        // check if the value is a hashtable
-        if (fetched_node->valueType != HASHTABLE)
-        {
-            return error_response("key is not for a hashtable");
-        }
-
-        cur_table = (HashTable *)fetched_node->value;
+        // free the hashtable, don't free the hashtable itself
+        HashTable *table = (HashTable *)value;
+        hfree_table_contents(table);
     }
-
-    // add the value to the hashtable
-    HashNode *new_node = hinit(strdup(field_key), STRING, strdup(value));
-    if (!new_node)
+    else if (type == LIST)
     {
-        return error_response("Failed to create new node for hashtable");
+        // free the list
+        List *list = (List *)value;
+        list_free_contents(list);
     }
+}
 
-    // if it already exists, remove the old value
-    HashNode *old_node = hremove(cur_table, field_key);
-    if (old_node)
-    {
-        hfree(old_node);
-    }
+/**
+ * @brief Ping command to check if the server is alive, returns PONG
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool ping_command(Conn *conn, Command *cmd)
+{
+    add_reply_shared(conn, &shared.pong);
 
-    HashNode *ret = hinsert(cur_table, new_node);
-    if (!ret)
-    {
-        return error_response("Failed to insert new node into hashtable");
-    }
+    return true;
+}
 
-    elem_added++;
+/**
+ *  EXISTS (key) -  Checks if the specified key exists in the database. Returns an integer response, 1 if the key exists, 0 otherwise.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure containing the (key)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool exists_command(Conn *conn, Command *cmd)
+{
+    int elem_exists = 0;
 
-    if (!aof_restore)
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node)
     {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_added);
+        elem_exists = 0;
     }
     else
     {
-        return NULL;
+        elem_exists = 1;
     }
+
+    add_reply_int(conn, elem_exists);
+
+    return true;
 }
 
 /**
- * @brief Executes an HGET command and returns the corresponding response string according to the liteDB protocol.
- *
- * Gets the value of field from the hash specified by key. Returns the value. If the key, or field don't exist in database, return nil
+ * @brief Deletes a key-value pair from the global table ,where value is a string.
  *
- * @param cmd Command structure specifying the (key, field)
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure containing the (key)
  *
- * @return char* response
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *hget_command(Command *cmd)
+bool del_command(Conn *conn, Command *cmd)
 {
-    if (cmd->num_args < 2)
-    {
-        return error_response("hget command requires at least 2 arguments (key, field)");
-    }
-
-    char *global_table_key = cmd->args[0];
-    char *field_key = cmd->args[1];
+    int elem_removed = 0;
 
-    // fetch the hashtable from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
     if (!fetched_node)
     {
-        return null_response();
-    }
-
-    // check if the value is a hashtable
-    if (fetched_node->valueType != HASHTABLE)
-    {
-        return error_response("key is not for a hashtable");
+        add_reply_shared(conn, &shared.no_key);
+        return false;
     }
 
-    HashTable *cur_table = (HashTable *)fetched_node->value;
+    // execute delete
+    global_table_del(fetched_node->key, fetched_node->value, fetched_node->valueType);
+    elem_removed++;
 
-    // fetch the value from the hashtable
-    HashNode *ret_node = hget(cur_table, field_key);
-    if (!ret_node)
-    {
-        return null_response();
-    }
+    add_reply_int(conn, elem_removed);
 
-    return get_response(ret_node->valueType, ret_node->value);
+    return true;
 }
 
 /**
- * @brief Executes an HDEL command and optionally logs the action to the AOF file.
- *
- * The HDEL command removes a field from a hash table. Returns an integer response indicating the number of elements removed.
+ * @brief Returns a protocol string containing all keys in the global hash table.
  *
- * @param cmd Command structure specifying the (key, field)
- * @param aof_restore Flag indicating whether to log the HDEL operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *hdel_command(Command *cmd, bool aof_restore)
+bool keys_command(Conn *conn, Command *cmd)
 {
+    // the number of keys is known up front, so the array header is written first
+    add_reply_array_len(conn, global_table->size);
 
-    ValueType response_type = INTEGER;
-    int elem_removed = 0;
+    // iterate through the hash table and write the keys to the output queue
+    HashIter iter;
+    hiter_init(global_table, &iter);
 
-    if (cmd->num_args < 2)
+    HashNode *node;
+    while ((node = hiter_next(&iter)) != NULL)
     {
-        return error_response("hdel command requires at least 2 arguments (key, field)");
+        add_reply_str(conn, node->key);
     }
 
-    char *global_table_key = cmd->args[0];
-    char *field_key = cmd->args[1];
+    return true;
+}
 
-    // fetch the hashtable from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
-    if (!fetched_node)
+/**
+ * @brief Flushes the entire database.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure triggering the flush operation.
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool flushall_cmd(Conn *conn, Command *cmd)
+{
+    // free the contents of every value, removing the nodes one at a time would resize the table while it is being iterated
+    HashIter iter;
+    hiter_init(global_table, &iter);
+
+    HashNode *node;
+    while ((node = hiter_next(&iter)) != NULL)
     {
-        return error_response("key not in database");
+        value_free_contents(node->value, node->valueType);
     }
 
-    // check if the value is a hashtable
-    if (fetched_node->valueType != HASHTABLE)
+    // then free all the nodes at once
+    hclear(global_table);
+
+    add_reply_nil(conn);
+
+    return true;
+}
+
+/**
+ * @brief Get the value of a key, it the key does not exist return nil. Returns the value
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool get_command(Conn *conn, Command *cmd)
+{
+    // get the value from the hash table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node)
     {
-        return error_response("key is not for a hashtable");
+        add_reply_nil(conn);
+        return true;
     }
 
-    HashTable *cur_table = (HashTable *)fetched_node->value;
+    // get the value from the hash node
+    ValueType type = fetched_node->valueType;
 
-    // remove the value from the hashtable
-    HashNode *removed_node = hremove(cur_table, field_key);
-    if (!removed_node)
+    if (type != STRING)
     {
-        return error_response("Failed to remove value from hashtable");
+        add_reply_error(conn, "Value for this key is not a string");
+        return false;
     }
 
-    // free the removed node
-    hfree(removed_node);
+    add_reply_str(conn, fetched_node->value);
 
-    elem_removed++;
+    return true;
+}
+
+// returns null response for the set command
+
+/**
+ * @brief Executes a SET command. All values are stored as strings in the global hashtable.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, value)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool set_command(Conn *conn, Command *cmd)
+{
+    // obtain type of the value
 
-    if (!aof_restore)
+    // * All data is stored as strings except for the ZSET values
+    HashNode *new_node = hinit(strdup(cmd->args[0]), STRING, strdup(cmd->args[1]));
+    if (new_node == NULL)
     {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_removed);
+        fprintf(stderr, "Error creating new node for hashtable\n");
+        exit(EXIT_FAILURE);
     }
-    else
+
+    HashNode *ret = hinsert(global_table, new_node);
+    if (ret == NULL)
     {
-        return NULL;
+        add_reply_error(conn, "Failed to insert new node into global table");
+        return false;
     }
+
+    add_reply_nil(conn);
+
+    return true;
 }
 
 /**
- * @brief Executes an HGETALL command and returns the corresponding response string according to the liteDB protocol.
- *
- * The HGETALL command retrieves all fields and values in a hash table. Returns an error response if the key does not exist.
+ * @brief Executes an MGET command. Returns an array with the value of every key, nil for a key that does not exist or does not hold a string.
  *
- * @param cmd Command structure specifying (key)
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, [key, ...])
  *
- * @return char* response
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *hgetall_command(Command *cmd)
+bool mget_command(Conn *conn, Command *cmd)
 {
-    if (cmd->num_args < 1)
+    HashNode *fetched_nodes[HGET_BATCH];
+
+    add_reply_array_len(conn, cmd->num_args);
+    for (int start = 0; start < cmd->num_args; start += HGET_BATCH)
     {
-        return error_response("hgetall command requires at least 1 argument (key)");
-    }
+        // look the keys up a batch at a time so their cache misses overlap
+        int count = cmd->num_args - start < HGET_BATCH ? cmd->num_args - start : HGET_BATCH;
+        hget_many(global_table, cmd->args + start, count, fetched_nodes);
 
-    char *global_table_key = cmd->args[0];
+        for (int i = 0; i < count; i++)
+        {
+            if (!fetched_nodes[i] || fetched_nodes[i]->valueType != STRING)
+            {
+                add_reply_nil(conn);
+                continue;
+            }
 
-    // fetch the hashtable from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
-    if (!fetched_node)
-    {
-        fprintf(stderr, "key not in database\n");
-        return empty_array_response();
+            add_reply_str(conn, fetched_nodes[i]->value);
+        }
     }
 
-    // check if the value is a hashtable
-    if (fetched_node->valueType != HASHTABLE)
+    return true;
+}
+
+/**
+ * @brief Executes an MSET command, setting several keys at once. Like SET it fails if a key already exists, in which case none of the keys are set.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, value, [key, value, ...])
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool mset_command(Conn *conn, Command *cmd)
+{
+    if (cmd->num_args % 2 != 0)
     {
-        fprintf(stderr, "key is not for a hashtable");
-        return empty_array_response();
+        add_reply_error(conn, "mset command requires a value for every key (key, value, ...)");
+        return false;
     }
 
-    HashTable *cur_table = (HashTable *)fetched_node->value;
-
-    // get all the keys in the hashtable
-    int num_elem = 0;
-    int inc_buffer = 5;
-
-    // buffer for the data
-    char *buffer = calloc(1 + 4 + MAX_MESSAGE_SIZE, sizeof(char));
-
-    // iterate through the hash table and write the keys to the buffer
-    for (int i = 0; i <= cur_table->mask; i++)
+    for (int i = 0; i < cmd->num_args; i += 2)
     {
-        HashNode *traverseList = cur_table->nodes[i];
+        HashNode *new_node = hinit(strdup(cmd->args[i]), STRING, strdup(cmd->args[i + 1]));
+        if (new_node == NULL)
+        {
+            fprintf(stderr, "Error creating new node for hashtable\n");
+            exit(EXIT_FAILURE);
+        }
 
-        while (traverseList != NULL)
+        if (hinsert(global_table, new_node) == NULL)
         {
-            // write the key to the buffer
-            int type = SER_STR;
-            int key_len = strlen(traverseList->key);
+            hfree(new_node);
 
-            // check if the buffer has enough space to write the key
-            if (inc_buffer + 5 + key_len > MAX_MESSAGE_SIZE)
+            // remove the keys this command already set, so a failed MSET leaves the database untouched
+            for (int j = i - 2; j >= 0; j -= 2)
             {
-                fprintf(stderr, "Failed to reallocate memory for hgetall response\n");
-                exit(EXIT_FAILURE);
+                hfree(hremove(global_table, cmd->args[j]));
             }
 
-            // write the type and length of the response, 1 byte
-            memcpy(buffer + inc_buffer, &type, 1);
-            memcpy(buffer + inc_buffer + 1, &key_len, 4);
+            add_reply_error(conn, "Failed to insert new node into global table");
+            return false;
+        }
+    }
+
+    add_reply_nil(conn);
 
-            // write the key
-            memcpy(buffer + inc_buffer + 5, traverseList->key, key_len);
+    return true;
+}
 
-            inc_buffer += 5 + key_len;
-            num_elem++;
+/**
+ * @brief Checks if a value of the global table is a hash, in either encoding
+ *
+ * @param node node of the global table
+ *
+ * @return bool true if the value is a hash
+ */
+static bool is_hash(HashNode *node)
+{
+    return node->valueType == HASHTABLE || node->valueType == HASHPACK;
+}
 
-            // write the value to the buffer
-            type = SER_STR;
-            int value_len = strlen(traverseList->value);
+/**
+ * @brief Converts a hash packed into a listpack to a hash table, the node of the hash points to the table afterwards.
+ *
+ * @param hash_node node of the global table holding the hash
+ *
+ * @return HashTable* the hash table
+ */
+static HashTable *hash_convert(HashNode *hash_node)
+{
+    Listpack *lp = (Listpack *)hash_node->value;
+    HashTable *table = hcreate(HASH_MIN_SIZE);
 
-            // check if the buffer has enough space to write the value
-            if (inc_buffer + 5 + value_len > MAX_MESSAGE_SIZE)
-            {
-                fprintf(stderr, "Failed to reallocate memory for hgetall response\n");
-                exit(EXIT_FAILURE);
-            }
+    for (int offset = lp_first(lp); offset >= 0; offset = lp_next(lp, lp_next(lp, offset)))
+    {
+        int field_len;
+        int value_len;
+        char *field = lp_get(lp, offset, &field_len);
+        char *value = lp_get(lp, lp_next(lp, offset), &value_len);
+
+        hinsert(table, hinit(strndup(field, field_len), STRING, strndup(value, value_len)));
+    }
 
-            // write the type and length of the response, 1 byte
-            memcpy(buffer + inc_buffer, &type, 1);
-            memcpy(buffer + inc_buffer + 1, &value_len, 4);
+    lp_free(lp);
+    hash_node->value = table;
+    hash_node->valueType = HASHTABLE;
 
-            // write the value
-            memcpy(buffer + inc_buffer + 5, traverseList->value, value_len);
+    return table;
+}
 
-            inc_buffer += 5 + value_len;
-            num_elem++;
+/**
+ * @brief Finds the offset of the value of a field of a hash packed into a listpack
+ *
+ * @param lp listpack of field and value pairs
+ * @param field_key field to find
+ *
+ * @return int offset of the value, -1 if the field does not exist
+ */
+static int hashpack_find(Listpack *lp, char *field_key)
+{
+    int offset = lp_find(lp, lp_first(lp), field_key, strlen(field_key), 1);
+    return offset < 0 ? -1 : lp_next(lp, offset);
+}
 
-            traverseList = traverseList->next;
+/**
+ * @brief Appends a reply for the value of a field of a hash, nil if the field does not exist
+ *
+ * @param conn Connection to reply to
+ * @param hash_node node of the global table holding the hash
+ * @param field_key field to reply with
+ */
+static void add_reply_hash_field(Conn *conn, HashNode *hash_node, char *field_key)
+{
+    if (hash_node->valueType == HASHPACK)
+    {
+        Listpack *lp = (Listpack *)hash_node->value;
+        int offset = hashpack_find(lp, field_key);
+        if (offset < 0)
+        {
+            add_reply_nil(conn);
+            return;
         }
+
+        int value_len;
+        char *value = lp_get(lp, offset, &value_len);
+        add_reply_bulk(conn, SER_STR, value, value_len);
+        return;
     }
 
-    // write the type and length of array to buffer
-    int type = SER_ARR;
-    memcpy(buffer, &type, 1);
-    memcpy(buffer + 1, &num_elem, 4);
+    HashNode *ret_node = hget((HashTable *)hash_node->value, field_key);
+    if (!ret_node)
+    {
+        add_reply_nil(conn);
+        return;
+    }
 
-    return buffer;
+    add_reply_value(conn, ret_node->valueType, ret_node->value);
 }
 
 /**
- *  LEXISTS (key, value) - Checks if a value exists in a list. Returns an integer response indicating the number of values found.
+ * The HEXISTS (key, field) command checks if a field exists in a hash . Returns an integer response indicating the number of fields found.
  *
- * @param cmd Command structure specifying the (key, value)
- * @return char* response
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, field)
  *
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *lexists_command(Command *cmd)
+bool hexists_command(Conn *conn, Command *cmd)
 {
-    ValueType response_type = INTEGER;
     int elem_exists = 0;
 
-    if (cmd->num_args < 2)
-    {
-        return error_response("lexists command requires at least 2 arguments (key, value)");
-    }
-
     char *global_table_key = cmd->args[0];
-    char *value = cmd->args[1];
+    char *field_key = cmd->args[1];
 
-    // fetch the list from the global table
+    // fetch the hashtable from the global table
     HashNode *fetched_node = hget(global_table, global_table_key);
+
     if (!fetched_node)
     {
         fprintf(stderr, "key not in database\n");
-        return get_response(response_type, &elem_exists);
+        add_reply_int(conn, 0);
+        return true;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    // check if the value is a hashtable
+    if (!is_hash(fetched_node))
     {
-        fprintf(stderr, "key is not for a list\n");
-        return get_response(response_type, &elem_exists);
+        fprintf(stderr, "key is not for a hashtable\n");
+        add_reply_int(conn, 0);
+        return true;
     }
 
-    List *list = (List *)fetched_node->value;
-
-    // check if the value exists in the list
-    int ret = list_contains(list, value, LIST_TYPE_STRING);
-    if (ret)
+    // check if the field exists in the hashtable
+    if (fetched_node->valueType == HASHPACK)
     {
-        elem_exists = 1;
+        elem_exists = hashpack_find((Listpack *)fetched_node->value, field_key) >= 0;
     }
     else
     {
-        elem_exists = 0;
+        elem_exists = hget((HashTable *)fetched_node->value, field_key) != NULL;
     }
 
-    return get_response(response_type, &elem_exists);
+    add_reply_int(conn, elem_exists);
+
+    return true;
 }
 
 /**
- * @brief Executes an LPUSH command and optionally logs the action to the AOF file.
+ * @brief Fetches the hash stored at a key of the global table, an empty hash packed into a listpack is created if the key does not exist.
  *
- * The LPUSH command adds a value to the head of a list. If the key does not exist, a new list is created. Returns an integer response indicating the number of elements added.
+ * @param conn Connection the error reply is written to
+ * @param global_table_key key of the hash
  *
- * @param cmd Command structure specifying (key, value)
- * @param aof_restore Flag indicating whether to log the LPUSH operation to the AOF file.
- *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return HashNode* the node of the global table holding the hash, NULL if an error reply was written
  */
-char *lpush_command(Command *cmd, bool aof_restore)
+static HashNode *hash_fetch_or_create(Conn *conn, char *global_table_key)
 {
-    ValueType response_type = INTEGER;
-    int elem_added = 0;
-
-    if (cmd->num_args < 2)
-    {
-        return error_response("lpush command requires at least 2 arguments (key, value)");
-    }
-
-    char *global_table_key = cmd->args[0];
-    char *value = cmd->args[1];
-
-    // fetch the list from the global table
     HashNode *fetched_node = hget(global_table, global_table_key);
     if (!fetched_node)
     {
-        // create a new list
-        List *new_list = list_init();
-
-        // create a new hash node
-        HashNode *new_node = hinit(strdup(global_table_key), LIST, new_list);
+        // insert a new empty hash into the global table
+        HashNode *new_node = hinit(strdup(global_table_key), HASHPACK, lp_new());
 
         HashNode *ret = hinsert(global_table, new_node);
         if (!ret)
         {
-            return error_response("Failed to insert new list into global table");
+            add_reply_error(conn, "Failed to insert new hash table into global table");
+            return NULL;
         }
 
-        fetched_node = new_node;
+        return new_node;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    // check if the value is a hashtable
+    if (!is_hash(fetched_node))
     {
-        return error_response("key is not for a list");
+        add_reply_shared(conn, &shared.not_hashtable);
+        return NULL;
     }
 
-    List *list = (List *)fetched_node->value;
+    return fetched_node;
+}
 
-    // add the value to the list
-    int ret = list_linsert(list, value, LIST_TYPE_STRING);
-    if (ret)
+/**
+ * @brief Sets a field of a hash, the old value of the field is replaced. A packed hash is converted to a hash table when the field would take it past the thresholds.
+ *
+ * @param conn Connection the error reply is written to
+ * @param hash_node node of the global table holding the hash
+ * @param field_key field to set
+ * @param value value of the field
+ *
+ * @return bool true if the field was set, false if an error reply was written
+ */
+static bool hash_set_field(Conn *conn, HashNode *hash_node, char *field_key, char *value)
+{
+    if (hash_node->valueType == HASHPACK)
+    {
+        Listpack *lp = (Listpack *)hash_node->value;
+        int field_len = strlen(field_key);
+        int value_len = strlen(value);
+        int offset = hashpack_find(lp, field_key);
+
+        if (offset >= 0 && value_len <= hash_max_listpack_value)
+        {
+            hash_node->value = lp_replace(lp, offset, value, value_len);
+            return true;
+        }
+
+        if (offset < 0 && field_len <= hash_max_listpack_value && value_len <= hash_max_listpack_value && (int)lp->count / 2 < hash_max_listpack_entries)
+        {
+            lp = lp_append(lp, field_key, field_len);
+            hash_node->value = lp_append(lp, value, value_len);
+            return true;
+        }
+
+        hash_convert(hash_node);
+    }
+
+    HashTable *cur_table = (HashTable *)hash_node->value;
+
+    // add the value to the hashtable
+    HashNode *new_node = hinit(strdup(field_key), STRING, strdup(value));
+    if (!new_node)
     {
-        return error_response("Failed to add value to list");
+        add_reply_error(conn, "Failed to create new node for hashtable");
+        return false;
     }
-    elem_added++;
 
-    if (!aof_restore)
+    // if it already exists, remove the old value
+    HashNode *old_node = hremove(cur_table, field_key);
+    if (old_node)
     {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_added);
+        hfree(old_node);
     }
-    else
+
+    HashNode *ret = hinsert(cur_table, new_node);
+    if (!ret)
     {
-        return NULL;
+        add_reply_error(conn, "Failed to insert new node into hashtable");
+        return false;
     }
+
+    return true;
 }
 
 /**
- * @brief Executes an RPUSH command and optionally logs the action to the AOF file.
+ * @brief Executes an HSET command.
  *
- * The RPUSH command adds a value to the tail of a list. If the key does not exist, a new list is created. Returns an integer response indicating the number of elements added.
+ * The HSET (key, field, value) command sets the value of a key in a hash table. If the key does not exist, a new hash table is created. Returns a response which containts the number of elements added/updated.
  *
- * @param cmd Command structure specifying the (key,value)
- * @param aof_restore Flag indicating whether to log the RPUSH operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, field, value)
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *rpush_command(Command *cmd, bool aof_restore)
+bool hset_command(Conn *conn, Command *cmd)
 {
-    ValueType response_type = INTEGER;
     int elem_added = 0;
 
-    if (cmd->num_args < 2)
-    {
-        return error_response("rpush command requires at least 2 arguments (key, value)");
-    }
-
-    char *global_table_key = cmd->args[0];
-    char *value = cmd->args[1];
-
-    // fetch the list from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
-    if (!fetched_node)
+    HashNode *hash_node = hash_fetch_or_create(conn, cmd->args[0]);
+    if (!hash_node)
     {
-        // create a new list
-        List *new_list = list_init();
-
-        // create a new hash node
-        HashNode *new_node = hinit(strdup(global_table_key), LIST, new_list);
-
-        HashNode *ret = hinsert(global_table, new_node);
-        if (!ret)
-        {
-            return error_response("Failed to insert new list into global table");
-        }
-
-        fetched_node = new_node;
+        return false;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    if (!hash_set_field(conn, hash_node, cmd->args[1], cmd->args[2]))
     {
-        return error_response("key is not for a list");
+        return false;
     }
 
-    List *list = (List *)fetched_node->value;
-
-    // add the value to the list
-    int ret = list_rinsert(list, value, LIST_TYPE_STRING);
-    if (ret)
-    {
-        return error_response("Failed to add value to list");
-    }
     elem_added++;
 
-    return get_response(response_type, &elem_added);
+    add_reply_int(conn, elem_added);
+
+    return true;
 }
 
 /**
- * @brief Executes an LPOP command and optionally logs the action to the AOF file.
+ * @brief Executes an HMSET command.
  *
- * The LPOP command removes a value from the head of a list. Returns the value removed.
+ * The HMSET (key, field, value, [field, value, ...]) command sets several fields of a hash table at once. If the key does not exist, a new hash table is created. Returns an integer response which contains the number of fields added/updated.
  *
- * @param cmd Command structure specifying the (key)
- * @param aof_restore Flag indicating whether to log the LPOP operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, field, value, ...)
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *lpop_command(Command *cmd, bool aof_restore)
+bool hmset_command(Conn *conn, Command *cmd)
 {
-    ValueType response_type = STRING;
+    int elem_added = 0;
 
-    if (cmd->num_args < 1)
+    if ((cmd->num_args - 1) % 2 != 0)
     {
-        return error_response("lpop command requires at least 1 argument (key)");
+        add_reply_error(conn, "hmset command requires a value for every field (key, field, value, ...)");
+        return false;
     }
 
-    char *global_table_key = cmd->args[0];
-
-    // fetch the list from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
-    if (!fetched_node)
+    HashNode *hash_node = hash_fetch_or_create(conn, cmd->args[0]);
+    if (!hash_node)
     {
-        return error_response("key not in database");
+        return false;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    for (int i = 1; i < cmd->num_args; i += 2)
     {
-        return error_response("key is not for a list");
+        if (!hash_set_field(conn, hash_node, cmd->args[i], cmd->args[i + 1]))
+        {
+            return false;
+        }
+
+        elem_added++;
     }
 
-    List *list = (List *)fetched_node->value;
+    add_reply_int(conn, elem_added);
 
-    // remove the value from the list
-    ListNode *removedNode = list_lremove(list);
-    if (!removedNode)
+    return true;
+}
+
+/**
+ * @brief Executes an HGET command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * Gets the value of field from the hash specified by key. Returns the value. If the key, or field don't exist in database, return nil
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, field)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool hget_command(Conn *conn, Command *cmd)
+{
+    char *global_table_key = cmd->args[0];
+    char *field_key = cmd->args[1];
+
+    // fetch the hashtable from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (!fetched_node)
     {
-        return error_response("Failed to remove value from list");
+        add_reply_nil(conn);
+        return true;
     }
 
-    // ensure that only strings are stored in the list, if not, error occcued somehwere in db, serious error
-    if (removedNode->listType != LIST_TYPE_STRING)
+    // check if the value is a hashtable
+    if (!is_hash(fetched_node))
     {
-        fprintf(stderr, "Value in list is somehow not a string\n");
-        exit(EXIT_FAILURE);
+        add_reply_shared(conn, &shared.not_hashtable);
+        return false;
     }
 
-    char *response;
+    add_reply_hash_field(conn, fetched_node, field_key);
 
-    if (!aof_restore)
+    return true;
+}
+
+/**
+ * @brief Executes an HMGET command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * Gets the values of several fields from the hash specified by key. Returns an array with one element per field, the value of the field or nil if the field does not exist. If the key does not exist every element is nil.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, field, [field, ...])
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool hmget_command(Conn *conn, Command *cmd)
+{
+    char *global_table_key = cmd->args[0];
+    int num_fields = cmd->num_args - 1;
+
+    // fetch the hashtable from the global table
+    HashTable *cur_table = NULL;
+
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (fetched_node)
     {
-        handle_aof_write(cmd);
+        // check if the value is a hashtable
+        if (!is_hash(fetched_node))
+        {
+            add_reply_shared(conn, &shared.not_hashtable);
+            return false;
+        }
+
+        // the fields of a packed hash are all in one buffer, there is nothing to batch
+        if (fetched_node->valueType == HASHPACK)
+        {
+            add_reply_array_len(conn, num_fields);
+            for (int i = 1; i <= num_fields; i++)
+            {
+                add_reply_hash_field(conn, fetched_node, cmd->args[i]);
+            }
 
-        // strdup the value to avoid double free
-        char *value = strdup(removedNode->data);
+            return true;
+        }
 
-        // produce the response
-        response = del_response(response_type, value);
+        cur_table = (HashTable *)fetched_node->value;
     }
-    else
+
+    HashNode *ret_nodes[HGET_BATCH] = {0};
+
+    add_reply_array_len(conn, num_fields);
+    for (int start = 1; start <= num_fields; start += HGET_BATCH)
     {
-        response = NULL;
+        // look the fields up a batch at a time so their cache misses overlap
+        int count = num_fields + 1 - start < HGET_BATCH ? num_fields + 1 - start : HGET_BATCH;
+        if (cur_table)
+        {
+            hget_many(cur_table, cmd->args + start, count, ret_nodes);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (!ret_nodes[i])
+            {
+                add_reply_nil(conn);
+                continue;
+            }
+
+            add_reply_value(conn, ret_nodes[i]->valueType, ret_nodes[i]->value);
+        }
     }
 
-    // free the removed node
-    list_free_node(removedNode);
-    return response;
+    return true;
 }
 
 /**
- * @brief Executes an RPOP command and optionally logs the action to the AOF file.
+ * @brief Executes an HDEL command.
  *
- * The RPOP command removes a value from the tail of a list. Returns the value removed.
+ * The HDEL command removes a field from a hash table. Returns an integer response indicating the number of elements removed.
  *
- * @param cmd Command structure specifying the (key)
- * @param aof_restore Flag indicating whether to log the RPOP operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, field)
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *rpop_command(Command *cmd, bool aof_restore)
+bool hdel_command(Conn *conn, Command *cmd)
 {
-
-    ValueType response_type = STRING;
-
-    if (cmd->num_args < 1)
-    {
-        return error_response("rpop command requires at least 1 argument (key)");
-    }
+    int elem_removed = 0;
 
     char *global_table_key = cmd->args[0];
+    char *field_key = cmd->args[1];
 
-    // fetch the list from the global table
+    // fetch the hashtable from the global table
     HashNode *fetched_node = hget(global_table, global_table_key);
     if (!fetched_node)
     {
-        return error_response("key not in database");
+        add_reply_shared(conn, &shared.no_key);
+        return false;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    // check if the value is a hashtable
+    if (!is_hash(fetched_node))
     {
-        return error_response("key is not for a list");
+        add_reply_shared(conn, &shared.not_hashtable);
+        return false;
     }
 
-    List *list = (List *)fetched_node->value;
+    if (fetched_node->valueType == HASHPACK)
+    {
+        // remove the field and the value after it
+        Listpack *lp = (Listpack *)fetched_node->value;
+        int offset = hashpack_find(lp, field_key);
+        if (offset < 0)
+        {
+            add_reply_error(conn, "Failed to remove value from hashtable");
+            return false;
+        }
 
-    // remove the value from the list
-    ListNode *removedNode = list_rremove(list);
-    if (!removedNode)
+        fetched_node->value = lp_delete(lp, lp_prev(lp, offset), 2);
+    }
+    else
     {
-        return error_response("Failed to remove value from list");
+        // remove the value from the hashtable
+        HashNode *removed_node = hremove((HashTable *)fetched_node->value, field_key);
+        if (!removed_node)
+        {
+            add_reply_error(conn, "Failed to remove value from hashtable");
+            return false;
+        }
+
+        // free the removed node
+        hfree(removed_node);
     }
 
-    // ensure that only strings are stored in the list, if not, error occcued somehwere in db, serious error
-    if (removedNode->listType != LIST_TYPE_STRING)
+    elem_removed++;
+
+    add_reply_int(conn, elem_removed);
+
+    return true;
+}
+
+/**
+ * @brief Executes an HGETALL command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * The HGETALL command retrieves all fields and values in a hash table. Returns an error response if the key does not exist.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying (key)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool hgetall_command(Conn *conn, Command *cmd)
+{
+    char *global_table_key = cmd->args[0];
+
+    // fetch the hashtable from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (!fetched_node)
     {
-        fprintf(stderr, "Value in list is somehow not a string\n");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "key not in database\n");
+        add_reply_array_len(conn, 0);
+        return true;
     }
 
-    char *response;
-
-    if (!aof_restore)
+    // check if the value is a hashtable
+    if (!is_hash(fetched_node))
     {
-        handle_aof_write(cmd);
+        fprintf(stderr, "key is not for a hashtable");
+        add_reply_array_len(conn, 0);
+        return true;
+    }
 
-        // strdup the value to avoid double free
-        char *value = strdup(removedNode->data);
+    if (fetched_node->valueType == HASHPACK)
+    {
+        // the fields and values already alternate in the listpack
+        Listpack *lp = (Listpack *)fetched_node->value;
+        add_reply_array_len(conn, lp->count);
+        for (int offset = lp_first(lp); offset >= 0; offset = lp_next(lp, offset))
+        {
+            int len;
+            char *str = lp_get(lp, offset, &len);
+            add_reply_bulk(conn, SER_STR, str, len);
+        }
 
-        // produce the response
-        response = del_response(response_type, value);
+        return true;
     }
-    else
+
+    HashTable *cur_table = (HashTable *)fetched_node->value;
+
+    // every field is followed by its value
+    add_reply_array_len(conn, cur_table->size * 2);
+
+    // iterate through the hash table and write the fields and values to the output queue
+    HashIter iter;
+    hiter_init(cur_table, &iter);
+
+    HashNode *node;
+    while ((node = hiter_next(&iter)) != NULL)
     {
-        // dont want to waste computation time on creating a response on AOF restore
-        response = NULL;
+        add_reply_str(conn, node->key);
+        add_reply_str(conn, node->value);
     }
 
-    // free the removed node
-    list_free_node(removedNode);
-    return response;
+    return true;
 }
 
 /**
- * @brief Executes an LREM command and optionally logs the action to the AOF file.
+ * @brief Parses an integer argument
  *
- * LREM: (key, count, value) - Removes the first count occurrences of elements equal to value from the list specified by key. Returns an integer response indicating the number of elements removed. If count is 0, all occurrences are removed. If count is negative, elements are removed starting from the tail of the list.
+ * @param str The argument
+ * @param value Set to the integer
  *
- * @param cmd Command structure specifying the (key, count, value)
- * @param aof_restore Flag indicating whether to log the LREM operation to the AOF file.
+ * @return bool true if the argument is an integer
  */
-char *lrem_command(Command *cmd, bool aof_restore)
+static bool parse_int(char *str, int *value)
 {
     errno = 0;
 
-    ValueType response_type = INTEGER;
-    int elem_removed = 0;
-
-    if (cmd->num_args < 3)
-    {
-        return error_response("lrem command requires at least 3 arguments (key, count, value)");
-    }
-
-    char *global_table_key = cmd->args[0];
-    char *count_str = cmd->args[1];
-    char *value = cmd->args[2];
-
-    int count;
-
-    // convert the count to an integer
-    // use strtol and duck typing to determine the type of the value
     char *endptr;
-    count = (int)strtol(count_str, &endptr, 10);
+    long parsed = strtol(str, &endptr, 10);
+    *value = (int)parsed;
 
-    // check errors
-    if (errno)
-    {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
-    }
+    return errno == 0 && endptr != str && *endptr == '\0' && parsed == *value;
+}
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || (endptr == count_str))
-    {
-        return error_response("Failed to convert count to integer");
-    }
+/**
+ *  LEXISTS (key, value) - Checks if a value exists in a list. Returns an integer response indicating the number of values found.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, value)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lexists_command(Conn *conn, Command *cmd)
+{
+    int elem_exists = 0;
+
+    char *global_table_key = cmd->args[0];
+    char *value = cmd->args[1];
 
     // fetch the list from the global table
     HashNode *fetched_node = hget(global_table, global_table_key);
     if (!fetched_node)
     {
-        return error_response("key not in database");
+        fprintf(stderr, "key not in database\n");
+        add_reply_int(conn, elem_exists);
+        return true;
     }
 
     // check if the value is a list
     if (fetched_node->valueType != LIST)
     {
-        return error_response("key is not for a list");
+        fprintf(stderr, "key is not for a list\n");
+        add_reply_int(conn, elem_exists);
+        return true;
     }
 
     List *list = (List *)fetched_node->value;
 
-    // remove the value from the list (All values in list are strings)
-    if (count < 0)
+    // check if the value exists in the list
+    int ret = list_contains(list, value, LIST_TYPE_STRING);
+    if (ret)
     {
-        // if count is negative, remove from the tail, flip the sign to count is positive again
-        count = -count;
-        elem_removed = list_removeFromTail(list, value, LIST_TYPE_STRING, count);
+        elem_exists = 1;
     }
     else
     {
-        elem_removed = list_removeFromHead(list, value, LIST_TYPE_STRING, count);
+        elem_exists = 0;
     }
 
-    if (!aof_restore)
-    {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_removed);
-    }
-    else
-    {
-        return NULL;
-    }
+    add_reply_int(conn, elem_exists);
+
+    return true;
 }
 
 /**
- * @brief Executes an LLEN command and returns the corresponding response string according to the liteDB protocol.
- *
- * The LLEN command returns the length of a list. Returns an integer response indicating the number of elements in the list.
+ * @brief Fetches the list stored at a key of the global table, an empty list is created if the key does not exist.
  *
- * @param cmd Command structure specifying the (key)
+ * @param conn Connection the error reply is written to
+ * @param global_table_key key of the list
  *
- * @return char* response
+ * @return HashNode* the node of the global table holding the list, NULL if an error reply was written
  */
-char *llen_cmd(Command *cmd)
+static HashNode *list_fetch_or_create(Conn *conn, char *global_table_key)
 {
-    ValueType response_type = INTEGER;
-    int len = 0;
-
-    if (cmd->num_args < 1)
-    {
-        return error_response("llen command requires at least 1 argument (key)");
-    }
-
-    char *global_table_key = cmd->args[0];
-
-    // fetch the list from the global table
     HashNode *fetched_node = hget(global_table, global_table_key);
     if (!fetched_node)
     {
-        fprintf(stderr, "key not in database");
-        return get_response(response_type, &len);
+        // insert a new empty list into the global table
+        HashNode *new_node = hinit(strdup(global_table_key), LIST, list_init());
+
+        HashNode *ret = hinsert(global_table, new_node);
+        if (!ret)
+        {
+            add_reply_error(conn, "Failed to insert new list into global table");
+            return NULL;
+        }
+
+        return new_node;
     }
 
     // check if the value is a list
     if (fetched_node->valueType != LIST)
     {
-        fprintf(stderr, "key is not for a list");
-        return get_response(response_type, &len);
+        add_reply_shared(conn, &shared.not_list);
+        return NULL;
     }
 
-    List *list = (List *)fetched_node->value;
-
-    // get the length of the list
-    len = list->size;
-
-    return get_response(response_type, &len);
+    return fetched_node;
 }
 
 /**
- * @brief Executes an LRANGE command and returns the corresponding response string according to the liteDB protocol.
+ * @brief Executes an LPUSH or an RPUSH command, the values are added one after the other, so LPUSH leaves the last one at the head of the list.
  *
- * The LRANGE command retrieves a range of elements from a list. Returns an array response containing the elements in the specified range.
- *
- * @param cmd Command structure specifying the (key, start, stop)
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, value, ...)
+ * @param head true to add the values to the head of the list, false to the tail
  *
- * @return char* response
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *lrange_cmd(Command *cmd)
+static bool push_generic(Conn *conn, Command *cmd, bool head)
 {
-    errno = 0;
-
-    if (cmd->num_args < 3)
+    HashNode *fetched_node = list_fetch_or_create(conn, cmd->args[0]);
+    if (!fetched_node)
     {
-        return error_response("lrange command requires at least 3 arguments (key, start, stop)");
+        return false;
     }
 
-    char *global_table_key = cmd->args[0];
-    char *start_str = cmd->args[1];
-    char *stop_str = cmd->args[2];
-
-    int start;
-    int stop;
-
-    // convert the start to an integer
-    // use strtol and duck typing to determine the type of the value
-    char *endptr;
-    start = (int)strtol(start_str, &endptr, 10);
+    List *list = (List *)fetched_node->value;
 
-    // check errors
-    if (errno)
+    // add the values to the list
+    int elem_added = 0;
+    for (int i = 1; i < cmd->num_args; i++)
     {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
+        int ret = head ? list_linsert(list, cmd->args[i], LIST_TYPE_STRING) : list_rinsert(list, cmd->args[i], LIST_TYPE_STRING);
+        if (ret)
+        {
+            add_reply_error(conn, "Failed to add value to list");
+            return false;
+        }
+        elem_added++;
     }
 
-    // Check if successfully converted to an integer
+    // the connections blocked on the list are served once the command has been executed
+    signal_list_ready(cmd->args[0]);
+
+    add_reply_int(conn, elem_added);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LPUSH command.
+ *
+ * The LPUSH command adds values to the head of a list, one after the other. If the key does not exist, a new list is created. Returns an integer response indicating the number of elements added.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying (key, value, ...)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lpush_command(Conn *conn, Command *cmd)
+{
+    return push_generic(conn, cmd, true);
+}
+
+/**
+ * @brief Executes an RPUSH command.
+ *
+ * The RPUSH command adds values to the tail of a list, one after the other. If the key does not exist, a new list is created. Returns an integer response indicating the number of elements added.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, value, ...)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool rpush_command(Conn *conn, Command *cmd)
+{
+    return push_generic(conn, cmd, false);
+}
+
+/**
+ * @brief Executes an LPOP command.
+ *
+ * The LPOP command removes a value from the head of a list. Returns the value removed.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lpop_command(Conn *conn, Command *cmd)
+{
+    char *global_table_key = cmd->args[0];
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (!fetched_node)
+    {
+        add_reply_shared(conn, &shared.no_key);
+        return false;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // remove the value from the list
+    ListNode *removedNode = list_lremove(list);
+    if (!removedNode)
+    {
+        add_reply_error(conn, "Failed to remove value from list");
+        return false;
+    }
+
+    // ensure that only strings are stored in the list, if not, error occcued somehwere in db, serious error
+    if (removedNode->listType != LIST_TYPE_STRING)
+    {
+        fprintf(stderr, "Value in list is somehow not a string\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the value is copied into the output queue, so the node can be freed right after
+    add_reply_str(conn, removedNode->data);
+
+    // free the removed node
+    list_free_node(removedNode);
+
+    return true;
+}
+
+/**
+ * @brief Executes an RPOP command.
+ *
+ * The RPOP command removes a value from the tail of a list. Returns the value removed.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool rpop_command(Conn *conn, Command *cmd)
+{
+    char *global_table_key = cmd->args[0];
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (!fetched_node)
+    {
+        add_reply_shared(conn, &shared.no_key);
+        return false;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // remove the value from the list
+    ListNode *removedNode = list_rremove(list);
+    if (!removedNode)
+    {
+        add_reply_error(conn, "Failed to remove value from list");
+        return false;
+    }
+
+    // ensure that only strings are stored in the list, if not, error occcued somehwere in db, serious error
+    if (removedNode->listType != LIST_TYPE_STRING)
+    {
+        fprintf(stderr, "Value in list is somehow not a string\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the value is copied into the output queue, so the node can be freed right after
+    add_reply_str(conn, removedNode->data);
+
+    // free the removed node
+    list_free_node(removedNode);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LREM command.
+ *
+ * LREM: (key, count, value) - Removes the first count occurrences of elements equal to value from the list specified by key. Returns an integer response indicating the number of elements removed. If count is 0, all occurrences are removed. If count is negative, elements are removed starting from the tail of the list.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, count, value)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lrem_command(Conn *conn, Command *cmd)
+{
+    errno = 0;
+
+    int elem_removed = 0;
+
+    char *global_table_key = cmd->args[0];
+    char *count_str = cmd->args[1];
+    char *value = cmd->args[2];
+
+    int count;
+
+    // convert the count to an integer
+    // use strtol and duck typing to determine the type of the value
+    char *endptr;
+    count = (int)strtol(count_str, &endptr, 10);
+
+    // check errors
+    if (errno)
+    {
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || (endptr == count_str))
+    {
+        add_reply_error(conn, "Failed to convert count to integer");
+        return false;
+    }
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (!fetched_node)
+    {
+        add_reply_shared(conn, &shared.no_key);
+        return false;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // remove the value from the list (All values in list are strings)
+    if (count < 0)
+    {
+        // if count is negative, remove from the tail, flip the sign to count is positive again
+        count = -count;
+        elem_removed = list_removeFromTail(list, value, LIST_TYPE_STRING, count);
+    }
+    else
+    {
+        elem_removed = list_removeFromHead(list, value, LIST_TYPE_STRING, count);
+    }
+
+    add_reply_int(conn, elem_removed);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LLEN command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * The LLEN command returns the length of a list. Returns an integer response indicating the number of elements in the list.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool llen_cmd(Conn *conn, Command *cmd)
+{
+    int len = 0;
+
+    char *global_table_key = cmd->args[0];
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+    if (!fetched_node)
+    {
+        fprintf(stderr, "key not in database");
+        add_reply_int(conn, len);
+        return true;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        fprintf(stderr, "key is not for a list");
+        add_reply_int(conn, len);
+        return true;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // get the length of the list
+    len = list->size;
+
+    add_reply_int(conn, len);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LRANGE command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * The LRANGE command retrieves a range of elements from a list. Returns an array response containing the elements in the specified range.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, start, stop)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lrange_cmd(Conn *conn, Command *cmd)
+{
+    errno = 0;
+
+    char *global_table_key = cmd->args[0];
+    char *start_str = cmd->args[1];
+    char *stop_str = cmd->args[2];
+
+    int start;
+    int stop;
+
+    // convert the start to an integer
+    // use strtol and duck typing to determine the type of the value
+    char *endptr;
+    start = (int)strtol(start_str, &endptr, 10);
+
+    // check errors
+    if (errno)
+    {
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Check if successfully converted to an integer
     if (!(*endptr == '\0') || (endptr == start_str))
     {
         fprintf(stderr, "Failed to convert start to integer");
-        return error_response("Failed to convert start to integer");
+        add_reply_error(conn, "Failed to convert start to integer");
+        return false;
     }
 
     // convert the stop to an integer
@@ -1521,333 +2102,1600 @@ char *lrange_cmd(Command *cmd)
         exit(EXIT_FAILURE);
     }
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || (endptr == stop_str))
-    {
-        return error_response("Failed to convert stop to integer");
-    }
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || (endptr == stop_str))
+    {
+        add_reply_error(conn, "Failed to convert stop to integer");
+        return false;
+    }
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+
+    if (!fetched_node)
+    {
+        fprintf(stderr, "key not in database");
+        add_reply_array_len(conn, 0);
+        return true;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        fprintf(stderr, "key is not for a list");
+        add_reply_array_len(conn, 0);
+        return true;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // check bounds
+    if (start < 0)
+    {
+        start = list->size + start;
+    }
+
+    if (stop < 0)
+    {
+        stop = list->size + stop;
+    }
+
+    if (stop < 0 || start < 0 || start >= list->size || start > stop)
+    {
+        add_reply_array_len(conn, 0);
+        return true;
+    }
+
+    if (stop >= list->size)
+    {
+        stop = list->size - 1;
+    }
+
+    // get the values from the list
+    int elems_to_fetch = stop - start + 1;
+    int num_elements = 0;
+
+    // iterate through the list and write the values to the buffer, start and stop are inclusive. The values are read one after the other from the blocks of the list.
+    ListIter iter;
+    ListNode current;
+    list_iter_init(list, &iter, start);
+
+    add_reply_array_len(conn, elems_to_fetch);
+
+    while (num_elements < elems_to_fetch && list_iter_next(&iter, &current))
+    {
+        // write the value to the output queue
+        add_reply_bulk(conn, SER_STR, current.data, current.len);
+
+        num_elements++;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Executes an LTRIM command.
+ *
+ * The LTRIM command trims a list to the specified range. Returns a null response if the operation is successful.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, start, stop)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool ltrim_cmd(Conn *conn, Command *cmd)
+{
+    errno = 0;
+
+    char *global_table_key = cmd->args[0];
+    char *start_str = cmd->args[1];
+    char *stop_str = cmd->args[2];
+
+    int start;
+    int stop;
+
+    // convert the start to an integer
+    // use strtol and duck typing to determine the type of the value
+    char *endptr;
+    start = (int)strtol(start_str, &endptr, 10);
+
+    // check errors
+    if (errno)
+    {
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || (endptr == start_str))
+    {
+        add_reply_error(conn, "Failed to convert start to integer");
+        return false;
+    }
+
+    // convert the stop to an integer
+    stop = (int)strtol(stop_str, &endptr, 10);
+
+    // check errors
+    if (errno)
+    {
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || (endptr == stop_str))
+    {
+        add_reply_error(conn, "Failed to convert stop to integer");
+        return false;
+    }
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+
+    if (!fetched_node)
+    {
+        add_reply_shared(conn, &shared.no_key);
+        return false;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // check bounds
+    if (start < 0)
+    {
+        start = list->size + start;
+    }
+
+    if (stop < 0)
+    {
+        stop = list->size + stop;
+    }
+
+    if (stop < 0 || start < 0 || start >= list->size || start > stop)
+    {
+        add_reply_array_len(conn, 0);
+        return true;
+    }
+
+    if (stop >= list->size)
+    {
+        stop = list->size - 1;
+    }
+
+    // trim the list
+    int ret = list_trim(list, start, stop);
+    if (ret)
+    {
+        add_reply_error(conn, "Failed to trim list");
+        return false;
+    }
+
+    add_reply_nil(conn);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LSET command.
+ *
+ * The LSET command sets the value of an element in a list, negative indexes count from the end of the list. Returns an integer response indicating the number of elements updated.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, index, value)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lset_cmd(Conn *conn, Command *cmd)
+{
+    errno = 0;
+
+    int elem_updated = 0;
+
+    char *global_table_key = cmd->args[0];
+    char *index_str = cmd->args[1];
+    char *value = cmd->args[2];
+
+    int index;
+
+    // convert the index to an integer
+    // use strtol and duck typing to determine the type of the value
+    char *endptr;
+    index = (int)strtol(index_str, &endptr, 10);
+
+    // check errors
+    if (errno)
+    {
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || (endptr == index_str))
+    {
+        add_reply_error(conn, "Failed to convert index to integer");
+        return false;
+    }
+
+    // fetch the list from the global table
+    HashNode *fetched_node = hget(global_table, global_table_key);
+
+    if (!fetched_node)
+    {
+        add_reply_shared(conn, &shared.no_key);
+        return false;
+    }
+
+    // check if the value is a list
+    if (fetched_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    List *list = (List *)fetched_node->value;
+
+    // negative indexes count from the end of the list
+    if (index < 0)
+    {
+        index += list->size;
+    }
+
+    // check bounds
+    if (index < 0 || index >= list->size)
+    {
+        add_reply_error(conn, "index out of bounds");
+        return false;
+    }
+
+    // set the value in the list
+    int ret = list_imodify(list, index, value, LIST_TYPE_STRING);
+    if (ret)
+    {
+        add_reply_error(conn, "Failed to set value in list");
+        return false;
+    }
+
+    elem_updated++;
+
+    add_reply_int(conn, elem_updated);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LINDEX command.
+ *
+ * LINDEX: (key, index) - Returns the element at index of the list specified by key, negative indexes count from the end of the list, -1 being the last element. Returns nil if the index is out of range or the key is not a list.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, index)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lindex_cmd(Conn *conn, Command *cmd)
+{
+    int index;
+    if (!parse_int(cmd->args[1], &index))
+    {
+        add_reply_error(conn, "Failed to convert index to integer");
+        return false;
+    }
+
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != LIST)
+    {
+        add_reply_nil(conn);
+        return true;
+    }
+
+    List *list = (List *)fetched_node->value;
+    if (index < 0)
+    {
+        index += list->size;
+    }
+
+    ListNode node;
+    if (index < 0 || index >= list->size || list_iget(list, index, &node) != 0)
+    {
+        add_reply_nil(conn);
+        return true;
+    }
+
+    add_reply_bulk(conn, SER_STR, node.data, node.len);
+
+    return true;
+}
+
+/**
+ * @brief Executes an LINSERT command.
+ *
+ * LINSERT: (key, BEFORE | AFTER, pivot, value) - Inserts value before or after the first element equal to pivot of the list specified by key. Returns the length of the list after the insert, -1 if pivot is not in the list, and 0 if the key does not exist.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, BEFORE | AFTER, pivot, value)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool linsert_command(Conn *conn, Command *cmd)
+{
+    bool after = strcasecmp(cmd->args[1], "AFTER") == 0;
+    if (!after && strcasecmp(cmd->args[1], "BEFORE") != 0)
+    {
+        add_reply_error(conn, "syntax error, expected BEFORE or AFTER");
+        return false;
+    }
+
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node)
+    {
+        add_reply_int(conn, 0);
+        return true;
+    }
+
+    if (fetched_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    List *list = (List *)fetched_node->value;
+    if (list_pinsert(list, cmd->args[2], cmd->args[3], LIST_TYPE_STRING, after) != 0)
+    {
+        add_reply_int(conn, -1);
+        return true;
+    }
+
+    add_reply_int(conn, list->size);
+
+    return true;
+}
+
+/**
+ * @brief Moves the element at one end of a list to one end of another list and replies with it. The destination is created if it does not exist, and can be the source itself.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param source_key key of the list to remove from
+ * @param destination_key key of the list to insert into
+ * @param from_head true to remove from the head of the source, false from its tail
+ * @param to_head true to insert at the head of the destination, false at its tail
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+static bool lmove_generic(Conn *conn, char *source_key, char *destination_key, bool from_head, bool to_head)
+{
+    HashNode *source_node = hget(global_table, source_key);
+    if (source_node && source_node->valueType != LIST)
+    {
+        add_reply_shared(conn, &shared.not_list);
+        return false;
+    }
+
+    // nothing to move, the destination is not created
+    if (!source_node || ((List *)source_node->value)->size == 0)
+    {
+        add_reply_nil(conn);
+        return true;
+    }
+
+    HashNode *destination_node = list_fetch_or_create(conn, destination_key);
+    if (!destination_node)
+    {
+        return false;
+    }
+
+    List *destination = (List *)destination_node->value;
+    list_move((List *)source_node->value, destination, from_head, to_head);
+    signal_list_ready(destination_key);
+
+    // reply with the element where it was moved to
+    ListNode node;
+    list_iget(destination, to_head ? 0 : destination->size - 1, &node);
+    add_reply_bulk(conn, SER_STR, node.data, node.len);
+
+    return true;
+}
+
+/**
+ * @brief Parses the LEFT or RIGHT argument of an LMOVE command
+ *
+ * @param str The argument
+ * @param head Set to true for LEFT, the head of the list, and false for RIGHT
+ *
+ * @return bool true if the argument is LEFT or RIGHT
+ */
+static bool parse_list_end(char *str, bool *head)
+{
+    *head = strcasecmp(str, "LEFT") == 0;
+    return *head || strcasecmp(str, "RIGHT") == 0;
+}
+
+/**
+ * @brief Executes an LMOVE command.
+ *
+ * LMOVE: (source, destination, LEFT | RIGHT, LEFT | RIGHT) - Removes the element at the head (LEFT) or the tail (RIGHT) of the list specified by source and adds it to the head or the tail of the list specified by destination, in one step. destination is created if it does not exist and can be the same list as source. Returns the element moved, nil if source does not exist or is empty.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (source, destination, LEFT | RIGHT, LEFT | RIGHT)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool lmove_command(Conn *conn, Command *cmd)
+{
+    bool from_head, to_head;
+    if (!parse_list_end(cmd->args[2], &from_head) || !parse_list_end(cmd->args[3], &to_head))
+    {
+        add_reply_error(conn, "syntax error, expected LEFT or RIGHT");
+        return false;
+    }
+
+    return lmove_generic(conn, cmd->args[0], cmd->args[1], from_head, to_head);
+}
+
+/**
+ * @brief Executes an RPOPLPUSH command.
+ *
+ * RPOPLPUSH: (source, destination) - Same as LMOVE source destination RIGHT LEFT.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (source, destination)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool rpoplpush_command(Conn *conn, Command *cmd)
+{
+    return lmove_generic(conn, cmd->args[0], cmd->args[1], false, true);
+}
+
+// keys whose list had elements added by the command being executed while connections are blocked on them, served once the command has been executed
+static char **ready_keys = NULL;
+static int num_ready_keys = 0;
+static int ready_keys_capacity = 0;
+
+// the blocked connections that wait with a timeout, a binary heap ordered by their deadline
+static BlockState **timers = NULL;
+static int num_timers = 0;
+static int timers_capacity = 0;
+
+// the connections that were served or timed out, in the order they were unblocked
+static Conn **unblocked_conns = NULL;
+static int num_unblocked_conns = 0;
+static int unblocked_conns_capacity = 0;
+
+/**
+ * @brief Makes room for one more element in an array, doubling its capacity once it is full
+ *
+ * @param array the array, NULL while it is empty
+ * @param count number of elements in the array
+ * @param capacity pointer to the capacity of the array, updated if it grows
+ * @param size size of an element
+ *
+ * @return void* the array, reallocated if it grew
+ */
+static void *array_reserve(void *array, int count, int *capacity, size_t size)
+{
+    if (count < *capacity)
+    {
+        return array;
+    }
+
+    *capacity = *capacity ? *capacity * 2 : 16;
+    array = realloc(array, *capacity * size);
+    if (array == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return array;
+}
+
+// milliseconds since an arbitrary point, the clock of the deadlines of the blocked connections
+static long long now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// swaps two entries of the timer heap
+static void timer_swap(int i, int j)
+{
+    BlockState *state = timers[i];
+    timers[i] = timers[j];
+    timers[j] = state;
+
+    timers[i]->timer_index = i;
+    timers[j]->timer_index = j;
+}
+
+/**
+ * @brief Moves an entry of the timer heap up or down until the heap is ordered again
+ *
+ * @param index position of the entry
+ */
+static void timer_fix(int index)
+{
+    while (index > 0 && timers[(index - 1) / 2]->deadline > timers[index]->deadline)
+    {
+        timer_swap(index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    while (true)
+    {
+        int first = index;
+        for (int child = 2 * index + 1; child <= 2 * index + 2 && child < num_timers; child++)
+        {
+            if (timers[child]->deadline < timers[first]->deadline)
+            {
+                first = child;
+            }
+        }
+
+        if (first == index)
+        {
+            return;
+        }
+
+        timer_swap(index, first);
+        index = first;
+    }
+}
+
+/**
+ * @brief Removes a connection from the timer heap, the last entry takes its place
+ *
+ * @param state what the connection is blocked on
+ */
+static void timer_remove(BlockState *state)
+{
+    int index = state->timer_index;
+
+    num_timers--;
+    if (index != num_timers)
+    {
+        timers[index] = timers[num_timers];
+        timers[index]->timer_index = index;
+        timer_fix(index);
+    }
+
+    state->timer_index = -1;
+}
+
+/**
+ * @brief Blocks a connection until an element is added to the list of one of the keys, or the timeout expires
+ *
+ * The connection is added at the end of the queue of every key, and to the timer heap if it has a timeout. It does not execute its next requests until it is unblocked, and update_conn_events() stops reading it.
+ *
+ * @param conn Connection to block
+ * @param keys the keys to wait on
+ * @param num_keys number of keys
+ * @param head true to pop from the head of the list, false from its tail
+ * @param timeout seconds to wait, 0 to wait forever
+ */
+static void block_conn(Conn *conn, char **keys, int num_keys, bool head, double timeout)
+{
+    if (!blocking_keys)
+    {
+        blocking_keys = hcreate(HASH_MIN_SIZE);
+    }
+
+    BlockState *state = malloc(sizeof(BlockState) + num_keys * sizeof(Waiter));
+    if (!state)
+    {
+        fprintf(stderr, "Failed to allocate memory for blocked connection\n");
+        exit(EXIT_FAILURE);
+    }
+
+    state->conn = conn;
+    state->head = head;
+    state->deadline = 0;
+    state->timer_index = -1;
+    state->num_keys = num_keys;
+
+    for (int i = 0; i < num_keys; i++)
+    {
+        HashNode *queue_node = hget(blocking_keys, keys[i]);
+        if (!queue_node)
+        {
+            WaitQueue *new_queue = calloc(1, sizeof(WaitQueue));
+            if (!new_queue)
+            {
+                fprintf(stderr, "Failed to allocate memory for wait queue\n");
+                exit(EXIT_FAILURE);
+            }
+
+            queue_node = hinsert(blocking_keys, hinit(strdup(keys[i]), WAIT_QUEUE, new_queue));
+            if (!queue_node)
+            {
+                fprintf(stderr, "Failed to insert wait queue\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // append the connection to the queue of the key
+        WaitQueue *queue = (WaitQueue *)queue_node->value;
+        Waiter *waiter = &state->waiters[i];
+
+        waiter->conn = conn;
+        waiter->queue_node = queue_node;
+        waiter->prev = queue->tail;
+        waiter->next = NULL;
+
+        if (queue->tail)
+        {
+            queue->tail->next = waiter;
+        }
+        else
+        {
+            queue->head = waiter;
+        }
+        queue->tail = waiter;
+    }
+
+    if (timeout > 0)
+    {
+        state->deadline = now_ms() + (long long)(timeout * 1000);
+
+        timers = array_reserve(timers, num_timers, &timers_capacity, sizeof(BlockState *));
+        state->timer_index = num_timers;
+        timers[num_timers++] = state;
+        timer_fix(state->timer_index);
+    }
+
+    conn->blocked = state;
+    conn->state = STATE_BLOCKED;
+}
+
+/**
+ * @brief Removes a blocked connection from the queues of its keys and from the timer heap, the queues left empty are freed
+ *
+ * @param conn Connection to unblock, its state is left to the caller
+ */
+static void unblock_conn(Conn *conn)
+{
+    BlockState *state = conn->blocked;
+
+    for (int i = 0; i < state->num_keys; i++)
+    {
+        Waiter *waiter = &state->waiters[i];
+        WaitQueue *queue = (WaitQueue *)waiter->queue_node->value;
+
+        if (waiter->prev)
+        {
+            waiter->prev->next = waiter->next;
+        }
+        else
+        {
+            queue->head = waiter->next;
+        }
+
+        if (waiter->next)
+        {
+            waiter->next->prev = waiter->prev;
+        }
+        else
+        {
+            queue->tail = waiter->prev;
+        }
+
+        if (!queue->head)
+        {
+            hfree(hremove(blocking_keys, waiter->queue_node->key));
+        }
+    }
+
+    if (state->timer_index >= 0)
+    {
+        timer_remove(state);
+    }
+
+    free(state);
+    conn->blocked = NULL;
+}
+
+/**
+ * @brief Unblocks a connection that was served or timed out, process_unblocked_conns() resumes it
+ *
+ * @param conn Connection to resume
+ */
+static void resume_conn(Conn *conn)
+{
+    unblock_conn(conn);
+    conn->state = STATE_REQ;
+
+    unblocked_conns = array_reserve(unblocked_conns, num_unblocked_conns, &unblocked_conns_capacity, sizeof(Conn *));
+    unblocked_conns[num_unblocked_conns++] = conn;
+    conn->unblocked = true;
+}
+
+/**
+ * @brief Drops what the blocking pops keep of a connection that is being closed
+ *
+ * @param conn Connection being closed
+ */
+void release_blocked_conn(Conn *conn)
+{
+    if (conn->blocked)
+    {
+        unblock_conn(conn);
+    }
+
+    if (conn->unblocked)
+    {
+        for (int i = 0; i < num_unblocked_conns; i++)
+        {
+            if (unblocked_conns[i] == conn)
+            {
+                memmove(unblocked_conns + i, unblocked_conns + i + 1, (num_unblocked_conns - i - 1) * sizeof(Conn *));
+                num_unblocked_conns--;
+                break;
+            }
+        }
+
+        conn->unblocked = false;
+    }
+}
+
+/**
+ * @brief Marks the list of a key as having new elements, the connections blocked on the key are served by serve_blocked_conns() once the command has been executed
+ *
+ * Called by the commands that add elements to a list, the key is only looked up while connections are blocked.
+ *
+ * @param key key of the list
+ */
+void signal_list_ready(char *key)
+{
+    if (!blocking_keys || !blocking_keys->size)
+    {
+        return;
+    }
+
+    HashNode *queue_node = hget(blocking_keys, key);
+    if (!queue_node || ((WaitQueue *)queue_node->value)->ready)
+    {
+        return;
+    }
+
+    ((WaitQueue *)queue_node->value)->ready = true;
+
+    ready_keys = array_reserve(ready_keys, num_ready_keys, &ready_keys_capacity, sizeof(char *));
+    ready_keys[num_ready_keys++] = strdup(key);
+}
+
+/**
+ * @brief Pops an element of a list for a blocking pop, and replies with the key and the element
+ *
+ * @param conn Connection the reply is written to
+ * @param key key of the list
+ * @param list the list, not empty
+ * @param head true to pop from the head of the list, false from its tail
+ */
+static void add_reply_blocking_pop(Conn *conn, char *key, List *list, bool head)
+{
+    ListNode *removed_node = head ? list_lremove(list) : list_rremove(list);
+
+    add_reply_array_len(conn, 2);
+    add_reply_bulk(conn, SER_STR, key, strlen(key));
+    add_reply_bulk(conn, SER_STR, removed_node->data, removed_node->len);
+
+    list_free_node(removed_node);
+}
+
+/**
+ * @brief Hands the elements added to the ready keys to the connections blocked on them, the oldest first
+ *
+ * Every element handed over is logged to the AOF as an LPOP or an RPOP, after the command that added it. The served connections are unblocked and resumed by process_unblocked_conns().
+ *
+ * @param aof_restore true if the command that added the elements is replayed from the AOF file, nothing is logged then
+ */
+void serve_blocked_conns(bool aof_restore)
+{
+    for (int i = 0; i < num_ready_keys; i++)
+    {
+        char *key = ready_keys[i];
+
+        HashNode *list_node = hget(global_table, key);
+        HashNode *queue_node = hget(blocking_keys, key);
+
+        // serving a connection frees the queue once nobody else waits on the key
+        while (queue_node && list_node && list_node->valueType == LIST && ((List *)list_node->value)->size > 0)
+        {
+            Conn *waiter = ((WaitQueue *)queue_node->value)->head->conn;
+            bool head = waiter->blocked->head;
+
+            add_reply_blocking_pop(waiter, key, (List *)list_node->value, head);
+
+            if (!aof_restore)
+            {
+                Command pop;
+                pop.name = head ? "LPOP" : "RPOP";
+                pop.args = pop.inline_args;
+                pop.arg_lens = pop.inline_arg_lens;
+                pop.args[0] = key;
+                pop.arg_lens[0] = strlen(key);
+                pop.num_args = 1;
+
+                handle_aof_write(&pop);
+            }
+
+            resume_conn(waiter);
+            queue_node = hget(blocking_keys, key);
+        }
+
+        if (queue_node)
+        {
+            ((WaitQueue *)queue_node->value)->ready = false;
+        }
+
+        free(key);
+    }
+
+    num_ready_keys = 0;
+}
+
+/**
+ * @brief Returns how long the event loop can wait for events before the first blocked connection times out
+ *
+ * @param timeout milliseconds the event loop waits for otherwise
+ *
+ * @return int the smaller of timeout and the milliseconds left before the first deadline
+ */
+int blocked_conns_timeout(int timeout)
+{
+    if (num_timers == 0)
+    {
+        return timeout;
+    }
+
+    long long left = timers[0]->deadline - now_ms();
+    if (left < 0)
+    {
+        left = 0;
+    }
+
+    return left < timeout ? (int)left : timeout;
+}
+
+/**
+ * @brief Replies nil to the blocked connections whose deadline has passed, and unblocks them
+ */
+void expire_blocked_conns()
+{
+    if (num_timers == 0)
+    {
+        return;
+    }
+
+    long long now = now_ms();
+    while (num_timers > 0 && timers[0]->deadline <= now)
+    {
+        Conn *conn = timers[0]->conn;
+
+        add_reply_nil(conn);
+        resume_conn(conn);
+    }
+}
+
+/**
+ * @brief Resumes the connections that were served or timed out
+ *
+ * Their replies are written and the requests they sent while they were blocked are executed, nothing else would pick those up since a blocked connection is not read. A connection unblocked by one of them is resumed in the same call.
+ */
+void process_unblocked_conns()
+{
+    for (int i = 0; i < num_unblocked_conns; i++)
+    {
+        Conn *conn = unblocked_conns[i];
+        conn->unblocked = false;
+
+        connection_io(conn);
+
+        if (conn->state != STATE_DONE)
+        {
+            update_conn_events(conn);
+        }
+
+        if (conn->state == STATE_DONE)
+        {
+            close_connection(fd2conn, conn);
+        }
+    }
+
+    num_unblocked_conns = 0;
+}
+
+/**
+ * @brief Parses the timeout of a blocking pop
+ *
+ * @param str The timeout in seconds, a decimal number
+ * @param timeout Set to the timeout
+ *
+ * @return bool true if the timeout is a number from 0 to BLOCK_TIMEOUT_MAX
+ */
+static bool parse_timeout(char *str, double *timeout)
+{
+    char *endptr;
+    *timeout = strtod(str, &endptr);
+
+    return endptr != str && *endptr == '\0' && *timeout >= 0 && *timeout <= BLOCK_TIMEOUT_MAX;
+}
+
+/**
+ * @brief Executes a BLPOP or a BRPOP command, pops from the first key holding a non empty list, or blocks the connection on all the keys
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, ..., timeout), rewritten to the LPOP or RPOP that was done so that is what the AOF logs
+ * @param head true to pop from the head of the lists, false from their tail
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+static bool blocking_pop_generic(Conn *conn, Command *cmd, bool head)
+{
+    int num_keys = cmd->num_args - 1;
+
+    double timeout;
+    if (!parse_timeout(cmd->args[num_keys], &timeout))
+    {
+        add_reply_error(conn, "timeout is not a valid number of seconds");
+        return false;
+    }
+
+    for (int i = 0; i < num_keys; i++)
+    {
+        HashNode *fetched_node = hget(global_table, cmd->args[i]);
+        if (!fetched_node)
+        {
+            continue;
+        }
+
+        if (fetched_node->valueType != LIST)
+        {
+            add_reply_shared(conn, &shared.not_list);
+            return false;
+        }
+
+        List *list = (List *)fetched_node->value;
+        if (list->size == 0)
+        {
+            continue;
+        }
+
+        add_reply_blocking_pop(conn, cmd->args[i], list, head);
+
+        cmd->name = head ? "LPOP" : "RPOP";
+        cmd->args[0] = cmd->args[i];
+        cmd->arg_lens[0] = cmd->arg_lens[i];
+        cmd->num_args = 1;
+
+        return true;
+    }
+
+    // without a connection there is nobody to wait for
+    if (!conn)
+    {
+        return true;
+    }
+
+    block_conn(conn, cmd->args, num_keys, head, timeout);
+
+    return true;
+}
+
+/**
+ * @brief Executes a BLPOP command.
+ *
+ * BLPOP: (key, ..., timeout) - Removes the first element of the first list specified by the keys that is not empty, and returns an array of the key and the element. If every list is empty or does not exist, the connection waits until an element is pushed to one of them, the connections waiting on a key are handed the pushed elements in the order they started waiting. Returns nil if timeout seconds pass first, a timeout of 0 waits forever. A waiting connection executes none of its next requests.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, ..., timeout)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool blpop_command(Conn *conn, Command *cmd)
+{
+    return blocking_pop_generic(conn, cmd, true);
+}
+
+/**
+ * @brief Executes a BRPOP command.
+ *
+ * BRPOP: (key, ..., timeout) - Same as BLPOP, removes the last element of the list.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, ..., timeout)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool brpop_command(Conn *conn, Command *cmd)
+{
+    return blocking_pop_generic(conn, cmd, false);
+}
+
+/**
+ * @brief Executes a ZADD command.
+ *
+ * The ZADD (key, score, name, [score, name, ...]) command adds values to a sorted set. If the key does not exist, a new sorted set is created. If a field already exists, it is updated instead. Returns an integer response indicating the number of elements added/updated. Nothing is added if any score is not a float.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, score, name, [score, name, ...])
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zadd_command(Conn *conn, Command *cmd)
+{
+    char *zset_key = cmd->args[0];
+
+    if (cmd->num_args % 2 != 1)
+    {
+        add_reply_error(conn, "Every score needs a name");
+        return false;
+    }
+
+    int num_pairs = (cmd->num_args - 1) / 2;
+    float *values = malloc(num_pairs * sizeof(float));
+    char **names = malloc(num_pairs * sizeof(char *));
+    if (values == NULL || names == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < num_pairs; i++)
+    {
+        char *score_str = cmd->args[1 + 2 * i];
+        names[i] = cmd->args[2 + 2 * i];
+
+        // convert the score to a float
+        char *endptr;
+        errno = 0;
+        values[i] = strtof(score_str, &endptr);
+
+        // a score out of the range of a float, or NaN, which has no place in the order of the set, is not a float either
+        if (errno == ERANGE || !(*endptr == '\0') || (endptr == score_str) || isnan(values[i]))
+        {
+            free(values);
+            free(names);
+            add_reply_error(conn, "Failed to convert score to float");
+            return false;
+        }
+    }
+
+    // fetch the zset from global table
+    HashNode *fetched_node = hget(global_table, zset_key);
+
+    if (!fetched_node)
+    {
+        // create a new zset,
+        ZSet *zset = zset_init();
+        if (!zset)
+        {
+            fprintf(stderr, "Failed to create ZSet\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // create a new hash node
+        HashNode *new_node = hinit(strdup(zset_key), ZSET, zset);
+        if (!new_node)
+        {
+            fprintf(stderr, "Failed to create new hash node\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // insert the new node into the global table
+        HashNode *ret = hinsert(global_table, new_node);
+        if (!ret)
+        {
+            fprintf(stderr, "Failed to insert new node into global table\n");
+            exit(EXIT_FAILURE);
+        }
+
+        fetched_node = new_node;
+    }
+
+    // check if the value is a ZSET
+    if (fetched_node->valueType != ZSET)
+    {
+        free(values);
+        free(names);
+        add_reply_shared(conn, &shared.not_zset);
+        return false;
+    }
+
+    ZSet *zset = (ZSet *)fetched_node->value;
+
+    // add the values to the ZSET, a new zset given many values at once is built from the sorted values instead of one insert per value
+    int ret = num_pairs == 1 ? zset_add(zset, names[0], values[0]) : zset_add_many(zset, names, values, num_pairs);
+    free(values);
+    free(names);
+
+    if (ret < 0)
+    {
+        add_reply_error(conn, "Failed to add value to ZSET");
+        return false;
+    }
+
+    add_reply_int(conn, num_pairs);
+
+    return true;
+}
+
+/**
+ * @brief Executes a ZREM command.
+ *
+ * ZREM: (key, name) - Removes the element from the sorted set with the specified name. The sorted set is specified by key. Returns the number of elements removed.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, name)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zrem_command(Conn *conn, Command *cmd)
+{
+    errno = 0;
+
+    int elem_removed = 0;
+
+    char *zset_key = cmd->args[0];
+    char *element_key = cmd->args[1];
+
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, zset_key);
+    if (!fetched_node)
+    {
+        add_reply_error(conn, "zset key not in database");
+        return false;
+    }
+
+    // check if the value is a ZSET
+    if (fetched_node->valueType != ZSET)
+    {
+        add_reply_shared(conn, &shared.not_zset);
+        return false;
+    }
+
+    ZSet *zset = (ZSet *)fetched_node->value;
+
+    // remove the value from the ZSET
+    int ret = zset_remove(zset, element_key);
+    if (ret < 0)
+    {
+        add_reply_error(conn, "Failed to remove value from zset");
+        return false;
+    }
+
+    elem_removed++;
+
+    add_reply_int(conn, elem_removed);
+
+    return true;
+}
+
+/**
+ * @brief Executes a ZSCORE command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * ZSCORE: (key, name) - Returns the score of the element with the specified name from the sorted set specified by key. Returns a float . Returns a null response if the element does not exist.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the  (key, name)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zscore_cmd(Conn *conn, Command *cmd)
+{
+    errno = 0;
+
+    float score;
 
-    // fetch the list from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
+    char *zset_key = cmd->args[0];
+    char *element_key = cmd->args[1];
 
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, zset_key);
     if (!fetched_node)
     {
-        fprintf(stderr, "key not in database");
-        return empty_array_response();
+        fprintf(stderr, "key not in database\n");
+        add_reply_nil(conn);
+        return true;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    // check if the value is a ZSET
+    if (fetched_node->valueType != ZSET)
     {
-        fprintf(stderr, "key is not for a list");
-        return empty_array_response();
+        fprintf(stderr, "key is not for a zset\n");
+        add_reply_nil(conn);
+        return true;
     }
 
-    List *list = (List *)fetched_node->value;
+    ZSet *zset = (ZSet *)fetched_node->value;
 
-    // check bounds
-    if (start < 0)
+    // search for the value in the ZSET
+    float *ret_score = zset_score(zset, element_key);
+    if (!ret_score)
     {
-        start = list->size + start;
+        fprintf(stderr, "Element not in zset\n");
+        add_reply_nil(conn);
+        return true;
     }
 
-    if (stop < 0)
-    {
-        stop = list->size + stop;
-    }
+    score = *ret_score;
 
-    if (stop < 0 || start < 0 || start >= list->size || start > stop)
-    {
-        return empty_array_response();
-    }
+    add_reply_float(conn, score);
 
-    if (stop >= list->size)
-    {
-        stop = list->size - 1;
-    }
+    return true;
+}
 
-    // get the values from the list
-    int elems_to_fetch = stop - start + 1;
-    int num_elements = 0;
-    int inc_buffer = 5;
+/**
+ * @brief Executes a ZMSCORE command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * ZMSCORE: (key, name, [name, ...]) - Returns an array with the score of every named element of the sorted set specified by key, nil for an element that does not exist. Like ZSCORE every element is nil if the key does not hold a sorted set.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, name, [name, ...])
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zmscore_cmd(Conn *conn, Command *cmd)
+{
+    int num_elements = cmd->num_args - 1;
 
-    // buffer for the data
-    char *buffer = calloc(1 + 4 + MAX_MESSAGE_SIZE, sizeof(char));
+    // fetch the zset from the global table
+    ZSet *zset = NULL;
 
-    // iterate through the list and write the values to the buffer, start and stop are inclusive
-    ListNode *current = list_iget(list, start);
-    if (!current)
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (fetched_node && fetched_node->valueType == ZSET)
     {
-        fprintf(stderr, "Failed to get start value from list");
-        return empty_array_response();
+        zset = (ZSet *)fetched_node->value;
     }
 
-    while (num_elements < elems_to_fetch)
-    {
-        // write the value to the buffer
-        int type = SER_STR;
-        int data_len = strlen(current->data);
+    float *ret_scores[HGET_BATCH] = {0};
 
-        // check if the buffer has enough space to write the value
-        if (inc_buffer + 5 + data_len > MAX_MESSAGE_SIZE)
+    add_reply_array_len(conn, num_elements);
+    for (int start = 1; start <= num_elements; start += HGET_BATCH)
+    {
+        // look the elements up a batch at a time so the cache misses of a zset with a hash table overlap
+        int count = num_elements + 1 - start < HGET_BATCH ? num_elements + 1 - start : HGET_BATCH;
+        if (zset)
         {
-            fprintf(stderr, "Failed to reallocate memory for lrange response\n");
-            exit(EXIT_FAILURE);
+            zset_score_many(zset, cmd->args + start, count, ret_scores);
         }
 
-        // write the type and length of the response, 1 byte
-        memcpy(buffer + inc_buffer, &type, 1);
-        memcpy(buffer + inc_buffer + 1, &data_len, 4);
-
-        // write the value
-        memcpy(buffer + inc_buffer + 5, current->data, data_len);
+        for (int i = 0; i < count; i++)
+        {
+            if (!ret_scores[i])
+            {
+                add_reply_nil(conn);
+                continue;
+            }
 
-        inc_buffer += 5 + data_len;
-        num_elements++;
-        current = current->next;
+            add_reply_float(conn, *ret_scores[i]);
+        }
     }
 
-    // write the type and length of array to buffer
-    int type = SER_ARR;
-    memcpy(buffer, &type, 1);
-    memcpy(buffer + 1, &num_elements, 4);
-
-    return buffer;
+    return true;
 }
 
 /**
- * @brief Executes an LTRIM command and optionally logs the action to the AOF file.
+ * @brief Executes a ZCARD command and writes the corresponding reply according to the liteDB protocol.
  *
- * The LTRIM command trims a list to the specified range. Returns a null response if the operation is successful.
+ * ZCARD: (key) - Returns the number of elements of the sorted set specified by key, 0 if the key does not hold a sorted set.
  *
- * @param cmd Command structure specifying the (key, start, stop)
- * @param aof_restore Flag indicating whether to log the LTRIM operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key)
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *ltrim_cmd(Command *cmd, bool aof_restore)
+bool zcard_cmd(Conn *conn, Command *cmd)
 {
-    errno = 0;
-
-    if (cmd->num_args < 3)
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
     {
-        return error_response("ltrim command requires at least 3 arguments (key, start, stop)");
+        add_reply_int(conn, 0);
+        return true;
     }
 
-    char *global_table_key = cmd->args[0];
-    char *start_str = cmd->args[1];
-    char *stop_str = cmd->args[2];
-
-    int start;
-    int stop;
+    add_reply_int(conn, zset_length((ZSet *)fetched_node->value));
 
-    // convert the start to an integer
-    // use strtol and duck typing to determine the type of the value
-    char *endptr;
-    start = (int)strtol(start_str, &endptr, 10);
+    return true;
+}
 
-    // check errors
-    if (errno)
+/**
+ * @brief Executes a ZRANK or a ZREVRANK command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, name)
+ * @param reverse true to rank the elements from the highest score
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+static bool zrank_generic(Conn *conn, Command *cmd, bool reverse)
+{
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
     {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
+        add_reply_nil(conn);
+        return true;
     }
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || (endptr == start_str))
+    ZSet *zset = (ZSet *)fetched_node->value;
+
+    int rank = zset_rank(zset, cmd->args[1]);
+    if (rank < 0)
     {
-        return error_response("Failed to convert start to integer");
+        add_reply_nil(conn);
+        return true;
     }
 
-    // convert the stop to an integer
-    stop = (int)strtol(stop_str, &endptr, 10);
+    add_reply_int(conn, reverse ? zset_length(zset) - 1 - rank : rank);
 
-    // check errors
-    if (errno)
-    {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
-    }
+    return true;
+}
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || (endptr == stop_str))
-    {
-        return error_response("Failed to convert stop to integer");
-    }
+/**
+ * @brief Executes a ZRANK command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * ZRANK: (key, name) - Returns the rank of the element with the specified name in the sorted set specified by key, elements are ranked from 0 by score and by name for equal scores. Returns a null response if the element does not exist.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, name)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zrank_cmd(Conn *conn, Command *cmd)
+{
+    return zrank_generic(conn, cmd, false);
+}
 
-    // fetch the list from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
+/**
+ * @brief Executes a ZREVRANK command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * ZREVRANK: (key, name) - Like ZRANK, with the element with the highest score ranked 0.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, name)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zrevrank_cmd(Conn *conn, Command *cmd)
+{
+    return zrank_generic(conn, cmd, true);
+}
 
-    if (!fetched_node)
+/**
+ * @brief Parses a score bound of a range, a float that is excluded from the range when it is prefixed with '('. -inf and +inf are accepted.
+ *
+ * @param str The bound
+ * @param value Set to the score of the bound
+ * @param exclusive Set to true if the score is excluded from the range
+ *
+ * @return bool true if the bound is valid
+ */
+static bool parse_score_bound(char *str, float *value, bool *exclusive)
+{
+    *exclusive = str[0] == '(';
+    if (*exclusive)
     {
-        return error_response("key not in database");
+        str++;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
-    {
-        return error_response("key is not for a list");
-    }
+    char *endptr;
+    *value = strtof(str, &endptr);
 
-    List *list = (List *)fetched_node->value;
+    return endptr != str && *endptr == '\0' && !isnan(*value);
+}
 
-    // check bounds
-    if (start < 0)
+/**
+ * @brief Executes a ZCOUNT command and writes the corresponding reply according to the liteDB protocol.
+ *
+ * ZCOUNT: (key, min, max) - Returns the number of elements of the sorted set specified by key with a score between min and max, both included unless they are prefixed with '('. The count is the difference of two ranks, no element is visited.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, min, max)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
+ */
+bool zcount_cmd(Conn *conn, Command *cmd)
+{
+    float min, max;
+    bool min_exclusive, max_exclusive;
+    if (!parse_score_bound(cmd->args[1], &min, &min_exclusive) || !parse_score_bound(cmd->args[2], &max, &max_exclusive))
     {
-        start = list->size + start;
+        add_reply_error(conn, "min or max is not a float");
+        return false;
     }
 
-    if (stop < 0)
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
     {
-        stop = list->size + stop;
+        add_reply_int(conn, 0);
+        return true;
     }
 
-    if (stop < 0 || start < 0 || start >= list->size || start > stop)
-    {
-        return empty_array_response();
-    }
+    ZSet *zset = (ZSet *)fetched_node->value;
 
-    if (stop >= list->size)
-    {
-        stop = list->size - 1;
-    }
+    // the elements up to max, minus the elements below min
+    int count = zset_count_lower(zset, max, !max_exclusive) - zset_count_lower(zset, min, min_exclusive);
 
-    // trim the list
-    int ret = list_trim(list, start, stop);
-    if (ret)
-    {
-        return error_response("Failed to trim list");
-    }
+    add_reply_int(conn, count > 0 ? count : 0);
 
-    if (!aof_restore)
-    {
-        handle_aof_write(cmd);
-        return null_response();
-    }
-    else
-    {
-        return NULL;
-    }
+    return true;
 }
 
 /**
- * @brief Executes an LSET command and optionally logs the action to the AOF file.
+ * @brief Resolves a range of ranks of a sorted set, negative ranks count from the end, -1 being the last element. The range is clamped to the elements of the sorted set.
  *
- * The LSET command sets the value of an element in a list. Returns an integer response indicating the number of elements updated.
+ * @param length The number of elements of the sorted set
+ * @param start The first rank of the range, set to the resolved rank
+ * @param stop The last rank of the range, included, set to the resolved rank
  *
- * @param cmd Command structure specifying the (key, index, value)
- * @param aof_restore Flag indicating whether to log the LSET operation to the AOF file.
- *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
+ * @return bool false if the range is empty
  */
-char *lset_cmd(Command *cmd, bool aof_restore)
+static bool zset_resolve_range(int length, int *start, int *stop)
 {
-    errno = 0;
-
-    ValueType response_type = INTEGER;
-    int elem_updated = 0;
-
-    if (cmd->num_args < 3)
+    if (*start < 0)
     {
-        return error_response("lset command requires at least 3 arguments (key, index, value)");
+        *start += length;
     }
 
-    char *global_table_key = cmd->args[0];
-    char *index_str = cmd->args[1];
-    char *value = cmd->args[2];
-
-    int index;
-
-    // convert the index to an integer
-    // use strtol and duck typing to determine the type of the value
-    char *endptr;
-    index = (int)strtol(index_str, &endptr, 10);
+    if (*stop < 0)
+    {
+        *stop += length;
+    }
 
-    // check errors
-    if (errno)
+    if (*start < 0)
     {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
+        *start = 0;
     }
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || (endptr == index_str))
+    if (*stop >= length)
     {
-        return error_response("Failed to convert index to integer");
+        *stop = length - 1;
     }
 
-    // fetch the list from the global table
-    HashNode *fetched_node = hget(global_table, global_table_key);
+    return *start <= *stop;
+}
 
-    if (!fetched_node)
+// chains of skiplist nodes removed by range deletions, freed a few at a time between events instead of before the reply of the deletion
+static SkipListNode **lazy_free_chains = NULL;
+static int num_lazy_free_chains = 0;
+static int lazy_free_capacity = 0;
+
+/**
+ * @brief Queues skiplist nodes removed from a sorted set to be freed by lazy_free_step()
+ *
+ * @param nodes The first node, linked to the others as skiplist_delete_range_by_rank() leaves them, NULL does nothing
+ */
+void lazy_free_nodes(SkipListNode *nodes)
+{
+    if (nodes == NULL)
     {
-        return error_response("key not in database");
+        return;
     }
 
-    // check if the value is a list
-    if (fetched_node->valueType != LIST)
+    if (num_lazy_free_chains == lazy_free_capacity)
     {
-        return error_response("key is not for a list");
+        lazy_free_capacity = lazy_free_capacity ? lazy_free_capacity * 2 : 16;
+        lazy_free_chains = realloc(lazy_free_chains, lazy_free_capacity * sizeof(SkipListNode *));
+        if (lazy_free_chains == NULL)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    List *list = (List *)fetched_node->value;
+    lazy_free_chains[num_lazy_free_chains++] = nodes;
+}
 
-    // check bounds
-    if (index < 0 || index >= list->size)
+/**
+ * @brief Frees some of the nodes queued by lazy_free_nodes()
+ *
+ * @param count The maximum number of nodes to free, -1 to free every node
+ *
+ * @return bool true if nodes are still queued
+ */
+bool lazy_free_step(int count)
+{
+    while (num_lazy_free_chains > 0 && count != 0)
     {
-        return error_response("index out of bounds");
-    }
+        SkipListNode **chain = &lazy_free_chains[num_lazy_free_chains - 1];
+        int freed = skiplist_free_nodes(chain, count);
+        if (count > 0)
+        {
+            count -= freed;
+        }
 
-    // set the value in the list
-    int ret = list_imodify(list, index, value, LIST_TYPE_STRING);
-    if (ret)
-    {
-        return error_response("Failed to set value in list");
+        if (*chain == NULL)
+        {
+            num_lazy_free_chains--;
+        }
     }
 
-    elem_updated++;
+    return num_lazy_free_chains > 0;
+}
+
+/**
+ * @brief Generates an array response for a range of elements in a sorted set.
+ *
+ * The function generates an array response containing a range keys and scores of the sorted set. The range is determined by the rank of its first element and the limit, it is empty if the rank is out of bounds. Elements are ordered by thier rank, or from the highest rank when reverse is true.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param zset sorted set to iterate through
+ * @param start rank of the first element
+ * @param limit Maximum number of elements to return
+ * @param reverse true to iterate from the first element towards the lower ranks
+ */
+void zset_iterate_response(Conn *conn, ZSet *zset, long start, long limit, bool reverse)
+{
+    int num_elements = 0;
 
-    if (!aof_restore)
+    // the number of elements is only known once the iteration stops, the array length is filled in afterwards
+    char *header = add_reply_deferred_array_len(conn);
+
+    if (start < 0 || start >= zset_length(zset))
     {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_updated);
+        set_deferred_array_len(header, 0);
+        return;
     }
-    else
+
+    // find the first element by its rank, then step to the next ranked element and write the key and score to the output queue
+    ZSetIter iter;
+    zset_iter_init(zset, &iter, start, reverse);
+
+    char *key;
+    float score;
+    while ((num_elements / 2 < limit) && zset_iter_next(&iter, &key, &score))
     {
-        return NULL;
+        // write the key
+        add_reply_str(conn, key);
+        num_elements++;
+
+        // now write the score
+        add_reply_float(conn, score);
+        num_elements++;
     }
+
+    set_deferred_array_len(header, num_elements);
 }
 
 /**
- * @brief Executes a ZADD command and optionally logs the action to the AOF file.
+ * @brief Executes a ZQUERY command and writes the corresponding reply according to the liteDB protocol.
  *
- * The ZADD (key, score, name) command adds a value to a sorted set. If the key does not exist, a new sorted set is created. If the field already exists, it is updated instead. Returns an integer response indicating the number of elements added/updated.
+ * The ZQUERY command retrieves a range of elements from a sorted set. Returns an array response containing the elements in the specified range.
  *
- * @param cmd Command structure specifying the (key, score, name)
- * @param aof_restore Flag indicating whether to log the ZADD operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, score, name, offset, limit)
  *
- * @return char* response if AOF restore is disabled, or NULL otherwise.
-
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *zadd_command(Command *cmd, bool aof_restore)
+bool zquery_cmd(Conn *conn, Command *cmd)
 {
     errno = 0;
 
-    ValueType response_type = INTEGER;
-    int elem_added = 0;
-
-    if (cmd->num_args < 3)
-    {
-        return error_response("zadd command requires at least 3 arguments (key, score, name)");
-    }
-
     char *zset_key = cmd->args[0];
     char *score_str = cmd->args[1];
+    char *element_key = cmd->args[2];
+    char *offset_str = cmd->args[3];
+    char *limit_str = cmd->args[4];
+
+    float score;
+    int offset;
+    int limit;
 
     // convert the score to a float
     // use strtol and duck typing to determine the type of the value
     char *endptr;
-    float value = strtof(score_str, &endptr);
+    score = strtof(score_str, &endptr);
 
     // check errors
     if (errno)
@@ -1859,695 +3707,730 @@ char *zadd_command(Command *cmd, bool aof_restore)
     // Check if successfully converted to a float
     if (!(*endptr == '\0') || (endptr == score_str))
     {
-        return error_response("Failed to convert score to float");
+        add_reply_error(conn, "Failed to convert score to float");
+        return false;
     }
 
-    // fetch the zset from global table
-    HashNode *fetched_node = hget(global_table, zset_key);
+    // convert the offset to an integer
+    offset = (int)strtol(offset_str, &endptr, 10);
 
-    if (!fetched_node)
+    // check errors
+    if (errno)
     {
-        // create a new zset,
-        ZSet *zset = zset_init();
-        if (!zset)
-        {
-            fprintf(stderr, "Failed to create ZSet\n");
-            exit(EXIT_FAILURE);
-        }
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
 
-        // create a new hash node
-        HashNode *new_node = hinit(strdup(zset_key), ZSET, zset);
-        if (!new_node)
-        {
-            fprintf(stderr, "Failed to create new hash node\n");
-            exit(EXIT_FAILURE);
-        }
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || (endptr == offset_str))
+    {
+        add_reply_error(conn, "Failed to convert offset to integer");
+        return false;
+    }
 
-        // insert the new node into the global table
-        HashNode *ret = hinsert(global_table, new_node);
-        if (!ret)
-        {
-            fprintf(stderr, "Failed to insert new node into global table\n");
-            exit(EXIT_FAILURE);
-        }
+    // convert the limit to an integer
+    limit = (int)strtol(limit_str, &endptr, 10);
 
-        fetched_node = new_node;
+    // check errors
+    if (errno)
+    {
+        perror("strtol failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Check if successfully converted to an integer
+    if (!(*endptr == '\0') || !(endptr != limit_str))
+    {
+        add_reply_error(conn, "Failed to convert limit to integer");
+        return false;
+    }
+
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, zset_key);
+    if (!fetched_node)
+    {
+        add_reply_error(conn, "zset key not in database");
+        return false;
     }
 
     // check if the value is a ZSET
     if (fetched_node->valueType != ZSET)
     {
-        return error_response("key is not for a ZSET");
+        add_reply_shared(conn, &shared.not_zset);
+        return false;
     }
 
     ZSet *zset = (ZSet *)fetched_node->value;
 
-    // add the value to the ZSET
-    int ret = zset_add(zset, cmd->args[2], value);
-    if (ret < 0)
+    // the origin of the range is the rank of an element
+    int origin_rank = -1;
+    char *not_found_error = "No valid elements in zset";
+
+    if ((isinf(score) == -1) && (strcmp(element_key, "\"\"") == 0))
     {
-        return error_response("Failed to add value to ZSET");
-    }
-    elem_added++;
+        // "" was passed as the key and -inf was passed as the score, perform a rank query
+        if (debug_mode)
+        {
+            printf("Performing rank query\n");
+        }
 
-    if (!aof_restore)
+        // the element with smallest rank
+        origin_rank = zset_length(zset) > 0 ? 0 : -1;
+    }
+    else if (strcmp(element_key, "\"\"") == 0)
     {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_added);
+        // "" was passed as the key, perform a range query with score without name
+        if (debug_mode)
+        {
+            printf("Performing range query\n");
+        }
+
+        // find the first element with the score in the ZSET
+        origin_rank = zset_rank_of_score(zset, score);
     }
     else
     {
-        return NULL;
+        // perform a query for the specific element
+        not_found_error = "Element not in zset";
+
+        // find the element in the ZSET
+        origin_rank = zset_rank_of_pair(zset, element_key, score);
+    }
+
+    if (origin_rank < 0)
+    {
+        add_reply_error(conn, not_found_error);
+        return false;
     }
+
+    // offset the rank of the origin by the value specified by the offset parameter
+    zset_iterate_response(conn, zset, (long)origin_rank + offset, limit, false);
+
+    return true;
 }
 
 /**
- * @brief Executes a ZREM command and optionally logs the action to the AOF file.
+ * @brief Executes a ZREVRANGE command and writes the corresponding reply according to the liteDB protocol.
  *
- * ZREM: (key, name) - Removes the element from the sorted set with the specified name. The sorted set is specified by key. Returns the number of elements removed.
+ * ZREVRANGE: (key, start, stop) - Returns an array with the name and the score of the elements of the sorted set specified by key from rank start to rank stop, included, ranked from the highest score. Negative ranks count from the element with the lowest score, -1 being that element.
  *
- * @param cmd Command structure specifying the (key, name)
- * @param aof_restore Flag indicating whether to log the ZREM operation to the AOF file.
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, start, stop)
+ *
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *zrem_command(Command *cmd, bool aof_restore)
+bool zrevrange_cmd(Conn *conn, Command *cmd)
 {
-    errno = 0;
-
-    ValueType response_type = INTEGER;
-    int elem_removed = 0;
-
-    if (cmd->num_args < 2)
+    int start, stop;
+    if (!parse_int(cmd->args[1], &start) || !parse_int(cmd->args[2], &stop))
     {
-        return error_response("zrem command requires at least 2 arguments (key, name)");
+        add_reply_error(conn, "start or stop is not an integer");
+        return false;
     }
 
-    char *zset_key = cmd->args[0];
-    char *element_key = cmd->args[1];
-
     // fetch the zset from the global table
-    HashNode *fetched_node = hget(global_table, zset_key);
-    if (!fetched_node)
-    {
-        return error_response("zset key not in database");
-    }
-
-    // check if the value is a ZSET
-    if (fetched_node->valueType != ZSET)
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
     {
-        return error_response("key is not for a zset");
+        add_reply_array_len(conn, 0);
+        return true;
     }
 
     ZSet *zset = (ZSet *)fetched_node->value;
 
-    // remove the value from the ZSET
-    int ret = zset_remove(zset, element_key);
-    if (ret < 0)
+    int length = zset_length(zset);
+    if (!zset_resolve_range(length, &start, &stop))
     {
-        return error_response("Failed to remove value from zset");
+        add_reply_array_len(conn, 0);
+        return true;
     }
 
-    elem_removed++;
+    // the reversed rank start is the rank length - 1 - start, the elements are walked backwards from there
+    zset_iterate_response(conn, zset, length - 1 - start, stop - start + 1, true);
 
-    if (!aof_restore)
-    {
-        handle_aof_write(cmd);
-        return get_response(response_type, &elem_removed);
-    }
-    else
-    {
-        return NULL;
-    }
+    return true;
 }
 
 /**
- * @brief Executes a ZSCORE command and returns the corresponding response string according to the liteDB protocol.
+ * @brief Executes a ZRANGEBYSCORE command and writes the corresponding reply according to the liteDB protocol.
  *
- * ZSCORE: (key, name) - Returns the score of the element with the specified name from the sorted set specified by key. Returns a float . Returns a null response if the element does not exist.
+ * ZRANGEBYSCORE: (key, min, max, [LIMIT, offset, count]) - Returns an array with the name and the score of the elements of the sorted set specified by key with a score between min and max, in order. The bounds are parsed like the ones of ZCOUNT. LIMIT skips the first offset elements of the range and returns at most count elements, every element when count is negative.
  *
- * @param cmd Command structure specifying the  (key, name)
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, min, max, [LIMIT, offset, count])
  *
- * @return char* response
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *zscore_cmd(Command *cmd)
+bool zrangebyscore_cmd(Conn *conn, Command *cmd)
 {
-    errno = 0;
-
-    ValueType response_type = FLOAT;
-    float score;
-
-    if (cmd->num_args < 2)
+    float min, max;
+    bool min_exclusive, max_exclusive;
+    if (!parse_score_bound(cmd->args[1], &min, &min_exclusive) || !parse_score_bound(cmd->args[2], &max, &max_exclusive))
     {
-        return error_response("zscore command requires at least 2 arguments (key, name)");
+        add_reply_error(conn, "min or max is not a float");
+        return false;
     }
 
-    char *zset_key = cmd->args[0];
-    char *element_key = cmd->args[1];
-
-    // fetch the zset from the global table
-    HashNode *fetched_node = hget(global_table, zset_key);
-    if (!fetched_node)
+    int offset = 0;
+    int count = -1;
+    if (cmd->num_args != 3 && (cmd->num_args != 6 || strcasecmp(cmd->args[3], "LIMIT") != 0 || !parse_int(cmd->args[4], &offset) || !parse_int(cmd->args[5], &count) || offset < 0))
     {
-        fprintf(stderr, "key not in database\n");
-        return null_response();
+        add_reply_error(conn, "syntax error, expected LIMIT offset count");
+        return false;
     }
 
-    // check if the value is a ZSET
-    if (fetched_node->valueType != ZSET)
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
     {
-        fprintf(stderr, "key is not for a zset\n");
-        return null_response();
+        add_reply_array_len(conn, 0);
+        return true;
     }
 
     ZSet *zset = (ZSet *)fetched_node->value;
 
-    // search for the value in the ZSET
-    HashNode *ret_node = zset_search_by_key(zset, element_key);
-    if (!ret_node)
+    // the range is every rank from the first element not below min to the last element not above max
+    int start = zset_count_lower(zset, min, min_exclusive);
+    int end = zset_count_lower(zset, max, !max_exclusive);
+
+    long limit = (long)end - start - offset;
+    if (count >= 0 && count < limit)
     {
-        fprintf(stderr, "Element not in zset\n");
-        return null_response();
+        limit = count;
     }
 
-    // check if the value is a float
-    if (ret_node->valueType != FLOAT)
+    if (limit <= 0)
     {
-        fprintf(stderr, "Value in zset is somehow not a float, catastrophic error\n");
-        exit(EXIT_FAILURE);
+        add_reply_array_len(conn, 0);
+        return true;
     }
 
-    score = *(float *)ret_node->value;
+    zset_iterate_response(conn, zset, (long)start + offset, limit, false);
 
-    return get_response(response_type, &score);
+    return true;
 }
 
 /**
- * @brief Generates an array response for a range of avl nodes in a sorted set.
+ * @brief Executes a ZREMRANGEBYRANK command.
  *
- * The function generates an array response containing a range keys and scores in the AVL tree. The range is determined by the start node and the limit. Elements are ordered by thier rank in the AVL tree.
+ * ZREMRANGEBYRANK: (key, start, stop) - Removes the elements of the sorted set specified by key from rank start to rank stop, included. Negative ranks count from the end, -1 being the element with the highest score. Returns the number of elements removed.
  *
- * @param tree AVL tree to iterate through
- * @param start Starting node in the AVL tree
- * @param limit Maximum number of elements to return
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, start, stop)
  *
- * @return char* response
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *avl_iterate_response(AVLNode *tree, AVLNode *start, long limit)
+bool zremrangebyrank_cmd(Conn *conn, Command *cmd)
 {
-    int num_elements = 0;
-    int inc_buffer = 5;
-
-    // buffer for the data
-    char *buffer = calloc(1 + 4 + MAX_MESSAGE_SIZE, sizeof(char));
-
-    // iterate through the AVL tree and write the key and score to the buffer
-    AVLNode *current = start;
-    while (current != NULL && (num_elements / 2 < limit))
+    int start, stop;
+    if (!parse_int(cmd->args[1], &start) || !parse_int(cmd->args[2], &stop))
     {
-        // write the key to the buffer
-        int type = SER_STR;
-        int key_len = strlen((char *)current->scnd_index);
-
-        // check if the buffer has enough space to write the key
-        if (inc_buffer + 5 + key_len > MAX_MESSAGE_SIZE)
-        {
-            fprintf(stderr, "Failed to reallocate memory for zquery response\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // write the type and length of the response, 1 byte
-        memcpy(buffer + inc_buffer, &type, 1);
-        memcpy(buffer + inc_buffer + 1, &key_len, 4);
-
-        // write the key
-        memcpy(buffer + inc_buffer + 5, current->scnd_index, key_len);
-
-        inc_buffer += 5 + key_len;
-        num_elements++;
-
-        // now write the score
-        type = SER_FLOAT;
-        int score_len = sizeof(float);
-
-        // check if the buffer has enough space to write the score
-        if (inc_buffer + 5 + score_len > MAX_MESSAGE_SIZE)
-        {
-            fprintf(stderr, "Failed to reallocate memory for zquery response\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // write the type and length of the response, 1 byte
-        memcpy(buffer + inc_buffer, &type, 1);
-        memcpy(buffer + inc_buffer + 1, &score_len, 4);
+        add_reply_error(conn, "start or stop is not an integer");
+        return false;
+    }
 
-        // write the score
-        memcpy(buffer + inc_buffer + 5, &current->value, score_len);
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
+    {
+        add_reply_int(conn, 0);
+        return true;
+    }
 
-        inc_buffer += 5 + score_len;
-        num_elements++;
+    ZSet *zset = (ZSet *)fetched_node->value;
 
-        // go to next ranked node
-        current = avl_offset(current, 1);
+    int removed = 0;
+    if (zset_resolve_range(zset_length(zset), &start, &stop))
+    {
+        // the removed nodes are freed after the reply, between events
+        SkipListNode *nodes;
+        removed = zset_remove_range_by_rank(zset, start, stop, &nodes);
+        lazy_free_nodes(nodes);
     }
 
-    // write the type and length of array to buffer
-    int type = SER_ARR;
-    memcpy(buffer, &type, 1);
-    memcpy(buffer + 1, &num_elements, 4);
+    add_reply_int(conn, removed);
 
-    return buffer;
+    return true;
 }
 
 /**
- * @brief Executes a ZQUERY command and returns the corresponding response string according to the liteDB protocol.
+ * @brief Executes a ZREMRANGEBYSCORE command.
  *
- * The ZQUERY command retrieves a range of elements from a sorted set. Returns an array response containing the elements in the specified range.
+ * ZREMRANGEBYSCORE: (key, min, max) - Removes the elements of the sorted set specified by key with a score between min and max, the bounds are parsed like the ones of ZCOUNT. Returns the number of elements removed.
  *
- * @param cmd Command structure specifying the (key, score, name, offset, limit)
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the (key, min, max)
  *
- * @return char* response
+ * @return bool true if the command succeeded, false if it replied with an error
  */
-char *zquery_cmd(Command *cmd)
+bool zremrangebyscore_cmd(Conn *conn, Command *cmd)
 {
-    errno = 0;
+    float min, max;
+    bool min_exclusive, max_exclusive;
+    if (!parse_score_bound(cmd->args[1], &min, &min_exclusive) || !parse_score_bound(cmd->args[2], &max, &max_exclusive))
+    {
+        add_reply_error(conn, "min or max is not a float");
+        return false;
+    }
 
-    if (cmd->num_args < 5)
+    // fetch the zset from the global table
+    HashNode *fetched_node = hget(global_table, cmd->args[0]);
+    if (!fetched_node || fetched_node->valueType != ZSET)
     {
-        return error_response("zquery command requires at least 5 arguments (key, score, name, offset, limit)");
+        add_reply_int(conn, 0);
+        return true;
     }
 
-    char *zset_key = cmd->args[0];
-    char *score_str = cmd->args[1];
-    char *element_key = cmd->args[2];
-    char *offset_str = cmd->args[3];
-    char *limit_str = cmd->args[4];
+    // the removed nodes are freed after the reply, between events
+    SkipListNode *nodes;
+    int removed = zset_remove_range_by_score((ZSet *)fetched_node->value, min, min_exclusive, max, max_exclusive, &nodes);
+    lazy_free_nodes(nodes);
 
-    float score;
-    int offset;
-    int limit;
+    add_reply_int(conn, removed);
 
-    // convert the score to a float
-    // use strtol and duck typing to determine the type of the value
-    char *endptr;
-    score = strtof(score_str, &endptr);
+    return true;
+}
 
-    // check errors
-    if (errno)
+/**
+ * @brief Hashes a command name with FNV-1a, ignoring case
+ *
+ * @param name command name to hash
+ *
+ * @return unsigned int hash of the name
+ */
+static unsigned int command_name_hash(const char *name)
+{
+    unsigned int hash = 2166136261u;
+    for (; *name; name++)
     {
-        perror("strtof failed");
-        exit(EXIT_FAILURE);
+        hash ^= (unsigned char)toupper((unsigned char)*name);
+        hash *= 16777619u;
     }
 
-    // Check if successfully converted to a float
-    if (!(*endptr == '\0') || (endptr == score_str))
+    return hash;
+}
+
+/**
+ * @brief Builds the index over the command table, must be called once before any command is executed.
+ *
+ * The index is an open addressing table of COMMAND_INDEX_SIZE slots holding pointers into command_table, so a lookup costs one hash of the name and usually a single strcasecmp instead of comparing the name against every command.
+ */
+void command_table_init()
+{
+    memset(command_index, 0, sizeof(command_index));
+
+    for (int i = 0; i < num_commands; i++)
     {
-        return error_response("Failed to convert score to float");
-    }
+        unsigned int slot = command_name_hash(command_table[i].name) & (COMMAND_INDEX_SIZE - 1);
+        while (command_index[slot])
+        {
+            slot = (slot + 1) & (COMMAND_INDEX_SIZE - 1);
+        }
 
-    // convert the offset to an integer
-    offset = (int)strtol(offset_str, &endptr, 10);
+        command_index[slot] = &command_table[i];
+    }
+}
 
-    // check errors
-    if (errno)
+/**
+ * @brief Looks up a command by name, the name is matched case insensitively
+ *
+ * @param name name of the command
+ *
+ * @return CommandDef* entry of the command in the command table, NULL if there is no such command
+ */
+CommandDef *lookup_command(const char *name)
+{
+    unsigned int slot = command_name_hash(name) & (COMMAND_INDEX_SIZE - 1);
+    while (command_index[slot])
     {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
+        if (strcasecmp(command_index[slot]->name, name) == 0)
+        {
+            return command_index[slot];
+        }
+
+        slot = (slot + 1) & (COMMAND_INDEX_SIZE - 1);
     }
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || (endptr == offset_str))
+    return NULL;
+}
+
+/**
+ * @brief Replies with the error for a command called with the wrong number of arguments, for example "zadd command requires at least 3 arguments (key, score, name)"
+ *
+ * @param conn Connection the reply is written to
+ * @param def entry of the command in the command table
+ */
+static void add_reply_arity_error(Conn *conn, CommandDef *def)
+{
+    char name[32];
+    int i;
+    for (i = 0; def->name[i] && i < (int)sizeof(name) - 1; i++)
     {
-        return error_response("Failed to convert offset to integer");
+        name[i] = tolower((unsigned char)def->name[i]);
     }
+    name[i] = 0;
 
-    // convert the limit to an integer
-    limit = (int)strtol(limit_str, &endptr, 10);
+    char err_msg[128];
+    snprintf(err_msg, sizeof(err_msg), "%s command requires %s%d argument%s %s", name, def->max_args == -1 ? "at least " : "", def->min_args, def->min_args == 1 ? "" : "s", def->usage);
+    add_reply_error(conn, err_msg);
+}
 
-    // check errors
-    if (errno)
+/**
+ * @brief Executes a command and writes its reply to the output queue of the connection according to the liteDB protocol.
+ *
+ * The command is looked up in the command table, its number of arguments is checked against the arity of the command and its handler is called. Commands flagged CMD_AOF are logged to the AOF file when they succeed, unless they are being replayed from it.
+ *
+ * @param conn Connection the reply is written to, NULL when restoring from the AOF
+ * @param cmd Command structure specifying the command to execute
+ * @param aof_restore Flag indicating that the command is replayed from the AOF file and must not be logged again
+ */
+void execute_command(Conn *conn, Command *cmd, bool aof_restore)
+{
+    if (!cmd->name)
     {
-        perror("strtol failed");
-        exit(EXIT_FAILURE);
+        add_reply_error(conn, "Command name was not specified");
+        return;
     }
 
-    // Check if successfully converted to an integer
-    if (!(*endptr == '\0') || !(endptr != limit_str))
+    CommandDef *def = lookup_command(cmd->name);
+    if (!def)
     {
-        return error_response("Failed to convert limit to integer");
+        add_reply_shared(conn, &shared.unknown_command);
+        return;
     }
 
-    // fetch the zset from the global table
-    HashNode *fetched_node = hget(global_table, zset_key);
-    if (!fetched_node)
+    if (cmd->num_args < def->min_args || (def->max_args != -1 && cmd->num_args > def->max_args))
     {
-        return error_response("zset key not in database");
+        add_reply_arity_error(conn, def);
+        return;
     }
 
-    // check if the value is a ZSET
-    if (fetched_node->valueType != ZSET)
+    def->stats.calls++;
+    bool ok = def->handler(conn, cmd);
+    if (!ok)
     {
-        return error_response("key is not for a zset");
+        def->stats.failed++;
     }
 
-    ZSet *zset = (ZSet *)fetched_node->value;
-
-    if ((isinf(score) == -1) && (strcmp(element_key, "\"\"") == 0))
+    // a blocking pop that has to wait is not logged, the pop it is served with is
+    if (ok && (def->flags & CMD_AOF) && !aof_restore && !(conn && conn->blocked))
     {
-        // "" was passed as the key and -inf was passed as the score, perform a rank query
-        printf("Performing rank query\n");
-
-        // find the element with smallest rank
-        AVLNode *origin_node = get_min_node(zset->avl_tree);
+        handle_aof_write(cmd);
+    }
 
-        if (!origin_node)
-        {
-            return error_response("No valid elements in zset");
-        }
+    // hand the elements the command added to the connections blocked on their lists
+    serve_blocked_conns(aof_restore);
+}
 
-        // offset the rank of the node in the AVL tree by the value specified by the offset parameter
-        AVLNode *offset_node = avl_offset(origin_node, offset);
+/**
+ * @brief Restores the database state from the AOF file.
+ *
+ * The function executes the commands logged in the AOF file to restore the database state. The function is called when the server starts up. Files written before commands were logged as framed records start with commands logged one per line, those are read line by line until the AOF_HEADER line, the framed records follow it.
+ *
+ * @return bool true if the AOF_HEADER line was found, false if it still has to be appended before new records are logged
+ */
+bool aof_restore_db()
+{
+    bool aof_restore = true;
+    bool framed = false;
+    Command cmd;
 
-        return avl_iterate_response(zset->avl_tree, offset_node, limit);
-    }
-    else if (strcmp(element_key, "\"\"") == 0)
+    // check if the AOF was initialized
+    if (!global_aof)
     {
-        // ! potential problem dealing with equal scores here due to the fact that nodes with equal scores can be stored on the right and left based on AVL rotations
-        // "" was passed as the key, perform a range query with score without name
-        printf("Performing range query\n");
-
-        // find the element in the ZSET using AVL tree
-        AVLNode *origin_node = avl_search_float(zset->avl_tree, score);
+        fprintf(stderr, "AOF not initialized\n");
+        exit(EXIT_FAILURE);
+    }
 
-        if (!origin_node)
+    // read the commands logged as lines, until the header of the framed records
+    char *line;
+    while ((line = aof_read_line(global_aof)) != NULL)
+    {
+        if (strcmp(line, AOF_HEADER) == 0)
         {
-            return error_response("No valid elements in zset");
+            free(line);
+            framed = true;
+            break;
         }
 
-        // offset the rank of the node in the AVL tree by the value specified by the offset parameter
-        AVLNode *offset_node = avl_offset(origin_node, offset);
+        // the line is null terminated, so the byte after the command can be overwritten by the parser
+        parse_cmd_string(line, strlen(line), &cmd);
 
-        return avl_iterate_response(zset->avl_tree, offset_node, limit);
-    }
-    else
-    {
-        // perform a query for the specific element
+        // execute the command, there is no connection to reply to
+        execute_command(NULL, &cmd, aof_restore);
+        command_free(&cmd);
 
-        // find the element in the ZSET using AVL tree
-        AVLNode *origin_node = avl_search_pair(zset->avl_tree, element_key, score);
+        // free the line from aof_read_line()
+        free(line);
+    }
 
-        if (!origin_node)
+    // read the framed records, each one is a request message preceded by its size
+    int size;
+    char *record;
+    while (framed && (record = aof_read_record(global_aof, &size)) != NULL)
+    {
+        if (parse_cmd_string(record, size, &cmd) < 0)
         {
-            return error_response("Element not in zset");
+            fprintf(stderr, "Malformed AOF record\n");
+            exit(EXIT_FAILURE);
         }
 
-        // offset the rank of the node in the AVL tree by the value specified by the offset parameter
-        AVLNode *offset_node = avl_offset(origin_node, offset);
+        execute_command(NULL, &cmd, aof_restore);
+        command_free(&cmd);
 
-        return avl_iterate_response(zset->avl_tree, offset_node, limit);
+        free(record);
     }
+
+    return framed;
 }
 
 /**
- * @brief Executes a command and returns the corresponding response string according to the liteDB protocol.
- *
- * The function executes a command and returns the corresponding response string according to the liteDB protocol. The function also handles logging the command to the AOF file if the aof_restore flag is set.
+ * @brief Checks if the output queue of a connection is full, a full queue pauses reading until the socket has taken some of it
  *
- * @param cmd Command structure specifying the command to execute
- * @param aof_restore Flag indicating whether to log the command to the AOF file
+ * @param conn Connection to check
  *
- * @return char* response
+ * @return bool true if the output queue is full
  */
-char *execute_command(Command *cmd, bool aof_restore)
+bool reply_queue_full(Conn *conn)
 {
+    return conn->reply_queued >= REPLY_QUEUE_LIMIT;
+}
 
-    char *return_response;
-
-    if (!cmd->name)
-    {
-        return_response = error_response("Command name was not specified");
-    }
-    else if (strcmp(cmd->name, "PING") == 0)
-    {
-        return_response = ping_command();
-    }
-    else if (strcmp(cmd->name, "EXISTS") == 0)
-    {
-        return_response = exists_command(cmd);
-    }
-    else if (strcmp(cmd->name, "DEL") == 0)
-    {
-
-        return_response = del_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "KEYS") == 0)
-    {
-
-        return_response = keys_command();
-    }
-    else if (strcmp(cmd->name, "FLUSHALL") == 0)
+/**
+ * @brief Frees all the blocks of the output queue of a connection
+ *
+ * @param conn Connection to free the output queue of
+ */
+void reply_queue_free(Conn *conn)
+{
+    ReplyBlock *block = conn->reply_head;
+    while (block)
     {
-
-        return_response = flushall_cmd(cmd, aof_restore);
+        ReplyBlock *next = block->next;
+        free(block);
+        block = next;
     }
-    else if (strcmp(cmd->name, "GET") == 0)
-    {
 
-        return_response = get_command(cmd);
-    }
-    else if (strcmp(cmd->name, "SET") == 0)
-    {
+    conn->reply_head = NULL;
+    conn->reply_tail = NULL;
+    conn->reply_sent = 0;
+    conn->reply_queued = 0;
+}
 
-        return_response = set_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "HEXISTS") == 0)
+/**
+ * @brief Shrinks a connection buffer back to its initial size once it has been drained, so a large request does not keep its memory.
+ *
+ * @param buffer pointer to the buffer, may be reallocated
+ * @param capacity pointer to the capacity of the buffer
+ */
+void buffer_shrink(char **buffer, int *capacity)
+{
+    if (*capacity <= CONN_BUFFER_INIT_SIZE)
     {
-        return_response = hexists_command(cmd);
+        return;
     }
-    else if (strcmp(cmd->name, "HSET") == 0)
-    {
 
-        return_response = hset_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "HGET") == 0)
+    char *new_buffer = realloc(*buffer, CONN_BUFFER_INIT_SIZE);
+    if (!new_buffer)
     {
-
-        return_response = hget_command(cmd);
+        // keep the larger buffer, it is still valid
+        return;
     }
-    else if (strcmp(cmd->name, "HDEL") == 0)
-    {
 
-        return_response = hdel_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "HGETALL") == 0)
-    {
+    *buffer = new_buffer;
+    *capacity = CONN_BUFFER_INIT_SIZE;
+}
 
-        return_response = hgetall_command(cmd);
-    }
-    else if (strcmp(cmd->name, "LEXISTS") == 0)
-    {
-        return_response = lexists_command(cmd);
-    }
-    else if (strcmp(cmd->name, "LPUSH") == 0)
-    {
+/**
+ * @brief Check if a complete request is waiting in the read buffer of a connection
+ *
+ * Requests stay buffered when processing stopped because the output queue was full, they have to be executed before waiting for more data since no epoll event will report them.
+ *
+ * @param conn connection object
+ *
+ * @return bool indicating if a complete request is buffered
+ */
+static bool request_buffered(Conn *conn)
+{
+    int pending_size = conn->current_read_size - conn->read_offset;
 
-        return_response = lpush_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "RPUSH") == 0)
+    if (pending_size < 4)
     {
-
-        return_response = rpush_command(cmd, aof_restore);
+        return false;
     }
-    else if (strcmp(cmd->name, "LPOP") == 0)
-    {
 
-        return_response = lpop_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "RPOP") == 0)
-    {
+    int message_size = 0;
+    memcpy(&message_size, conn->read_buffer + conn->read_offset, 4);
 
-        return_response = rpop_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "LREM") == 0)
-    {
+    return message_size >= 0 && pending_size >= 4 + message_size;
+}
 
-        return_response = lrem_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "LLEN") == 0)
-    {
+/**
+ * @brief Finds the key of a buffered request without modifying it, the key is the first argument after the command name
+ *
+ * @param message message of the request
+ * @param message_size size of the message
+ * @param key_len set to the length of the key
+ *
+ * @return char* start of the key in the message, NULL if the request has no key or is malformed
+ */
+static char *request_key(char *message, int message_size, int *key_len)
+{
+    char *end = message + message_size;
 
-        return_response = llen_cmd(cmd);
-    }
-    else if (strcmp(cmd->name, "LRANGE") == 0)
+    if (message_size > 0 && message[0] == FRAME_MARKER)
     {
+        // skip the marker, the number of arguments and the command name
+        int num_args;
+        int name_len;
+        if (message_size < 1 + 4 + 4)
+        {
+            return NULL;
+        }
+        memcpy(&num_args, message + 1, 4);
+        memcpy(&name_len, message + 1 + 4, 4);
 
-        return_response = lrange_cmd(cmd);
-    }
-    else if (strcmp(cmd->name, "LTRIM") == 0)
-    {
+        if (num_args < 2 || name_len < 0 || name_len > message_size - (1 + 4 + 4 + 4))
+        {
+            return NULL;
+        }
 
-        return_response = ltrim_cmd(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "LSET") == 0)
-    {
+        char *key = message + 1 + 4 + 4 + name_len;
 
-        return_response = lset_cmd(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "ZADD") == 0)
-    {
+        memcpy(key_len, key, 4);
+        key += 4;
+        if (*key_len < 0 || *key_len > end - key)
+        {
+            return NULL;
+        }
 
-        return_response = zadd_command(cmd, aof_restore);
+        return key;
     }
-    else if (strcmp(cmd->name, "ZREM") == 0)
-    {
 
-        return_response = zrem_command(cmd, aof_restore);
-    }
-    else if (strcmp(cmd->name, "ZSCORE") == 0)
+    // skip the command name and the spaces around it
+    char *key = message;
+    while (key < end && *key == ' ')
     {
-
-        return_response = zscore_cmd(cmd);
+        key++;
     }
-    else if (strcmp(cmd->name, "ZQUERY") == 0)
+    while (key < end && *key != ' ')
     {
-        return_response = zquery_cmd(cmd);
+        key++;
     }
-    else
+    while (key < end && *key == ' ')
     {
-        return_response = error_response("Unknown command");
+        key++;
     }
 
-    // free the command
-    free(cmd->name);
-
-    // free all args
-    for (int i = 0; i < cmd->num_args; i++)
+    char *key_end = key;
+    while (key_end < end && *key_end != ' ')
     {
-        free(cmd->args[i]);
+        key_end++;
     }
 
-    // free the command
-    free(cmd);
-
-    return return_response;
+    *key_len = key_end - key;
+    return *key_len > 0 ? key : NULL;
 }
 
 /**
- * @brief Restores the database state from the AOF file.
+ * @brief Prefetches the global table entries of the keys of the next buffered requests.
  *
- * The function reads the AOF file line by line and executes the commands to restore the database state. The function is called when the server starts up.
+ * Looking a key up in the global table is a chain of dependent cache misses, which are otherwise taken one request at a time. The keys of up to REQUEST_PREFETCH_BATCH complete requests following the read offset are hashed and prefetched together with hprefetch(), so their misses overlap before the requests are executed. The requests are only read, parsing them still happens when they are executed.
+ *
+ * @param conn Connection whose buffered requests are prefetched
  */
-void aof_restore_db()
+static void prefetch_request_keys(Conn *conn)
 {
-    bool aof_restore = true;
+    uint64_t hash_codes[REQUEST_PREFETCH_BATCH];
+    int count = 0;
 
-    // check if the AOF was initialized
-    if (!global_aof)
+    int offset = conn->read_offset;
+    for (int i = 0; i < REQUEST_PREFETCH_BATCH && conn->current_read_size - offset >= 4; i++)
     {
-        fprintf(stderr, "AOF not initialized\n");
-        exit(EXIT_FAILURE);
-    }
+        int message_size;
+        memcpy(&message_size, conn->read_buffer + offset, 4);
+        if (message_size < 0 || conn->current_read_size - offset - 4 < message_size)
+        {
+            break;
+        }
 
-    // read the AOF file line by line
-    char *line;
-    while ((line = aof_read_line(global_aof)) != NULL)
-    {
-        // parse the command
-        Command *cmd = parse_cmd_string(line, strlen(line));
+        int key_len;
+        char *key = request_key(conn->read_buffer + offset + 4, message_size, &key_len);
+        if (key)
+        {
+            hash_codes[count++] = hash_len(key, key_len);
+        }
 
-        // execute the command
-        execute_command(cmd, aof_restore);
+        offset += 4 + message_size;
+    }
 
-        // free the line from aof_read_line()
-        free(line);
+    // a single request has nothing to overlap with
+    if (count > 1)
+    {
+        hprefetch(global_table, hash_codes, count);
     }
 }
 
 /**
- * @brief Writes a response to a buffer following the liteDB protocol.
+ * @brief Executes every complete request buffered by a connection, until the output queue is full.
  *
- * The function writes a response to a buffer following the liteDB protocol. The response is a byte string that follows the protocol. The function returns the number of bytes written to the buffer.
+ * The keys of the requests are prefetched a batch at a time by prefetch_request_keys() before the batch is executed.
  *
- * @param buffer Buffer to write the response to
- * @param response Response to write to the buffer
+ * @param conn Connection whose requests are executed
  *
- * @return int number of bytes written to the buffer
+ * @return int number of requests executed
  */
-int buffer_write_response(char *buffer, char *response)
+int process_buffered_requests(Conn *conn)
 {
+    int processed = 0;
 
-    // write type and size of message
-    memcpy(buffer, response, 1 + 4);
-
-    int type = 0;
-    memcpy(&type, buffer, 1);
-
-    int message_size = 0;
-    memcpy(&message_size, buffer + 1, 4);
-
-    // for the type and size of the message
-    int response_size = 1 + 4;
-
-    if (type == SER_ARR)
+    while (true)
     {
-        for (int i = 0; i < message_size; i++)
+        if (processed % REQUEST_PREFETCH_BATCH == 0)
         {
-            int el_len = 0;
-            memcpy(&el_len, response + response_size + 1, 4);
-
-            // make sure the buffer has enough space to write the response
-            if (response_size + 5 + el_len > MAX_MESSAGE_SIZE)
-            {
-                fprintf(stderr, "Failed to reallocate memory for response\n");
-                exit(EXIT_FAILURE);
-            }
-
-            // write the response
-            memcpy(buffer + response_size, response + response_size, 5 + el_len);
-
-            response_size += 5 + el_len;
+            prefetch_request_keys(conn);
         }
 
-        return response_size;
-    }
-    else
-    {
-        // response without array
-        response_size += message_size;
-
-        // check if the buffer has enough space to write the response
-        if (response_size > MAX_MESSAGE_SIZE)
+        if (!try_process_single_request(conn))
         {
-            fprintf(stderr, "Failed to reallocate memory for response\n");
-            exit(EXIT_FAILURE);
+            return processed;
         }
 
-        // write the response
-        memcpy(buffer + 5, response + 5, message_size);
-
-        return response_size;
+        processed++;
     }
 }
 
 /**
  * @brief Attempts to process a single request from a connection.
  *
- * The function attempts to process a single request from a connection. The function checks if the read buffer of the connection has enough data to process a request. If the read buffer has enough data, the function processes the request and writes the response to the write buffer. The function returns true if the request was fully processed and sent to the connection, and false otherwise.
+ * The function attempts to process a single request from a connection. The function checks if the read buffer of the connection has enough data to process a request. If the read buffer has enough data, the function executes the request and appends the response to the output queue, the responses of pipelined requests are flushed together afterwards. The function returns true if a request was processed, and false if there is no complete request buffered or the output queue is full.
  *
  * @param conn Connection structure to handle
  */
 bool try_process_single_request(Conn *conn)
 {
+    // stop executing requests once the output queue is full, they are picked up again once it has been flushed. A blocked connection executes nothing until it is resumed
+    if (reply_queue_full(conn) || conn->state == STATE_BLOCKED)
+    {
+        return false;
+    }
+
+    // the request starts at the read offset, everything before it has already been processed
+    char *request = conn->read_buffer + conn->read_offset;
+    int pending_size = conn->current_read_size - conn->read_offset;
+
     // check if the read buffer has enough data to process a request
-    if (conn->current_read_size < 4)
+    if (pending_size < 4)
     {
         // not enough data to process a request
         return false;
     }
 
-    // copy the first 4 bytes of the read buffer, assume the message size is in little endian (this machine is little endian)
+    // copy the first 4 bytes of the request, assume the message size is in little endian (this machine is little endian)
     int message_size = 0;
-    memcpy(&message_size, conn->read_buffer, 4);
+    memcpy(&message_size, request, 4);
 
-    if (message_size > MAX_MESSAGE_SIZE)
+    if (message_size < 0 || message_size > max_message_size)
     {
         fprintf(stderr, "Message size too large\n");
         conn->state = STATE_DONE;
@@ -2555,90 +4438,118 @@ bool try_process_single_request(Conn *conn)
     }
 
     // check if the read buffer has enough data to process a request
-    if (conn->current_read_size < 4 + message_size)
+    if (pending_size < 4 + message_size)
     {
         // not enough data to process a request
         return false;
     }
 
-    // print the message, account for the fact that the message is not null terminated due to pipe-lining
-    printf("Client %d says: %.*s\n", conn->fd, message_size, conn->read_buffer + 4);
-
-    // parse the message to extract the command
-    Command *cmd = parse_cmd_string(conn->read_buffer + 4, message_size);
-
-    // aof_restore is false, since the command is not being restored from the AOF file
-    bool aof_restore = false;
+    // print the message in debug mode only, it costs more than most commands, account for the fact that the message is not null terminated due to pipe-lining
+    if (debug_mode)
+    {
+        printf("Client %d says: %.*s\n", conn->fd, message_size, request + 4);
+    }
 
-    // execute the command, response is a null terminated byte string following the protocol
-    char *response = execute_command(cmd, aof_restore);
+    // the parser terminates the last argument with the byte after the message, which belongs to the next pipelined request, the read buffer always has room for it
+    char *message_end = request + 4 + message_size;
+    char next_byte = *message_end;
 
-    // write response to the write buffer
-    int response_size = buffer_write_response(conn->write_buffer, response);
+    // parse the message to extract the command, its arguments point into the read buffer
+    Command cmd;
+    int parsed = parse_cmd_string(request + 4, message_size, &cmd);
+    if (parsed == -1)
+    {
+        add_reply_error(conn, "Malformed request");
+    }
+    else if (parsed == -2)
+    {
+        add_reply_error(conn, "Arguments can not contain a null byte");
+    }
+    else
+    {
+        // aof_restore is false, since the command is not being restored from the AOF file
+        bool aof_restore = false;
 
-    // free the response
-    free(response);
+        // execute the command, the reply is serialized straight into the output queue and written together with the replies of the other pipelined requests
+        execute_command(conn, &cmd, aof_restore);
+    }
 
-    conn->need_write_size = response_size;
+    command_free(&cmd);
+    *message_end = next_byte;
 
-    // remove the request from the read buffer
-    int remaining_size = conn->current_read_size - (4 + message_size);
+    // consume the request, the following pipelined requests stay where they are
+    conn->read_offset += 4 + message_size;
 
-    // using memmove instead of memcpy to handle overlapping memory regions
-    if (remaining_size)
+    // once everything has been processed the buffer is empty again, give back the memory of a large request
+    if (conn->read_offset == conn->current_read_size)
     {
-        memmove(conn->read_buffer, conn->read_buffer + 4 + message_size, remaining_size);
+        conn->read_offset = 0;
+        conn->current_read_size = 0;
+        buffer_shrink(&conn->read_buffer, &conn->read_buffer_capacity);
     }
 
-    conn->current_read_size = remaining_size;
-
-    // the request has been processed, move to the response state
-    conn->state = STATE_RESP;
-    state_resp(conn);
-
     // continue the outer loop to process pipelined requests
-    return (conn->state == STATE_REQ);
+    return true;
 }
 
 /**
  * @brief Attempts to fill the read buffer of a connection.
  *
- * The function attempts to fill the read buffer of a connection. The function reads from the socket and fills the read buffer of the connection. The function returns false to indicate to that the attempt to read any characters into the buffer was unsuccessful or that the connection is waiting for a response, and true otherwise.
+ * The function attempts to fill the read buffer of a connection. The function reads from the socket and fills the read buffer of the connection, growing it when it is full. The function returns false to indicate that the attempt to read any characters into the buffer was unsuccessful, and true otherwise.
  *
  * @param conn Connection structure to handle
  *
- * @return bool indicating if this function should be called again in the while loop of state_req()
+ * @return bool indicating if any data was read
  */
 bool try_fill_read_buffer(Conn *conn)
 {
-    // check if the read buffer overflowed
-    if (conn->current_read_size > sizeof(conn->read_buffer))
+    // make room for the pending request, if its size is known grow straight to fit it
+    int pending_size = conn->current_read_size - conn->read_offset;
+    int needed = pending_size + 1;
+    if (pending_size >= 4)
     {
-        fprintf(stderr, "Read buffer overflow\n");
-        return false;
+        int message_size = 0;
+        memcpy(&message_size, conn->read_buffer + conn->read_offset, 4);
+
+        if (message_size >= 0 && message_size <= max_message_size && 4 + message_size > needed)
+        {
+            needed = 4 + message_size;
+        }
+    }
+
+    // move the unprocessed bytes to the front only if the request does not fit behind them, or once the consumed prefix is at least half the buffer, so every byte is moved a bounded number of times
+    if (conn->read_offset > 0 && (conn->read_offset + needed + 1 > conn->read_buffer_capacity || conn->read_offset >= conn->read_buffer_capacity / 2))
+    {
+        memmove(conn->read_buffer, conn->read_buffer + conn->read_offset, pending_size);
+        conn->current_read_size = pending_size;
+        conn->read_offset = 0;
     }
 
+    buffer_reserve(&conn->read_buffer, &conn->read_buffer_capacity, conn->read_offset + needed + 1);
+
     // read from the socket
     int read_size = 0;
 
     // attempt to read from the socket until we have read some characters or a signal has not interrupted the read
     do
     {
-        int max_possible_read = sizeof(conn->read_buffer) - conn->current_read_size;
+        // keep one byte spare after the data, the parser null terminates the last argument of a request there
+        int max_possible_read = conn->read_buffer_capacity - conn->current_read_size - 1;
 
         read_size = read(conn->fd, conn->read_buffer + conn->current_read_size, max_possible_read);
     } while (read_size < 0 && errno == EINTR);
 
-    if ((read_size < 0) && (errno = EAGAIN))
+    if ((read_size < 0) && (errno == EAGAIN || errno == EWOULDBLOCK))
     {
-        //  read buffer is full, wait for the next poll event
+        //  no more data to read, wait for the next epoll event
         return false;
     }
 
     if (read_size < 0)
     {
-        // an error that is not EINTR or EAGAIN occured
+        // an error that is not EINTR or EAGAIN occured, exit the connection
         perror("read failed");
+        conn->state = STATE_DONE;
         return false;
     }
 
@@ -2646,8 +4557,8 @@ bool try_fill_read_buffer(Conn *conn)
     {
         // if read_size is 0 then EOF reached
 
-        // if the current_read_size is greater than 0, then the EOF was reached before reading the full message
-        if (conn->current_read_size > 0)
+        // if there are unprocessed bytes, then the EOF was reached before reading the full message
+        if (conn->current_read_size > conn->read_offset)
         {
             fprintf(stderr, "EOF reached before reading full message\n");
         }
@@ -2662,24 +4573,14 @@ bool try_fill_read_buffer(Conn *conn)
     }
 
     conn->current_read_size += read_size;
-    if (conn->current_read_size > sizeof(conn->read_buffer))
-    {
-        fprintf(stderr, "Read buffer overflow\n");
-        return false;
-    }
 
-    // the loop here is to handle that clients can send multiple requests in one go (pipe-lining)
-    while (try_process_single_request(conn))
-    {
-    };
-
-    return (conn->state == STATE_REQ);
+    return true;
 }
 
 /**
- * @brief Attempts to flush the write buffer of a connection.
+ * @brief Attempts to flush the output queue of a connection.
  *
- * The function attempts to flush the write buffer of a connection. The function writes to the socket and flushes the write buffer of the connection. The function returns false to indicate that the attempt to write any characters into the buffer was unsuccessful or that the connection is waiting for a request, and true otherwise.
+ * The function writes as many queued reply blocks as possible to the socket with a single writev() call and frees the blocks that were fully written. The function returns false to indicate that the queue is empty or that the socket can not take more data, and true otherwise.
  *
  * @param conn Connection structure to handle
  *
@@ -2687,22 +4588,37 @@ bool try_fill_read_buffer(Conn *conn)
  */
 bool try_flush_write_buffer(Conn *conn)
 {
+    if (!conn->reply_queued)
+    {
+        return false;
+    }
+
+    // gather the queued blocks, the head block may already be partially written
+    struct iovec iov[REPLY_IOV_MAX];
+    int iov_count = 0;
 
-    int write_size = 0;
+    for (ReplyBlock *block = conn->reply_head; block && iov_count < REPLY_IOV_MAX; block = block->next)
+    {
+        int offset = (block == conn->reply_head) ? conn->reply_sent : 0;
+
+        iov[iov_count].iov_base = block->data + offset;
+        iov[iov_count].iov_len = block->size - offset;
+        iov_count++;
+    }
+
+    ssize_t write_size = 0;
 
     // attempt to write to the socket until we have written some characters or a signal has not interrupted the write
     do
     {
-        int max_possible_write = conn->need_write_size - conn->current_write_size;
-
-        write_size = write(conn->fd, conn->write_buffer + conn->current_write_size, max_possible_write);
+        write_size = writev(conn->fd, iov, iov_count);
     } while (write_size < 0 && errno == EINTR);
 
     if (write_size < 0)
     {
-        if (errno == EAGAIN)
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
         {
-            // write buffer is full, wait for the next poll event
+            // socket buffer is full, wait for the next epoll event
             return false;
         }
         // an error that is not EINTR or EAGAIN occured, exit the connection
@@ -2711,48 +4627,73 @@ bool try_flush_write_buffer(Conn *conn)
         return false;
     }
 
-    conn->current_write_size += write_size;
+    conn->reply_queued -= write_size;
 
-    if (conn->current_write_size > conn->need_write_size)
+    // free the blocks that have been fully written
+    ssize_t remaining = write_size;
+    while (remaining > 0)
     {
-        fprintf(stderr, "Write buffer overflow\n");
-        conn->state = STATE_DONE;
-        return false;
-    };
+        ReplyBlock *head = conn->reply_head;
+        int unsent = head->size - conn->reply_sent;
 
-    if (conn->current_write_size == conn->need_write_size)
-    {
-        // the response has been fully written, move to the request state
-        conn->state = STATE_REQ;
-        conn->current_write_size = 0;
-        conn->need_write_size = 0;
+        if (remaining < unsent)
+        {
+            conn->reply_sent += remaining;
+            break;
+        }
 
-        // exit the outer write loop
-        return false;
+        remaining -= unsent;
+        conn->reply_head = head->next;
+        conn->reply_sent = 0;
+        free(head);
     }
 
-    // data still in the write buffer, try to write again in the outer loop
-    return true;
+    if (!conn->reply_head)
+    {
+        conn->reply_tail = NULL;
+    }
+
+    // data still queued, try to write again in the outer loop
+    return conn->reply_queued > 0;
 }
 
 /**
  * @brief Handles the request state of a connection.
  *
- * The function handles the request state of a connection. Calls try_fill_read_buffer() repeatedly.
+ * The function handles the request state of a connection. All complete requests that are buffered are executed first, then their replies are flushed together and more data is read from the socket, until the socket would block. Reading only pauses when the output queue is full, in which case the connection moves to STATE_RESP.
  *
  * @param conn Connection structure to handle
  */
 void state_req(Conn *conn)
 {
-    while (try_fill_read_buffer(conn))
+    do
     {
-    };
+        // execute every complete request that is buffered, their replies are queued
+        process_buffered_requests(conn);
+
+        // flush the replies of all the processed requests together
+        while (try_flush_write_buffer(conn))
+        {
+        };
+
+        if (conn->state != STATE_REQ)
+        {
+            return;
+        }
+
+        if (reply_queue_full(conn))
+        {
+            // the socket can not take the replies fast enough, wait until it has taken some of them
+            conn->state = STATE_RESP;
+            return;
+        }
+    } while (request_buffered(conn) || try_fill_read_buffer(conn));
 }
 
 /**
  * @brief Handles the response state of a connection.
  *
- * The function handles the response state of a connection. Calls try_flush_write_buffer() repeatedly.
+ * The function handles the response state of a connection, in which the output queue is full. Calls try_flush_write_buffer() repeatedly and moves back to the request state once the queue is no longer full.
  *
  * @param conn Connection structure to handle
  */
@@ -2761,4 +4702,9 @@ void state_resp(Conn *conn)
     while (try_flush_write_buffer(conn))
     {
     };
+
+    if (conn->state == STATE_RESP && !reply_queue_full(conn))
+    {
+        conn->state = STATE_REQ;
+    }
 }
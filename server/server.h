@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -11,12 +13,15 @@
 #include <netinet/in.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <signal.h>
+#include <time.h>
 
-// Zset includes AVLTree and HashTable header
+// Zset includes SkipList and HashTable header, list includes the listpack header
 #include "../ZSet/ZSet.h"
 #include "../list/list.h"
 #include "../aof/aof.h"
@@ -28,97 +33,362 @@
 #define AOF_FILE "AOF.aof"
 #define FLUSH_INTERVAL_SEC 5
 
+// maximum number of ready events handled per epoll_wait() call
+#define MAX_EPOLL_EVENTS 1024
+
 // should be multiple of two
 #define INIT_TABLE_SIZE 1024
 
+// a hash is packed into a listpack until it has more fields than this, or a field or value longer than HASH_MAX_LISTPACK_VALUE bytes
+#define HASH_MAX_LISTPACK_ENTRIES 128
+#define HASH_MAX_LISTPACK_VALUE 64
+
+// initial size of the per connection read buffer, it grows on demand up to max_message_size
+#define CONN_BUFFER_INIT_SIZE 512
+
+// replies are queued in blocks of at least this size, larger replies get a block that fits them
+#define REPLY_BLOCK_SIZE 4096
+
+// once this many reply bytes are queued, reading pauses until the socket has taken some of them
+#define REPLY_QUEUE_LIMIT (1024 * 1024)
+
+// maximum number of reply blocks passed to a single writev() call
+#define REPLY_IOV_MAX 64
+
+// integer replies from 0 up to this value are pre-encoded
+#define SHARED_INTEGERS 1024
+
+// number of buckets of the global table moved per event loop tick while it is being resized and no client is waiting
+#define IDLE_REHASH_BUCKETS 1024
+
+// number of skiplist nodes removed by range deletions that are freed per event loop tick
+#define LAZY_FREE_STEP 1024
+
+// commands with up to this many arguments are parsed without any heap allocation
+#define CMD_INLINE_ARGS 16
+
+// number of pipelined requests whose keys are prefetched together before they are executed
+#define REQUEST_PREFETCH_BATCH HGET_BATCH
+
+// largest timeout of BLPOP and BRPOP in seconds, a timeout of 0 waits forever
+#define BLOCK_TIMEOUT_MAX (60 * 60 * 24 * 365)
+
+// command flags, a command either only reads the database or writes to it, CMD_AOF commands are logged to the AOF when they succeed
+#define CMD_READ 0x1
+#define CMD_WRITE 0x2
+#define CMD_AOF 0x4
+
+// size of the open addressing index over the command table, a power of two at least twice the number of commands
+#define COMMAND_INDEX_SIZE 64
+
 // variables/structs for the event loop
 enum Conn_State
 {
     STATE_REQ,
     STATE_RESP,
+    // waiting for an element in BLPOP or BRPOP, the connection is neither read nor executes its requests until it is served or times out
+    STATE_BLOCKED,
     STATE_DONE
 };
 
-typedef struct
+// a block of queued reply bytes, blocks form the output queue of a connection
+typedef struct ReplyBlock
+{
+    struct ReplyBlock *next;
+    int size;
+    int capacity;
+    char data[];
+} ReplyBlock;
+
+typedef struct Conn
 {
     int fd;
     enum Conn_State state;
 
-    // read buffer
-    char read_buffer[4 + MAX_MESSAGE_SIZE + 1];
+    // events the fd is currently registered for with epoll
+    uint32_t events;
+
+    // read buffer, grows to fit the pending request and shrinks back once drained. Requests are consumed by advancing read_offset, the unprocessed bytes are only moved to the front when more room is needed
+    char *read_buffer;
+    int read_buffer_capacity;
     int current_read_size;
+    int read_offset;
 
-    // write buffer
-    char write_buffer[4 + MAX_MESSAGE_SIZE + 1];
-    int need_write_size;
-    int current_write_size;
+    // output queue, the replies of all processed requests are appended here and flushed together with writev()
+    ReplyBlock *reply_head;
+    ReplyBlock *reply_tail;
+    int reply_sent;
+    int reply_queued;
+
+    // set while the connection is blocked
+    struct BlockState *blocked;
+
+    // the connection was served or timed out, and is queued to resume executing its requests
+    bool unblocked;
 } Conn;
 
+// an entry of the queue of the connections blocked on a key, a connection blocked on many keys has an entry in the queue of each
+typedef struct Waiter
+{
+    Conn *conn;
+
+    // the node of the key in blocking_keys, its value is the queue
+    HashNode *queue_node;
+
+    struct Waiter *prev;
+    struct Waiter *next;
+} Waiter;
+
+// connections blocked on a key, served oldest first
+typedef struct
+{
+    Waiter *head;
+    Waiter *tail;
+
+    // the key is in the ready keys, an element was added to its list by the command being executed
+    bool ready;
+} WaitQueue;
+
+// what a connection is blocked on
+typedef struct BlockState
+{
+    Conn *conn;
+
+    // pop from the head of the list, BLPOP, or from its tail, BRPOP
+    bool head;
+
+    // CLOCK_MONOTONIC time in milliseconds the wait times out at, and the position of the connection in the timer heap, -1 when it waits forever
+    long long deadline;
+    int timer_index;
+
+    int num_keys;
+    Waiter waiters[];
+} BlockState;
+
+// a reply encoded once at startup and copied into the output queue of every connection that sends it
+typedef struct
+{
+    char *data;
+    int size;
+} SharedReply;
+
+typedef struct
+{
+    SharedReply nil;
+    SharedReply empty_array;
+    SharedReply pong;
+    SharedReply no_key;
+    SharedReply not_hashtable;
+    SharedReply not_list;
+    SharedReply not_zset;
+    SharedReply unknown_command;
+    SharedReply integers[SHARED_INTEGERS];
+} SharedReplies;
+
+// arguments point into the request they were parsed from and are null terminated in place, they are only valid until the request is consumed
 typedef struct
 {
     char *name;
-    char *args[MAX_ARGS];
+    char **args;
+    int *arg_lens;
     int num_args;
+    int args_capacity;
 
+    // storage for the arguments of typical commands, args spills to the heap for larger ones
+    char *inline_args[CMD_INLINE_ARGS];
+    int inline_arg_lens[CMD_INLINE_ARGS];
 } Command;
 
+// a command handler writes the reply to conn and returns false if the command failed
+typedef bool (*CommandHandler)(Conn *conn, Command *cmd);
+
+typedef struct
+{
+    long calls;
+    long failed;
+} CommandStats;
+
+// an entry of the command table, generated from COMMAND_TABLE
+typedef struct
+{
+    const char *name;
+    CommandHandler handler;
+    int min_args;
+    int max_args;
+    int flags;
+    const char *usage;
+    CommandStats stats;
+} CommandDef;
+
 // server functions
 void set_fd_nonblocking(int fd);
 int accept_new_connection(Conn *fd2conn[], int server_socket);
+void update_conn_events(Conn *conn);
+void close_connection(Conn *fd2conn[], Conn *conn);
 void connection_io(Conn *conn);
 bool try_process_single_request(Conn *conn);
+int process_buffered_requests(Conn *conn);
 bool try_fill_read_buffer(Conn *conn);
 bool try_flush_write_buffer(Conn *conn);
 void state_req(Conn *conn);
 void state_resp(Conn *conn);
 
-char *get_response(ValueType type, void *value);
-char *null_response();
-char *error_response(char *err_msg);
-char *avl_iterate_response(AVLNode *tree, AVLNode *start, long limit);
+void buffer_reserve(char **buffer, int *capacity, int needed);
+void buffer_shrink(char **buffer, int *capacity);
+bool reply_queue_full(Conn *conn);
+void reply_queue_free(Conn *conn);
 
-Command *parse_cmd_string(char *cmd_string, int size);
-char *execute_command(Command *cmd, bool aof_restore);
+// reply builder, replies are serialized straight into the output queue of the connection
+void shared_replies_init();
+char *reply_reserve(Conn *conn, int size);
+void add_reply_bulk(Conn *conn, SerialType type, const void *value, int value_len);
+void add_reply_shared(Conn *conn, SharedReply *reply);
+void add_reply_str(Conn *conn, const char *str);
+void add_reply_int(Conn *conn, int value);
+void add_reply_float(Conn *conn, float value);
+void add_reply_nil(Conn *conn);
+void add_reply_error(Conn *conn, const char *err_msg);
+void add_reply_value(Conn *conn, ValueType type, void *value);
+void add_reply_array_len(Conn *conn, int num_elements);
+char *add_reply_deferred_array_len(Conn *conn);
+void set_deferred_array_len(char *header, int num_elements);
+void zset_iterate_response(Conn *conn, ZSet *zset, long start, long limit, bool reverse);
+
+int parse_cmd_string(char *cmd_string, int size, Command *cmd);
+void command_free(Command *cmd);
+void execute_command(Conn *conn, Command *cmd, bool aof_restore);
 
 void global_table_del(char *key, char *value, ValueType type);
-char *exists_command(Command *cmd);
-char *del_command(Command *cmd, bool aof_restore);
-char *keys_command();
-char *flushall_cmd(Command *cmd, bool aof_restore);
-
-char *get_command(Command *cmd);
-char *set_command(Command *cmd, bool aof_restore);
-
-char *hexists_command(Command *cmd);
-char *hset_command(Command *cmd, bool aof_restore);
-char *hget_command(Command *cmd);
-char *hdel_command(Command *cmd, bool aof_restore);
-char *hgetall_command(Command *cmd);
-
-char *lexists_command(Command *cmd);
-char *lpush_command(Command *cmd, bool aof_restore);
-char *rpush_command(Command *cmd, bool aof_restore);
-char *lpop_command(Command *cmd, bool aof_restore);
-char *rpop_command(Command *cmd, bool aof_restore);
-char *lrem_command(Command *cmd, bool aof_restore);
-char *llen_cmd(Command *cmd);
-char *lrange_cmd(Command *cmd);
-char *ltrim_cmd(Command *cmd, bool aof_restore);
-char *lset_cmd(Command *cmd, bool aof_restore);
-
-char *zadd_command(Command *cmd, bool aof_restore);
-char *zrem_command(Command *cmd, bool aof_restore);
-char *zscore_cmd(Command *cmd);
-char *zquery_cmd(Command *cmd);
-
-void aof_restore_db();
+void value_free_contents(void *value, ValueType type);
+bool ping_command(Conn *conn, Command *cmd);
+bool exists_command(Conn *conn, Command *cmd);
+bool del_command(Conn *conn, Command *cmd);
+bool keys_command(Conn *conn, Command *cmd);
+bool flushall_cmd(Conn *conn, Command *cmd);
+
+bool get_command(Conn *conn, Command *cmd);
+bool set_command(Conn *conn, Command *cmd);
+bool mget_command(Conn *conn, Command *cmd);
+bool mset_command(Conn *conn, Command *cmd);
+
+bool hexists_command(Conn *conn, Command *cmd);
+bool hset_command(Conn *conn, Command *cmd);
+bool hget_command(Conn *conn, Command *cmd);
+bool hmset_command(Conn *conn, Command *cmd);
+bool hmget_command(Conn *conn, Command *cmd);
+bool hdel_command(Conn *conn, Command *cmd);
+bool hgetall_command(Conn *conn, Command *cmd);
+
+bool lexists_command(Conn *conn, Command *cmd);
+bool lpush_command(Conn *conn, Command *cmd);
+bool rpush_command(Conn *conn, Command *cmd);
+bool lpop_command(Conn *conn, Command *cmd);
+bool rpop_command(Conn *conn, Command *cmd);
+bool lrem_command(Conn *conn, Command *cmd);
+bool llen_cmd(Conn *conn, Command *cmd);
+bool lrange_cmd(Conn *conn, Command *cmd);
+bool ltrim_cmd(Conn *conn, Command *cmd);
+bool lset_cmd(Conn *conn, Command *cmd);
+bool lindex_cmd(Conn *conn, Command *cmd);
+bool linsert_command(Conn *conn, Command *cmd);
+bool lmove_command(Conn *conn, Command *cmd);
+bool rpoplpush_command(Conn *conn, Command *cmd);
+bool blpop_command(Conn *conn, Command *cmd);
+bool brpop_command(Conn *conn, Command *cmd);
+
+bool zadd_command(Conn *conn, Command *cmd);
+bool zrem_command(Conn *conn, Command *cmd);
+bool zscore_cmd(Conn *conn, Command *cmd);
+bool zmscore_cmd(Conn *conn, Command *cmd);
+bool zcard_cmd(Conn *conn, Command *cmd);
+bool zrank_cmd(Conn *conn, Command *cmd);
+bool zrevrank_cmd(Conn *conn, Command *cmd);
+bool zcount_cmd(Conn *conn, Command *cmd);
+bool zquery_cmd(Conn *conn, Command *cmd);
+bool zrevrange_cmd(Conn *conn, Command *cmd);
+bool zrangebyscore_cmd(Conn *conn, Command *cmd);
+bool zremrangebyrank_cmd(Conn *conn, Command *cmd);
+bool zremrangebyscore_cmd(Conn *conn, Command *cmd);
+
+void lazy_free_nodes(SkipListNode *nodes);
+bool lazy_free_step(int count);
+
+// blocking list pops, see blpop_command()
+void release_blocked_conn(Conn *conn);
+void signal_list_ready(char *key);
+void serve_blocked_conns(bool aof_restore);
+int blocked_conns_timeout(int timeout);
+void expire_blocked_conns();
+void process_unblocked_conns();
+
+// every command, X(name, handler, min_args, max_args, flags, usage). The arguments exclude the command name, a max_args of -1 means there is no upper bound, usage lists the arguments in the error reply of a call with the wrong number of them
+#define COMMAND_TABLE(X)                                                                                      \
+    X("PING", ping_command, 0, -1, CMD_READ, "")                                                              \
+    X("EXISTS", exists_command, 1, 1, CMD_READ, "(key)")                                                      \
+    X("DEL", del_command, 1, 1, CMD_WRITE | CMD_AOF, "(key)")                                                 \
+    X("KEYS", keys_command, 0, -1, CMD_READ, "")                                                              \
+    X("FLUSHALL", flushall_cmd, 0, -1, CMD_WRITE | CMD_AOF, "")                                               \
+    X("GET", get_command, 1, 1, CMD_READ, "(key)")                                                            \
+    X("SET", set_command, 2, 2, CMD_WRITE | CMD_AOF, "(key, value)")                                          \
+    X("MGET", mget_command, 1, -1, CMD_READ, "(key, ...)")                                                    \
+    X("MSET", mset_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, value, ...)")                                  \
+    X("HEXISTS", hexists_command, 2, -1, CMD_READ, "(key, field)")                                            \
+    X("HSET", hset_command, 3, -1, CMD_WRITE | CMD_AOF, "(key, field, value)")                                \
+    X("HGET", hget_command, 2, -1, CMD_READ, "(key, field)")                                                  \
+    X("HMSET", hmset_command, 3, -1, CMD_WRITE | CMD_AOF, "(key, field, value, ...)")                         \
+    X("HMGET", hmget_command, 2, -1, CMD_READ, "(key, field, ...)")                                           \
+    X("HDEL", hdel_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, field)")                                       \
+    X("HGETALL", hgetall_command, 1, -1, CMD_READ, "(key)")                                                   \
+    X("LEXISTS", lexists_command, 2, -1, CMD_READ, "(key, value)")                                            \
+    X("LPUSH", lpush_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, value, ...)")                                \
+    X("RPUSH", rpush_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, value, ...)")                                \
+    X("LPOP", lpop_command, 1, -1, CMD_WRITE | CMD_AOF, "(key)")                                              \
+    X("RPOP", rpop_command, 1, -1, CMD_WRITE | CMD_AOF, "(key)")                                              \
+    X("LREM", lrem_command, 3, -1, CMD_WRITE | CMD_AOF, "(key, count, value)")                                \
+    X("LLEN", llen_cmd, 1, -1, CMD_READ, "(key)")                                                             \
+    X("LRANGE", lrange_cmd, 3, -1, CMD_READ, "(key, start, stop)")                                            \
+    X("LTRIM", ltrim_cmd, 3, -1, CMD_WRITE | CMD_AOF, "(key, start, stop)")                                   \
+    X("LSET", lset_cmd, 3, -1, CMD_WRITE | CMD_AOF, "(key, index, value)")                                    \
+    X("LINDEX", lindex_cmd, 2, 2, CMD_READ, "(key, index)")                                                   \
+    X("LINSERT", linsert_command, 4, 4, CMD_WRITE | CMD_AOF, "(key, BEFORE | AFTER, pivot, value)")           \
+    X("LMOVE", lmove_command, 4, 4, CMD_WRITE | CMD_AOF, "(source, destination, LEFT | RIGHT, LEFT | RIGHT)") \
+    X("RPOPLPUSH", rpoplpush_command, 2, 2, CMD_WRITE | CMD_AOF, "(source, destination)")                     \
+    X("BLPOP", blpop_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, ..., timeout)")                              \
+    X("BRPOP", brpop_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, ..., timeout)")                              \
+    X("ZADD", zadd_command, 3, -1, CMD_WRITE | CMD_AOF, "(key, score, name, ...)")                            \
+    X("ZREM", zrem_command, 2, -1, CMD_WRITE | CMD_AOF, "(key, name)")                                        \
+    X("ZSCORE", zscore_cmd, 2, -1, CMD_READ, "(key, name)")                                                   \
+    X("ZMSCORE", zmscore_cmd, 2, -1, CMD_READ, "(key, name, ...)")                                            \
+    X("ZCARD", zcard_cmd, 1, 1, CMD_READ, "(key)")                                                            \
+    X("ZRANK", zrank_cmd, 2, 2, CMD_READ, "(key, name)")                                                      \
+    X("ZREVRANK", zrevrank_cmd, 2, 2, CMD_READ, "(key, name)")                                                \
+    X("ZCOUNT", zcount_cmd, 3, 3, CMD_READ, "(key, min, max)")                                                \
+    X("ZQUERY", zquery_cmd, 5, -1, CMD_READ, "(key, score, name, offset, limit)")                             \
+    X("ZREVRANGE", zrevrange_cmd, 3, 3, CMD_READ, "(key, start, stop)")                                       \
+    X("ZRANGEBYSCORE", zrangebyscore_cmd, 3, 6, CMD_READ, "(key, min, max, [LIMIT, offset, count])")          \
+    X("ZREMRANGEBYRANK", zremrangebyrank_cmd, 3, 3, CMD_WRITE | CMD_AOF, "(key, start, stop)")                \
+    X("ZREMRANGEBYSCORE", zremrangebyscore_cmd, 3, 3, CMD_WRITE | CMD_AOF, "(key, min, max)")
+
+void command_table_init();
+CommandDef *lookup_command(const char *name);
+
+bool aof_restore_db();
 void handle_aof_write(Command *cmd);
 
 // Global variables (usually avoid, but okay here since no function depends on a specific state of the global table or aof, behaves)
 extern HashTable *global_table;
+extern HashTable *blocking_keys;
 extern AOF *global_aof;
 extern pthread_t aof_thread;
 extern int server_socket;
+extern int epoll_fd;
+extern int max_message_size;
+extern bool debug_mode;
+extern int hash_max_listpack_entries;
+extern int hash_max_listpack_value;
 extern Conn *fd2conn[MAX_CLIENTS];
+extern SharedReplies shared;
+extern CommandDef command_table[];
+extern const int num_commands;
 
 #endif
\ No newline at end of file
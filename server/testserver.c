@@ -2,8 +2,50 @@
 #include "server.h"
 #include <assert.h>
 
+// connection the replies are written to in the tests, it is never attached to a socket
+Conn *conn;
+
+// copy the replies queued on the test connection into a null terminated buffer and empty the queue
+char *test_reply(Conn *conn)
+{
+    char *reply = calloc(conn->reply_queued + 1, sizeof(char));
+    int offset = 0;
+
+    for (ReplyBlock *block = conn->reply_head; block; block = block->next)
+    {
+        memcpy(reply + offset, block->data, block->size);
+        offset += block->size;
+    }
+
+    reply_queue_free(conn);
+
+    return reply;
+}
+
+// parse a command from a string literal, the parser writes into the message so it is copied first
+Command *test_parse(char *cmd_string)
+{
+    int size = strlen(cmd_string);
+
+    char *message = malloc(size + 1);
+    memcpy(message, cmd_string, size + 1);
+
+    Command *cmd = malloc(sizeof(Command));
+    parse_cmd_string(message, size, cmd);
+
+    return cmd;
+}
+
+// append a length-prefixed argument to a framed request message
+int test_frame_arg(char *message, int offset, char *arg, int len)
+{
+    memcpy(message + offset, &len, 4);
+    memcpy(message + offset + 4, arg, len);
+    return offset + 4 + len;
+}
+
 // test the server functions
-bool test_get_response()
+bool test_add_reply_value()
 {
     // test string
     ValueType type = STRING;
@@ -14,7 +56,8 @@ bool test_get_response()
 
     char *response;
 
-    response = get_response(type, value);
+    add_reply_value(conn, type, value);
+    response = test_reply(conn);
 
     // check first byte
     memcpy(&response_type, response, 1);
@@ -42,7 +85,8 @@ bool test_get_response()
     int i = 123;
     value = &i;
 
-    response = get_response(type, value);
+    add_reply_value(conn, type, value);
+    response = test_reply(conn);
 
     // check first byte
     memcpy(&response_type, response, 1);
@@ -70,7 +114,8 @@ bool test_get_response()
     float f = 123.456;
     value = &f;
 
-    response = get_response(type, value);
+    add_reply_value(conn, type, value);
+    response = test_reply(conn);
 
     // check first byte
     memcpy(&response_type, response, 1);
@@ -93,15 +138,27 @@ bool test_get_response()
         return false;
     }
 
+    // test an integer that is too large for the shared replies
+    i = SHARED_INTEGERS + 1;
+    add_reply_int(conn, i);
+    response = test_reply(conn);
+
+    if (response[0] != SER_INT || *(int *)(response + 5) != i)
+    {
+        fprintf(stderr, "large integer response value should be %d\n", i);
+        return false;
+    }
+
     // all tests passed
     return true;
 }
 
 // ! Don't have to unit test all fucntions, some are covered by integration tests
 
-bool test_null_response()
+bool test_add_reply_nil()
 {
-    char *response = null_response();
+    add_reply_nil(conn);
+    char *response = test_reply(conn);
 
     SerialType type = 0;
 
@@ -122,9 +179,10 @@ bool test_null_response()
     return true;
 }
 
-bool test_error_response()
+bool test_add_reply_error()
 {
-    char *response = error_response("error message");
+    add_reply_error(conn, "error message");
+    char *response = test_reply(conn);
 
     SerialType type = 0;
 
@@ -151,22 +209,26 @@ bool test_error_response()
     return true;
 }
 
-bool test_avl_iterate_response()
+bool test_zset_iterate_response()
 {
 
-    // create AVL tree
-    AVLNode *root = avl_init("1", 1);
-    avl_insert(root, "2", 2);
-    avl_insert(root, "3", 3);
+    // create a sorted set with a skiplist
+    ZSet *zset = zset_init();
+    zset_max_packed_entries = 0;
+    zset_add(zset, "1", 1);
+    zset_add(zset, "2", 2);
+    zset_add(zset, "3", 3);
+    zset_max_packed_entries = ZSET_MAX_PACKED_ENTRIES;
 
-    AVLNode *start = avl_search_float(root, 1);
-    if (start == NULL)
+    int start = zset_rank_of_score(zset, 1);
+    if (start != 0 || zset_is_packed(zset))
     {
         fprintf(stderr, "node with key 1 not found\n");
         return false;
     }
 
-    char *response = avl_iterate_response(root, start, 2);
+    zset_iterate_response(conn, zset, start, 2, false);
+    char *response = test_reply(conn);
 
     // check first byte
     if (response[0] != SER_ARR)
@@ -189,13 +251,15 @@ bool test_avl_iterate_response()
         return false;
     }
 
+    zset_free_contents(zset);
+    free(zset);
+
     return true;
 }
 
 bool test_parse_cmd_string()
 {
-    char *cmd_string = "SET key";
-    Command *cmd = parse_cmd_string(cmd_string, strlen(cmd_string));
+    Command *cmd = test_parse("SET key");
 
     if (strcmp(cmd->name, "SET") != 0)
     {
@@ -215,6 +279,114 @@ bool test_parse_cmd_string()
         return false;
     }
 
+    // consecutive spaces are skipped
+    cmd = test_parse("  HSET  hash field   value ");
+    if (strcmp(cmd->name, "HSET") != 0 || cmd->num_args != 3 || strcmp(cmd->args[2], "value") != 0 || cmd->arg_lens[2] != 5)
+    {
+        fprintf(stderr, "spaces between tokens should be skipped\n");
+        return false;
+    }
+
+    return true;
+}
+
+// build a framed SET request whose value contains spaces and a newline, returns the size of the message
+int test_set_frame(char *message)
+{
+    int num_args = 3;
+    message[0] = FRAME_MARKER;
+    memcpy(message + 1, &num_args, 4);
+
+    int size = test_frame_arg(message, 1 + 4, "SET", 3);
+    size = test_frame_arg(message, size, "key", 3);
+    return test_frame_arg(message, size, "a value\nwith spaces", 19);
+}
+
+bool test_parse_framed_cmd()
+{
+    char message[1024];
+    Command cmd;
+
+    // an argument running past the end of the message is rejected
+    int size = test_set_frame(message);
+    if (parse_cmd_string(message, size - 1, &cmd) != -1)
+    {
+        fprintf(stderr, "truncated framed command should be rejected\n");
+        return false;
+    }
+    command_free(&cmd);
+
+    // the value is kept as a single argument, the parser overwrote the length prefixes so the message is built again
+    size = test_set_frame(message);
+    if (parse_cmd_string(message, size, &cmd) < 0)
+    {
+        fprintf(stderr, "framed command should parse\n");
+        return false;
+    }
+
+    if (strcmp(cmd.name, "SET") != 0 || cmd.num_args != 2 || strcmp(cmd.args[0], "key") != 0)
+    {
+        fprintf(stderr, "framed command name and key are wrong\n");
+        return false;
+    }
+
+    if (strcmp(cmd.args[1], "a value\nwith spaces") != 0 || cmd.arg_lens[1] != 19)
+    {
+        fprintf(stderr, "framed value should keep its spaces\n");
+        return false;
+    }
+
+    // the arguments point into the message, nothing was copied
+    if (cmd.args[0] < message || cmd.args[0] >= message + size)
+    {
+        fprintf(stderr, "framed arguments should point into the message\n");
+        return false;
+    }
+    command_free(&cmd);
+
+    // a null byte in an argument is refused, the commands would store the argument cut short at it
+    size = test_set_frame(message);
+    message[size - 5] = '\0';
+    if (parse_cmd_string(message, size, &cmd) != -2)
+    {
+        fprintf(stderr, "framed argument with a null byte should be rejected\n");
+        return false;
+    }
+    command_free(&cmd);
+
+    // more arguments than fit inline spill to the heap
+    int num_args = 1 + 2 * CMD_INLINE_ARGS;
+    memcpy(message + 1, &num_args, 4);
+    size = test_frame_arg(message, 1 + 4, "MSET", 4);
+    for (int i = 1; i < num_args; i++)
+    {
+        char arg[16];
+        int len = sprintf(arg, "arg%d", i);
+        size = test_frame_arg(message, size, arg, len);
+    }
+
+    if (parse_cmd_string(message, size, &cmd) < 0 || cmd.num_args != num_args - 1)
+    {
+        fprintf(stderr, "framed command with many arguments should parse\n");
+        return false;
+    }
+
+    if (strcmp(cmd.args[num_args - 2], "arg32") != 0)
+    {
+        fprintf(stderr, "last spilled argument is wrong\n");
+        return false;
+    }
+    command_free(&cmd);
+
+    // a command string with a null byte is refused as well
+    memcpy(message, "SET key a\0b", 11);
+    if (parse_cmd_string(message, 11, &cmd) != -2)
+    {
+        fprintf(stderr, "command string with a null byte should be rejected\n");
+        return false;
+    }
+    command_free(&cmd);
+
     return true;
 }
 
@@ -234,11 +406,9 @@ bool test_string_commands()
     test_init();
 
     char *cmdString = "SET key value";
-    // set this to true, don't want to write to aof file in a tests
-    bool aof_restore = true;
 
-    Command *cmd = parse_cmd_string(cmdString, 13);
-    set_command(cmd, aof_restore);
+    Command *cmd = test_parse(cmdString);
+    set_command(NULL, cmd);
 
     // check if global table has the key
     HashNode *fetched_node = hget(global_table, "key");
@@ -256,8 +426,8 @@ bool test_string_commands()
 
     // test del command
     cmdString = "DEL key";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    del_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    del_command(NULL, cmd);
 
     // check if key was deleted
     fetched_node = hget(global_table, "key");
@@ -277,8 +447,9 @@ bool test_exists_command()
 {
     // test exists on key that does not exist
     char *cmdStringExists = "EXISTS key";
-    Command *cmdExists = parse_cmd_string(cmdStringExists, strlen(cmdStringExists));
-    char *existsResponse = exists_command(cmdExists);
+    Command *cmdExists = test_parse(cmdStringExists);
+    exists_command(conn, cmdExists);
+    char *existsResponse = test_reply(conn);
 
     if (existsResponse[0] != SER_INT)
     {
@@ -294,11 +465,12 @@ bool test_exists_command()
 
     // insert a key
     char *cmdStringSet = "SET key value";
-    Command *cmdSet = parse_cmd_string(cmdStringSet, strlen(cmdStringSet));
-    set_command(cmdSet, true);
+    Command *cmdSet = test_parse(cmdStringSet);
+    set_command(NULL, cmdSet);
 
     // test exists on key that exists
-    existsResponse = exists_command(cmdExists);
+    exists_command(conn, cmdExists);
+    existsResponse = test_reply(conn);
 
     if (existsResponse[0] != SER_INT)
     {
@@ -320,28 +492,27 @@ bool test_meta_commands()
 
     test_init();
 
-    // set this to true, don't want to write to aof file in a tests
-    bool aof_restore = true;
 
     // insert a string,hashtable, list, sorted set
     char *cmdString = "SET key value";
-    Command *cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    set_command(cmd, aof_restore);
+    Command *cmd = test_parse(cmdString);
+    set_command(NULL, cmd);
 
     cmdString = "HSET hash key value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    hset_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    hset_command(NULL, cmd);
 
     cmdString = "LPUSH list value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lpush_command(NULL, cmd);
 
     cmdString = "ZADD sortedset 1 value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    zadd_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    zadd_command(NULL, cmd);
 
     // test keys command
-    char *response = keys_command();
+    keys_command(conn, cmd);
+    char *response = test_reply(conn);
     if (response[0] != SER_ARR)
     {
         fprintf(stderr, "response type should be array\n");
@@ -357,8 +528,8 @@ bool test_meta_commands()
     // test del command
     cmdString = "DEL key";
 
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    del_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    del_command(NULL, cmd);
 
     // check if key was deleted
     HashNode *fetched_node = hget(global_table, "key");
@@ -370,8 +541,8 @@ bool test_meta_commands()
 
     // test flushall command
     cmdString = "FLUSHALL";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    flushall_cmd(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    flushall_cmd(NULL, cmd);
 
     // check if all keys were deleted
     int num_keys = global_table->size;
@@ -397,15 +568,13 @@ bool test_meta_commands()
 
 bool test_hashtable_commands()
 {
-    // set this to true, don't want to write to aof file in a tests
-    bool aof_restore = true;
 
     test_init();
 
     // test hset command
     char *cmdString = "HSET hash key value";
-    Command *cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    hset_command(cmd, aof_restore);
+    Command *cmd = test_parse(cmdString);
+    hset_command(NULL, cmd);
 
     // check if global table has the hash
     HashNode *fetched_node = hget(global_table, "hash");
@@ -415,15 +584,16 @@ bool test_hashtable_commands()
         return false;
     }
 
-    // check if hash has the key
-    HashNode *hash_node = hget(fetched_node->value, "key");
-    if (!hash_node)
+    // check if hash has the key, a small hash is packed into a listpack
+    Listpack *lp = fetched_node->value;
+    int value_len;
+    if (fetched_node->valueType != HASHPACK || lp->count != 2 || lp_find(lp, lp_first(lp), "key", 3, 1) != 0)
     {
         fprintf(stderr, "key not found in hash, was not set\n");
         return false;
     }
 
-    if (strcmp(hash_node->value, "value") != 0)
+    if (strncmp(lp_get(lp, lp_next(lp, 0), &value_len), "value", 5) != 0 || value_len != 5)
     {
         fprintf(stderr, "incorrect value set\n");
         return false;
@@ -431,8 +601,9 @@ bool test_hashtable_commands()
 
     // test hexists command
     cmdString = "HEXISTS hash key";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    char *response = hexists_command(cmd);
+    cmd = test_parse(cmdString);
+    hexists_command(conn, cmd);
+    char *response = test_reply(conn);
 
     if (response[0] != SER_INT)
     {
@@ -447,8 +618,9 @@ bool test_hashtable_commands()
 
     // test get command
     cmdString = "HGET hash key";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    response = hget_command(cmd);
+    cmd = test_parse(cmdString);
+    hget_command(conn, cmd);
+    response = test_reply(conn);
 
     if (response[0] != SER_STR)
     {
@@ -470,31 +642,78 @@ bool test_hashtable_commands()
 
     // test hdel command
     cmdString = "HDEL hash key";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    hdel_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    hdel_command(NULL, cmd);
 
     // check if key was deleted
-    hash_node = hget(fetched_node->value, "key");
-    if (hash_node)
+    if (((Listpack *)fetched_node->value)->count != 0)
     {
         fprintf(stderr, "key was not deleted\n");
         return false;
     }
 
+    // the hash is converted to a hash table once it has more fields than the threshold, and every field survives the conversion
+    char field[32];
+    char value[32];
+    char set_string[128];
+    for (int i = 0; i <= hash_max_listpack_entries; i++)
+    {
+        sprintf(set_string, "HSET hash field%d value%d", i, i);
+        hset_command(NULL, test_parse(set_string));
+
+        if ((fetched_node->valueType == HASHPACK) != (i < hash_max_listpack_entries))
+        {
+            fprintf(stderr, "hash was not converted at the threshold\n");
+            return false;
+        }
+    }
+
+    for (int i = 0; i <= hash_max_listpack_entries; i++)
+    {
+        sprintf(field, "field%d", i);
+        sprintf(value, "value%d", i);
+        HashNode *hash_node = hget(fetched_node->value, field);
+        if (!hash_node || strcmp(hash_node->value, value) != 0)
+        {
+            fprintf(stderr, "field %s lost in the conversion to a hash table\n", field);
+            return false;
+        }
+    }
+
+    // a value longer than the threshold converts a small hash as well
+    char long_value[HASH_MAX_LISTPACK_VALUE + 2];
+    memset(long_value, 'x', sizeof(long_value) - 1);
+    long_value[sizeof(long_value) - 1] = '\0';
+
+    hset_command(NULL, test_parse("HSET hash2 field value"));
+    fetched_node = hget(global_table, "hash2");
+    if (fetched_node->valueType != HASHPACK)
+    {
+        fprintf(stderr, "small hash should be packed\n");
+        return false;
+    }
+
+    sprintf(set_string, "HSET hash2 field %s", long_value);
+    hset_command(NULL, test_parse(set_string));
+    HashNode *hash_node = fetched_node->valueType == HASHTABLE ? hget(fetched_node->value, "field") : NULL;
+    if (!hash_node || strcmp(hash_node->value, long_value) != 0)
+    {
+        fprintf(stderr, "hash with a long value should be a hash table\n");
+        return false;
+    }
+
     return true;
 }
 
 bool test_list_commands()
 {
-    // set this to true, don't want to write to aof file in a tests
-    bool aof_restore = true;
 
     test_init();
 
     // test lpush command
     char *cmdString = "LPUSH list value";
-    Command *cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpush_command(cmd, aof_restore);
+    Command *cmd = test_parse(cmdString);
+    lpush_command(NULL, cmd);
 
     // check if global table has the list
     HashNode *fetched_node = hget(global_table, "list");
@@ -511,32 +730,33 @@ bool test_list_commands()
         return false;
     }
 
-    // check if list has the value
-    ListNode *list_node = list_iget(fetched_node->value, 0);
-    if (strcmp(list_node->data, "value") != 0)
+    // check if list has the value, the strings of a list are not null terminated
+    ListNode list_node;
+    list_iget(fetched_node->value, 0, &list_node);
+    if (list_node.len != 5 || memcmp(list_node.data, "value", 5) != 0)
     {
-        printf("%s\n", (char *)list_node->data);
+        printf("%.*s\n", list_node.len, (char *)list_node.data);
         fprintf(stderr, "value not found in list, was not set\n");
         return false;
     }
 
     // test rpush command
     cmdString = "RPUSH list value2";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    rpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    rpush_command(NULL, cmd);
 
-    list_node = list_iget(fetched_node->value, 1);
-    if (strcmp(list_node->data, "value2") != 0)
+    list_iget(fetched_node->value, 1, &list_node);
+    if (list_node.len != 6 || memcmp(list_node.data, "value2", 6) != 0)
     {
-        printf("String is %s\n", (char *)list_node->data);
+        printf("String is %.*s\n", list_node.len, (char *)list_node.data);
         fprintf(stderr, "value2 not found in list, was not set\n");
         return false;
     }
 
     // test lpop command
     cmdString = "LPOP list";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpop_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lpop_command(NULL, cmd);
 
     // check if list has size 1
     if (((List *)fetched_node->value)->size != 1)
@@ -547,8 +767,8 @@ bool test_list_commands()
 
     // test rpop command
     cmdString = "RPOP list";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    rpop_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    rpop_command(NULL, cmd);
 
     // check if list has size 0
     if (((List *)fetched_node->value)->size != 0)
@@ -559,8 +779,9 @@ bool test_list_commands()
 
     // test llen command
     cmdString = "LLEN list";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    char *response = llen_cmd(cmd);
+    cmd = test_parse(cmdString);
+    llen_cmd(conn, cmd);
+    char *response = test_reply(conn);
 
     if (response[0] != SER_INT)
     {
@@ -577,15 +798,15 @@ bool test_list_commands()
 
     // test lset
     cmdString = "LPUSH list value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lpush_command(NULL, cmd);
 
     cmdString = "LSET list 0 newvalue";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lset_cmd(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lset_cmd(NULL, cmd);
 
-    list_node = list_iget(fetched_node->value, 0);
-    if (strcmp(list_node->data, "newvalue") != 0)
+    list_iget(fetched_node->value, 0, &list_node);
+    if (list_node.len != 8 || memcmp(list_node.data, "newvalue", 8) != 0)
     {
         fprintf(stderr, "value not found in list, was not set\n");
         return false;
@@ -593,30 +814,30 @@ bool test_list_commands()
 
     // remove all elements
     cmdString = "LPOP list";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpop_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lpop_command(NULL, cmd);
 
     // test ltrim
     cmdString = "LPUSH list value2";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lpush_command(NULL, cmd);
 
     cmdString = "LPUSH list value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    lpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    lpush_command(NULL, cmd);
 
     cmdString = "RPUSH list value3";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    rpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    rpush_command(NULL, cmd);
 
     cmdString = "RPUSH list value4";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    rpush_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    rpush_command(NULL, cmd);
 
     // trim from 1 to 2
     cmdString = "LTRIM list 1 2";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    ltrim_cmd(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    ltrim_cmd(NULL, cmd);
 
     // check if list has size 1
     if (((List *)fetched_node->value)->size != 2)
@@ -626,40 +847,310 @@ bool test_list_commands()
     }
 
     // check first element
-    list_node = list_iget(fetched_node->value, 0);
-    if (strcmp(list_node->data, "value2") != 0)
+    list_iget(fetched_node->value, 0, &list_node);
+    if (list_node.len != 6 || memcmp(list_node.data, "value2", 6) != 0)
     {
         fprintf(stderr, "ltrim, value2 not found in list, was not set\n");
         return false;
     }
 
     // check second element
-    list_node = list_iget(fetched_node->value, 1);
-    if (strcmp(list_node->data, "value3") != 0)
+    list_iget(fetched_node->value, 1, &list_node);
+    if (list_node.len != 6 || memcmp(list_node.data, "value3", 6) != 0)
     {
 
-        printf("%s\n", (char *)list_node->data);
+        printf("%.*s\n", list_node.len, (char *)list_node.data);
         fprintf(stderr, "ltrim, value3 not found in list, was not set\n");
         return false;
     }
 
+    // test lrange over a list of many blocks, starting in the middle of one
+    for (int i = 0; i < 2000; i++)
+    {
+        char push_string[32];
+        sprintf(push_string, "RPUSH biglist item:%04d", i);
+        execute_command(conn, test_parse(push_string), true);
+    }
+    free(test_reply(conn));
+
+    execute_command(conn, test_parse("LRANGE biglist 1500 1502"), true);
+    response = test_reply(conn);
+
+    // "item:1500" is 1 + 4 + 9 bytes
+    char *element = response + 5;
+    if (response[0] != SER_ARR || *(int *)(response + 1) != 3 || strncmp(element + 5, "item:1500", 9) != 0 || strncmp(element + 33, "item:1502", 9) != 0)
+    {
+        fprintf(stderr, "lrange over many blocks is wrong\n");
+        return false;
+    }
+
+    // test lindex from the middle and from the end of the list
+    execute_command(conn, test_parse("LINDEX biglist 1234"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_STR || strncmp(response + 5, "item:1234", 9) != 0)
+    {
+        fprintf(stderr, "lindex should reply item:1234\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("LINDEX biglist -1"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_STR || strncmp(response + 5, "item:1999", 9) != 0)
+    {
+        fprintf(stderr, "lindex -1 should reply the last element\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("LINDEX biglist 2000"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_NIL)
+    {
+        fprintf(stderr, "lindex out of range should reply nil\n");
+        return false;
+    }
+
+    // test linsert after a pivot in the middle of the list, and before a pivot that is not in it
+    execute_command(conn, test_parse("LINSERT biglist AFTER item:1000 inserted"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_INT || *(int *)(response + 5) != 2001)
+    {
+        fprintf(stderr, "linsert should reply the new length\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("LINDEX biglist 1001"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_STR || strncmp(response + 5, "inserted", 8) != 0)
+    {
+        fprintf(stderr, "linsert should insert after the pivot\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("LINSERT biglist BEFORE missing inserted"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_INT || *(int *)(response + 5) != -1)
+    {
+        fprintf(stderr, "linsert with a missing pivot should reply -1\n");
+        return false;
+    }
+
+    // test lset with a negative index
+    execute_command(conn, test_parse("LSET biglist -2 newvalue"), true);
+    free(test_reply(conn));
+    execute_command(conn, test_parse("LINDEX biglist 1999"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_STR || strncmp(response + 5, "newvalue", 8) != 0)
+    {
+        fprintf(stderr, "lset -2 should set the element before the last one\n");
+        return false;
+    }
+
+    // test variadic pushes, lpush leaves the last value at the head
+    execute_command(conn, test_parse("LPUSH pushed a b c"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_INT || *(int *)(response + 5) != 3)
+    {
+        fprintf(stderr, "lpush should reply the number of values added\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("RPUSH pushed d e"), true);
+    free(test_reply(conn));
+    execute_command(conn, test_parse("LRANGE pushed 0 -1"), true);
+    response = test_reply(conn);
+
+    // every element is 1 + 4 + 1 bytes
+    const char *expected = "cbade";
+    element = response + 5;
+    for (int i = 0; i < 5; i++, element += 6)
+    {
+        if (response[0] != SER_ARR || *(int *)(response + 1) != 5 || element[5] != expected[i])
+        {
+            fprintf(stderr, "variadic pushes should give c b a d e\n");
+            return false;
+        }
+    }
+
+    // test lmove from the tail of one list to the head of a new one, and rotating a list onto itself
+    execute_command(conn, test_parse("LMOVE pushed moved RIGHT LEFT"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_STR || response[5] != 'e')
+    {
+        fprintf(stderr, "lmove should reply the element moved\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("LMOVE pushed pushed left right"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_STR || response[5] != 'c')
+    {
+        fprintf(stderr, "lmove onto the same list should rotate it\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("RPOPLPUSH pushed moved"), true);
+    free(test_reply(conn));
+    execute_command(conn, test_parse("LRANGE moved 0 -1"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_ARR || *(int *)(response + 1) != 2 || response[10] != 'c' || response[16] != 'e')
+    {
+        fprintf(stderr, "rpoplpush should push to the head of the destination\n");
+        return false;
+    }
+
+    // nothing is moved out of a missing list, and the destination is not created
+    execute_command(conn, test_parse("RPOPLPUSH missing created"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_NIL || hget(global_table, "created"))
+    {
+        fprintf(stderr, "rpoplpush from a missing list should reply nil\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("LMOVE pushed moved UP LEFT"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR)
+    {
+        fprintf(stderr, "lmove with a bad direction should reply an error\n");
+        return false;
+    }
+
     // reset global table
     test_reset();
 
     return true;
 }
 
+bool test_blocking_commands()
+{
+    test_init();
+
+    // a second connection that waits alongside the test connection, neither is attached to a socket
+    Conn *other = calloc(1, sizeof(Conn));
+    other->fd = -1;
+
+    // a list that is not empty is popped right away
+    execute_command(conn, test_parse("RPUSH jobs a b"), true);
+    free(test_reply(conn));
+
+    execute_command(conn, test_parse("BRPOP missing jobs 0"), true);
+    char *response = test_reply(conn);
+    char *element = response + 5;
+    if (response[0] != SER_ARR || *(int *)(response + 1) != 2 || strncmp(element + 5, "jobs", 4) != 0 || element[9 + 5] != 'b' || conn->state != STATE_REQ)
+    {
+        fprintf(stderr, "brpop on a list that is not empty should pop right away\n");
+        return false;
+    }
+    free(response);
+
+    // both connections block on empty lists, the oldest one is served first
+    execute_command(conn, test_parse("LPOP jobs"), true);
+    free(test_reply(conn));
+    execute_command(other, test_parse("BLPOP queue jobs 0"), true);
+    execute_command(conn, test_parse("BLPOP queue 0"), true);
+    if (conn->state != STATE_BLOCKED || other->state != STATE_BLOCKED || conn->reply_queued || other->reply_queued)
+    {
+        fprintf(stderr, "blpop on empty lists should block\n");
+        return false;
+    }
+
+    execute_command(NULL, test_parse("RPUSH queue first second"), true);
+
+    response = test_reply(other);
+    element = response + 5;
+    if (response[0] != SER_ARR || strncmp(element + 5, "queue", 5) != 0 || strncmp(element + 10 + 5, "first", 5) != 0 || other->state != STATE_REQ || other->blocked)
+    {
+        fprintf(stderr, "the oldest blocked connection should get the first element\n");
+        return false;
+    }
+    free(response);
+
+    response = test_reply(conn);
+    element = response + 5;
+    if (response[0] != SER_ARR || strncmp(element + 10 + 5, "second", 6) != 0 || conn->state != STATE_REQ)
+    {
+        fprintf(stderr, "the next blocked connection should get the second element\n");
+        return false;
+    }
+    free(response);
+
+    // the elements were handed over, and nobody waits on any key anymore
+    HashNode *queue_node = hget(global_table, "queue");
+    if (((List *)queue_node->value)->size != 0 || hget(blocking_keys, "queue") || hget(blocking_keys, "jobs"))
+    {
+        fprintf(stderr, "served connections should leave the wait queues\n");
+        return false;
+    }
+
+    // an element moved into a list serves a connection blocked on it
+    execute_command(conn, test_parse("BRPOP moved 0"), true);
+    execute_command(NULL, test_parse("RPUSH jobs job"), true);
+    execute_command(NULL, test_parse("LMOVE jobs moved LEFT LEFT"), true);
+    response = test_reply(conn);
+    element = response + 5;
+    if (response[0] != SER_ARR || strncmp(element + 10 + 5, "job", 3) != 0)
+    {
+        fprintf(stderr, "lmove should serve the connection blocked on the destination\n");
+        return false;
+    }
+    free(response);
+
+    // a wait with a timeout expires with a nil reply
+    execute_command(conn, test_parse("BRPOP empty 0.01"), true);
+    expire_blocked_conns();
+    if (conn->state != STATE_BLOCKED)
+    {
+        fprintf(stderr, "brpop should not time out early\n");
+        return false;
+    }
+
+    usleep(20000);
+    expire_blocked_conns();
+    response = test_reply(conn);
+    if (response[0] != SER_NIL || conn->state != STATE_REQ || hget(blocking_keys, "empty"))
+    {
+        fprintf(stderr, "brpop should reply nil once it times out\n");
+        return false;
+    }
+    free(response);
+
+    // a connection closed while it is blocked leaves the queues
+    execute_command(other, test_parse("BLPOP closed 5"), true);
+    release_blocked_conn(other);
+    if (hget(blocking_keys, "closed") || blocked_conns_timeout(1000) != 1000)
+    {
+        fprintf(stderr, "a released connection should leave the queues and the timers\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("BLPOP jobs -1"), true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR || conn->state != STATE_REQ)
+    {
+        fprintf(stderr, "blpop with a negative timeout should fail\n");
+        return false;
+    }
+    free(response);
+
+    // the test connections are never resumed
+    release_blocked_conn(conn);
+    release_blocked_conn(other);
+    free(other);
+
+    test_reset();
+
+    return true;
+}
+
 bool test_zset_commands()
 {
-    // set this to true, don't want to write to aof file in a tests
-    bool aof_restore = true;
 
     test_init();
 
     // test zadd command
     char *cmdString = "ZADD sortedset 1 value";
-    Command *cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    zadd_command(cmd, aof_restore);
+    Command *cmd = test_parse(cmdString);
+    zadd_command(NULL, cmd);
 
     // check if global table has the sorted set
     HashNode *fetched_node = hget(global_table, "sortedset");
@@ -670,8 +1161,8 @@ bool test_zset_commands()
     }
 
     // check if sorted set has the value
-    HashNode *hash_node = zset_search_by_key(fetched_node->value, "value");
-    if (!hash_node)
+    float *score = zset_score(fetched_node->value, "value");
+    if (!score || !zset_is_packed(fetched_node->value))
     {
         fprintf(stderr, "zset, value not found in sorted set, was not set\n");
         return false;
@@ -679,8 +1170,9 @@ bool test_zset_commands()
 
     // test zscore
     cmdString = "ZSCORE sortedset value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    char *response = zscore_cmd(cmd);
+    cmd = test_parse(cmdString);
+    zscore_cmd(conn, cmd);
+    char *response = test_reply(conn);
 
     if (response[0] != SER_FLOAT)
     {
@@ -696,12 +1188,12 @@ bool test_zset_commands()
 
     // test zrem
     cmdString = "ZREM sortedset value";
-    cmd = parse_cmd_string(cmdString, strlen(cmdString));
-    zrem_command(cmd, aof_restore);
+    cmd = test_parse(cmdString);
+    zrem_command(NULL, cmd);
 
     // check if key was deleted
-    hash_node = zset_search_by_key(fetched_node->value, "value");
-    if (hash_node)
+    score = zset_score(fetched_node->value, "value");
+    if (score)
     {
         fprintf(stderr, "value was not deleted\n");
         return false;
@@ -710,22 +1202,328 @@ bool test_zset_commands()
     // reset global table
     test_reset();
 
+    // a packed sorted set replies to every query exactly like one with a hash table and a skiplist, including members with equal scores and updated scores
+    char *zadds[] = {"3 c", "1 a", "2 h", "2 d", "5 e", "2 f", "4 a", "0 g", "2 b"};
+    char *queries[] = {"ZQUERY ranked 2 \"\" 0 1", "ZQUERY ranked -inf \"\" 0 100", "ZQUERY ranked -inf \"\" 2 3", "ZQUERY ranked 2 \"\" 0 10", "ZQUERY ranked 1.5 \"\" 0 2", "ZQUERY ranked 4.5 \"\" -2 3", "ZQUERY ranked 2 \"\" 1 2", "ZQUERY ranked 2 \"\" -1 2", "ZQUERY ranked 2 d 0 10", "ZQUERY ranked 2 h -3 2", "ZQUERY ranked 4 a 0 1", "ZQUERY ranked 3 \"\" 5 1", "ZQUERY ranked 7 \"\" 0 1", "ZQUERY ranked 1 a 0 1", "ZREVRANGE ranked 0 -1", "ZREVRANGE ranked 1 2", "ZREVRANGE ranked -2 100", "ZREVRANGE ranked 5 1", "ZRANGEBYSCORE ranked (1 2", "ZRANGEBYSCORE ranked -inf +inf LIMIT 2 3", "ZRANGEBYSCORE ranked 2 (2", "ZRANGEBYSCORE ranked 0 10 LIMIT 1 -1", "ZREMRANGEBYSCORE ranked (1 2", "ZREMRANGEBYRANK ranked -1 -1", "ZQUERY ranked -inf \"\" 0 100"};
+    int num_queries = sizeof(queries) / sizeof(queries[0]);
+    char *replies[2][sizeof(queries) / sizeof(queries[0])];
+    int reply_lens[2][sizeof(queries) / sizeof(queries[0])];
+    char cmd_string[64];
+
+    // the last queries remove elements, they run after the others
+    for (int encoding = 0; encoding < 2; encoding++)
+    {
+        test_init();
+        zset_max_packed_entries = encoding == 0 ? ZSET_MAX_PACKED_ENTRIES : 0;
+
+        for (int i = 0; i < (int)(sizeof(zadds) / sizeof(zadds[0])); i++)
+        {
+            sprintf(cmd_string, "ZADD ranked %s", zadds[i]);
+            zadd_command(NULL, test_parse(cmd_string));
+        }
+        zrem_command(NULL, test_parse("ZREM ranked c"));
+
+        if (zset_is_packed(hget(global_table, "ranked")->value) != (encoding == 0))
+        {
+            fprintf(stderr, "zset, wrong encoding\n");
+            return false;
+        }
+
+        for (int i = 0; i < num_queries; i++)
+        {
+            execute_command(conn, test_parse(queries[i]), true);
+            reply_lens[encoding][i] = conn->reply_queued;
+            replies[encoding][i] = test_reply(conn);
+
+            if (encoding == 1 && (reply_lens[0][i] != reply_lens[1][i] || memcmp(replies[0][i], replies[1][i], reply_lens[1][i]) != 0))
+            {
+                fprintf(stderr, "zset, %s replies differently when packed\n", queries[i]);
+                return false;
+            }
+        }
+
+        // members with equal scores are ordered by name, not by insertion, b is the first member after the array header and the string header
+        if (replies[encoding][0][10] != 'b')
+        {
+            fprintf(stderr, "zset, equal scores not ordered by member\n");
+            return false;
+        }
+
+        test_reset();
+    }
+
+    zset_max_packed_entries = ZSET_MAX_PACKED_ENTRIES;
+
+    // a packed sorted set is converted once it has more members than the threshold
+    test_init();
+    for (int i = 0; i <= ZSET_MAX_PACKED_ENTRIES; i++)
+    {
+        sprintf(cmd_string, "ZADD big %d m%d", i % 7, i);
+        zadd_command(NULL, test_parse(cmd_string));
+    }
+
+    ZSet *big = hget(global_table, "big")->value;
+    if (zset_is_packed(big) || big->hash_table->size != ZSET_MAX_PACKED_ENTRIES + 1 || big->skiplist->length != ZSET_MAX_PACKED_ENTRIES + 1 || *zset_score(big, "m13") != 6)
+    {
+        fprintf(stderr, "zset, conversion lost members\n");
+        return false;
+    }
+
+    // ranks and counts, the members with score 0 are m0, m14, m21, ..., m63 and m7 in order, nil is -1
+    char *rank_cmds[] = {"ZCARD big", "ZCARD missing", "ZRANK big m0", "ZRANK big m7", "ZRANK big m8", "ZRANK big m1", "ZREVRANK big m0", "ZRANK big missing", "ZRANK missing m0", "ZCOUNT big 2 (4", "ZCOUNT big -inf +inf", "ZCOUNT big (0 0", "ZCOUNT big 6 2", "ZCOUNT missing 0 1"};
+    int rank_replies[] = {65, 0, 0, 9, 19, 10, 64, -1, -1, 18, 65, 0, 0, 0};
+    for (int i = 0; i < (int)(sizeof(rank_cmds) / sizeof(rank_cmds[0])); i++)
+    {
+        execute_command(conn, test_parse(rank_cmds[i]), false);
+        response = test_reply(conn);
+        if (rank_replies[i] < 0 ? response[0] != SER_NIL : (response[0] != SER_INT || *(int *)(response + 5) != rank_replies[i]))
+        {
+            fprintf(stderr, "zset, %s replied wrong\n", rank_cmds[i]);
+            return false;
+        }
+    }
+
+    // a ZADD of many pairs builds a new sorted set at once, the last score of a repeated name wins
+    char multi_string[2048] = "ZADD multi";
+    for (int i = 0; i < 2 * ZSET_MAX_PACKED_ENTRIES; i++)
+    {
+        sprintf(multi_string + strlen(multi_string), " %d m%d", i % 7, i % (ZSET_MAX_PACKED_ENTRIES + 1));
+    }
+
+    execute_command(conn, test_parse(multi_string), true);
+    response = test_reply(conn);
+    ZSet *multi = hget(global_table, "multi")->value;
+    if (response[0] != SER_INT || *(int *)(response + 5) != 2 * ZSET_MAX_PACKED_ENTRIES || zset_length(multi) != ZSET_MAX_PACKED_ENTRIES + 1 || *zset_score(multi, "m0") != (ZSET_MAX_PACKED_ENTRIES + 1) % 7 || *zset_score(multi, "m13") != 1 || zset_is_packed(multi))
+    {
+        fprintf(stderr, "zset, ZADD of many pairs is wrong\n");
+        return false;
+    }
+
+    execute_command(conn, test_parse("ZADD multi 1 a 2"), true);
+    if (test_reply(conn)[0] != SER_ERR || zset_score(multi, "a"))
+    {
+        fprintf(stderr, "zset, ZADD with a score without a name should fail\n");
+        return false;
+    }
+
+    // a score out of the range of a float or NaN is refused, nothing of the command is added
+    char *bad_scores[] = {"ZADD multi 1 a 1e50 b", "ZADD multi 1 a -1e-50 b", "ZADD multi nan a", "ZADD bad 1 a NaN b"};
+    for (int i = 0; i < (int)(sizeof(bad_scores) / sizeof(bad_scores[0])); i++)
+    {
+        execute_command(conn, test_parse(bad_scores[i]), true);
+        if (test_reply(conn)[0] != SER_ERR || zset_score(multi, "a") || hget(global_table, "bad"))
+        {
+            fprintf(stderr, "zset, %s should fail\n", bad_scores[i]);
+            return false;
+        }
+    }
+
+    execute_command(conn, test_parse("ZCOUNT big 1 x"), false);
+    if (test_reply(conn)[0] != SER_ERR)
+    {
+        fprintf(stderr, "zset, ZCOUNT with an invalid bound should fail\n");
+        return false;
+    }
+
+    test_reset();
+
+    return true;
+}
+
+bool test_execute_command()
+{
+    test_init();
+
+    // the stats count every call since the start of the tests
+    long set_calls = lookup_command("SET")->stats.calls;
+    long hget_failed = lookup_command("HGET")->stats.failed;
+
+    // command names are matched case insensitively
+    Command *cmd = test_parse("set key value");
+    execute_command(conn, cmd, true);
+    char *response = test_reply(conn);
+    if (response[0] != SER_NIL || !hget(global_table, "key"))
+    {
+        fprintf(stderr, "lowercase set should be dispatched\n");
+        return false;
+    }
+
+    CommandDef *def = lookup_command("Set");
+    if (!def || def->handler != set_command || def->stats.calls != set_calls + 1)
+    {
+        fprintf(stderr, "set should be found and counted\n");
+        return false;
+    }
+
+    // the arity is checked before the handler is called
+    cmd = test_parse("SET key");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR || strcmp(response + 5, "set command requires 2 arguments (key, value)") != 0)
+    {
+        fprintf(stderr, "set with one argument should reply with the arity error\n");
+        return false;
+    }
+
+    if (def->stats.calls != set_calls + 1)
+    {
+        fprintf(stderr, "calls rejected by the arity check should not be counted\n");
+        return false;
+    }
+
+    // a handler replying with an error counts as a failed call
+    cmd = test_parse("HGET key field");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR || lookup_command("HGET")->stats.failed != hget_failed + 1)
+    {
+        fprintf(stderr, "hget on a string should fail\n");
+        return false;
+    }
+
+    cmd = test_parse("NOSUCHCOMMAND key");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR || strcmp(response + 5, "Unknown command") != 0)
+    {
+        fprintf(stderr, "unknown command should be rejected\n");
+        return false;
+    }
+
+    test_reset();
+
+    return true;
+}
+
+bool test_batch_commands()
+{
+    test_init();
+
+    // MSET then MGET, a missing key is nil
+    Command *cmd = test_parse("MSET a 1 b 2");
+    execute_command(conn, cmd, true);
+    char *response = test_reply(conn);
+    if (response[0] != SER_NIL)
+    {
+        fprintf(stderr, "mset should reply nil\n");
+        return false;
+    }
+
+    cmd = test_parse("MGET a missing b");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ARR || *(int *)(response + 1) != 3)
+    {
+        fprintf(stderr, "mget should reply an array of 3 elements\n");
+        return false;
+    }
+
+    // "1" is 1 + 4 + 1 bytes, nil is 1 + 4 bytes
+    char *element = response + 5;
+    if (element[0] != SER_STR || element[5] != '1' || element[6] != SER_NIL || element[11] != SER_STR || element[16] != '2')
+    {
+        fprintf(stderr, "mget elements are wrong\n");
+        return false;
+    }
+
+    // MSET fails if a key exists and sets none of its keys
+    cmd = test_parse("MSET c 3 a 4");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR || hget(global_table, "c") || strcmp(hget(global_table, "a")->value, "1") != 0)
+    {
+        fprintf(stderr, "failed mset should leave the database untouched\n");
+        return false;
+    }
+
+    cmd = test_parse("MSET a");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR)
+    {
+        fprintf(stderr, "mset without a value should fail\n");
+        return false;
+    }
+
+    // HMSET then HMGET
+    cmd = test_parse("HMSET hash f1 v1 f2 v2");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_INT || *(int *)(response + 5) != 2)
+    {
+        fprintf(stderr, "hmset should set 2 fields\n");
+        return false;
+    }
+
+    cmd = test_parse("HMGET hash f2 missing");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    element = response + 5;
+    if (response[0] != SER_ARR || *(int *)(response + 1) != 2 || element[0] != SER_STR || strncmp(element + 5, "v2", 2) != 0 || element[7] != SER_NIL)
+    {
+        fprintf(stderr, "hmget elements are wrong\n");
+        return false;
+    }
+
+    cmd = test_parse("HMGET a f1");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    if (response[0] != SER_ERR)
+    {
+        fprintf(stderr, "hmget on a string should fail\n");
+        return false;
+    }
+
+    // ZMSCORE
+    cmd = test_parse("ZADD zset 1.5 m");
+    execute_command(conn, cmd, true);
+    test_reply(conn);
+
+    cmd = test_parse("ZMSCORE zset missing m");
+    execute_command(conn, cmd, true);
+    response = test_reply(conn);
+    element = response + 5;
+    if (response[0] != SER_ARR || *(int *)(response + 1) != 2 || element[0] != SER_NIL || element[5] != SER_FLOAT || *(float *)(element + 10) != 1.5)
+    {
+        fprintf(stderr, "zmscore elements are wrong\n");
+        return false;
+    }
+
+    test_reset();
+
     return true;
 }
 
 int main()
 {
 
-    assert(test_get_response());
-    assert(test_null_response());
-    assert(test_error_response());
-    assert(test_avl_iterate_response());
+    conn = calloc(1, sizeof(Conn));
+    conn->fd = -1;
+    shared_replies_init();
+    command_table_init();
+
+    assert(test_add_reply_value());
+    assert(test_add_reply_nil());
+    assert(test_add_reply_error());
+    assert(test_zset_iterate_response());
     assert(test_parse_cmd_string());
-    assert(test_string_commands());
-    assert(test_hashtable_commands());
-    assert(test_list_commands());
-    assert(test_zset_commands());
-    assert(test_meta_commands());
+    assert(test_parse_framed_cmd());
+
+    // the commands are tested with every hash table engine
+    HashEngine engines[] = {HASH_ENGINE_CHAINED, HASH_ENGINE_SWISS};
+    for (int i = 0; i < 2; i++)
+    {
+        hset_engine(engines[i]);
+
+        assert(test_string_commands());
+        assert(test_hashtable_commands());
+        assert(test_list_commands());
+        assert(test_blocking_commands());
+        assert(test_zset_commands());
+        assert(test_meta_commands());
+        assert(test_execute_command());
+        assert(test_batch_commands());
+    }
 
     printf("All tests passed\n");
     return 0;
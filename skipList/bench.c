@@ -0,0 +1,167 @@
+// benchmark the skiplist against the AVL tree it replaced as the index of the ZSet, for inserts, range scans from a member, lookups by rank and deletes
+#include "skipList.h"
+#include "../AVLTree/AVLTree.h"
+#include <time.h>
+
+#define BENCH_OPS (1 << 18)
+#define BENCH_RANGE 100
+
+// the secondary index of the AVL tree is the key of a member
+int compare_scnd_index(void *scnd_index1, void *scnd_index2)
+{
+    return strcmp((char *)scnd_index1, (char *)scnd_index2) != 0;
+}
+
+// nanoseconds since an arbitrary point
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// time every operation on an index of num_keys members, and print a line of results for each index
+static void bench(int num_keys, char **keys, float *scores)
+{
+    // inserts
+    double start = now_ns();
+    SkipList *list = skiplist_init();
+    for (int i = 0; i < num_keys; i++)
+    {
+        skiplist_insert(list, keys[i], scores[i]);
+    }
+    double list_insert = (now_ns() - start) / num_keys;
+
+    start = now_ns();
+    AVLNode *tree = NULL;
+    for (int i = 0; i < num_keys; i++)
+    {
+        tree = avl_insert(tree, keys[i], scores[i]);
+    }
+    double tree_insert = (now_ns() - start) / num_keys;
+
+    // range scans of BENCH_RANGE members starting at a member, like ZQUERY, which reads the key and the score of every member
+    int ops = BENCH_OPS / BENCH_RANGE;
+    double sum = 0;
+    srand(1);
+    start = now_ns();
+    for (int i = 0; i < ops; i++)
+    {
+        int member = rand() % num_keys;
+        int rank;
+        SkipListNode *node = skiplist_search_pair(list, keys[member], scores[member], &rank);
+        for (int j = 0; j < BENCH_RANGE && node; j++, node = node->level[0].forward)
+        {
+            sum += node->score + node->key[0];
+        }
+    }
+    double list_range = (now_ns() - start) / ops;
+
+    srand(1);
+    start = now_ns();
+    for (int i = 0; i < ops; i++)
+    {
+        int member = rand() % num_keys;
+        AVLNode *node = avl_search_pair(tree, keys[member], scores[member]);
+        for (int j = 0; j < BENCH_RANGE && node; j++, node = avl_offset(node, 1))
+        {
+            sum -= node->value + ((char *)node->scnd_index)[0];
+        }
+    }
+    double tree_range = (now_ns() - start) / ops;
+
+    // lookups by rank, the AVL tree offsets from its first node like a ZQUERY rank query
+    srand(2);
+    start = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        sum += skiplist_get_by_rank(list, rand() % num_keys)->score;
+    }
+    double list_rank = (now_ns() - start) / BENCH_OPS;
+
+    srand(2);
+    AVLNode *min = get_min_node(tree);
+    start = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        sum -= avl_offset(min, rand() % num_keys)->value;
+    }
+    double tree_rank = (now_ns() - start) / BENCH_OPS;
+
+    // deletes of every member, in the order they were inserted
+    start = now_ns();
+    for (int i = 0; i < num_keys; i++)
+    {
+        skiplist_delete(list, keys[i], scores[i]);
+    }
+    double list_delete = (now_ns() - start) / num_keys;
+
+    start = now_ns();
+    for (int i = 0; i < num_keys; i++)
+    {
+        tree = avl_delete(tree, keys[i], scores[i]);
+    }
+    double tree_delete = (now_ns() - start) / num_keys;
+
+    printf("%10d %10s %12.1f %12.1f %12.1f %12.1f\n", num_keys, "skiplist", list_insert, list_range, list_rank, list_delete);
+    printf("%10d %10s %12.1f %12.1f %12.1f %12.1f\n", num_keys, "avl", tree_insert, tree_range, tree_rank, tree_delete);
+
+    // keeps the compiler from dropping the reads
+    if (sum == 0.5)
+    {
+        printf("\n");
+    }
+
+    skiplist_free(list);
+}
+
+int main()
+{
+    int sizes[] = {1 << 10, 1 << 16, 1 << 20};
+    int max_keys = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+
+    // distinct random scores, so neither index is slowed down by equal scores
+    char **keys = malloc(sizeof(char *) * max_keys);
+    float *scores = malloc(sizeof(float) * max_keys);
+    srand(0);
+    for (int i = 0; i < max_keys; i++)
+    {
+        char key[32];
+        sprintf(key, "member:%d", i);
+        keys[i] = strdup(key);
+        scores[i] = (float)i;
+    }
+
+    for (int i = max_keys - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        float score = scores[i];
+        scores[i] = scores[j];
+        scores[j] = score;
+    }
+
+    printf("%10s %10s %12s %12s %12s %12s\n", "members", "index", "insert ns", "range ns", "rank ns", "delete ns");
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        bench(sizes[i], keys, scores);
+    }
+
+    // a leaderboard where many members share a score, the AVL tree searches both subtrees of equal scores while the skiplist orders them by key
+    printf("16 distinct scores\n");
+    for (int i = 0; i < max_keys; i++)
+    {
+        scores[i] = (float)((int)scores[i] % 16);
+    }
+
+    bench(sizes[0], keys, scores);
+    bench(sizes[1] / 4, keys, scores);
+
+    for (int i = 0; i < max_keys; i++)
+    {
+        free(keys[i]);
+    }
+    free(keys);
+    free(scores);
+
+    return 0;
+}
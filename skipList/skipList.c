@@ -0,0 +1,658 @@
+// * This file contains the implementation of the skiplist, the ordered index of the ZSet. The nodes are sorted by score, and nodes with equal scores by key, so every node has a single place in the list. Every node is on the lowest level, and on each level above with probability SKIPLIST_P, so a search skips over most of the nodes on the higher levels and takes O(log n) steps. Each link also stores the number of nodes it spans, which gives the rank of a node on the way down and finds a node by its rank in O(log n). Range scans follow the links of the lowest level, one node after another, without climbing back up like an in-order walk of a tree.
+
+//! Ranks are 0 based, internally the header has rank 0 and the first node rank 1, which is what the spans add up to.
+
+#include "skipList.h"
+
+/**
+ * @brief Creates a node with a number of levels, the key is copied into the same allocation, after the levels, so a range scan reads one allocation per node
+ *
+ * @param level The number of levels of the node
+ * @param key The key of the node, or NULL for the header
+ * @param score The score of the node
+ *
+ * @return SkipListNode* The node
+ */
+static SkipListNode *skiplist_create_node(int level, char *key, float score)
+{
+    size_t key_size = key != NULL ? strlen(key) + 1 : 0;
+    SkipListNode *node = calloc(1, sizeof(SkipListNode) + level * sizeof(struct SkipListLevel) + key_size);
+    if (node == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (key != NULL)
+    {
+        node->key = (char *)&node->level[level];
+        memcpy(node->key, key, key_size);
+    }
+
+    node->score = score;
+
+    return node;
+}
+
+/**
+ * @brief Picks the number of levels of a new node, each level above the first with probability SKIPLIST_P
+ *
+ * @return int The number of levels
+ */
+static int skiplist_random_level()
+{
+    int level = 1;
+    while (level < SKIPLIST_MAX_LEVEL && (random() & 0xFFFF) < SKIPLIST_P * 0xFFFF)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+/**
+ * @brief Checks if the node a link points to goes before a score and a key, the score is read from the link so the node is only read when the scores are equal
+ *
+ * @param link The link
+ * @param score The score
+ * @param key The key
+ *
+ * @return bool true if the link points to a node that goes before the score and the key
+ */
+static inline bool skiplist_link_before(struct SkipListLevel *link, float score, char *key)
+{
+    return link->forward && (link->forward_score < score || (link->forward_score == score && strcmp(link->forward->key, key) < 0));
+}
+
+/**
+ * @brief Finds the last node of every level that goes before a score and a key
+ *
+ * @param list The skiplist
+ * @param score The score
+ * @param key The key
+ * @param update Set to the last node of every level before the score and the key
+ * @param rank Set to the rank of the node of every level, 0 for the header
+ */
+static void skiplist_find_update(SkipList *list, float score, char *key, SkipListNode **update, int *rank)
+{
+    SkipListNode *node = list->header;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        rank[i] = i == list->level - 1 ? 0 : rank[i + 1];
+        while (skiplist_link_before(&node->level[i], score, key))
+        {
+            rank[i] += node->level[i].span;
+            node = node->level[i].forward;
+        }
+
+        update[i] = node;
+    }
+}
+
+/**
+ * @brief Initializes an empty skiplist
+ *
+ * @return SkipList* The skiplist
+ */
+SkipList *skiplist_init()
+{
+    SkipList *list = calloc(1, sizeof(SkipList));
+    if (list == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    list->header = skiplist_create_node(SKIPLIST_MAX_LEVEL, NULL, 0);
+    list->tail = NULL;
+    list->length = 0;
+    list->level = 1;
+
+    return list;
+}
+
+/**
+ * @brief Builds the skiplist from nodes sorted by score and key, each node is appended after the last one, so the build is O(n) instead of a search per node
+ *
+ * @param list The skiplist, it must be empty
+ * @param keys The keys of the nodes, copied, sorted with the scores and without duplicate pairs
+ * @param scores The scores of the nodes
+ * @param count The number of nodes
+ */
+void skiplist_build(SkipList *list, char **keys, float *scores, int count)
+{
+    // the last node of every level and its rank, the header until a node of the level is appended
+    SkipListNode *last[SKIPLIST_MAX_LEVEL];
+    int last_rank[SKIPLIST_MAX_LEVEL];
+    for (int i = 0; i < SKIPLIST_MAX_LEVEL; i++)
+    {
+        last[i] = list->header;
+        last_rank[i] = 0;
+    }
+
+    for (int rank = 1; rank <= count; rank++)
+    {
+        int level = skiplist_random_level();
+        SkipListNode *node = skiplist_create_node(level, keys[rank - 1], scores[rank - 1]);
+        for (int i = 0; i < level; i++)
+        {
+            last[i]->level[i].forward = node;
+            last[i]->level[i].forward_score = node->score;
+            last[i]->level[i].span = rank - last_rank[i];
+            last[i] = node;
+            last_rank[i] = rank;
+        }
+
+        node->backward = list->tail;
+        list->tail = node;
+
+        if (level > list->level)
+        {
+            list->level = level;
+        }
+    }
+
+    // the last link of every level spans to the end of the list
+    for (int i = 0; i < list->level; i++)
+    {
+        last[i]->level[i].span = count - last_rank[i];
+    }
+
+    list->length = count;
+}
+
+/**
+ * @brief Links a node into the skiplist at the position of its score and key
+ *
+ * @param list The skiplist
+ * @param node The node, not linked into the skiplist
+ * @param level The number of levels of the node
+ */
+static void skiplist_link(SkipList *list, SkipListNode *node, int level)
+{
+    SkipListNode *update[SKIPLIST_MAX_LEVEL];
+    int rank[SKIPLIST_MAX_LEVEL];
+
+    // find the last node of every level that goes before the node, and its rank
+    skiplist_find_update(list, node->score, node->key, update, rank);
+
+    // the levels the list did not have yet start at the header, and span every node
+    if (level > list->level)
+    {
+        for (int i = list->level; i < level; i++)
+        {
+            rank[i] = 0;
+            update[i] = list->header;
+            update[i]->level[i].span = list->length;
+        }
+
+        list->level = level;
+    }
+
+    for (int i = 0; i < level; i++)
+    {
+        node->level[i].forward = update[i]->level[i].forward;
+        node->level[i].forward_score = update[i]->level[i].forward_score;
+        update[i]->level[i].forward = node;
+        update[i]->level[i].forward_score = node->score;
+
+        // the link of the previous node is split in two at the node
+        node->level[i].span = update[i]->level[i].span - (rank[0] - rank[i]);
+        update[i]->level[i].span = (rank[0] - rank[i]) + 1;
+    }
+
+    // the links above the node now span one more node
+    for (int i = level; i < list->level; i++)
+    {
+        update[i]->level[i].span++;
+    }
+
+    node->backward = update[0] == list->header ? NULL : update[0];
+    if (node->level[0].forward)
+    {
+        node->level[0].forward->backward = node;
+    }
+    else
+    {
+        list->tail = node;
+    }
+
+    list->length++;
+}
+
+/**
+ * @brief Inserts a node into the skiplist, before the nodes with a greater score, or an equal score and a greater key
+ *
+ * @param list The skiplist
+ * @param key The key of the node, copied, there must not already be a node with the key and the score
+ * @param score The score of the node
+ *
+ * @return SkipListNode* The new node, it stays at the same address until it is deleted
+ */
+SkipListNode *skiplist_insert(SkipList *list, char *key, float score)
+{
+    int level = skiplist_random_level();
+    SkipListNode *node = skiplist_create_node(level, key, score);
+    skiplist_link(list, node, level);
+
+    return node;
+}
+
+/**
+ * @brief Unlinks a node from every level of the skiplist, the node is not freed
+ *
+ * @param list The skiplist
+ * @param node The node to unlink
+ * @param update The last node of every level before the node
+ */
+static void skiplist_unlink(SkipList *list, SkipListNode *node, SkipListNode **update)
+{
+    for (int i = 0; i < list->level; i++)
+    {
+        if (update[i]->level[i].forward == node)
+        {
+            update[i]->level[i].span += node->level[i].span - 1;
+            update[i]->level[i].forward = node->level[i].forward;
+            update[i]->level[i].forward_score = node->level[i].forward_score;
+        }
+        else
+        {
+            update[i]->level[i].span--;
+        }
+    }
+
+    if (node->level[0].forward)
+    {
+        node->level[0].forward->backward = node->backward;
+    }
+    else
+    {
+        list->tail = node->backward;
+    }
+
+    while (list->level > 1 && list->header->level[list->level - 1].forward == NULL)
+    {
+        list->level--;
+    }
+
+    list->length--;
+}
+
+/**
+ * @brief Finds the last node of every level that goes before a node of the skiplist from the rank of the node, without comparing scores
+ *
+ * The rank is counted on the lowest level, so this is O(n), it is only used for a node the search by score does not reach.
+ *
+ * @param list The skiplist
+ * @param node The node
+ * @param update Set to the last node of every level before the node
+ */
+static void skiplist_find_update_by_rank(SkipList *list, SkipListNode *node, SkipListNode **update)
+{
+    int node_rank = 1;
+    SkipListNode *current = list->header->level[0].forward;
+    while (current != node)
+    {
+        if (current == NULL)
+        {
+            fprintf(stderr, "Node not in the skiplist\n");
+            exit(EXIT_FAILURE);
+        }
+
+        current = current->level[0].forward;
+        node_rank++;
+    }
+
+    current = list->header;
+    int traversed = 0;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        while (current->level[i].forward && traversed + current->level[i].span < node_rank)
+        {
+            traversed += current->level[i].span;
+            current = current->level[i].forward;
+        }
+
+        update[i] = current;
+    }
+}
+
+/**
+ * @brief Finds the last node of every level that goes before a node of the skiplist
+ *
+ * @param list The skiplist
+ * @param node The node
+ * @param update Set to the last node of every level before the node
+ *
+ * @return int The number of levels of the node
+ */
+static int skiplist_find_node(SkipList *list, SkipListNode *node, SkipListNode **update)
+{
+    int rank[SKIPLIST_MAX_LEVEL];
+    skiplist_find_update(list, node->score, node->key, update, rank);
+
+    // a score that does not compare, like NaN, stops the search before the node, unlinking from there would leave the node linked
+    if (update[0]->level[0].forward != node)
+    {
+        skiplist_find_update_by_rank(list, node, update);
+    }
+
+    int level = 0;
+    while (level < list->level && update[level]->level[level].forward == node)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+/**
+ * @brief Deletes a node of the skiplist and frees it
+ *
+ * @param list The skiplist
+ * @param node The node
+ */
+void skiplist_delete_node(SkipList *list, SkipListNode *node)
+{
+    SkipListNode *update[SKIPLIST_MAX_LEVEL];
+    skiplist_find_node(list, node, update);
+    skiplist_unlink(list, node, update);
+
+    free(node);
+}
+
+/**
+ * @brief Unlinks the nodes of a range of ranks from the skiplist, the links before the first node are found once and stay the links before every node of the range
+ *
+ * @param list The skiplist
+ * @param start The rank of the first node
+ * @param end The rank of the last node, included
+ * @param removed Set to the first node unlinked, the nodes stay linked to each other by their forward link of the lowest level, the last one to NULL. They are freed with skiplist_free_nodes()
+ *
+ * @return int The number of nodes unlinked
+ */
+int skiplist_delete_range_by_rank(SkipList *list, int start, int end, SkipListNode **removed)
+{
+    SkipListNode *update[SKIPLIST_MAX_LEVEL];
+    SkipListNode *node = list->header;
+    int traversed = 0;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        while (node->level[i].forward && traversed + node->level[i].span <= start)
+        {
+            traversed += node->level[i].span;
+            node = node->level[i].forward;
+        }
+
+        update[i] = node;
+    }
+
+    SkipListNode *first = node->level[0].forward;
+    SkipListNode *last = NULL;
+    int count = 0;
+
+    // the 1 based rank of update[0] is the 0 based rank of the node after it, so traversed is the rank of node from here on
+    node = first;
+    while (node && traversed <= end)
+    {
+        SkipListNode *next = node->level[0].forward;
+        skiplist_unlink(list, node, update);
+
+        last = node;
+        node = next;
+        traversed++;
+        count++;
+    }
+
+    if (last)
+    {
+        last->level[0].forward = NULL;
+    }
+
+    *removed = count > 0 ? first : NULL;
+
+    return count;
+}
+
+/**
+ * @brief Frees nodes unlinked by skiplist_delete_range_by_rank()
+ *
+ * @param nodes The first node, set to the first node that was not freed, NULL once every node is freed
+ * @param count The maximum number of nodes to free, -1 to free every node
+ *
+ * @return int The number of nodes freed
+ */
+int skiplist_free_nodes(SkipListNode **nodes, int count)
+{
+    int freed = 0;
+    SkipListNode *node = *nodes;
+    while (node != NULL && freed != count)
+    {
+        SkipListNode *next = node->level[0].forward;
+        free(node);
+        node = next;
+        freed++;
+    }
+
+    *nodes = node;
+
+    return freed;
+}
+
+/**
+ * @brief Changes the score of a node of the skiplist, the node keeps its address and its key
+ *
+ * When the node stays between the same neighbours only the score is changed, otherwise the node is unlinked and linked again at its new position, with the same levels.
+ *
+ * @param list The skiplist
+ * @param node The node
+ * @param score The new score
+ */
+void skiplist_update_score(SkipList *list, SkipListNode *node, float score)
+{
+    if (node->score == score)
+    {
+        return;
+    }
+
+    SkipListNode *update[SKIPLIST_MAX_LEVEL];
+    int level = skiplist_find_node(list, node, update);
+
+    SkipListNode *next = node->level[0].forward;
+    bool after_previous = node->backward == NULL || node->backward->score < score || (node->backward->score == score && strcmp(node->backward->key, node->key) < 0);
+    bool before_next = next == NULL || score < next->score || (score == next->score && strcmp(node->key, next->key) < 0);
+    if (after_previous && before_next)
+    {
+        // the links to the node cache its score
+        node->score = score;
+        for (int i = 0; i < level; i++)
+        {
+            update[i]->level[i].forward_score = score;
+        }
+
+        return;
+    }
+
+    skiplist_unlink(list, node, update);
+    node->score = score;
+    skiplist_link(list, node, level);
+}
+
+/**
+ * @brief Deletes the node with a key and a score from the skiplist
+ *
+ * @param list The skiplist
+ * @param key The key of the node
+ * @param score The score of the node
+ *
+ * @return bool true if the node was deleted, false if it was not found
+ */
+bool skiplist_delete(SkipList *list, char *key, float score)
+{
+    SkipListNode *update[SKIPLIST_MAX_LEVEL];
+    int rank[SKIPLIST_MAX_LEVEL];
+    skiplist_find_update(list, score, key, update, rank);
+
+    SkipListNode *node = update[0]->level[0].forward;
+    if (node == NULL || node->score != score || strcmp(node->key, key) != 0)
+    {
+        return false;
+    }
+
+    skiplist_unlink(list, node, update);
+    free(node);
+
+    return true;
+}
+
+/**
+ * @brief Searches for the first node with a score at least a value
+ *
+ * @param list The skiplist
+ * @param score The value
+ * @param rank Set to the rank of the node if it is found
+ *
+ * @return SkipListNode* The first node with a score at least the value, NULL if every score is lower
+ */
+SkipListNode *skiplist_lower_bound(SkipList *list, float score, int *rank)
+{
+    SkipListNode *node = list->header;
+    int traversed = 0;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        while (node->level[i].forward && node->level[i].forward_score < score)
+        {
+            traversed += node->level[i].span;
+            node = node->level[i].forward;
+        }
+    }
+
+    node = node->level[0].forward;
+    if (node == NULL)
+    {
+        return NULL;
+    }
+
+    *rank = traversed;
+    return node;
+}
+
+/**
+ * @brief Counts the nodes with a score lower than a value, or at most the value, from the spans of the links on the way down
+ *
+ * @param list The skiplist
+ * @param score The value
+ * @param inclusive true to count the nodes with a score at most the value, false for the nodes with a lower score
+ *
+ * @return int The number of nodes
+ */
+int skiplist_count_lower(SkipList *list, float score, bool inclusive)
+{
+    SkipListNode *node = list->header;
+    int traversed = 0;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        while (node->level[i].forward && (node->level[i].forward_score < score || (inclusive && node->level[i].forward_score == score)))
+        {
+            traversed += node->level[i].span;
+            node = node->level[i].forward;
+        }
+    }
+
+    return traversed;
+}
+
+/**
+ * @brief Searches for the node with a key and a score
+ *
+ * @param list The skiplist
+ * @param key The key to search for
+ * @param score The score of the key
+ * @param rank Set to the rank of the node if it is found
+ *
+ * @return SkipListNode* The node, NULL if there is none
+ */
+SkipListNode *skiplist_search_pair(SkipList *list, char *key, float score, int *rank)
+{
+    SkipListNode *node = list->header;
+    int traversed = 0;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        while (skiplist_link_before(&node->level[i], score, key))
+        {
+            traversed += node->level[i].span;
+            node = node->level[i].forward;
+        }
+    }
+
+    node = node->level[0].forward;
+    if (node == NULL || node->score != score || strcmp(node->key, key) != 0)
+    {
+        return NULL;
+    }
+
+    *rank = traversed;
+    return node;
+}
+
+/**
+ * @brief Returns the node at a rank
+ *
+ * @param list The skiplist
+ * @param rank The rank of the node
+ *
+ * @return SkipListNode* The node, NULL if the rank is out of bounds
+ */
+SkipListNode *skiplist_get_by_rank(SkipList *list, int rank)
+{
+    if (rank < 0 || rank >= list->length)
+    {
+        return NULL;
+    }
+
+    SkipListNode *node = list->header;
+    int traversed = 0;
+    for (int i = list->level - 1; i >= 0; i--)
+    {
+        while (node->level[i].forward && traversed + node->level[i].span <= rank + 1)
+        {
+            traversed += node->level[i].span;
+            node = node->level[i].forward;
+        }
+
+        if (traversed == rank + 1)
+        {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Frees the skiplist and its nodes
+ *
+ * @param list The skiplist
+ */
+void skiplist_free(SkipList *list)
+{
+    SkipListNode *node = list->header->level[0].forward;
+    while (node != NULL)
+    {
+        SkipListNode *next = node->level[0].forward;
+        free(node);
+        node = next;
+    }
+
+    free(list->header);
+    free(list);
+}
+
+// print the skiplist
+void skiplist_print(SkipList *list)
+{
+    for (SkipListNode *node = list->header->level[0].forward; node != NULL; node = node->level[0].forward)
+    {
+        printf("%s: %f\n", node->key, node->score);
+    }
+}
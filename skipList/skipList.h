@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// maximum number of levels of a skiplist, enough for 4^32 nodes
+#define SKIPLIST_MAX_LEVEL 32
+
+// probability that a node of a level is also on the next level
+#define SKIPLIST_P 0.25
+
+typedef struct SkipListNode
+{
+    // the key is stored in the node, after its levels
+    char *key;
+    float score;
+
+    // the previous node on the lowest level, NULL for the first node
+    struct SkipListNode *backward;
+
+    // the next node on each level of the node, span is the number of nodes the link skips over plus one, so ranks are summed on the way down. The score of the next node is kept in the link as well, in what would be padding, so a search only reads the nodes it moves to and not every node it compares against.
+    struct SkipListLevel
+    {
+        struct SkipListNode *forward;
+        float forward_score;
+        int span;
+    } level[];
+} SkipListNode;
+
+typedef struct
+{
+    // the header is not a node of the list, it has every level and its forward links are the first node of each level
+    SkipListNode *header;
+    SkipListNode *tail;
+    int length;
+    int level;
+} SkipList;
+
+SkipList *skiplist_init();
+SkipListNode *skiplist_insert(SkipList *list, char *key, float score);
+void skiplist_build(SkipList *list, char **keys, float *scores, int count);
+bool skiplist_delete(SkipList *list, char *key, float score);
+void skiplist_delete_node(SkipList *list, SkipListNode *node);
+void skiplist_update_score(SkipList *list, SkipListNode *node, float score);
+int skiplist_delete_range_by_rank(SkipList *list, int start, int end, SkipListNode **removed);
+int skiplist_free_nodes(SkipListNode **nodes, int count);
+SkipListNode *skiplist_lower_bound(SkipList *list, float score, int *rank);
+int skiplist_count_lower(SkipList *list, float score, bool inclusive);
+SkipListNode *skiplist_search_pair(SkipList *list, char *key, float score, int *rank);
+SkipListNode *skiplist_get_by_rank(SkipList *list, int rank);
+void skiplist_free(SkipList *list);
+void skiplist_print(SkipList *list);
@@ -0,0 +1,299 @@
+#include "skipList.h"
+#include <math.h>
+
+// reference of the expected order, the keys sorted by score and by key for equal scores
+char *expectedKeys[2000];
+float expectedScores[2000];
+int expectedLength = 0;
+
+// checks the skiplist against the reference, walking it forward and backward and finding every node by its rank
+int check_list(SkipList *list)
+{
+    if (list->length != expectedLength)
+    {
+        return 1;
+    }
+
+    SkipListNode *node = list->header->level[0].forward;
+    SkipListNode *previous = NULL;
+    for (int i = 0; i < expectedLength; i++, previous = node, node = node->level[0].forward)
+    {
+        if (node == NULL || node->backward != previous || strcmp(node->key, expectedKeys[i]) != 0 || node->score != expectedScores[i])
+        {
+            return 1;
+        }
+
+        int rank = -1;
+        if (skiplist_get_by_rank(list, i) != node || skiplist_search_pair(list, node->key, node->score, &rank) != node || rank != i)
+        {
+            return 1;
+        }
+    }
+
+    return node != NULL || list->tail != previous || skiplist_get_by_rank(list, expectedLength) != NULL || skiplist_get_by_rank(list, -1) != NULL;
+}
+
+// inserts a key into the reference at the position of its score and key
+void expected_insert(char *key, float score)
+{
+    int position = expectedLength;
+    while (position > 0 && (expectedScores[position - 1] > score || (expectedScores[position - 1] == score && strcmp(expectedKeys[position - 1], key) > 0)))
+    {
+        position--;
+    }
+
+    memmove(expectedKeys + position + 1, expectedKeys + position, (expectedLength - position) * sizeof(char *));
+    memmove(expectedScores + position + 1, expectedScores + position, (expectedLength - position) * sizeof(float));
+    expectedKeys[position] = key;
+    expectedScores[position] = score;
+    expectedLength++;
+}
+
+// removes the key at a position of the reference, the key is returned
+char *expected_remove(int position)
+{
+    char *key = expectedKeys[position];
+    memmove(expectedKeys + position, expectedKeys + position + 1, (expectedLength - position - 1) * sizeof(char *));
+    memmove(expectedScores + position, expectedScores + position + 1, (expectedLength - position - 1) * sizeof(float));
+    expectedLength--;
+
+    return key;
+}
+
+int main()
+{
+    SkipList *list = skiplist_init();
+
+    // test insert, equal scores are ordered by key
+    char key[32];
+    srandom(42);
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key%d", i);
+        float score = random() % 50;
+        skiplist_insert(list, key, score);
+        expected_insert(strdup(key), score);
+    }
+
+    if (check_list(list))
+    {
+        printf("Test 1 (Insert) failed\n");
+        return 1;
+    }
+
+    // test search by score, the first node with a score at least the value is found
+    int rank = -1;
+    SkipListNode *first = skiplist_lower_bound(list, expectedScores[500], &rank);
+    if (!first || rank > 500 || first->score != expectedScores[500] || (rank > 0 && expectedScores[rank - 1] == expectedScores[500]))
+    {
+        printf("Test 2 (Search by score) failed\n");
+        return 1;
+    }
+
+    // test counts, the nodes below a score or up to it
+    int at_most = rank;
+    while (at_most < expectedLength && expectedScores[at_most] == expectedScores[500])
+    {
+        at_most++;
+    }
+
+    if (skiplist_count_lower(list, expectedScores[500], false) != rank || skiplist_count_lower(list, expectedScores[500], true) != at_most || skiplist_count_lower(list, 100, true) != expectedLength)
+    {
+        printf("Test 2 (Count) failed\n");
+        return 1;
+    }
+
+    first = skiplist_lower_bound(list, 0.5, &rank);
+    if (!first || first->score < 0.5 || rank == 0 || expectedScores[rank - 1] >= 0.5 || expectedScores[rank] != first->score)
+    {
+        printf("Test 2 (Search by score) failed\n");
+        return 1;
+    }
+
+    if (skiplist_lower_bound(list, 100, &rank) || skiplist_search_pair(list, "missing", expectedScores[0], &rank) || skiplist_search_pair(list, expectedKeys[0], expectedScores[0] + 0.5, &rank))
+    {
+        printf("Test 2 (Search by score) failed\n");
+        return 1;
+    }
+
+    // test delete, every other node in the middle of runs of equal scores
+    for (int i = expectedLength - 1; i >= 0; i -= 2)
+    {
+        if (!skiplist_delete(list, expectedKeys[i], expectedScores[i]))
+        {
+            printf("Test 3 (Delete) failed\n");
+            return 1;
+        }
+
+        free(expected_remove(i));
+    }
+
+    if (check_list(list) || skiplist_delete(list, "missing", 1))
+    {
+        printf("Test 3 (Delete) failed\n");
+        return 1;
+    }
+
+    // test update of scores, the nodes keep their address whether they move or stay between the same neighbours
+    for (int i = 0; i < 300; i++)
+    {
+        int position = random() % expectedLength;
+        float score = i % 2 ? expectedScores[position] + 0.25 : random() % 50;
+        SkipListNode *node = skiplist_search_pair(list, expectedKeys[position], expectedScores[position], &rank);
+        skiplist_update_score(list, node, score);
+
+        char *updated = expected_remove(position);
+        expected_insert(updated, score);
+        if (node->score != score || skiplist_search_pair(list, updated, score, &rank) != node)
+        {
+            printf("Test 4 (Update score) failed\n");
+            return 1;
+        }
+    }
+
+    if (check_list(list))
+    {
+        printf("Test 4 (Update score) failed\n");
+        return 1;
+    }
+
+    // test delete of a node, without its key
+    SkipListNode *middle = skiplist_get_by_rank(list, expectedLength / 2);
+    skiplist_delete_node(list, middle);
+    free(expected_remove(expectedLength / 2));
+    if (check_list(list))
+    {
+        printf("Test 5 (Delete node) failed\n");
+        return 1;
+    }
+
+    // test delete of a range of ranks, the nodes come back in order and are freed separately
+    int start = expectedLength / 3;
+    int end = start + 40;
+    SkipListNode *removed;
+    if (skiplist_delete_range_by_rank(list, start, end, &removed) != end - start + 1)
+    {
+        printf("Test 6 (Delete range) failed\n");
+        return 1;
+    }
+
+    for (SkipListNode *node = removed; node != NULL; node = node->level[0].forward)
+    {
+        char *key = expected_remove(start);
+        if (strcmp(node->key, key) != 0)
+        {
+            printf("Test 6 (Delete range) failed\n");
+            return 1;
+        }
+
+        free(key);
+    }
+
+    if (skiplist_free_nodes(&removed, 10) != 10 || skiplist_free_nodes(&removed, -1) != end - start - 9 || removed != NULL || check_list(list))
+    {
+        printf("Test 6 (Delete range) failed\n");
+        return 1;
+    }
+
+    // the range stops at the last node
+    if (skiplist_delete_range_by_rank(list, expectedLength - 2, expectedLength + 5, &removed) != 2)
+    {
+        printf("Test 6 (Delete range) failed\n");
+        return 1;
+    }
+
+    skiplist_free_nodes(&removed, -1);
+    if (skiplist_delete_range_by_rank(list, expectedLength, expectedLength + 5, &removed) != 0 || removed != NULL)
+    {
+        printf("Test 6 (Delete range) failed\n");
+        return 1;
+    }
+
+    free(expected_remove(expectedLength - 1));
+    free(expected_remove(expectedLength - 1));
+    if (check_list(list))
+    {
+        printf("Test 6 (Delete range) failed\n");
+        return 1;
+    }
+
+    // test delete of every node
+    while (expectedLength > 0)
+    {
+        expectedLength--;
+        skiplist_delete(list, expectedKeys[expectedLength], expectedScores[expectedLength]);
+        free(expectedKeys[expectedLength]);
+    }
+
+    if (check_list(list) || list->level != 1 || list->tail != NULL)
+    {
+        printf("Test 7 (Delete all) failed\n");
+        return 1;
+    }
+
+    skiplist_free(list);
+
+    // test build from sorted nodes, the list is then changed like any other
+    list = skiplist_init();
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key%04d", i);
+        expected_insert(strdup(key), i / 3);
+    }
+
+    skiplist_build(list, expectedKeys, expectedScores, expectedLength);
+    if (check_list(list))
+    {
+        printf("Test 8 (Build) failed\n");
+        return 1;
+    }
+
+    skiplist_insert(list, "key0100x", 33);
+    expected_insert(strdup("key0100x"), 33);
+    skiplist_delete(list, expectedKeys[500], expectedScores[500]);
+    free(expected_remove(500));
+    if (check_list(list))
+    {
+        printf("Test 8 (Build) failed\n");
+        return 1;
+    }
+
+    while (expectedLength > 0)
+    {
+        free(expected_remove(expectedLength - 1));
+    }
+
+    skiplist_free(list);
+
+    // test a score that does not compare, the search stops before the node once a node goes in front of it, it is still unlinked when it is deleted or its score is changed
+    list = skiplist_init();
+    SkipListNode *unordered = skiplist_insert(list, "nan", NAN);
+    skiplist_insert(list, "key1", 1);
+    expected_insert(strdup("key1"), 1);
+    skiplist_delete_node(list, unordered);
+    if (check_list(list))
+    {
+        printf("Test 9 (Unordered score) failed\n");
+        return 1;
+    }
+
+    unordered = skiplist_insert(list, "nan", NAN);
+    skiplist_insert(list, "key0", 0);
+    expected_insert(strdup("key0"), 0);
+    skiplist_update_score(list, unordered, 2);
+    expected_insert(strdup("nan"), 2);
+    if (check_list(list))
+    {
+        printf("Test 9 (Unordered score) failed\n");
+        return 1;
+    }
+
+    while (expectedLength > 0)
+    {
+        free(expected_remove(expectedLength - 1));
+    }
+
+    skiplist_free(list);
+
+    return 0;
+}